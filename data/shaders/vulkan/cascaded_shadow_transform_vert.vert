@@ -6,6 +6,7 @@
 #include "headers/shadow_mapping.glsl"
 
 layout(set = 0, binding = 0) readonly buffer VBO { Vertex data[]; } vbo;
+layout(set = 0, binding = 0) readonly buffer PackedVBO { PackedVertex data[]; } packed_vbo;
 layout(set = 0, binding = 1) readonly buffer IBO { uint data[]; } ibo;
 layout(set = 0, binding = 2) readonly buffer InstanceDataBlock 
 { 
@@ -17,15 +18,33 @@ layout(set = 1, binding = 0) readonly buffer ShadowCascadesSSBO
     CascadesData data;
 } shadow_cascades;
 
+/* Written by the draw command generation pass */
+layout(set = 2, binding = 0) readonly buffer DrawCommandsBlock { DrawCommand data[]; } draw_commands;
+layout(set = 2, binding = 2) readonly buffer PrimitivesBlock   { Primitive   data[]; } primitives;
+
+/* Index of the first draw command of the mesh : gl_DrawID is relative to the indirect draw call */
 layout(push_constant) uniform PushConstants
 {
-    mat4 model;
-} primitive_push_constants;
+    uint first_draw;
+    uint vertex_format;
+} push_constants;
 
 void main()
 {
-    uint index = ibo.data[gl_VertexIndex];
-    Vertex v = vbo.data[index];
-    vec4 position_os = vec4(v.px, v.py, v.pz, 1.0);
-    gl_Position = shadow_cascades.data.dir_light_view_proj[gl_ViewIndex] * instances.data[gl_InstanceIndex].model * primitive_push_constants.model * position_os;
+    /* Indexed draw : gl_VertexIndex is the vertex, not the position in the index buffer */
+    uint index = gl_VertexIndex;
+    Primitive primitive = primitives.data[draw_commands.data[push_constants.first_draw + gl_DrawID].primitive_idx];
+
+    /* Only the position is fetched */
+    vec4 position_os;
+    if (push_constants.vertex_format == VERTEX_FORMAT_PACKED)
+    {
+        position_os = vec4(unpack_position(packed_vbo.data[index], primitive.bbox_min_os.xyz, primitive.bbox_max_os.xyz), 1.0);
+    }
+    else
+    {
+        Vertex v = vbo.data[index];
+        position_os = vec4(v.px, v.py, v.pz, 1.0);
+    }
+    gl_Position = shadow_cascades.data.dir_light_view_proj[gl_ViewIndex] * instances.data[gl_InstanceIndex].model * primitive.model * position_os;
 }
\ No newline at end of file
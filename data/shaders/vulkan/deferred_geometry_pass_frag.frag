@@ -2,55 +2,81 @@
 #extension GL_EXT_nonuniform_qualifier : enable
 
 #include "headers/normal_mapping.glsl" 
+#include "headers/data.glsl"
 
 layout(location = 1) in vec4 normal_vs;
 layout(location = 2) in vec2 uv;
 layout(location = 3) in vec3 vertex_to_eye_ws;
+layout(location = 4) flat in uint material_id;
 
 layout(location = 0) out vec4  gbuffer_base_color;
 layout(location = 1) out vec2  gbuffer_normal_vs;
 layout(location = 2) out vec2  gbuffer_metalness_roughness;
 layout(location = 3) out vec4  gbuffer_lighting_accumulation;
 
-layout(push_constant) uniform constants
+layout(set = 2, binding = 3) readonly buffer MaterialsBlock
 {
-    layout(offset = 64)
-    int texture_base_color_idx;
-    int texture_normal_map_idx;
-    int texture_metalness_roughness_idx;
-    int texture_emissive_map_idx;
-    vec4 base_color;
-    vec3 emissive_factor;
-    float pad;
-    vec2 metalness_roughness;
-} material;
+    Material data[];
+} materials;
 
 layout(set = 1, binding = 0) uniform sampler2D bindless_tex[];
 
+/* Mip feedback for the texture streamer : largest texture size (in texels) needed, per texture id */
+layout(set = 1, binding = 1) buffer TextureFeedback
+{
+    uint requested_size[];
+} texture_feedback;
+
+void request_texture_size(int texture_idx, uint texel_size)
+{
+    if(texture_idx != -1)
+    {
+        atomicMax(texture_feedback.requested_size[texture_idx], texel_size);
+    }
+}
+
 vec3 decode_gltf_normal_map(vec3 normal)
 {
     // GLTF normal map values are in [0, 1] range.
-    return normal * 2 - 1;
+    // Z is reconstructed so that two-channel (BC5) normal maps work the same as RGBA ones.
+    vec2 xy = normal.xy * 2 - 1;
+    return vec3(xy, sqrt(max(0.0, 1.0 - dot(xy, xy))));
 }
 
 void main()
 {
+    Material material = materials.data[material_id];
+    vec4 material_base_color = vec4(material.base_color_r, material.base_color_g, material.base_color_b, material.base_color_a);
+    vec3 material_emissive_factor = vec3(material.emissive_factor_r, material.emissive_factor_g, material.emissive_factor_b);
+    vec2 material_metalness_roughness = vec2(material.metalness, material.roughness);
+
+    /* Size at which one texel covers one pixel. Derivatives are taken in uniform control flow, only 1 pixel out of 16 writes it. */
+    vec2 uv_footprint = max(abs(dFdx(uv)), abs(dFdy(uv)));
+    uint texel_size = uint(min(1.0 / max(max(uv_footprint.x, uv_footprint.y), 1e-6), 65536.0));
+    if(((uint(gl_FragCoord.x) | uint(gl_FragCoord.y)) & 3u) == 0u)
+    {
+        request_texture_size(material.texture_base_color_idx, texel_size);
+        request_texture_size(material.texture_normal_map_idx, texel_size);
+        request_texture_size(material.texture_metalness_roughness_idx, texel_size);
+        request_texture_size(material.texture_emissive_map_idx, texel_size);
+    }
+
     vec3 N = normalize( normal_vs.xyz );
-    vec2 metalness_roughness = material.metalness_roughness;
-    vec4 base_color  = material.base_color;
-    vec4 emissive_color  = vec4(material.emissive_factor, 1);
+    vec2 metalness_roughness = material_metalness_roughness;
+    vec4 base_color  = material_base_color;
+    vec4 emissive_color  = vec4(material_emissive_factor, 1);
 
     /* Sample base color */
     if(material.texture_base_color_idx != -1)
     {
-        base_color = texture(bindless_tex[material.texture_base_color_idx], uv.xy).rgba * material.base_color;
+        base_color = texture(bindless_tex[material.texture_base_color_idx], uv.xy).rgba * material_base_color;
         if(base_color.a <= 0.05) discard;
     }
     gbuffer_base_color = base_color;
 
     if(material.texture_emissive_map_idx != -1)
     {
-        emissive_color = texture(bindless_tex[material.texture_emissive_map_idx], uv.xy) * vec4(material.emissive_factor, 1) * emissive_color;
+        emissive_color = texture(bindless_tex[material.texture_emissive_map_idx], uv.xy) * vec4(material_emissive_factor, 1) * emissive_color;
     }
 
     gbuffer_lighting_accumulation = emissive_color;
@@ -69,7 +95,7 @@ void main()
         Its green channel contains roughness values and its blue channel contains metalness values. */
     if(material.texture_metalness_roughness_idx != -1)
     {
-        metalness_roughness = texture(bindless_tex[material.texture_metalness_roughness_idx], uv).bg * material.metalness_roughness;
+        metalness_roughness = texture(bindless_tex[material.texture_metalness_roughness_idx], uv).bg * material_metalness_roughness;
     }
     gbuffer_metalness_roughness = metalness_roughness;
 }
\ No newline at end of file
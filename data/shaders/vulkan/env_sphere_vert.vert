@@ -16,7 +16,7 @@ layout(set = 1, binding = 1) readonly buffer IndexBuffer  { uint   data[]; } idx
 
 void main()
 {
-    uint index = idx_buffer.data[gl_VertexIndex];
+    uint index = gl_VertexIndex;
     Vertex v = vtx_buffer.data[index];
     vec4 position_os = vec4(v.px, v.py, v.pz, 1.0);
     vec4 position_cs = frame.data.proj * mat4(mat3(frame.data.view)) * position_os;
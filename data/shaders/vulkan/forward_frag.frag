@@ -9,19 +9,14 @@
 layout(location = 0) in vec4 position_ws;
 layout(location = 1) in vec4 normal_ws;
 layout(location = 2) in vec2 uv;
+layout(location = 4) flat in uint material_id;
 
 layout(location = 0) out vec4 out_color;
 
-layout(push_constant) uniform constants
+layout(set = 2, binding = 3) readonly buffer MaterialsBlock
 {
-    layout(offset = 64)
-    int texture_base_color_idx;
-    int texture_normal_map_idx;
-    int texture_metalness_roughness_idx;
-    int texture_emissive_map_idx;
-    vec4 base_color;
-    vec2 metalness_roughness;
-} push_constants;
+    Material data[];
+} materials;
 
 layout(set = 0, binding = 0) uniform FrameDataBlock 
 { 
@@ -30,20 +25,21 @@ layout(set = 0, binding = 0) uniform FrameDataBlock
 
 layout(set = 1, binding = 0) uniform sampler2D textures[];
 
-layout(set = 3, binding = 0) buffer ShaderParams 
+layout(set = 4, binding = 0) buffer ShaderParams 
 { 
     bool enable_normal_mapping; 
 } shader_params;
 
 void main()
 {
-    ivec4 mat = ivec4(push_constants.texture_base_color_idx, push_constants.texture_normal_map_idx, push_constants.texture_metalness_roughness_idx, push_constants.texture_emissive_map_idx);
+    Material material = materials.data[material_id];
+    ivec4 mat = ivec4(material.texture_base_color_idx, material.texture_normal_map_idx, material.texture_metalness_roughness_idx, material.texture_emissive_map_idx);
     
     vec3 light_color = vec3(0.27,0.1,0.01);
 
     BRDFData brdf_data;
-    brdf_data.albedo = push_constants.base_color.rgb;
-    brdf_data.metalness_roughness = push_constants.metalness_roughness;
+    brdf_data.albedo = vec3(material.base_color_r, material.base_color_g, material.base_color_b);
+    brdf_data.metalness_roughness = vec2(material.metalness, material.roughness);
     brdf_data.normal_ws = normalize(normal_ws).xyz;
     brdf_data.viewdir_ws = normalize(frame.data.eye_pos_ws - position_ws).xyz;
     brdf_data.lightdir_ws = normalize(-vec3(1, -1, 0));
@@ -60,7 +56,7 @@ void main()
         brdf_data.normal_ws = perturb_normal(brdf_data.normal_ws, N_TS, brdf_data.viewdir_ws, uv);
     }
 
-    brdf_data.albedo = push_constants.base_color.rgb;
+    brdf_data.albedo = vec3(material.base_color_r, material.base_color_g, material.base_color_b);
      
     if (mat.x > -1)
     {
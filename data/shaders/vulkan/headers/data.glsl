@@ -12,4 +12,81 @@ struct InstanceData
 {
     mat4  model;
     vec4  color;
-};
\ No newline at end of file
+};
+
+/* Primitives of all meshes, see ObjectManager::GPUPrimitive */
+struct Primitive
+{
+    mat4 model;
+    uint mesh_idx;
+    uint material_id;
+    uint first_vertex;
+    uint vertex_count;
+    vec4 bbox_min_os;
+    vec4 bbox_max_os;
+    int base_vertex;
+    uint first_meshlet;
+    uint meshlet_count;
+    uint first_lod;
+    uint lod_count;
+    uint pad0;
+    uint pad1;
+    uint pad2;
+};
+
+/* LODs of all primitives, see ObjectManager::GPUPrimitiveLod */
+struct PrimitiveLod
+{
+    uint first_index;
+    uint index_count;
+    float error;
+    uint pad0;
+};
+
+/* Meshlets of all meshes, see ObjectManager::GPUMeshlet */
+struct Meshlet
+{
+    vec4 bounding_sphere;
+    vec4 cone;
+    uint primitive_idx;
+    uint first_index;
+    uint index_count;
+    uint pad0;
+};
+
+/* See ObjectManager::GPUMeshDrawData */
+struct MeshDrawData
+{
+    uint first_primitive;
+    uint num_primitives;
+    uint instance_count;
+    uint first_draw;
+    uint draw_capacity;
+    uint first_meshlet;
+    uint num_meshlets;
+    uint pad0;
+};
+
+/* VkDrawIndexedIndirectCommand followed by the index of the primitive drawn */
+struct DrawCommand
+{
+    uint index_count;
+    uint instance_count;
+    uint first_index;
+    int  vertex_offset;
+    uint first_instance;
+    uint primitive_idx;
+};
+
+/* Scalar members only : std430 stride matches the C++ Material (56 bytes) */
+struct Material
+{
+    int texture_base_color_idx;
+    int texture_normal_map_idx;
+    int texture_metalness_roughness_idx;
+    int texture_emissive_map_idx;
+    float base_color_r, base_color_g, base_color_b, base_color_a;
+    float emissive_factor_r, emissive_factor_g, emissive_factor_b;
+    float pad;
+    float metalness, roughness;
+};
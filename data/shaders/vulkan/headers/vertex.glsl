@@ -3,4 +3,54 @@ struct Vertex
     float px,py,pz;
     float nx,ny,nz;
     float u, v, w;
-};
\ No newline at end of file
+};
+
+/* See PackedVertexData in VulkanMesh.h */
+struct PackedVertex
+{
+    uint pos_xy;
+    uint pos_z;
+    uint normal;
+    uint uv;
+};
+
+/* See VertexFormat in VulkanMesh.h */
+#define VERTEX_FORMAT_FLOAT  0
+#define VERTEX_FORMAT_PACKED 1
+
+/*
+    Index i of an index buffer read as an SSBO of uints. 16 bit indices (VulkanMesh::index_type) are packed two per uint :
+    pass the uint holding index i, e.g. pull_index_16(idx_buffer.data[i >> 1], i). Indices are local to their primitive.
+*/
+uint pull_index_16(uint packed_indices, uint i)
+{
+    return (packed_indices >> ((i & 1u) * 16u)) & 0xFFFFu;
+}
+
+vec3 decode_octahedral(vec2 e)
+{
+    vec3 n = vec3(e.xy, 1.0 - abs(e.x) - abs(e.y));
+    float t = max(-n.z, 0.0);
+    n.x += n.x >= 0.0 ? -t : t;
+    n.y += n.y >= 0.0 ? -t : t;
+    return normalize(n);
+}
+
+/* Positions are quantized to the object space bounds of the primitive */
+vec3 unpack_position(PackedVertex p, vec3 bbox_min_os, vec3 bbox_max_os)
+{
+    return bbox_min_os + vec3(unpackUnorm2x16(p.pos_xy), unpackUnorm2x16(p.pos_z).x) * (bbox_max_os - bbox_min_os);
+}
+
+Vertex unpack_vertex(PackedVertex p, vec3 bbox_min_os, vec3 bbox_max_os)
+{
+    vec3 pos = unpack_position(p, bbox_min_os, bbox_max_os);
+    vec3 normal = decode_octahedral(unpackSnorm2x16(p.normal));
+    vec2 uv = unpackHalf2x16(p.uv);
+
+    Vertex v;
+    v.px = pos.x; v.py = pos.y; v.pz = pos.z;
+    v.nx = normal.x; v.ny = normal.y; v.nz = normal.z;
+    v.u = uv.x; v.v = uv.y; v.w = 0.0;
+    return v;
+}
\ No newline at end of file
@@ -7,8 +7,10 @@ layout(location = 0) out vec4 position_ws;
 layout(location = 1) out vec4 normal_vs;
 layout(location = 2) out vec2 uv;
 layout(location = 3) out vec3 vertex_to_eye_ws;
+layout(location = 4) flat out uint material_id;
 
 layout(set = 2, binding = 0) readonly buffer VertexBufferBlock  { Vertex data[]; } vtx_buffer;
+layout(set = 2, binding = 0) readonly buffer PackedVertexBufferBlock { PackedVertex data[]; } packed_vtx_buffer;
 layout(set = 2, binding = 1) readonly buffer IndexBufferBlock   { uint   data[]; } idx_buffer;
 layout(set = 2, binding = 2) readonly buffer InstanceDataBlock 
 { 
@@ -20,18 +22,36 @@ layout(set = 0, binding = 0) uniform FrameDataBlock
     FrameData data;
 } frame;
 
+/* Written by the draw command generation pass */
+layout(set = 3, binding = 0) readonly buffer DrawCommandsBlock { DrawCommand data[]; } draw_commands;
+layout(set = 3, binding = 2) readonly buffer PrimitivesBlock   { Primitive   data[]; } primitives;
+
+/* Index of the first draw command of the mesh : gl_DrawID is relative to the indirect draw call */
 layout (push_constant) uniform PushConstantsBlock
 {
-    mat4 model;
-} primitive_push_constants;
+    uint first_draw;
+    uint vertex_format;
+} push_constants;
 
 void main()
 {
-    uint index = idx_buffer.data[gl_VertexIndex];
-    Vertex v = vtx_buffer.data[index];
+    /* Indexed draw : gl_VertexIndex is the vertex, not the position in the index buffer */
+    uint index = gl_VertexIndex;
+    Primitive primitive = primitives.data[draw_commands.data[push_constants.first_draw + gl_DrawID].primitive_idx];
+    material_id = primitive.material_id;
+
+    Vertex v;
+    if (push_constants.vertex_format == VERTEX_FORMAT_PACKED)
+    {
+        v = unpack_vertex(packed_vtx_buffer.data[index], primitive.bbox_min_os.xyz, primitive.bbox_max_os.xyz);
+    }
+    else
+    {
+        v = vtx_buffer.data[index];
+    }
     vec4 position_os = vec4(v.px, v.py, v.pz, 1.0);
 
-    mat4 model = instances.data[gl_InstanceIndex].model * primitive_push_constants.model;
+    mat4 model = instances.data[gl_InstanceIndex].model * primitive.model;
     position_ws = model * position_os;
     vec4 position_cs = frame.data.view_proj * position_ws;
     mat4 normal_mat = transpose(inverse(  model  ));
@@ -24,7 +24,7 @@ layout(set = 0, binding = 0) uniform FrameDataBlock
 
 void main()
 {
-    uint index = idx_buffer.data[gl_VertexIndex];
+    uint index = gl_VertexIndex;
     Vertex v = vtx_buffer.data[index];
     light_instance_index = gl_InstanceIndex;
     gl_Position = ps.view_proj * instances.data[gl_InstanceIndex].model * vec4(v.px, v.py, v.pz, 1.0);
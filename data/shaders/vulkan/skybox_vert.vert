@@ -22,7 +22,7 @@ layout(set = 1, binding = 1) readonly buffer IndexBuffer  { uint   data[]; } idx
 
 void main()
 {
-    uint index = idx_buffer.data[gl_VertexIndex];
+    uint index = gl_VertexIndex;
     Vertex v = vtx_buffer.data[index];
     position_os = vec4(v.px, v.py, v.pz, 1.0);
     vec4 position_ws = ps.model * position_os;
@@ -39,7 +39,7 @@ const vec4 layer_index_color[6] =
 
 void main()
 {
-    uint index = idx_buffer.data[gl_VertexIndex];
+    uint index = gl_VertexIndex;
     Vertex v = vtx_buffer.data[index];
     position_os = vec4(v.px, v.py, v.pz, 1.0);
     debug_color = layer_index_color[gl_ViewIndex];
@@ -9,7 +9,7 @@ project("corelib")
 	lib_dir = engine_root .. "src/thirdparty/"
 
 	lib_list = {
-		os.getenv("VULKAN_SDK") .. "/Lib",
+		vulkan_sdk .. "/Lib",
 	}
 
 	location(project_path)
@@ -39,7 +39,7 @@ project("corelib")
 		lib_dir .. "imgui",
 		lib_dir .. "imgui/widgets/imguizmo",
 		lib_dir .. "cgltf",
-		os.getenv("VULKAN_SDK") .. "/Include"
+		vulkan_sdk .. "/Include"
 	}
 	
 	targetdir	(engine_root .. "build/bin/" .. outputdir )
@@ -47,19 +47,31 @@ project("corelib")
 
 	filter "system:windows"
 		systemversion "latest"
-		defines { "WIN32_LEAN_AND_MEAN", "GLM_FORCE_DEPTH_ZERO_TO_ONE", "_CRT_SECURE_NO_WARNINGS"}
-		links	{ "vulkan-1", "imgui", "OptickCore", "shcore" }
+		defines { "WIN32_LEAN_AND_MEAN", "GLM_FORCE_DEPTH_ZERO_TO_ONE", "_CRT_SECURE_NO_WARNINGS", "SHADERC_SHAREDLIB"}
+		links	{ "vulkan-1", "imgui", "OptickCore", "shcore", "shaderc_shared" }
+
+	filter "system:linux"
+		defines { "GLM_FORCE_DEPTH_ZERO_TO_ONE", "SHADERC_SHAREDLIB"}
+		links	{ "vulkan", "imgui", "OptickCore", "shaderc_shared", "pthread", "dl" }
+		if vulkan_sdk ~= "" then
+			includedirs { vulkan_sdk .. "/include" }
+			libdirs { vulkan_sdk .. "/lib" }
+		end
 		
 	filter "configurations:Debug"
 		runtime "Debug"
 		symbols "on"
-		buildoptions {"/Od", "/WX",  "/permissive-"}
 		defines { "ENGINE_DEBUG", "GLM_DEPTH_ZERO_TO_ONE" }
 		libdirs { lib_list, lib_dir .. "optick/lib/x64/debug/" }
 		
 	filter "configurations:Release"
 		runtime "Release"
 		optimize "off"
-		buildoptions { "/WX",  "/permissive-"}
 		defines { "ENGINE_RELEASE", "GLM_DEPTH_ZERO_TO_ONE" }
-		libdirs { lib_list, lib_dir .. "optick/lib/x64/release/" }
\ No newline at end of file
+		libdirs { lib_list, lib_dir .. "optick/lib/x64/release/" }
+
+	filter { "toolset:msc*", "configurations:Debug" }
+		buildoptions {"/Od", "/WX",  "/permissive-"}
+
+	filter { "toolset:msc*", "configurations:Release" }
+		buildoptions { "/WX",  "/permissive-"}
@@ -11,15 +11,22 @@ project "imgui"
     vpaths { ["imgui"] = { imgui_dir .. "*.cpp", imgui_dir .. "*.h", imgui_dir .. "misc/debuggers/*.natvis" } }
     filter { "toolset:msc*" }
         files { imgui_dir .. "misc/debuggers/*.natvis" }
-    filter { "system:windows" }
-    includedirs { imgui_dir, os.getenv("VULKAN_SDK") .. "/Include"  }
+    filter {}
+    includedirs { imgui_dir, vulkan_sdk .. "/Include"  }
     files { 
         imgui_dir .. "*.h", imgui_dir .. "*.cpp", 
-        imgui_dir .. "backends/imgui_impl_win32.h", 
         imgui_dir .. "backends/imgui_impl_vulkan.h", 
-        imgui_dir .. "backends/imgui_impl_win32.cpp",
         imgui_dir .. "backends/imgui_impl_vulkan.cpp", 
         widgets_dir .. "imguizmo/" .. "*.h", widgets_dir .. "imguizmo/" .. "*.cpp",
     }
+    filter { "system:windows" }
+    files { 
+        imgui_dir .. "backends/imgui_impl_win32.h", 
+        imgui_dir .. "backends/imgui_impl_win32.cpp",
+    }
+    filter { "system:linux" }
+    if vulkan_sdk ~= "" then
+        includedirs { vulkan_sdk .. "/include" }
+    end
 
  
\ No newline at end of file
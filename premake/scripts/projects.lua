@@ -3,7 +3,10 @@
 projects = 
 {
 	"SampleProject",
-	"ComputeShaderToy"
+	"ComputeShaderToy",
+	"TextureBaker",
+	"JobBenchmark",
+	"CullingBenchmark"
 }
 
 -- Generate projects 
@@ -24,7 +27,7 @@ for i, name in ipairs(projects) do
 
 		libdirs 
 		{
-			os.getenv("VULKAN_SDK") .. "/Lib"
+			vulkan_sdk .. "/Lib"
 		}
 		
 		files 
@@ -54,7 +57,8 @@ for i, name in ipairs(projects) do
 			lib_dir .. "stb",
 			lib_dir .. "optick/include",
 			lib_dir .. "spdlog",
-			os.getenv("VULKAN_SDK") .. "/Include"
+			lib_dir .. "cgltf",
+			vulkan_sdk .. "/Include"
 		}
 
 		links
@@ -66,11 +70,22 @@ for i, name in ipairs(projects) do
 			systemversion "latest"
 			linkoptions { "/ENTRY:mainCRTStartup" } -- Allows using main() instead of WinMain(...) as the entry point
 
+		filter "system:linux"
+			-- GNU ld resolves static libraries in order, corelib's dependencies come after it
+			links { "imgui", "vulkan", "OptickCore", "shaderc_shared", "pthread", "dl" }
+			libdirs { lib_dir .. "optick/lib/x64/%{cfg.buildcfg:lower()}/" }
+			if vulkan_sdk ~= "" then
+				includedirs { vulkan_sdk .. "/include" }
+				libdirs { vulkan_sdk .. "/lib" }
+			end
+
 		filter "configurations:Debug"
 			runtime "Debug"
 			symbols "on"
-			buildoptions {"/Od" }
 			defines { "ENGINE_DEBUG" }
+
+		filter { "toolset:msc*", "configurations:Debug" }
+			buildoptions {"/Od" }
 			disablewarnings { 
 				"4061", -- enumerator 'identifier' in switch of enum 'enumeration' is not explicitly handled by a case label
 				"4200", -- nonstandard extension used : zero-sized array in struct/union
@@ -5,6 +5,7 @@ workspace "Cardinalis"
 	architecture "x64"
 	engine_root = _WORKING_DIR .. "/"
 	premake_dir = "premake/scripts/"
+	vulkan_sdk = os.getenv("VULKAN_SDK") or "" -- unset on Linux when the headers and loader come from the distribution
 	outputdir = "%{cfg.buildcfg}-%{prj.name}-%{cfg.system}-%{cfg.architecture}" -- ex: Debug-Windows-x64
 
 
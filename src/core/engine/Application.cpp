@@ -1,6 +1,14 @@
 #include "Application.h"
 
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
 #include <iostream>
+#include <string_view>
+
+#include "imgui.h"
+#include "optick.h"
 
 #include "core/engine/logger.h"
 #include "core/engine/Window.h"
@@ -9,26 +17,62 @@
 #include "core/rendering/vulkan/vk_frame.hpp"
 #include "core/rendering/vulkan/VulkanRenderInterface.h"
 #include "core/rendering/vulkan/VulkanRendererBase.h"
+#include "core/rendering/vulkan/RenderObjectManager.h"
+#include "core/rendering/vulkan/texture_streamer.h"
+#include "core/rendering/vulkan/shader_compiler.h"
+#include "core/rendering/vulkan/VkResourceManager.h"
 #include "core/engine/vulkan/objects/vk_debug_marker.hpp"
 
-Application::Application(const char* title, uint32_t width, uint32_t height)
-    : b_init_success(false), m_debug_name(title)
+/* Headless frames advance time by a fixed step so that runs are comparable */
+static constexpr float k_headless_delta_time = 1.0f / 60.0f;
+
+Application::Application(const char* title, uint32_t width, uint32_t height, const launch_options& options)
+    : b_init_success(false), m_debug_name(title), m_options(options)
 {
-    m_window.reset(
-        new Window({.width = width, .height = height, .title = title}, this));
+#ifndef _WIN32
+    /* Only the Win32 window is implemented, other platforms render offscreen */
+    if (!m_options.headless)
+    {
+        fprintf(stderr, "No window implementation on this platform, running headless\n");
+        m_options.headless = true;
+        if (m_options.num_frames == 0)
+        {
+            m_options.num_frames = launch_options::k_default_headless_frames;
+        }
+    }
+#endif // _WIN32
+
+    if (!m_options.headless)
+    {
+        m_window.reset(
+            new Window({.width = width, .height = height, .title = title}, this));
+    }
+    else
+    {
+        /* Created by the window otherwise, renderers register their textures to the ImGui backend */
+        ImGui::CreateContext();
+        ImGui::GetIO().DisplaySize = ImVec2((float)width, (float)height);
+    }
 
     m_event_manager.reset(new EventManager(m_window.get()));
 
     logger::init("Engine");
 
     m_rhi.reset(new RenderInterface(title, 1, 3, 0));
-    m_rhi->init();
+    m_rhi->init(m_options.headless);
+    if (m_options.headless)
+    {
+        m_rhi->create_offscreen_targets(width, height);
+    }
+    else
+    {
 #ifdef _WIN32
-    m_rhi->create_surface(m_window.get());
-    m_rhi->create_swapchain();
+        m_rhi->create_surface(m_window.get());
+        m_rhi->create_swapchain();
 #else
-    assert(false);
+        assert(false);
 #endif  // _WIN32
+    }
 
     b_init_success = true;
 }
@@ -38,24 +82,249 @@ Application::~Application()
     m_rhi->terminate();
     m_rhi.release();
     m_window.release();
+
+    if (m_options.headless)
+    {
+        ImGui::DestroyContext();
+    }
+}
+
+launch_options Application::parse_command_line(int argc, char* argv[])
+{
+    launch_options options;
+
+    /* Called before the logger is initialized */
+    for (int i = 1; i < argc; i++)
+    {
+        std::string_view arg = argv[i];
+        bool has_value = i + 1 < argc;
+        if (arg == "--headless")
+        {
+            options.headless = true;
+        }
+        else if (arg == "--frames" && has_value)
+        {
+            options.num_frames = (uint32_t)std::strtoul(argv[++i], nullptr, 10);
+        }
+        else if (arg == "--scene" && has_value)
+        {
+            options.scene = argv[++i];
+        }
+        else if (arg == "--camera-path" && has_value)
+        {
+            options.camera_path = argv[++i];
+        }
+        else if (arg == "--timings" && has_value)
+        {
+            options.timings_path = argv[++i];
+        }
+        else if (arg == "--dump-image" && has_value)
+        {
+            options.dump_path = argv[++i];
+        }
+        else if (arg == "--packed-vertices")
+        {
+            options.packed_vertices = true;
+        }
+        else if (arg == "--lod-bias" && has_value)
+        {
+            options.lod_bias = std::strtof(argv[++i], nullptr);
+        }
+        else if (arg == "--optick-capture" && has_value)
+        {
+            options.optick_capture_frames = (uint32_t)std::strtoul(argv[++i], nullptr, 10);
+            if (i + 1 < argc && argv[i + 1][0] != '-')
+            {
+                options.optick_capture_path = argv[++i];
+            }
+        }
+        else
+        {
+            fprintf(stderr, "Unknown command line argument : %s\n", argv[i]);
+        }
+    }
+
+    if (options.headless && options.num_frames == 0)
+    {
+        options.num_frames = launch_options::k_default_headless_frames;
+    }
+
+    return options;
+}
+
+/* Writes a B8G8R8A8/R8G8B8A8 image in TRANSFER_SRC_OPTIMAL layout to a binary PPM. Waits for the device. */
+static bool write_ppm(const Texture2D& texture, const std::string& path)
+{
+    VkFormat format = texture.info.imageFormat;
+    bool is_bgra = format == VK_FORMAT_B8G8R8A8_SRGB || format == VK_FORMAT_B8G8R8A8_UNORM;
+    bool is_rgba = format == VK_FORMAT_R8G8B8A8_SRGB || format == VK_FORMAT_R8G8B8A8_UNORM;
+    if (!is_bgra && !is_rgba)
+    {
+        LOG_ERROR("Cannot write {} : unsupported format {}", path, string_VkFormat(format));
+        return false;
+    }
+
+    uint32_t width = texture.info.width;
+    uint32_t height = texture.info.height;
+    size_t size_bytes = size_t(width) * height * 4;
+
+    vk::buffer readback;
+    readback.init(vk::buffer::type::READBACK, size_bytes, "Image Readback");
+    readback.create();
+
+    VkBufferImageCopy region =
+    {
+        .imageSubresource = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 0, 1 },
+        .imageExtent = { width, height, 1 }
+    };
+
+    VkCommandBuffer cmd_buffer = begin_temp_cmd_buffer();
+    vkCmdCopyImageToBuffer(cmd_buffer, texture.image, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, readback, 1, &region);
+    end_temp_cmd_buffer(cmd_buffer);
+
+    const uint8_t* pixels = (const uint8_t*)readback.map(ctx.device, 0, size_bytes);
+    FILE* file = fopen(path.c_str(), "wb");
+    bool ok = file != nullptr;
+    if (file)
+    {
+        fprintf(file, "P6\n%u %u\n255\n", width, height);
+        std::vector<uint8_t> row(size_t(width) * 3);
+        for (uint32_t y = 0; y < height && ok; y++)
+        {
+            const uint8_t* src = pixels + size_t(y) * width * 4;
+            for (uint32_t x = 0; x < width; x++)
+            {
+                row[3 * x + 0] = src[4 * x + (is_bgra ? 2 : 0)];
+                row[3 * x + 1] = src[4 * x + 1];
+                row[3 * x + 2] = src[4 * x + (is_bgra ? 0 : 2)];
+            }
+            ok = fwrite(row.data(), 1, row.size(), file) == row.size();
+        }
+        fclose(file);
+    }
+    readback.unmap(ctx.device);
+    readback.destroy();
+
+    if (ok)
+    {
+        LOG_INFO("Wrote {}", path);
+    }
+    else
+    {
+        LOG_ERROR("Cannot write {}", path);
+    }
+    return ok;
+}
+
+void Application::write_frame_timings() const
+{
+    const std::vector<float>& gpu_frame_ms = ctx.profiler.frame_times_ms;
+
+    FILE* file = fopen(m_options.timings_path.c_str(), "w");
+    if (!file)
+    {
+        LOG_ERROR("Cannot write frame timings {}", m_options.timings_path);
+        return;
+    }
+
+    double sum_frame_ms = 0.0, sum_cpu_ms = 0.0, sum_gpu_ms = 0.0;
+    fprintf(file, "frame,frame_ms,cpu_ms,gpu_ms\n");
+    for (size_t i = 0; i < m_frame_timings.size(); i++)
+    {
+        float gpu_ms = i < gpu_frame_ms.size() ? gpu_frame_ms[i] : 0.0f;
+        fprintf(file, "%zu,%.4f,%.4f,%.4f\n", i, m_frame_timings[i].frame_ms, m_frame_timings[i].cpu_ms, gpu_ms);
+        sum_frame_ms += m_frame_timings[i].frame_ms;
+        sum_cpu_ms += m_frame_timings[i].cpu_ms;
+        sum_gpu_ms += gpu_ms;
+    }
+    fclose(file);
+
+    double num_frames = (double)std::max<size_t>(m_frame_timings.size(), 1);
+    LOG_INFO("{} frames : avg frame {:.3f} ms, cpu {:.3f} ms, gpu {:.3f} ms. Timings written to {}", m_frame_timings.size(),
+        sum_frame_ms / num_frames, sum_cpu_ms / num_frames, sum_gpu_ms / num_frames, m_options.timings_path);
 }
 
 void Application::run()
 {
     init();
 
-    while (!m_window->is_closed())
+    /* Captures without the Optick GUI attached : the capture starts with the first frame */
+    if (m_options.optick_capture_frames > 0)
+    {
+        LOG_INFO("Capturing {} frames to {}", m_options.optick_capture_frames, m_options.optick_capture_path);
+        OPTICK_START_CAPTURE();
+    }
+    uint32_t num_captured_frames = 0;
+
+    if (m_options.headless)
+    {
+        LOG_INFO("Headless run : {} frames", m_options.num_frames);
+        ctx.profiler.record_frame_times = true;
+        m_time = 0.0f;
+    }
+
+    while (m_window ? !m_window->is_closed() : true)
     {
-        m_time = (float)m_window->GetTime();
-        Timestep timestep = m_time - m_last_frametime;
-        m_last_frametime = m_time;
-        m_delta_time = timestep.GetSeconds();
-        m_window->handle_events();
-        m_window->update();
+        OPTICK_FRAME("MainThread");
+
+        if (m_options.num_frames > 0 && ctx.frame_count >= m_options.num_frames)
+        {
+            break;
+        }
+
+        auto frame_start = std::chrono::steady_clock::now();
+        if (m_window)
+        {
+            m_time = (float)m_window->GetTime();
+            Timestep timestep = m_time - m_last_frametime;
+            m_last_frametime = m_time;
+            m_delta_time = timestep.GetSeconds();
+            m_window->handle_events();
+            m_window->update();
+        }
+        else
+        {
+            m_time += ctx.frame_count > 0 ? k_headless_delta_time : 0.0f;
+            m_delta_time = k_headless_delta_time;
+        }
         update(m_time, m_delta_time);
-        prerender();
-        render();
-        postrender();
+        {
+            OPTICK_GPU_CONTEXT(ctx.get_current_frame().cmd_buffer);
+            prerender();
+            {
+                OPTICK_EVENT("render");
+                render();
+            }
+            postrender();
+        }
+
+        if (m_options.headless)
+        {
+            float frame_ms = std::chrono::duration<float, std::milli>(std::chrono::steady_clock::now() - frame_start).count();
+            m_frame_timings.push_back({ .frame_ms = frame_ms, .cpu_ms = frame_ms - m_fence_wait_ms });
+        }
+
+        if (m_options.optick_capture_frames > 0 && ++num_captured_frames == m_options.optick_capture_frames)
+        {
+            OPTICK_STOP_CAPTURE();
+            OPTICK_SAVE_CAPTURE(m_options.optick_capture_path.c_str());
+            LOG_INFO("Saved Optick capture {}", m_options.optick_capture_path);
+            break;
+        }
+    }
+
+    if (m_options.headless)
+    {
+        vkDeviceWaitIdle(ctx.device);
+        ctx.profiler.flush();
+        write_frame_timings();
+
+        /* Last frame rendered : the frame index has already moved on */
+        if (!m_options.dump_path.empty() && ctx.frame_count > 0)
+        {
+            uint32_t last_frame_idx = (ctx.curr_frame_idx + NUM_FRAMES - 1) % NUM_FRAMES;
+            write_ppm(ctx.swapchain->color_attachments[last_frame_idx], m_options.dump_path);
+        }
     }
 
     exit();
@@ -63,46 +332,111 @@ void Application::run()
 
 void Application::prerender()
 {
+    OPTICK_EVENT();
+
     vk::frame& current_frame = ctx.get_current_frame();
 
     vk::swapchain& swapchain = *m_rhi->get_swapchain();
 
-    VK_CHECK(vkWaitForFences(ctx.device, 1, &current_frame.fence_queue_submitted, true, UINT64_MAX));
+    {
+        OPTICK_EVENT("Wait frame fence");
+        auto wait_start = std::chrono::steady_clock::now();
+        VK_CHECK(vkWaitForFences(ctx.device, 1, &current_frame.fence_queue_submitted, true, UINT64_MAX));
+        m_fence_wait_ms = std::chrono::duration<float, std::milli>(std::chrono::steady_clock::now() - wait_start).count();
+    }
     VK_CHECK(vkResetFences(ctx.device, 1, &current_frame.fence_queue_submitted));
 
+    /* The frame has completed : its texture feedback can be read and its bindless set updated */
+    VkResourceManager::get_instance(ctx.device)->destroy_retired(ctx.frame_count);
+    texture_streamer::get_instance().update(ctx.curr_frame_idx);
+    shader_compiler::get_instance().update();
+    ObjectManager::get_instance().update_texture_descriptors(ctx.curr_frame_idx);
+    ObjectManager::get_instance().update_mesh_draw_data(ctx.curr_frame_idx);
+    ctx.recorder.reset(ctx.curr_frame_idx);
+
     swapchain.acquire_next_image(current_frame.semaphore_swapchain_acquire);
     
     VkCommandBufferBeginInfo cmdBufferBeginInfo = { .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO };
     current_frame.cmd_buffer.begin();
+    ctx.profiler.begin_frame(current_frame.cmd_buffer, ctx.curr_frame_idx);
+    ctx.uploader.record_acquires(current_frame.cmd_buffer);
     swapchain.color_attachments[swapchain.current_backbuffer_idx].transition(current_frame.cmd_buffer, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL, VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT);
 
 }
 
 void Application::postrender()
 {
+    OPTICK_EVENT();
+
     vk::frame& current_frame = ctx.get_current_frame();
     vk::swapchain& swapchain = *m_rhi->get_swapchain();
 
-    /* Transition to present */
-    swapchain.color_attachments[swapchain.current_backbuffer_idx].transition(current_frame.cmd_buffer, VK_IMAGE_LAYOUT_PRESENT_SRC_KHR, VK_ACCESS_NONE);
+    /* Transition to present, offscreen images are left ready to be read back */
+    if (swapchain.is_offscreen)
+    {
+        swapchain.color_attachments[swapchain.current_backbuffer_idx].transition(current_frame.cmd_buffer, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, VK_ACCESS_TRANSFER_READ_BIT);
+    }
+    else
+    {
+        swapchain.color_attachments[swapchain.current_backbuffer_idx].transition(current_frame.cmd_buffer, VK_IMAGE_LAYOUT_PRESENT_SRC_KHR, VK_ACCESS_NONE);
+    }
+    ctx.profiler.end_frame(current_frame.cmd_buffer);
     VK_CHECK(vkEndCommandBuffer(current_frame.cmd_buffer));
 
     // Submit commands for the GPU to work on the current backbuffer
     // Has to wait for the swapchain image to be acquired before beginning, we wait on imageAcquired semaphore.
     // Signals a renderComplete semaphore to let the next operation know that it finished
-    VkPipelineStageFlags wait_stage = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
+    // Also waits on the upload timeline for data queued on the transfer queue during the frame.
+    // Offscreen targets are neither acquired nor presented : no binary semaphores.
+    vk::upload_handle uploads = ctx.uploader.flush();
+    VkSemaphore wait_semaphores[2];
+    VkPipelineStageFlags wait_stages[2];
+    uint64_t wait_values[2];
+    uint32_t num_waits = 0;
+    if (!swapchain.is_offscreen)
+    {
+        wait_semaphores[num_waits] = current_frame.semaphore_swapchain_acquire;
+        wait_stages[num_waits] = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
+        wait_values[num_waits++] = 0;
+    }
+    if (uploads.is_valid())
+    {
+        wait_semaphores[num_waits] = ctx.uploader.get_timeline_semaphore();
+        wait_stages[num_waits] = VK_PIPELINE_STAGE_ALL_COMMANDS_BIT;
+        wait_values[num_waits++] = uploads.value;
+    }
+
+    VkTimelineSemaphoreSubmitInfo timeline_info = {};
+    timeline_info.sType = VK_STRUCTURE_TYPE_TIMELINE_SEMAPHORE_SUBMIT_INFO;
+    timeline_info.waitSemaphoreValueCount = num_waits;
+    timeline_info.pWaitSemaphoreValues = wait_values;
+
     VkSubmitInfo submit_info = {};
     submit_info.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+    submit_info.pNext = &timeline_info;
     submit_info.commandBufferCount = 1;
     submit_info.pCommandBuffers = current_frame.cmd_buffer.ptr();
-    submit_info.waitSemaphoreCount = 1;
-    submit_info.pWaitSemaphores = &current_frame.semaphore_swapchain_acquire;
-    submit_info.pWaitDstStageMask = &wait_stage;
-    submit_info.signalSemaphoreCount = 1;
-    submit_info.pSignalSemaphores = &current_frame.smp_queue_submitted;
+    submit_info.waitSemaphoreCount = num_waits;
+    submit_info.pWaitSemaphores = wait_semaphores;
+    submit_info.pWaitDstStageMask = wait_stages;
+
+    /* The frame timeline tells the upload service when the buffers this frame reads can be overwritten */
+    VkSemaphore signal_semaphores[2] = { ctx.frame_timeline_semaphore, current_frame.smp_queue_submitted };
+    uint64_t signal_values[2] = { ctx.frame_count + 1ull, 0 };
+    timeline_info.signalSemaphoreValueCount = swapchain.is_offscreen ? 1 : 2;
+    timeline_info.pSignalSemaphoreValues = signal_values;
+    submit_info.signalSemaphoreCount = swapchain.is_offscreen ? 1 : 2;
+    submit_info.pSignalSemaphores = signal_semaphores;
 
     vkQueueSubmit(ctx.device.graphics_queue, 1, &submit_info, current_frame.fence_queue_submitted);
 
+    if (swapchain.is_offscreen)
+    {
+        ctx.frame_count++;
+        ctx.update_frame_index();
+        return;
+    }
+
     // Present work
     // Waits for the GPU queue to finish execution before presenting, we wait on renderComplete semaphore
     VkPresentInfoKHR present_info = {};
@@ -113,7 +447,11 @@ void Application::postrender()
     present_info.waitSemaphoreCount = 1;
     present_info.pWaitSemaphores = &current_frame.smp_queue_submitted;
 
-    vkQueuePresentKHR(ctx.device.graphics_queue, &present_info);
+    {
+        OPTICK_EVENT("Present");
+        vkQueuePresentKHR(ctx.device.graphics_queue, &present_info);
+    }
+    OPTICK_GPU_FLIP(swapchain.vk_swapchain);
 
     ctx.frame_count++;
     ctx.update_frame_index();
@@ -121,7 +459,7 @@ void Application::postrender()
 
 double Application::get_time_secs() 
 { 
-    return m_window->GetTime(); 
+    return m_window ? m_window->GetTime() : m_time; 
 }
 
 void Application::on_window_resize() 
@@ -186,7 +524,7 @@ void Application::on_mouse_move(MouseEvent event)
 
 bool Application::get_key_state(Key key)
 {
-    return m_window->AsyncKeyState(key);
+    return m_window && m_window->AsyncKeyState(key);
 }
 
 void Application::on_key_event(KeyEvent event)
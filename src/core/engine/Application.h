@@ -1,6 +1,7 @@
 #pragma once
 
 #include <memory>
+#include <string>
 #include <vector>
 
 #include "InputEvents.h"
@@ -20,15 +21,43 @@ class VulkanImGuiRenderer;
 class VulkanModelRenderer;
 class VulkanClearColorRenderer;
 
+/* Command line options, see Application::parse_command_line */
+struct launch_options
+{
+	/* --headless : no window nor swapchain, frames are rendered to offscreen targets (e.g. on lavapipe) */
+	bool headless = false;
+	/* --frames N : exits after N frames, 0 runs until the window is closed */
+	uint32_t num_frames = 0;
+	/* --scene X : model loaded instead of the default scene, relative to data/models */
+	std::string scene;
+	/* --camera-path Y : keyframes played back by the camera, see camera_path */
+	std::string camera_path;
+	/* --timings path : per-frame CPU/GPU times of a headless run (csv) */
+	std::string timings_path = "frame_timings.csv";
+	/* --dump-image path : last frame of a headless run written to a .ppm */
+	std::string dump_path;
+	/* --packed-vertices : scene meshes use the compact vertex format, see VertexFormat */
+	bool packed_vertices = false;
+	/* --lod-bias X : log2 of the scale of the LOD error allowed, see DrawCommandGenerator::lod_bias */
+	float lod_bias = 0.0f;
+	/* --optick-capture N [path] : captures the first frames to an Optick file then exits */
+	uint32_t optick_capture_frames = 0;
+	std::string optick_capture_path = "capture.opt";
+
+	static constexpr uint32_t k_default_headless_frames = 300;
+};
+
 /// <summary>
 /// Skeleton of an application to derive in client code.
 /// </summary>
 class Application {
 public:
 	
-	Application(const char* title, uint32_t width, uint32_t height);
+	Application(const char* title, uint32_t width, uint32_t height, const launch_options& options = {});
 	virtual ~Application();
 
+	static launch_options parse_command_line(int argc, char* argv[]);
+
 	/* Main application loop */
 	void run();
 
@@ -59,6 +88,8 @@ public:
 	 */
 	double get_time_secs();
 
+	bool is_headless() const { return m_options.headless; }
+
 	bool b_init_success;
 
 	std::unique_ptr<EventManager> m_event_manager;
@@ -79,6 +110,18 @@ protected:
 
 	const char* m_debug_name;
 
+	launch_options m_options;
+
+	/* Headless runs */
+	struct frame_timing
+	{
+		float frame_ms;
+		float cpu_ms;		/* Frame time minus the wait for the GPU */
+	};
+	std::vector<frame_timing> m_frame_timings;
+	float m_fence_wait_ms = 0.0f;
+	void write_frame_timings() const;
+
 	std::unique_ptr<Window> m_window;
 	std::unique_ptr<RenderInterface> m_rhi;
 };
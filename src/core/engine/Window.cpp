@@ -485,6 +485,44 @@ double Window::Impl::get_time() const
 
 #else
 
+/* Only the Win32 window is implemented, elsewhere Application runs headless and never creates one */
+struct WindowData
+{
+};
+
+class Window::Impl
+{
+public:
+	Impl(const WindowInfo& info, Application* hApp) : m_WinInfo(info), m_WinState({}) {}
+
+	void Create() { LOG_ERROR("No window implementation on this platform, run with --headless"); m_WinState.b_is_closed = true; }
+	void Show() {}
+	void UpdateGUI()  const {}
+	void ShutdownGUI()  const {}
+	bool IsClosed()  const { return m_WinState.b_is_closed; }
+	int  GetHeight() const { return m_WinInfo.height; }
+	int  GetWidth()	const { return m_WinInfo.width; }
+	float GetAspectRatio() const { return m_WinInfo.aspect_ratio; }
+	const WindowData*  GetData()	const { return &m_Data; }
+	void HandleEvents() {}
+	double get_time() const { return 0.0; }
+
+	void OnClose() { m_WinState.b_is_closed = true; }
+	void OnResize(unsigned int width, unsigned int height) {}
+
+	void OnMouseDown(MouseEvent event) {}
+	void OnMouseUp(MouseEvent event) {}
+	void OnMouseMove(MouseEvent event) {}
+	void OnKeyEvent(KeyEvent event) {}
+	bool AsyncKeyState(Key key) const { return false; }
+
+	bool is_in_focus() const { return false; }
+
+	WindowInfo m_WinInfo;
+	WindowState m_WinState;
+	WindowData m_Data;
+};
+
 #endif
 
 /////////////////////////////////////////////////////////////////////////
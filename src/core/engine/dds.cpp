@@ -0,0 +1,287 @@
+#include "dds.h"
+#include "core/engine/logger.h"
+
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <string>
+
+/* https://learn.microsoft.com/en-us/windows/win32/direct3ddds/dds-header */
+namespace dds
+{
+	static constexpr uint32_t magic = 0x20534444; /* "DDS " */
+	static constexpr uint32_t max_dimension = 32768; /* Keeps the mip size computations from overflowing */
+
+	static constexpr uint32_t make_fourcc(char a, char b, char c, char d)
+	{
+		return uint32_t(uint8_t(a)) | (uint32_t(uint8_t(b)) << 8) | (uint32_t(uint8_t(c)) << 16) | (uint32_t(uint8_t(d)) << 24);
+	}
+
+	enum flags : uint32_t
+	{
+		DDSD_CAPS			= 0x1,
+		DDSD_HEIGHT			= 0x2,
+		DDSD_WIDTH			= 0x4,
+		DDSD_PIXELFORMAT	= 0x1000,
+		DDSD_MIPMAPCOUNT	= 0x20000,
+		DDSD_LINEARSIZE		= 0x80000,
+		DDPF_FOURCC			= 0x4,
+		DDSCAPS_COMPLEX		= 0x8,
+		DDSCAPS_TEXTURE		= 0x1000,
+		DDSCAPS_MIPMAP		= 0x400000,
+	};
+
+	struct pixel_format
+	{
+		uint32_t size;
+		uint32_t flags;
+		uint32_t fourcc;
+		uint32_t rgb_bit_count;
+		uint32_t r_mask;
+		uint32_t g_mask;
+		uint32_t b_mask;
+		uint32_t a_mask;
+	};
+
+	struct header
+	{
+		uint32_t size;
+		uint32_t flags;
+		uint32_t height;
+		uint32_t width;
+		uint32_t pitch_or_linear_size;
+		uint32_t depth;
+		uint32_t mip_map_count;
+		uint32_t reserved1[11];
+		pixel_format pf;
+		uint32_t caps;
+		uint32_t caps2;
+		uint32_t caps3;
+		uint32_t caps4;
+		uint32_t reserved2;
+	};
+
+	struct header_dx10
+	{
+		uint32_t dxgi_format;
+		uint32_t resource_dimension;
+		uint32_t misc_flag;
+		uint32_t array_size;
+		uint32_t misc_flags2;
+	};
+
+	static_assert(sizeof(header) == 124);
+	static_assert(sizeof(header_dx10) == 20);
+
+	struct format_entry
+	{
+		uint32_t dxgi_format;
+		VkFormat vk_format;
+		uint32_t block_size_bytes;
+	};
+
+	static constexpr format_entry format_table[] =
+	{
+		{ 71, VK_FORMAT_BC1_RGBA_UNORM_BLOCK,	8  },
+		{ 72, VK_FORMAT_BC1_RGBA_SRGB_BLOCK,	8  },
+		{ 77, VK_FORMAT_BC3_UNORM_BLOCK,		16 },
+		{ 78, VK_FORMAT_BC3_SRGB_BLOCK,			16 },
+		{ 80, VK_FORMAT_BC4_UNORM_BLOCK,		8  },
+		{ 83, VK_FORMAT_BC5_UNORM_BLOCK,		16 },
+		{ 98, VK_FORMAT_BC7_UNORM_BLOCK,		16 },
+		{ 99, VK_FORMAT_BC7_SRGB_BLOCK,			16 },
+	};
+
+	static const format_entry* find_format(VkFormat format)
+	{
+		for (const format_entry& e : format_table)
+		{
+			if (e.vk_format == format) return &e;
+		}
+		return nullptr;
+	}
+
+	static const format_entry* find_dxgi_format(uint32_t dxgi_format)
+	{
+		for (const format_entry& e : format_table)
+		{
+			if (e.dxgi_format == dxgi_format) return &e;
+		}
+		return nullptr;
+	}
+
+	std::string get_baked_path(std::string_view texture_path)
+	{
+		return std::string(texture_path) + ".dds";
+	}
+
+	uint32_t get_block_size_bytes(VkFormat format)
+	{
+		const format_entry* e = find_format(format);
+		return e ? e->block_size_bytes : 0;
+	}
+
+	size_t get_mip_size_bytes(VkFormat format, uint32_t w, uint32_t h)
+	{
+		size_t blocks_x = std::max<size_t>(1, (size_t(w) + 3) / 4);
+		size_t blocks_y = std::max<size_t>(1, (size_t(h) + 3) / 4);
+		return blocks_x * blocks_y * get_block_size_bytes(format);
+	}
+
+	bool load(std::string_view filename, compressed_image& out_image, uint32_t max_size)
+	{
+		std::string path(filename);
+		FILE* file = fopen(path.c_str(), "rb");
+		if (!file)
+		{
+			return false;
+		}
+
+		uint32_t file_magic = 0;
+		header hdr = {};
+		header_dx10 hdr_dx10 = {};
+
+		bool ok = fread(&file_magic, sizeof(file_magic), 1, file) == 1 && file_magic == magic
+			&& fread(&hdr, sizeof(hdr), 1, file) == 1 && hdr.size == sizeof(header);
+
+		VkFormat format = VK_FORMAT_UNDEFINED;
+		if (ok && (hdr.pf.flags & DDPF_FOURCC))
+		{
+			switch (hdr.pf.fourcc)
+			{
+			case make_fourcc('D', 'X', '1', '0'):
+			{
+				ok = fread(&hdr_dx10, sizeof(hdr_dx10), 1, file) == 1 && hdr_dx10.array_size <= 1;
+				const format_entry* e = find_dxgi_format(hdr_dx10.dxgi_format);
+				format = e ? e->vk_format : VK_FORMAT_UNDEFINED;
+				break;
+			}
+			case make_fourcc('D', 'X', 'T', '1'): format = VK_FORMAT_BC1_RGBA_UNORM_BLOCK; break;
+			case make_fourcc('D', 'X', 'T', '5'): format = VK_FORMAT_BC3_UNORM_BLOCK; break;
+			case make_fourcc('A', 'T', 'I', '1'): format = VK_FORMAT_BC4_UNORM_BLOCK; break;
+			case make_fourcc('A', 'T', 'I', '2'): format = VK_FORMAT_BC5_UNORM_BLOCK; break;
+			default: break;
+			}
+		}
+
+		if (!ok || format == VK_FORMAT_UNDEFINED || hdr.width == 0 || hdr.height == 0
+			|| hdr.width > max_dimension || hdr.height > max_dimension)
+		{
+			LOG_ERROR("Unsupported or invalid DDS file : {}", filename);
+			fclose(file);
+			return false;
+		}
+
+		/* The header is not trusted : the mip count is clamped to a full chain and every level must fit in what is left of the file */
+		long data_offset = ftell(file);
+		long file_size = data_offset >= 0 && fseek(file, 0, SEEK_END) == 0 ? ftell(file) : -1;
+		if (file_size < data_offset || fseek(file, data_offset, SEEK_SET) != 0)
+		{
+			LOG_ERROR("Could not read DDS file : {}", filename);
+			fclose(file);
+			return false;
+		}
+		size_t remaining_size_bytes = size_t(file_size - data_offset);
+
+		uint32_t max_mip_levels = uint32_t(std::floor(std::log2(std::max(hdr.width, hdr.height)))) + 1;
+
+		out_image.format = format;
+		out_image.w = hdr.width;
+		out_image.h = hdr.height;
+		out_image.mip_levels = std::clamp(hdr.mip_map_count, 1u, max_mip_levels);
+		out_image.mip_offsets.resize(out_image.mip_levels);
+		out_image.mip_sizes.resize(out_image.mip_levels);
+
+		out_image.first_mip = 0;
+		while (max_size && out_image.first_mip + 1 < out_image.mip_levels
+			&& std::max(hdr.width >> out_image.first_mip, hdr.height >> out_image.first_mip) > max_size)
+		{
+			out_image.first_mip++;
+		}
+
+		/* Offsets are relative to the first loaded mip */
+		size_t skipped_size_bytes = 0;
+		size_t total_size_bytes = 0;
+		for (uint32_t mip = 0; mip < out_image.mip_levels; mip++)
+		{
+			out_image.mip_sizes[mip] = get_mip_size_bytes(format, std::max(1u, hdr.width >> mip), std::max(1u, hdr.height >> mip));
+			if (out_image.mip_sizes[mip] > remaining_size_bytes)
+			{
+				LOG_ERROR("Truncated DDS file : {}", filename);
+				fclose(file);
+				out_image = {};
+				return false;
+			}
+			remaining_size_bytes -= out_image.mip_sizes[mip];
+
+			if (mip < out_image.first_mip)
+			{
+				out_image.mip_offsets[mip] = 0;
+				skipped_size_bytes += out_image.mip_sizes[mip];
+				continue;
+			}
+			out_image.mip_offsets[mip] = total_size_bytes;
+			total_size_bytes += out_image.mip_sizes[mip];
+		}
+
+		out_image.data.resize(total_size_bytes);
+		ok = fseek(file, (long)skipped_size_bytes, SEEK_CUR) == 0
+			&& fread(out_image.data.data(), 1, total_size_bytes, file) == total_size_bytes;
+		fclose(file);
+
+		if (!ok)
+		{
+			LOG_ERROR("Truncated DDS file : {}", filename);
+			out_image = {};
+		}
+
+		return ok;
+	}
+
+	bool write(std::string_view filename, const compressed_image& image)
+	{
+		assert(image.first_mip == 0);
+
+		const format_entry* e = find_format(image.format);
+		if (!e)
+		{
+			LOG_ERROR("Cannot write DDS file {} : unsupported format {}", filename, (int)image.format);
+			return false;
+		}
+
+		header hdr = {};
+		hdr.size = sizeof(header);
+		hdr.flags = DDSD_CAPS | DDSD_HEIGHT | DDSD_WIDTH | DDSD_PIXELFORMAT | DDSD_MIPMAPCOUNT | DDSD_LINEARSIZE;
+		hdr.height = image.h;
+		hdr.width = image.w;
+		hdr.pitch_or_linear_size = (uint32_t)get_mip_size_bytes(image.format, image.w, image.h);
+		hdr.mip_map_count = image.mip_levels;
+		hdr.pf.size = sizeof(pixel_format);
+		hdr.pf.flags = DDPF_FOURCC;
+		hdr.pf.fourcc = make_fourcc('D', 'X', '1', '0');
+		hdr.caps = DDSCAPS_TEXTURE | (image.mip_levels > 1 ? DDSCAPS_COMPLEX | DDSCAPS_MIPMAP : 0);
+
+		header_dx10 hdr_dx10 = {};
+		hdr_dx10.dxgi_format = e->dxgi_format;
+		hdr_dx10.resource_dimension = 3; /* D3D10_RESOURCE_DIMENSION_TEXTURE2D */
+		hdr_dx10.array_size = 1;
+
+		std::string path(filename);
+		FILE* file = fopen(path.c_str(), "wb");
+		if (!file)
+		{
+			LOG_ERROR("Could not open {} for writing", filename);
+			return false;
+		}
+
+		bool ok = fwrite(&magic, sizeof(magic), 1, file) == 1
+			&& fwrite(&hdr, sizeof(hdr), 1, file) == 1
+			&& fwrite(&hdr_dx10, sizeof(hdr_dx10), 1, file) == 1
+			&& fwrite(image.data.data(), 1, image.data.size(), file) == image.data.size();
+
+		fclose(file);
+		return ok;
+	}
+}
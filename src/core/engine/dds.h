@@ -0,0 +1,45 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+#include <vulkan/vulkan.h>
+
+/* Block-compressed image with its full mip chain, as stored in a .dds file */
+struct compressed_image
+{
+	VkFormat format = VK_FORMAT_UNDEFINED;
+	uint32_t w = 0;
+	uint32_t h = 0;
+	uint32_t mip_levels = 0;
+
+	/* First mip held by data. Offsets of the mips before it are not valid. */
+	uint32_t first_mip = 0;
+
+	/* Mips are stored tightly packed, from the largest to the smallest */
+	std::vector<uint8_t> data;
+	std::vector<size_t> mip_offsets;
+	std::vector<size_t> mip_sizes;
+};
+
+namespace dds
+{
+	/*
+		Supports DX10 headers (BC1/BC3/BC4/BC5/BC7) and the legacy DXT1/DXT5/ATI1/ATI2 fourCCs.
+		max_size : mips larger than max_size texels are skipped (the last mip is always loaded), 0 loads the whole chain.
+	*/
+	bool load(std::string_view filename, compressed_image& out_image, uint32_t max_size = 0);
+
+	/* Always writes a DX10 header */
+	bool write(std::string_view filename, const compressed_image& image);
+
+	/* Path of the offline baked version of a texture (see the TextureBaker project) */
+	std::string get_baked_path(std::string_view texture_path);
+
+	/* Size in bytes of a 4x4 block, 0 if the format is not a supported block-compressed format */
+	uint32_t get_block_size_bytes(VkFormat format);
+
+	/* Size in bytes of a block-compressed mip level */
+	size_t get_mip_size_bytes(VkFormat format, uint32_t w, uint32_t h);
+}
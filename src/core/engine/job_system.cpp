@@ -0,0 +1,304 @@
+#include "job_system.h"
+#include "core/engine/logger.h"
+
+#include "optick.h"
+
+#include <algorithm>
+
+/* Index of the calling thread in the pool, 0 outside of it */
+static thread_local unsigned int t_thread_index = 0;
+
+/* Rounds of stealing attempts before a worker goes to sleep */
+static constexpr int NUM_SPINS_BEFORE_SLEEP = 64;
+
+void job_system::init(unsigned int num_threads)
+{
+	if (!m_threads.empty())
+	{
+		return;
+	}
+
+	if (num_threads == 0)
+	{
+		/* Keep one hardware thread for the main thread */
+		num_threads = std::max(2u, std::thread::hardware_concurrency()) - 1;
+	}
+
+	m_stop = false;
+	m_queues.clear();
+	for (unsigned int i = 0; i < num_threads + 1; i++)
+	{
+		m_queues.push_back(std::make_unique<work_queue>());
+	}
+
+	m_threads.reserve(num_threads);
+	for (unsigned int i = 0; i < num_threads; i++)
+	{
+		m_threads.emplace_back(&job_system::worker_loop, this, i + 1);
+	}
+
+	LOG_INFO("Job system started with {} worker threads.", num_threads);
+}
+
+void job_system::terminate()
+{
+	{
+		std::lock_guard lock(m_sleep_mutex);
+		m_stop = true;
+	}
+	m_cv_sleep.notify_all();
+
+	for (std::thread& t : m_threads)
+	{
+		if (t.joinable())
+		{
+			t.join();
+		}
+	}
+	m_threads.clear();
+
+	/* Workers drain the queues before exiting, only jobs still waiting on a dependency can be left */
+	if (!m_deferred.empty())
+	{
+		LOG_WARN("Job system terminated with {} jobs waiting on a dependency.", m_deferred.size());
+		m_deferred.clear();
+		m_num_deferred = 0;
+	}
+}
+
+job_system::~job_system()
+{
+	terminate();
+}
+
+unsigned int job_system::get_thread_index()
+{
+	return t_thread_index;
+}
+
+void job_system::push(job&& j)
+{
+	if (m_threads.empty())
+	{
+		init();
+	}
+
+	work_queue& queue = *m_queues[t_thread_index];
+	{
+		std::lock_guard lock(queue.mutex);
+		queue.jobs.push_back(std::move(j));
+	}
+
+	/* Pairs with the sleeping count increment in worker_loop : either the worker sees the job or we see the sleeper */
+	m_num_queued.fetch_add(1);
+	if (m_num_sleeping.load() > 0)
+	{
+		std::lock_guard lock(m_sleep_mutex);
+		m_cv_sleep.notify_one();
+	}
+}
+
+void job_system::run(std::function<void()> func, job_counter* counter)
+{
+	if (counter)
+	{
+		counter->m_value.fetch_add(1);
+	}
+
+	push({ std::move(func), counter });
+}
+
+void job_system::run_after(job_counter& dependency, std::function<void()> func, job_counter* counter)
+{
+	if (counter)
+	{
+		counter->m_value.fetch_add(1);
+	}
+
+	job j = { std::move(func), counter };
+	{
+		std::lock_guard lock(m_deferred_mutex);
+
+		/* Registered before checking the dependency, finish() checks them in the opposite order */
+		m_num_deferred.fetch_add(1);
+		if (!dependency.is_done())
+		{
+			m_deferred.push_back({ &dependency, std::move(j) });
+			return;
+		}
+		m_num_deferred.fetch_sub(1);
+	}
+
+	push(std::move(j));
+}
+
+void job_system::run_range(size_t count, size_t min_batch_size, const std::function<void(size_t, size_t)>& func, job_counter& counter)
+{
+	if (count == 0)
+	{
+		return;
+	}
+
+	if (m_threads.empty())
+	{
+		init();
+	}
+
+	/* A few batches per thread so that uneven iterations still balance out through stealing */
+	size_t max_batches = (size_t)get_num_threads() * 4;
+	size_t num_batches = std::clamp(count / std::max<size_t>(1, min_batch_size), (size_t)1, max_batches);
+	size_t batch_size = (count + num_batches - 1) / num_batches;
+
+	/* Shared by every batch, the caller does not have to keep func alive */
+	auto shared_func = std::make_shared<std::function<void(size_t, size_t)>>(func);
+
+	for (size_t begin = 0; begin < count; begin += batch_size)
+	{
+		size_t end = std::min(count, begin + batch_size);
+		run([shared_func, begin, end]() { (*shared_func)(begin, end); }, &counter);
+	}
+}
+
+void job_system::wait(job_counter& counter)
+{
+	unsigned int thread_index = t_thread_index;
+	while (!counter.is_done())
+	{
+		if (!try_run_one(thread_index))
+		{
+			std::this_thread::yield();
+		}
+	}
+}
+
+void job_system::parallel_for(size_t count, const std::function<void(size_t)>& func, size_t min_batch_size)
+{
+	job_counter counter;
+	run_range(count, min_batch_size, [&func](size_t begin, size_t end)
+	{
+		for (size_t i = begin; i < end; i++)
+		{
+			func(i);
+		}
+	}, counter);
+	wait(counter);
+}
+
+bool job_system::pop_or_steal(unsigned int thread_index, job& out_job)
+{
+	if (m_queues.empty())
+	{
+		return false;
+	}
+
+	/* Own queue first, newest job */
+	{
+		work_queue& queue = *m_queues[thread_index];
+		std::lock_guard lock(queue.mutex);
+		if (!queue.jobs.empty())
+		{
+			out_job = std::move(queue.jobs.back());
+			queue.jobs.pop_back();
+			m_num_queued.fetch_sub(1);
+			return true;
+		}
+	}
+
+	/* Steal the oldest job of the other queues */
+	size_t num_queues = m_queues.size();
+	for (size_t i = 1; i < num_queues; i++)
+	{
+		work_queue& queue = *m_queues[(thread_index + i) % num_queues];
+		std::lock_guard lock(queue.mutex);
+		if (!queue.jobs.empty())
+		{
+			out_job = std::move(queue.jobs.front());
+			queue.jobs.pop_front();
+			m_num_queued.fetch_sub(1);
+			return true;
+		}
+	}
+
+	return false;
+}
+
+bool job_system::try_run_one(unsigned int thread_index)
+{
+	job j;
+	if (!pop_or_steal(thread_index, j))
+	{
+		return false;
+	}
+
+	j.func();
+	finish(j);
+
+	return true;
+}
+
+void job_system::finish(job& j)
+{
+	if (!j.counter)
+	{
+		return;
+	}
+
+	/* The counter may be destroyed by a waiter as soon as it reaches zero : do not touch it afterwards */
+	if (j.counter->m_value.fetch_sub(1) == 1 && m_num_deferred.load() > 0)
+	{
+		release_deferred();
+	}
+}
+
+void job_system::release_deferred()
+{
+	std::vector<job> ready;
+	{
+		std::lock_guard lock(m_deferred_mutex);
+		auto it = std::partition(m_deferred.begin(), m_deferred.end(), [](const deferred_job& d) { return !d.dependency->is_done(); });
+		for (auto ready_it = it; ready_it != m_deferred.end(); ++ready_it)
+		{
+			ready.push_back(std::move(ready_it->pending));
+		}
+		m_deferred.erase(it, m_deferred.end());
+		m_num_deferred.fetch_sub(ready.size());
+	}
+
+	for (job& j : ready)
+	{
+		push(std::move(j));
+	}
+}
+
+void job_system::worker_loop(unsigned int thread_index)
+{
+	t_thread_index = thread_index;
+	OPTICK_THREAD("Worker");
+
+	int num_spins = 0;
+	while (true)
+	{
+		if (try_run_one(thread_index))
+		{
+			num_spins = 0;
+			continue;
+		}
+
+		if (m_stop.load())
+		{
+			return;
+		}
+
+		if (++num_spins < NUM_SPINS_BEFORE_SLEEP)
+		{
+			std::this_thread::yield();
+			continue;
+		}
+
+		num_spins = 0;
+		std::unique_lock lock(m_sleep_mutex);
+		m_num_sleeping.fetch_add(1);
+		m_cv_sleep.wait(lock, [this] { return m_stop.load() || m_num_queued.load() > 0; });
+		m_num_sleeping.fetch_sub(1);
+	}
+}
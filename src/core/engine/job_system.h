@@ -0,0 +1,113 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/*
+	Number of outstanding jobs of a group. Incremented when a job is scheduled, decremented when it completes.
+	A counter must outlive every job it tracks and every job scheduled to run after it.
+*/
+class job_counter
+{
+public:
+	bool is_done() const { return m_value.load(std::memory_order_acquire) == 0; }
+	uint32_t get_value() const { return m_value.load(std::memory_order_acquire); }
+
+private:
+	friend class job_system;
+	std::atomic<uint32_t> m_value = 0;
+};
+
+/*
+	Work-stealing job scheduler.
+	Each worker owns a deque : it pushes and pops at the back (LIFO, cache warm), idle workers steal from the front
+	of the others. Threads that are not workers (main thread, loaders) share an extra deque.
+	Waiting on a counter runs pending jobs on the calling thread instead of blocking, so jobs can schedule and wait
+	on nested jobs. Jobs touching Vulkan objects must only record into objects owned by the job (e.g. secondary
+	command buffers from a per-thread pool), queue submission stays on the main thread.
+*/
+class job_system
+{
+public:
+	static job_system& get_instance()
+	{
+		static job_system instance;
+		return instance;
+	}
+
+	/* 0 : one worker per hardware thread, minus the main thread */
+	void init(unsigned int num_threads = 0);
+	void terminate();
+
+	/* Schedules func, counter (optional) is decremented once it has run */
+	void run(std::function<void()> func, job_counter* counter = nullptr);
+
+	/* Schedules func once dependency reaches zero */
+	void run_after(job_counter& dependency, std::function<void()> func, job_counter* counter = nullptr);
+
+	/* Schedules func(begin, end) over [0, count) split in batches of at least min_batch_size iterations */
+	void run_range(size_t count, size_t min_batch_size, const std::function<void(size_t, size_t)>& func, job_counter& counter);
+
+	/* Runs pending jobs on the calling thread until counter reaches zero */
+	void wait(job_counter& counter);
+
+	/* Runs func(i) for i in [0, count) across the pool and returns once all iterations are done */
+	void parallel_for(size_t count, const std::function<void(size_t)>& func, size_t min_batch_size = 1);
+
+	unsigned int get_num_threads() const { return (unsigned int)m_threads.size(); }
+
+	/* 0 for threads outside the pool, [1, get_num_threads()] for workers. Stable for the lifetime of the pool. */
+	static unsigned int get_thread_index();
+
+	job_system(const job_system&) = delete;
+	job_system& operator=(const job_system&) = delete;
+private:
+	job_system() = default;
+	~job_system();
+
+	struct job
+	{
+		std::function<void()> func;
+		job_counter* counter = nullptr;
+	};
+
+	/* Padded so that owner pushes and thief pops of neighbouring queues do not share a cache line */
+	struct alignas(64) work_queue
+	{
+		std::mutex mutex;
+		std::deque<job> jobs;
+	};
+
+	/* Job waiting on a counter to reach zero */
+	struct deferred_job
+	{
+		job_counter* dependency = nullptr;
+		job pending;
+	};
+
+	void push(job&& j);
+	bool pop_or_steal(unsigned int thread_index, job& out_job);
+	bool try_run_one(unsigned int thread_index);
+	void finish(job& j);
+	void release_deferred();
+	void worker_loop(unsigned int thread_index);
+
+	std::vector<std::thread> m_threads;
+	std::vector<std::unique_ptr<work_queue>> m_queues;	/* [0] shared by external threads, [i] owned by worker i */
+
+	std::atomic<size_t> m_num_queued = 0;
+	std::atomic<unsigned int> m_num_sleeping = 0;
+	std::mutex m_sleep_mutex;
+	std::condition_variable m_cv_sleep;
+	std::atomic<bool> m_stop = false;
+
+	std::mutex m_deferred_mutex;
+	std::vector<deferred_job> m_deferred;
+	std::atomic<size_t> m_num_deferred = 0;
+};
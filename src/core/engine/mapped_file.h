@@ -0,0 +1,32 @@
+#pragma once
+
+#include <cstdint>
+#include <cstddef>
+#include <string_view>
+
+/* Read-only memory mapping of a whole file */
+class mapped_file
+{
+public:
+	mapped_file() = default;
+	~mapped_file();
+
+	mapped_file(const mapped_file&) = delete;
+	mapped_file& operator=(const mapped_file&) = delete;
+
+	bool open(std::string_view filename);
+	void close();
+
+	const uint8_t* data() const { return m_data; }
+	size_t size() const { return m_size; }
+	bool is_open() const { return m_data != nullptr; }
+
+private:
+	const uint8_t* m_data = nullptr;
+	size_t m_size = 0;
+
+#if defined(_WIN32)
+	void* m_file = nullptr;
+	void* m_mapping = nullptr;
+#endif
+};
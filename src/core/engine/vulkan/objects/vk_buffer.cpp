@@ -26,14 +26,21 @@ namespace vk
 		VkResourceManager::get_instance(ctx.device)->destroy_buffer(m_hash);
 	}
 
+	void vk::buffer::retire()
+	{
+		VkResourceManager::get_instance(ctx.device)->retire_buffer(m_hash, ctx.frame_count);
+	}
+
 	void* vk::buffer::map(VkDevice device, size_t offset, size_t size)
 	{
 		assert(m_vk_device_memory);
 		void* p_data = nullptr;
 
-		if (size > 0)
+		/* Host visible memory blocks are persistently mapped by the allocator */
+		if (size > 0 && m_allocation.mapped)
 		{
-			vkMapMemory(device, m_vk_device_memory, offset, size, 0, &p_data);
+			assert(offset + size <= m_allocation.size);
+			p_data = (uint8_t*)m_allocation.mapped + offset;
 			is_mapped = true;
 		}
 
@@ -43,20 +50,35 @@ namespace vk
 	void vk::buffer::unmap(VkDevice device)
 	{
 		assert(m_vk_device_memory);
-		if (is_mapped)
-		{
-			vkUnmapMemory(device, m_vk_device_memory);
-			is_mapped = false;
-		}
+		is_mapped = false;
 	}
 
 	void vk::buffer::upload(VkDevice device, const void* data, size_t offset, size_t size)
 	{
+		if (size == 0)
+		{
+			return;
+		}
+
 		void* p_data = map(device, offset, size);
 		if (nullptr != p_data)
 		{
 			memcpy(p_data, data, size);
 			unmap(device);
+			return;
+		}
+
+		/* Device local memory : copied on the transfer queue, visible to the next graphics submission */
+		ctx.uploader.upload(m_vk_buffer, offset, data, size);
+	}
+
+	void vk::buffer::upload_after_frames(VkDevice device, const void* data, size_t offset, size_t size)
+	{
+		/* Always copied on the transfer queue, also for host visible memory : a memcpy would race with the frames in flight */
+		assert(m_type != type::STAGING && m_type != type::READBACK);
+		if (size > 0)
+		{
+			ctx.uploader.upload(m_vk_buffer, offset, data, size, ctx.frame_count);
 		}
 	}
 
@@ -67,21 +89,35 @@ namespace vk
 		case vk::buffer::type::UNIFORM:
 			create_vk_buffer_impl(size,
 				VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
-				VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+				vk::memory_usage::DYNAMIC);
 			break;
 		case vk::buffer::type::STORAGE:
 			create_vk_buffer_impl(size,
 				VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
-				VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+				vk::memory_usage::GPU_ONLY);
 			break;
 		case vk::buffer::type::STAGING:
 			create_vk_buffer_impl(size,
 				VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
-				VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+				vk::memory_usage::STAGING);
 			break;
 		case vk::buffer::type::INDIRECT:
 			create_vk_buffer_impl(size,
-				VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+				VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT, vk::memory_usage::GPU_ONLY);
+			break;
+		case vk::buffer::type::GEOMETRY:
+			create_vk_buffer_impl(size,
+				VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_INDEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT, vk::memory_usage::GPU_ONLY);
+			break;
+		case vk::buffer::type::DYNAMIC:
+			create_vk_buffer_impl(size,
+				VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+				vk::memory_usage::DYNAMIC);
+			break;
+		case vk::buffer::type::READBACK:
+			create_vk_buffer_impl(size,
+				VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+				vk::memory_usage::READBACK);
 			break;
 		default:
 			LOG_ERROR("Unknown buffer type.");
@@ -90,7 +126,7 @@ namespace vk
 		}
 	}
 
-	void vk::buffer::create_vk_buffer_impl(size_t size, VkBufferUsageFlags usage, VkMemoryPropertyFlags memProperties)
+	void vk::buffer::create_vk_buffer_impl(size_t size, VkBufferUsageFlags usage, vk::memory_usage mem_usage)
 	{
 
 		VkBufferCreateInfo info =
@@ -104,28 +140,29 @@ namespace vk
 			.pQueueFamilyIndices = nullptr
 		};
 
+		/* Device local buffers are written by the upload service on the transfer queue : share them instead of transferring ownership on every update */
+		const uint32_t queue_families[] = { ctx.device.queue_family_indices[vk::queue_family::graphics], ctx.device.queue_family_indices[vk::queue_family::transfer] };
+		if (mem_usage == vk::memory_usage::GPU_ONLY && (usage & VK_BUFFER_USAGE_TRANSFER_DST_BIT) && queue_families[0] != queue_families[1])
+		{
+			info.sharingMode = VK_SHARING_MODE_CONCURRENT;
+			info.queueFamilyIndexCount = 2;
+			info.pQueueFamilyIndices = queue_families;
+		}
+
 		VK_CHECK(vkCreateBuffer(ctx.device, &info, nullptr, &m_vk_buffer));
 
 		VkMemoryRequirements memRequirements;
 		vkGetBufferMemoryRequirements(ctx.device, m_vk_buffer, &memRequirements);
 		m_size_bytes = memRequirements.size;
 
-		VkMemoryAllocateInfo allocInfo = {};
-		allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
-		allocInfo.allocationSize = memRequirements.size;
-		allocInfo.memoryTypeIndex = ctx.device.find_memory_type(memRequirements.memoryTypeBits, memProperties);
-		VK_CHECK(vkAllocateMemory(ctx.device, &allocInfo, nullptr, &m_vk_device_memory));
+		VkResourceManager* resource_manager = VkResourceManager::get_instance(ctx.device);
+		m_allocation = resource_manager->get_allocator().allocate(memRequirements, mem_usage, vk::memory_allocator::resource_kind::LINEAR, m_debug_name);
+		assert(m_allocation.is_valid());
+		m_vk_device_memory = m_allocation.memory;
 
-		VK_CHECK(vkBindBufferMemory(ctx.device, m_vk_buffer, m_vk_device_memory, 0));
+		VK_CHECK(vkBindBufferMemory(ctx.device, m_vk_buffer, m_vk_device_memory, m_allocation.offset));
 
 		/* Add to manager */
-		m_hash = VkResourceManager::get_instance(ctx.device)->add_buffer(m_vk_buffer, m_vk_device_memory);
+		m_hash = resource_manager->add_buffer(m_vk_buffer, m_allocation);
 	}
 }
-void copy_from_buffer(const vk::buffer& src, const vk::buffer& dst, VkDeviceSize size)
-{
-	VkCommandBuffer cmd_buffer = begin_temp_cmd_buffer();
-	VkBufferCopy bufferRegion = { .srcOffset = 0, .dstOffset = 0, .size = size };
-	vkCmdCopyBuffer(cmd_buffer, src, dst, 1, &bufferRegion);
-	end_temp_cmd_buffer(cmd_buffer);
-}
@@ -2,19 +2,31 @@
 
 #include "vulkan/vulkan.hpp"
 #include "core/engine/vulkan/vk_common.h"
+#include "core/engine/vulkan/vk_memory_allocator.h"
 
 namespace vk
 {
 	struct buffer
 	{
+		/*
+			UNIFORM		: CPU written uniform data, see DYNAMIC
+			STORAGE		: device local SSBO, upload() goes through a staging buffer
+			STAGING		: host memory, transfer source only
+			INDIRECT	: device local indirect commands
+			GEOMETRY	: device local vertex/index data, read as SSBO (vertex pulling) and bound as index buffer
+			DYNAMIC		: SSBO written by the CPU every frame, host visible (BAR memory when available)
+			READBACK	: SSBO written by the GPU and read back by the CPU, host cached memory when available
+		*/
 		enum class type
 		{
-			NONE, UNIFORM, STORAGE, STAGING, INDIRECT
+			NONE, UNIFORM, STORAGE, STAGING, INDIRECT, GEOMETRY, DYNAMIC, READBACK
 		} m_type;
 
 		void init(type buffer_type, size_t size, const char* name);
 		void create();
 		void destroy();
+		/* Destroyed once the frames in flight have completed, see VkResourceManager::retire_buffer */
+		void retire();
 		bool m_b_initialized = false;
 
 		size_t m_hash;
@@ -25,12 +37,15 @@ namespace vk
 		void* map(VkDevice device, size_t offset, size_t size);
 		void unmap(VkDevice device);
 		void upload(VkDevice device, const void* data, size_t offset, size_t size);
+		/* For buffers the frames in flight read : the copy runs on the GPU once the frames submitted so far have completed */
+		void upload_after_frames(VkDevice device, const void* data, size_t offset, size_t size);
 
 		VkBuffer_T* m_vk_buffer = VK_NULL_HANDLE;
 		VkDeviceMemory_T* m_vk_device_memory = VK_NULL_HANDLE;
+		vk::allocation m_allocation;
 
 		void create_vk_buffer(size_t size);
-		void create_vk_buffer_impl(size_t size, VkBufferUsageFlags usage, VkMemoryPropertyFlags memProperties);
+		void create_vk_buffer_impl(size_t size, VkBufferUsageFlags usage, vk::memory_usage mem_usage);
 		const char* m_debug_name;
 		size_t m_size_bytes = 0;
 		void* data = nullptr;
@@ -39,4 +54,3 @@ namespace vk
 	};
 }
 
-void copy_from_buffer(const vk::buffer& src, const vk::buffer& dst, VkDeviceSize size);
@@ -2,11 +2,17 @@
 #include "core/engine/vulkan/vk_context.h"
 #include "core/engine/vulkan/objects/vk_device.h"
 
+#include "optick.h"
+
+#include <optional>
+
 namespace vk
 {
 	/************************************************************************************************/
 	/* Debug marker utility class using RAII to mark a scope										*/
 	/* https://registry.khronos.org/vulkan/specs/1.3-extensions/man/html/VK_EXT_debug_utils.html	*/
+	/* Also timed by the GPU profiler when recorded on the primary command buffer of the frame		*/
+	/* and an Optick CPU event (+ GPU event on the primary command buffer) while capturing			*/
 	/************************************************************************************************/
 	class debug_marker
 	{
@@ -16,15 +22,42 @@ namespace vk
 			this->m_cmd_buffer = cmd_buffer;
 			VkDebugUtilsLabelEXT info = { VK_STRUCTURE_TYPE_DEBUG_UTILS_LABEL_EXT, nullptr, name, *color.data() };
 			fpCmdBeginDebugUtilsLabelEXT(m_cmd_buffer, &info);
+			m_profiler_scope = ctx.profiler.begin_scope(m_cmd_buffer, name);
+#if USE_OPTICK
+			if (Optick::IsActive())
+			{
+				/* Shared descriptions are looked up by name, marker names are not always literals */
+				const Optick::EventDescription& description = *Optick::EventDescription::CreateShared(name);
+				m_optick_event.emplace(description);
+				VkCommandBuffer frame_cmd_buffer = ctx.get_current_frame().cmd_buffer;
+				if (m_cmd_buffer == frame_cmd_buffer && Optick::IsActive(Optick::Mode::GPU))
+				{
+					m_optick_gpu_context.emplace(m_cmd_buffer);
+					m_optick_gpu_event.emplace(description);
+				}
+			}
+#endif
 		}
 
 		~debug_marker()
 		{
+#if USE_OPTICK
+			m_optick_gpu_event.reset();
+			m_optick_gpu_context.reset();
+			m_optick_event.reset();
+#endif
+			ctx.profiler.end_scope(m_cmd_buffer, m_profiler_scope);
 			fpCmdEndDebugUtilsLabelEXT(m_cmd_buffer);
 		}
 	private:
 		const char* m_name = nullptr;
 		VkCommandBuffer m_cmd_buffer = VK_NULL_HANDLE;
+		uint32_t m_profiler_scope = UINT32_MAX;
+#if USE_OPTICK
+		std::optional<Optick::Event> m_optick_event;
+		std::optional<Optick::GPUContextScope> m_optick_gpu_context;
+		std::optional<Optick::GPUEvent> m_optick_gpu_event;
+#endif
 	};
 
 	/*
@@ -116,6 +116,13 @@ namespace vk
 			descriptor_pool_sizes[uint8_t(descriptor_type::storage_buffer)].descriptorCount++;
 		}
 
+		void add_storage_buffer_array_binding(uint32_t index, VkShaderStageFlags shader_stage, uint32_t count, std::string_view name)
+		{
+			add_binding(index, count, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, shader_stage, name);
+			descriptor_pool_sizes[uint8_t(descriptor_type::storage_buffer)].type = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+			descriptor_pool_sizes[uint8_t(descriptor_type::storage_buffer)].descriptorCount += count;
+		}
+
 		void add_combined_image_sampler_binding(uint32_t index, VkShaderStageFlags shader_stage, uint32_t count, std::string_view name)
 		{
 			add_binding(index, count, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, shader_stage, name);
@@ -235,7 +242,7 @@ namespace vk
 			vkUpdateDescriptorSets(ctx.device, 1u, &buffer_descriptor_write, 0, nullptr);
 		}
 
-		void write_descriptor_storage_buffer(uint32_t binding, VkBuffer buffer, VkDeviceSize offset, VkDeviceSize range)
+		void write_descriptor_storage_buffer(uint32_t binding, VkBuffer buffer, VkDeviceSize offset, VkDeviceSize range, uint32_t array_element = 0)
 		{
 			VkDescriptorBufferInfo buffer_descriptor_info =
 			{
@@ -250,7 +257,7 @@ namespace vk
 				.pNext = nullptr,
 				.dstSet = vk_set,
 				.dstBinding = binding,
-				.dstArrayElement = 0,
+				.dstArrayElement = array_element,
 				.descriptorCount = 1,
 				.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
 				.pImageInfo = nullptr,
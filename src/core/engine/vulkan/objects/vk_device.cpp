@@ -1,9 +1,12 @@
 #include "vk_device.h"
 #include "core/engine/common.h"
 
+#include <algorithm>
+#include <cstring>
+
 namespace vk
 {
-	VkResult vk::device::create()
+	VkResult vk::device::create(bool headless)
 	{
 		// Instance
 		VkApplicationInfo application_info =
@@ -17,7 +20,7 @@ namespace vk
 			.apiVersion = vk_api_version,
 		};
 
-		helper_funcs.enable_instance_extensions_layers(enabled_instance_layers, enabled_instance_extensions);
+		helper_funcs.enable_instance_extensions_layers(enabled_instance_layers, enabled_instance_extensions, headless);
 
 		VkInstanceCreateInfo instance_create_info =
 		{
@@ -44,7 +47,7 @@ namespace vk
 				vkGetPhysicalDeviceProperties(physical_device, &physical_device_properties);
 				limits = physical_device_properties.limits;
 
-				helper_funcs.enable_device_extensions(enabled_device_extensions);
+				helper_funcs.enable_device_extensions(enabled_device_extensions, headless);
 				
 				/* Enabled device features */
 				VkPhysicalDeviceDescriptorIndexingFeaturesEXT descriptor_indexing_feature = {};
@@ -52,6 +55,8 @@ namespace vk
 				VkPhysicalDeviceMultiviewFeaturesKHR multiview_feature = {};
 				VkPhysicalDeviceDepthClampZeroOneFeaturesEXT depth_clamp_feature = {};
 				VkPhysicalDeviceSynchronization2Features synchronization2_feature = {};
+				VkPhysicalDeviceTimelineSemaphoreFeatures timeline_semaphore_feature = {};
+				VkPhysicalDeviceShaderDrawParametersFeatures shader_draw_parameters_feature = {};
 				VkPhysicalDeviceExtendedDynamicState3FeaturesEXT dynamic_state3_features = {};
 
 				/* Descriptor indexing */
@@ -79,9 +84,19 @@ namespace vk
 
 				/* Synchronization 2 */
 				synchronization2_feature.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_SYNCHRONIZATION_2_FEATURES;
-				synchronization2_feature.pNext = VK_NULL_HANDLE;
+				synchronization2_feature.pNext = &timeline_semaphore_feature;
 				synchronization2_feature.synchronization2 = VK_TRUE;
 
+				/* Timeline semaphores (upload service) */
+				timeline_semaphore_feature.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_TIMELINE_SEMAPHORE_FEATURES;
+				timeline_semaphore_feature.pNext = &shader_draw_parameters_feature;
+				timeline_semaphore_feature.timelineSemaphore = VK_TRUE;
+
+				/* gl_DrawID (indirect draws) */
+				shader_draw_parameters_feature.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_SHADER_DRAW_PARAMETERS_FEATURES;
+				shader_draw_parameters_feature.pNext = VK_NULL_HANDLE;
+				shader_draw_parameters_feature.shaderDrawParameters = VK_TRUE;
+
 				physical_device_features = {};
 				physical_device_features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2;
 				physical_device_features.pNext = &descriptor_indexing_feature;
@@ -97,13 +112,32 @@ namespace vk
 				queue_family_indices[queue_family::compute]  = helper_funcs.get_queue_family_index(VK_QUEUE_COMPUTE_BIT, queue_family_properties);
 				queue_family_indices[queue_family::transfer] = helper_funcs.get_queue_family_index(VK_QUEUE_TRANSFER_BIT, queue_family_properties);
 
-				VkDeviceQueueCreateInfo queues_create_info[queue_family::count] = {};
+				/* No dedicated compute/transfer family (e.g. software implementations) : share the graphics queue */
+				for (int i = queue_family::compute; i < queue_family::count; i++)
+				{
+					if (queue_family_indices[i] == UINT32_MAX)
+					{
+						queue_family_indices[i] = queue_family_indices[queue_family::graphics];
+					}
+				}
+
+				/* One queue per unique family */
+				std::vector<VkDeviceQueueCreateInfo> queues_create_info;
 				for (int i = 0; i < queue_family::count; i++)
 				{
-					queues_create_info[i].sType = VK_STRUCTURE_TYPE_DEVICE_QUEUE_CREATE_INFO;
-					queues_create_info[i].pQueuePriorities = &default_queue_priority;
-					queues_create_info[i].queueCount = 1u;
-					queues_create_info[i].queueFamilyIndex = queue_family_indices[i];
+					bool is_duplicate = std::any_of(queues_create_info.begin(), queues_create_info.end(),
+						[&](const VkDeviceQueueCreateInfo& info) { return info.queueFamilyIndex == queue_family_indices[i]; });
+
+					if (!is_duplicate)
+					{
+						queues_create_info.push_back(
+						{
+							.sType = VK_STRUCTURE_TYPE_DEVICE_QUEUE_CREATE_INFO,
+							.queueFamilyIndex = queue_family_indices[i],
+							.queueCount = 1u,
+							.pQueuePriorities = &default_queue_priority,
+						});
+					}
 				}
 
 				VkDeviceCreateInfo device_create_info =
@@ -111,8 +145,8 @@ namespace vk
 					.sType = VK_STRUCTURE_TYPE_DEVICE_CREATE_INFO,
 					.pNext = &physical_device_features,
 					.flags = 0,
-					.queueCreateInfoCount = queue_family::count,
-					.pQueueCreateInfos = queues_create_info,
+					.queueCreateInfoCount = (uint32_t)queues_create_info.size(),
+					.pQueueCreateInfos = queues_create_info.data(),
 					.enabledExtensionCount = (uint32_t)enabled_device_extensions.size(),
 					.ppEnabledExtensionNames = enabled_device_extensions.data(),
 					.pEnabledFeatures = nullptr,
@@ -134,7 +168,7 @@ namespace vk
 		return result;
 	}
 
-	void device::helpers::enable_instance_extensions_layers(std::vector<const char*>& enabled_instance_layers, std::vector<const char*>& enabled_instance_extensions)
+	void device::helpers::enable_instance_extensions_layers(std::vector<const char*>& enabled_instance_layers, std::vector<const char*>& enabled_instance_extensions, bool headless)
 	{
 		enabled_instance_extensions =
 		{
@@ -155,15 +189,28 @@ namespace vk
 	#endif // ENGINE_DEBUG
 			"VK_LAYER_LUNARG_monitor"
 		};
+
+		/* Nothing to present : only the extensions every implementation has (e.g. lavapipe), the monitor layer draws to the window title */
+		if (headless)
+		{
+			std::erase_if(enabled_instance_extensions, [](const char* ext) { return strstr(ext, "_surface") != nullptr; });
+			std::erase_if(enabled_instance_layers, [](const char* layer) { return strcmp(layer, "VK_LAYER_LUNARG_monitor") == 0; });
+		}
 	}
-	void device::helpers::enable_device_extensions(std::vector<const char*>& enabled_device_extensions)
+	void device::helpers::enable_device_extensions(std::vector<const char*>& enabled_device_extensions, bool headless)
 	{
 		enabled_device_extensions =
 		{
 			"VK_KHR_maintenance1",
 			"VK_KHR_swapchain",
-			"VK_KHR_dynamic_rendering"
+			"VK_KHR_dynamic_rendering",
+			"VK_KHR_draw_indirect_count"
 		};
+
+		if (headless)
+		{
+			std::erase_if(enabled_device_extensions, [](const char* ext) { return strcmp(ext, "VK_KHR_swapchain") == 0; });
+		}
 	}
 	void device::helpers::enable_physical_device_features(VkPhysicalDevice physical_device, VkPhysicalDeviceFeatures2& physical_features2)
 	{
@@ -237,7 +284,7 @@ namespace vk
 			}
 		}
 
-		LOG_ERROR("Could not find queue family index for queue family.");
+		LOG_WARN("Could not find a dedicated queue family for queue flags {}.", (uint32_t)queue_family);
 		return -1;
 	}
 	void device::helpers::load_device_function_pointers(VkDevice device)
@@ -246,6 +293,8 @@ namespace vk
 		fpCmdEndDebugUtilsLabelEXT = PFN_vkCmdEndDebugUtilsLabelEXT(vkGetDeviceProcAddr(device, "vkCmdEndDebugUtilsLabelEXT"));
 		fpCmdInsertDebugUtilsLabelEXT = PFN_vkCmdInsertDebugUtilsLabelEXT(vkGetDeviceProcAddr(device, "vkCmdInsertDebugUtilsLabelEXT"));
 		fpSetDebugUtilsObjectNameEXT = PFN_vkSetDebugUtilsObjectNameEXT(vkGetDeviceProcAddr(device, "vkSetDebugUtilsObjectNameEXT"));
+		fpCmdDrawIndirectCountKHR = PFN_vkCmdDrawIndirectCountKHR(vkGetDeviceProcAddr(device, "vkCmdDrawIndirectCountKHR"));
+		fpCmdDrawIndexedIndirectCountKHR = PFN_vkCmdDrawIndexedIndirectCountKHR(vkGetDeviceProcAddr(device, "vkCmdDrawIndexedIndirectCountKHR"));
 	}
 
 	uint32_t device::find_memory_type(uint32_t memory_type_bits, VkMemoryPropertyFlags memory_properties)
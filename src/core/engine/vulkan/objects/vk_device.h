@@ -10,7 +10,8 @@ namespace vk
 	class device
 	{
 	public:
-		VkResult create();
+		/* headless : no surface/swapchain extensions, see RenderInterface::create_offscreen_targets */
+		VkResult create(bool headless = false);
 		operator VkDevice() const { return m_device; }
 		VkInstance instance;
 		VkPhysicalDevice physical_device;
@@ -23,6 +24,7 @@ namespace vk
 		VkQueue transfer_queue = VK_NULL_HANDLE;
 	public:
 		uint32_t find_memory_type(uint32_t memory_type_bits, VkMemoryPropertyFlags memory_properties);
+		bool is_texture_compression_bc_supported() const { return physical_device_features.features.textureCompressionBC == VK_TRUE; }
 	protected:
 		VkDevice m_device = VK_NULL_HANDLE;
 		VkPhysicalDeviceProperties physical_device_properties = {};
@@ -34,8 +36,8 @@ namespace vk
 
 		struct helpers
 		{
-			void enable_instance_extensions_layers(std::vector<const char*>& enabled_instance_layers, std::vector<const char*>& enabled_instance_extensions);
-			void enable_device_extensions(std::vector<const char*>& enabled_device_extensions);
+			void enable_instance_extensions_layers(std::vector<const char*>& enabled_instance_layers, std::vector<const char*>& enabled_instance_extensions, bool headless);
+			void enable_device_extensions(std::vector<const char*>& enabled_device_extensions, bool headless);
 			void enable_physical_device_features(VkPhysicalDevice physical_device, VkPhysicalDeviceFeatures2& physical_device_features);
 			int get_queue_family_index(VkQueueFlagBits queue_family, std::span<VkQueueFamilyProperties> queue_family_properties);
 			void load_device_function_pointers(VkDevice device);
@@ -46,4 +48,6 @@ namespace vk
 	inline PFN_vkCmdEndDebugUtilsLabelEXT		fpCmdEndDebugUtilsLabelEXT;
 	inline PFN_vkCmdInsertDebugUtilsLabelEXT	fpCmdInsertDebugUtilsLabelEXT;
 	inline PFN_vkSetDebugUtilsObjectNameEXT		fpSetDebugUtilsObjectNameEXT;
+	inline PFN_vkCmdDrawIndirectCountKHR		fpCmdDrawIndirectCountKHR;
+	inline PFN_vkCmdDrawIndexedIndirectCountKHR	fpCmdDrawIndexedIndirectCountKHR;
 }
\ No newline at end of file
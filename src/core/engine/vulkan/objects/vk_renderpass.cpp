@@ -4,7 +4,7 @@
 
 namespace vk
 {
-	void renderpass_dynamic::begin(VkCommandBuffer cmd_buffer, glm::vec2 extent, uint32_t viewMask)
+	void renderpass_dynamic::begin(VkCommandBuffer cmd_buffer, glm::vec2 extent, uint32_t viewMask, VkRenderingFlags flags)
 	{
 		VkRect2D area = {};
 		area.offset.x = 0;
@@ -14,6 +14,7 @@ namespace vk
 
 		VkRenderingInfo render_info = {};
 		render_info.sType = VK_STRUCTURE_TYPE_RENDERING_INFO;
+		render_info.flags = flags;
 		render_info.renderArea = area;
 		render_info.layerCount = 1;
 		render_info.colorAttachmentCount = (uint32_t)color_attachments.size();
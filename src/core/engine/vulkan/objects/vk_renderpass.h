@@ -8,7 +8,7 @@ namespace vk
 {
 	struct renderpass_dynamic
 	{
-		void begin(VkCommandBuffer cmd_buffer, glm::vec2 extent, uint32_t viewMask = 0);
+		void begin(VkCommandBuffer cmd_buffer, glm::vec2 extent, uint32_t viewMask = 0, VkRenderingFlags flags = 0);
 		void end(VkCommandBuffer cmd_buffer) const;
 		void reset();
 
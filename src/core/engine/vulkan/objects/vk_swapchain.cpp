@@ -124,6 +124,34 @@ namespace vk
 		end_temp_cmd_buffer(cmd_buffer);
 	}
 
+	void swapchain::init_offscreen(uint32_t width, uint32_t height, VkFormat colorFormat, VkFormat depthStencilFormat)
+	{
+		is_offscreen = true;
+		info.image_count = NUM_FRAMES;
+		info.width = width;
+		info.height = height;
+		info.color_format = colorFormat;
+		info.color_space = VK_COLOR_SPACE_SRGB_NONLINEAR_KHR;
+		info.depth_format = depthStencilFormat;
+		info.present_mode = VK_PRESENT_MODE_FIFO_KHR;
+
+		color_attachments.resize(info.image_count);
+		depth_attachments.resize(info.image_count);
+
+		for (uint32_t i = 0; i < info.image_count; i++)
+		{
+			std::string color_name = "Offscreen Color Image #" + std::to_string(i);
+			color_attachments[i].init(colorFormat, info.width, info.height, 1, false, color_name.c_str());
+			color_attachments[i].create(ctx.device, VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT);
+
+			std::string ds_name = "Offscreen Depth/Stencil Image #" + std::to_string(i);
+			depth_attachments[i].init(depthStencilFormat, info.width, info.height, 1, false, ds_name.c_str());
+			depth_attachments[i].create(ctx.device, VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT);
+		}
+
+		LOG_INFO("Offscreen render targets : {}x{}", info.width, info.height);
+	}
+
 	void swapchain::reinitialize()
 	{
 		LOG_INFO("Reinitializing swapchain");
@@ -147,11 +175,27 @@ namespace vk
 			depth_attachments[i].destroy();
 		}
 
+		if (is_offscreen)
+		{
+			for (uint32_t i = 0; i < info.image_count; i++)
+			{
+				color_attachments[i].destroy();
+			}
+			return;
+		}
+
 		vkDestroySwapchainKHR(ctx.device, vk_swapchain, nullptr);
 	}
 
 	VkResult swapchain::acquire_next_image(VkSemaphore imageAcquiredSmp)
 	{
+		/* The image of a frame in flight is free once its fence has been waited : nothing is signaled */
+		if (is_offscreen)
+		{
+			current_backbuffer_idx = ctx.curr_frame_idx;
+			return VK_SUCCESS;
+		}
+
 		return vkAcquireNextImageKHR(ctx.device, vk_swapchain, UINT64_MAX, imageAcquiredSmp, VK_NULL_HANDLE, &current_backbuffer_idx);
 	}
 
@@ -24,6 +24,8 @@ namespace vk
 		swapchain() = default;
 		swapchain(VkSurfaceKHR surface);
 		void init(VkFormat colorFormat, VkColorSpaceKHR colorSpace, VkFormat depthStencilFormat);
+		/* No surface : the color attachments are regular images, left in TRANSFER_SRC_OPTIMAL at the end of a frame */
+		void init_offscreen(uint32_t width, uint32_t height, VkFormat colorFormat, VkFormat depthStencilFormat);
 		void reinitialize();
 		void destroy();
 		void clear_color(VkCommandBuffer cmd_buffer);
@@ -33,9 +35,10 @@ namespace vk
 		VkResult acquire_next_image(VkSemaphore imageAcquiredSmp);
 		VkResult present(VkCommandBuffer cmdBuffer, VkQueue queue, uint32_t imageIndices);
 
-		VkSurfaceKHR h_surface;
-		VkSwapchainKHR vk_swapchain;
+		VkSurfaceKHR h_surface = VK_NULL_HANDLE;
+		VkSwapchainKHR vk_swapchain = VK_NULL_HANDLE;
 		swapchain_info info;
+		bool is_offscreen = false;
 
 		std::vector<Texture2D> color_attachments;
 		std::vector<Texture2D> depth_attachments;
@@ -1,11 +0,0 @@
-#include "vk_texture.h"
-#include "core/engine/vulkan/job/vk_texture_job.h"
-
-namespace vk
-{
-	void vk::texture::load(const vk::texture_load_info& load_info)
-	{
-
-	}
-}
-
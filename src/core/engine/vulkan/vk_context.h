@@ -3,6 +3,9 @@
 #include "core/engine/common.h"
 #include "core/engine/vulkan/objects/vk_device.h"
 #include "core/engine/vulkan/objects/vk_swapchain.h"
+#include "core/engine/vulkan/vk_upload_service.h"
+#include "core/engine/vulkan/vk_parallel_recorder.h"
+#include "core/engine/vulkan/vk_gpu_profiler.h"
 #include "core/rendering/vulkan/vk_frame.hpp"
 
 /* Number of frames in flight */
@@ -17,6 +20,10 @@ namespace vk
 
 		vk::device device;
 		vk::frame frames[NUM_FRAMES];
+		VkSemaphore frame_timeline_semaphore = VK_NULL_HANDLE;	/* The submission of frame_count N signals N + 1 */
+		vk::upload_service uploader;
+		vk::parallel_recorder recorder;
+		vk::gpu_profiler profiler;
 
 		vk::frame& get_current_frame() { return frames[curr_frame_idx]; }
 		void update_frame_index() { curr_frame_idx = (curr_frame_idx + 1) % NUM_FRAMES; }
@@ -0,0 +1,312 @@
+#include "vk_gpu_profiler.h"
+#include "core/engine/logger.h"
+#include "core/engine/vulkan/objects/vk_device.h"
+
+#include "imgui.h"
+
+#include <algorithm>
+#include <cassert>
+#include <cstdio>
+
+namespace vk
+{
+	void gpu_profiler::init(const vk::device& device, uint32_t queue_family_index, uint32_t num_frames)
+	{
+		m_device = device;
+
+		uint32_t num_queue_families = 0;
+		vkGetPhysicalDeviceQueueFamilyProperties(device.physical_device, &num_queue_families, nullptr);
+		std::vector<VkQueueFamilyProperties> queue_families(num_queue_families);
+		vkGetPhysicalDeviceQueueFamilyProperties(device.physical_device, &num_queue_families, queue_families.data());
+
+		uint32_t valid_bits = queue_families[queue_family_index].timestampValidBits;
+		m_is_supported = valid_bits > 0;
+		if (!m_is_supported)
+		{
+			LOG_WARN("GPU profiler : timestamps are not supported by the queue.");
+			return;
+		}
+
+		m_timestamp_mask = valid_bits >= 64 ? UINT64_MAX : (1ull << valid_bits) - 1;
+		m_timestamp_period_ns = device.physical_device_properties.limits.timestampPeriod;
+
+		VkQueryPoolCreateInfo pool_info =
+		{
+			.sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO,
+			.queryType = VK_QUERY_TYPE_TIMESTAMP,
+			.queryCount = 2 * max_scopes
+		};
+
+		m_frames.resize(num_frames);
+		for (frame_queries& frame : m_frames)
+		{
+			VK_CHECK(vkCreateQueryPool(m_device, &pool_info, nullptr, &frame.pool));
+		}
+	}
+
+	void gpu_profiler::destroy()
+	{
+		for (frame_queries& frame : m_frames)
+		{
+			vkDestroyQueryPool(m_device, frame.pool, nullptr);
+		}
+		m_frames.clear();
+		m_current = nullptr;
+	}
+
+	void gpu_profiler::begin_frame(VkCommandBuffer cmd_buffer, uint32_t frame_idx)
+	{
+		if (!m_is_supported)
+		{
+			return;
+		}
+
+		frame_queries& frame = m_frames[frame_idx];
+		read_results(frame);
+		frame.scopes.clear();
+		frame.frame_number = m_num_frames++;
+
+		if (!enabled)
+		{
+			return;
+		}
+
+		vkCmdResetQueryPool(cmd_buffer, frame.pool, 0, 2 * max_scopes);
+		m_current = &frame;
+		m_cmd_buffer = cmd_buffer;
+		m_open_scope = UINT32_MAX;
+		m_frame_scope = begin_scope(cmd_buffer, "Frame");
+	}
+
+	void gpu_profiler::end_frame(VkCommandBuffer cmd_buffer)
+	{
+		if (m_current == nullptr)
+		{
+			return;
+		}
+
+		end_scope(cmd_buffer, m_frame_scope);
+		m_current = nullptr;
+		m_cmd_buffer = VK_NULL_HANDLE;
+	}
+
+	void gpu_profiler::flush()
+	{
+		std::vector<frame_queries*> pending;
+		for (frame_queries& frame : m_frames)
+		{
+			pending.push_back(&frame);
+		}
+
+		/* Oldest first, the last frame read is the one shown */
+		std::sort(pending.begin(), pending.end(), [](const frame_queries* a, const frame_queries* b) { return a->frame_number < b->frame_number; });
+		for (frame_queries* frame : pending)
+		{
+			read_results(*frame);
+			frame->scopes.clear();
+		}
+	}
+
+	uint32_t gpu_profiler::begin_scope(VkCommandBuffer cmd_buffer, const char* name)
+	{
+		if (m_current == nullptr || cmd_buffer != m_cmd_buffer || m_current->scopes.size() >= max_scopes)
+		{
+			return UINT32_MAX;
+		}
+
+		uint32_t index = (uint32_t)m_current->scopes.size();
+		uint32_t depth = m_open_scope == UINT32_MAX ? 0 : m_current->scopes[m_open_scope].depth + 1;
+		m_current->scopes.push_back({ name, m_open_scope, depth });
+		m_open_scope = index;
+
+		vkCmdWriteTimestamp2(cmd_buffer, VK_PIPELINE_STAGE_2_TOP_OF_PIPE_BIT, m_current->pool, 2 * index);
+		return index;
+	}
+
+	void gpu_profiler::end_scope(VkCommandBuffer cmd_buffer, uint32_t scope)
+	{
+		if (scope == UINT32_MAX || m_current == nullptr)
+		{
+			return;
+		}
+
+		/* Scopes are RAII markers : they end in reverse order */
+		assert(scope == m_open_scope);
+		m_open_scope = m_current->scopes[scope].parent;
+
+		vkCmdWriteTimestamp2(cmd_buffer, VK_PIPELINE_STAGE_2_BOTTOM_OF_PIPE_BIT, m_current->pool, 2 * scope + 1);
+	}
+
+	void gpu_profiler::read_results(frame_queries& frame)
+	{
+		if (frame.scopes.empty())
+		{
+			return;
+		}
+
+		/* The fence of the frame has been waited : no VK_QUERY_RESULT_WAIT_BIT needed */
+		std::vector<uint64_t> timestamps(2 * frame.scopes.size());
+		VkResult result = vkGetQueryPoolResults(m_device, frame.pool, 0, (uint32_t)timestamps.size(), timestamps.size() * sizeof(uint64_t),
+			timestamps.data(), sizeof(uint64_t), VK_QUERY_RESULT_64_BIT);
+		if (result != VK_SUCCESS)
+		{
+			return;
+		}
+
+		m_last_frame_order.clear();
+
+		std::vector<std::string> paths(frame.scopes.size());
+		for (size_t i = 0; i < frame.scopes.size(); i++)
+		{
+			const scope& s = frame.scopes[i];
+			paths[i] = s.parent == UINT32_MAX ? s.name : paths[s.parent] + "/" + s.name;
+
+			auto [it, inserted] = m_stats_index.try_emplace(paths[i], m_stats.size());
+			if (inserted)
+			{
+				m_stats.push_back({ .path = paths[i], .name = s.name, .depth = s.depth });
+			}
+
+			uint64_t ticks = (timestamps[2 * i + 1] - timestamps[2 * i]) & m_timestamp_mask;
+			float ms = float(double(ticks) * m_timestamp_period_ns * 1e-6);
+
+			scope_stats& stats = m_stats[it->second];
+			stats.last_ms = ms;
+			stats.history[stats.head] = ms;
+			stats.head = (stats.head + 1) % k_history_size;
+			stats.num_samples = std::min(stats.num_samples + 1, k_history_size);
+
+			m_last_frame_order.push_back(it->second);
+		}
+
+		/* Scope 0 is the "Frame" scope opened in begin_frame() */
+		if (record_frame_times)
+		{
+			if (frame_times_ms.size() <= frame.frame_number)
+			{
+				frame_times_ms.resize(frame.frame_number + 1, 0.0f);
+			}
+			frame_times_ms[frame.frame_number] = m_stats[m_last_frame_order.front()].last_ms;
+		}
+	}
+
+	float gpu_profiler::scope_stats::get_min() const
+	{
+		return num_samples ? *std::min_element(history, history + num_samples) : 0.0f;
+	}
+
+	float gpu_profiler::scope_stats::get_avg() const
+	{
+		float sum = 0.0f;
+		for (uint32_t i = 0; i < num_samples; i++)
+		{
+			sum += history[i];
+		}
+		return num_samples ? sum / num_samples : 0.0f;
+	}
+
+	float gpu_profiler::scope_stats::get_max() const
+	{
+		return num_samples ? *std::max_element(history, history + num_samples) : 0.0f;
+	}
+
+	void gpu_profiler::show_ui()
+	{
+		if (ImGui::Begin("GPU Profiler"))
+		{
+			if (!m_is_supported)
+			{
+				ImGui::Text("Timestamps are not supported by the graphics queue.");
+				ImGui::End();
+				return;
+			}
+
+			ImGui::Checkbox("Enabled", &enabled);
+			ImGui::SameLine();
+			if (ImGui::Button("Export CSV"))
+			{
+				export_csv(export_path + ".csv");
+			}
+			ImGui::SameLine();
+			if (ImGui::Button("Export JSON"))
+			{
+				export_json(export_path + ".json");
+			}
+
+			ImGuiTableFlags flags = ImGuiTableFlags_RowBg | ImGuiTableFlags_BordersInnerV | ImGuiTableFlags_SizingStretchProp;
+			if (ImGui::BeginTable("GPU Scopes", 5, flags))
+			{
+				ImGui::TableSetupColumn("Pass");
+				ImGui::TableSetupColumn("Last (ms)");
+				ImGui::TableSetupColumn("Min");
+				ImGui::TableSetupColumn("Avg");
+				ImGui::TableSetupColumn("Max");
+				ImGui::TableHeadersRow();
+
+				for (size_t index : m_last_frame_order)
+				{
+					const scope_stats& stats = m_stats[index];
+					ImGui::TableNextRow();
+					ImGui::TableNextColumn();
+					ImGui::Text("%*s%s", int(2 * stats.depth), "", stats.name.c_str());
+					ImGui::TableNextColumn();
+					ImGui::Text("%.3f", stats.last_ms);
+					ImGui::TableNextColumn();
+					ImGui::Text("%.3f", stats.get_min());
+					ImGui::TableNextColumn();
+					ImGui::Text("%.3f", stats.get_avg());
+					ImGui::TableNextColumn();
+					ImGui::Text("%.3f", stats.get_max());
+				}
+
+				ImGui::EndTable();
+			}
+		}
+		ImGui::End();
+	}
+
+	bool gpu_profiler::export_csv(const std::string& path) const
+	{
+		FILE* file = fopen(path.c_str(), "w");
+		if (!file)
+		{
+			LOG_ERROR("GPU profiler : cannot write {}", path);
+			return false;
+		}
+
+		fprintf(file, "scope,depth,last_ms,min_ms,avg_ms,max_ms,samples\n");
+		for (const scope_stats& stats : m_stats)
+		{
+			fprintf(file, "\"%s\",%u,%.4f,%.4f,%.4f,%.4f,%u\n", stats.path.c_str(), stats.depth, stats.last_ms,
+				stats.get_min(), stats.get_avg(), stats.get_max(), stats.num_samples);
+		}
+		fclose(file);
+
+		LOG_INFO("GPU profiler : exported {} scopes to {}", m_stats.size(), path);
+		return true;
+	}
+
+	bool gpu_profiler::export_json(const std::string& path) const
+	{
+		FILE* file = fopen(path.c_str(), "w");
+		if (!file)
+		{
+			LOG_ERROR("GPU profiler : cannot write {}", path);
+			return false;
+		}
+
+		fprintf(file, "{\n\t\"history_frames\": %u,\n\t\"scopes\": [\n", k_history_size);
+		for (size_t i = 0; i < m_stats.size(); i++)
+		{
+			const scope_stats& stats = m_stats[i];
+			fprintf(file, "\t\t{ \"path\": \"%s\", \"depth\": %u, \"last_ms\": %.4f, \"min_ms\": %.4f, \"avg_ms\": %.4f, \"max_ms\": %.4f, \"samples\": %u }%s\n",
+				stats.path.c_str(), stats.depth, stats.last_ms, stats.get_min(), stats.get_avg(), stats.get_max(), stats.num_samples,
+				i + 1 < m_stats.size() ? "," : "");
+		}
+		fprintf(file, "\t]\n}\n");
+		fclose(file);
+
+		LOG_INFO("GPU profiler : exported {} scopes to {}", m_stats.size(), path);
+		return true;
+	}
+}
@@ -0,0 +1,106 @@
+#pragma once
+
+#include "core/engine/vulkan/vk_common.h"
+
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+namespace vk
+{
+	class device;
+
+	/*
+		GPU timings of the scopes marked with VULKAN_RENDER_DEBUG_MARKER.
+		Each frame in flight has its own timestamp query pool : scopes recorded on the primary command buffer of the
+		frame write a timestamp when they begin and end, nested scopes form a hierarchy. The results of a frame are read
+		in begin_frame() once its fence has been waited, NUM_FRAMES frames later, so reading never stalls.
+		Scopes recorded on other command buffers (secondaries, immediate submits) are not timed. Scopes must not begin or
+		end inside a multiview render pass, where a timestamp takes one query per view.
+	*/
+	class gpu_profiler
+	{
+	public:
+		void init(const vk::device& device, uint32_t queue_family_index, uint32_t num_frames);
+		void destroy();
+
+		/* Call once the fence of the frame has been waited, after cmd_buffer (the primary of the frame) has begun */
+		void begin_frame(VkCommandBuffer cmd_buffer, uint32_t frame_idx);
+
+		/* Before cmd_buffer ends */
+		void end_frame(VkCommandBuffer cmd_buffer);
+
+		/* Reads the results of the frames still in flight. Call once the device is idle. */
+		void flush();
+
+		/* Returns the scope index to end, UINT32_MAX if the scope is not timed */
+		uint32_t begin_scope(VkCommandBuffer cmd_buffer, const char* name);
+		void end_scope(VkCommandBuffer cmd_buffer, uint32_t scope);
+
+		void show_ui();
+
+		/* One line/object per scope : path, depth and last/min/avg/max in ms */
+		bool export_csv(const std::string& path) const;
+		bool export_json(const std::string& path) const;
+
+		bool enabled = true;
+		uint32_t max_scopes = 128;					/* Per frame */
+
+		/* GPU time of every frame ("Frame" scope) indexed by frame number, for benchmark runs. 0 : not timed. */
+		bool record_frame_times = false;
+		std::vector<float> frame_times_ms;
+		std::string export_path = "gpu_profile";	/* .csv/.json appended */
+
+		static constexpr uint32_t k_history_size = 128;	/* Frames the min/avg/max are computed over */
+
+	private:
+		struct scope
+		{
+			std::string name;			/* Copied : markers may be named from temporary strings */
+			uint32_t parent;
+			uint32_t depth;
+		};
+
+		struct frame_queries
+		{
+			VkQueryPool pool = VK_NULL_HANDLE;
+			std::vector<scope> scopes;			/* In recording order, the query of scope i is 2i at begin and 2i+1 at end */
+			uint64_t frame_number = 0;
+		};
+
+		/* Timings of a scope path (e.g. "Frame/Deferred Shading/Deferred Lighting Pass") */
+		struct scope_stats
+		{
+			std::string path;
+			std::string name;
+			uint32_t depth = 0;
+			float history[k_history_size] = {};
+			uint32_t num_samples = 0;
+			uint32_t head = 0;
+			float last_ms = 0.0f;
+
+			float get_min() const;
+			float get_avg() const;
+			float get_max() const;
+		};
+
+		void read_results(frame_queries& frame);
+
+		VkDevice m_device = VK_NULL_HANDLE;
+		float m_timestamp_period_ns = 0.0f;
+		uint64_t m_timestamp_mask = 0;
+		bool m_is_supported = false;
+
+		std::vector<frame_queries> m_frames;
+		frame_queries* m_current = nullptr;			/* Null outside begin_frame/end_frame */
+		VkCommandBuffer m_cmd_buffer = VK_NULL_HANDLE;
+		uint32_t m_open_scope = UINT32_MAX;
+		uint32_t m_frame_scope = UINT32_MAX;
+		uint64_t m_num_frames = 0;					/* Frames begun */
+
+		std::vector<scope_stats> m_stats;
+		std::unordered_map<std::string, size_t> m_stats_index;
+		std::vector<size_t> m_last_frame_order;		/* m_stats indices of the last frame read, in recording order */
+	};
+}
@@ -0,0 +1,510 @@
+#include "vk_memory_allocator.h"
+#include "core/engine/logger.h"
+
+#include <algorithm>
+#include <cassert>
+#include <span>
+#include <string>
+
+namespace vk
+{
+	static constexpr VkDeviceSize max_block_size = 64ull * 1024 * 1024;
+	static constexpr VkDeviceSize min_block_size = 4ull * 1024 * 1024;
+
+	static VkDeviceSize align_up(VkDeviceSize value, VkDeviceSize alignment)
+	{
+		return alignment > 1 ? (value + alignment - 1) & ~(alignment - 1) : value;
+	}
+
+	struct placement_step
+	{
+		VkMemoryPropertyFlags required;
+		VkMemoryPropertyFlags avoided;
+	};
+
+	/* Keep BAR memory for dynamic data : GPU only resources first look for device local memory that is not host visible */
+	static constexpr placement_step gpu_only_chain[] =
+	{
+		{ VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT },
+		{ VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, 0 },
+		{ 0, 0 },
+	};
+
+	static constexpr placement_step dynamic_chain[] =
+	{
+		{ VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT | VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, 0 },
+		{ VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, 0 },
+	};
+
+	static constexpr placement_step staging_chain[] =
+	{
+		{ VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT },
+		{ VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, 0 },
+	};
+
+	static constexpr placement_step readback_chain[] =
+	{
+		{ VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT | VK_MEMORY_PROPERTY_HOST_CACHED_BIT, 0 },
+		{ VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT },
+		{ VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, 0 },
+	};
+
+	static std::span<const placement_step> get_placement_chain(memory_usage usage)
+	{
+		switch (usage)
+		{
+		case memory_usage::GPU_ONLY:	return gpu_only_chain;
+		case memory_usage::DYNAMIC:		return dynamic_chain;
+		case memory_usage::STAGING:		return staging_chain;
+		case memory_usage::READBACK:	return readback_chain;
+		default:						assert(false); return {};
+		}
+	}
+
+	static const char* get_usage_name(memory_usage usage)
+	{
+		switch (usage)
+		{
+		case memory_usage::GPU_ONLY:	return "GPU only";
+		case memory_usage::DYNAMIC:		return "Dynamic";
+		case memory_usage::STAGING:		return "Staging";
+		case memory_usage::READBACK:	return "Readback";
+		default:						return "Unknown";
+		}
+	}
+
+	void memory_allocator::init(VkDevice device, VkPhysicalDevice physical_device)
+	{
+		m_device = device;
+		vkGetPhysicalDeviceMemoryProperties(physical_device, &m_memory_properties);
+
+		m_pools.resize(m_memory_properties.memoryTypeCount * 2);
+		for (uint32_t i = 0; i < m_memory_properties.memoryTypeCount; i++)
+		{
+			m_pools[i * 2 + 0] = { .memory_type_index = i, .kind = resource_kind::LINEAR };
+			m_pools[i * 2 + 1] = { .memory_type_index = i, .kind = resource_kind::OPTIMAL };
+		}
+
+		log_placement_policy();
+	}
+
+	void memory_allocator::log_placement_policy() const
+	{
+		constexpr float to_mb = 1.0f / (1024.0f * 1024.0f);
+
+		for (uint32_t i = 0; i < m_memory_properties.memoryHeapCount; i++)
+		{
+			LOG_INFO("Memory heap {} : {:.0f} MB{}", i, m_memory_properties.memoryHeaps[i].size * to_mb,
+				(m_memory_properties.memoryHeaps[i].flags & VK_MEMORY_HEAP_DEVICE_LOCAL_BIT) ? ", device local" : "");
+		}
+
+		for (size_t usage = 0; usage < (size_t)memory_usage::COUNT; usage++)
+		{
+			const std::span<const placement_step> chain = get_placement_chain((memory_usage)usage);
+			for (size_t step = 0; step < chain.size(); step++)
+			{
+				uint32_t memory_type_index = find_memory_type(UINT32_MAX, chain[step].required, chain[step].avoided);
+				if (memory_type_index != UINT32_MAX)
+				{
+					const VkMemoryType& type = m_memory_properties.memoryTypes[memory_type_index];
+					LOG_INFO("{} memory -> type {} (heap {}, flags {:#x}){}", get_usage_name((memory_usage)usage), memory_type_index, type.heapIndex,
+						type.propertyFlags, step > 0 ? ", fallback" : "");
+					break;
+				}
+			}
+		}
+	}
+
+	void memory_allocator::destroy()
+	{
+		std::lock_guard lock(m_mutex);
+
+		for (pool& p : m_pools)
+		{
+			for (block& b : p.blocks)
+			{
+				if (b.allocation_count > 0)
+				{
+					LOG_WARN("Memory block of type {} destroyed with {} live allocations.", p.memory_type_index, b.allocation_count);
+				}
+				destroy_block(b);
+			}
+			p.blocks.clear();
+			p.bytes_used = 0;
+			p.bytes_wasted = 0;
+		}
+	}
+
+	uint32_t memory_allocator::find_memory_type(uint32_t memory_type_bits, VkMemoryPropertyFlags properties, VkMemoryPropertyFlags avoided_properties) const
+	{
+		uint32_t fallback = UINT32_MAX;
+
+		for (uint32_t i = 0; i < m_memory_properties.memoryTypeCount; i++)
+		{
+			VkMemoryPropertyFlags type_properties = m_memory_properties.memoryTypes[i].propertyFlags;
+			if ((memory_type_bits & (1u << i)) && (type_properties & properties) == properties)
+			{
+				if ((type_properties & avoided_properties) == 0)
+				{
+					return i;
+				}
+
+				if (fallback == UINT32_MAX)
+				{
+					fallback = i;
+				}
+			}
+		}
+
+		return fallback;
+	}
+
+	VkDeviceSize memory_allocator::get_block_size(uint32_t memory_type_index) const
+	{
+		/* Small heaps (e.g. 256MB BAR) get smaller blocks so that a few pools cannot exhaust them */
+		uint32_t heap_index = m_memory_properties.memoryTypes[memory_type_index].heapIndex;
+		VkDeviceSize heap_size = m_memory_properties.memoryHeaps[heap_index].size;
+		return std::clamp(heap_size / 8, min_block_size, max_block_size);
+	}
+
+	bool memory_allocator::create_block(pool& p, VkDeviceSize size, bool is_dedicated, block& out_block)
+	{
+		VkMemoryAllocateInfo alloc_info =
+		{
+			.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO,
+			.allocationSize = size,
+			.memoryTypeIndex = p.memory_type_index
+		};
+
+		if (vkAllocateMemory(m_device, &alloc_info, nullptr, &out_block.memory) != VK_SUCCESS)
+		{
+			return false;
+		}
+
+		out_block.size = size;
+		out_block.is_dedicated = is_dedicated;
+		out_block.allocation_count = 0;
+		out_block.free_ranges.clear();
+		out_block.free_ranges.insert({ 0, size });
+
+		if (m_memory_properties.memoryTypes[p.memory_type_index].propertyFlags & VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT)
+		{
+			void* p_data = nullptr;
+			VK_CHECK(vkMapMemory(m_device, out_block.memory, 0, VK_WHOLE_SIZE, 0, &p_data));
+			out_block.mapped = (uint8_t*)p_data;
+		}
+
+		return true;
+	}
+
+	void memory_allocator::destroy_block(block& b)
+	{
+		if (VK_NULL_HANDLE != b.memory)
+		{
+			if (b.mapped)
+			{
+				vkUnmapMemory(m_device, b.memory);
+			}
+			vkFreeMemory(m_device, b.memory, nullptr);
+		}
+
+		b = {};
+	}
+
+	bool memory_allocator::allocate_from_block(block& b, const VkMemoryRequirements& requirements, allocation& out_alloc)
+	{
+		/* First fit */
+		for (auto it = b.free_ranges.begin(); it != b.free_ranges.end(); ++it)
+		{
+			VkDeviceSize range_offset = it->first;
+			VkDeviceSize range_size = it->second;
+			VkDeviceSize aligned_offset = align_up(range_offset, requirements.alignment);
+
+			if (aligned_offset + requirements.size > range_offset + range_size)
+			{
+				continue;
+			}
+
+			VkDeviceSize taken_size = aligned_offset + requirements.size - range_offset;
+			b.free_ranges.erase(it);
+			if (taken_size < range_size)
+			{
+				b.free_ranges.insert({ range_offset + taken_size, range_size - taken_size });
+			}
+
+			b.allocation_count++;
+
+			out_alloc.memory = b.memory;
+			out_alloc.offset = aligned_offset;
+			out_alloc.size = requirements.size;
+			out_alloc.mapped = b.mapped ? b.mapped + aligned_offset : nullptr;
+			out_alloc.range_offset = range_offset;
+			out_alloc.range_size = taken_size;
+			out_alloc.is_dedicated = b.is_dedicated;
+			return true;
+		}
+
+		return false;
+	}
+
+	allocation memory_allocator::allocate_from_type(const VkMemoryRequirements& requirements, uint32_t memory_type_index, resource_kind kind)
+	{
+		allocation alloc;
+
+		uint32_t pool_index = memory_type_index * 2 + (kind == resource_kind::OPTIMAL ? 1 : 0);
+		pool& p = m_pools[pool_index];
+		alloc.pool_index = pool_index;
+
+		VkDeviceSize block_size = get_block_size(memory_type_index);
+
+		/* Large resources (render targets, big vertex buffers) get their own memory : no point fragmenting a block with them */
+		if (requirements.size > block_size / 2)
+		{
+			block& b = p.blocks.emplace_back();
+			if (!create_block(p, requirements.size, true, b) || !allocate_from_block(b, requirements, alloc))
+			{
+				p.blocks.pop_back();
+				return {};
+			}
+		}
+		else
+		{
+			bool found = false;
+			for (block& b : p.blocks)
+			{
+				if (!b.is_dedicated && allocate_from_block(b, requirements, alloc))
+				{
+					found = true;
+					break;
+				}
+			}
+
+			if (!found)
+			{
+				block& b = p.blocks.emplace_back();
+				if (!create_block(p, block_size, false, b) || !allocate_from_block(b, requirements, alloc))
+				{
+					p.blocks.pop_back();
+					return {};
+				}
+			}
+		}
+
+		p.bytes_used += alloc.size;
+		p.bytes_wasted += alloc.offset - alloc.range_offset;
+
+		return alloc;
+	}
+
+	allocation memory_allocator::allocate(const VkMemoryRequirements& requirements, VkMemoryPropertyFlags properties, resource_kind kind, const char* debug_name)
+	{
+		uint32_t memory_type_index = find_memory_type(requirements.memoryTypeBits, properties);
+		if (memory_type_index == UINT32_MAX)
+		{
+			LOG_ERROR("No memory type matches the requested properties for {}.", debug_name ? debug_name : "<unnamed>");
+			return {};
+		}
+
+		std::lock_guard lock(m_mutex);
+
+		allocation alloc = allocate_from_type(requirements, memory_type_index, kind);
+		if (!alloc.is_valid())
+		{
+			LOG_ERROR("Failed to allocate {} bytes from memory type {} for {}.", requirements.size, memory_type_index, debug_name ? debug_name : "<unnamed>");
+		}
+
+		return alloc;
+	}
+
+	allocation memory_allocator::allocate(const VkMemoryRequirements& requirements, memory_usage usage, resource_kind kind, const char* debug_name)
+	{
+		std::lock_guard lock(m_mutex);
+
+		const std::span<const placement_step> chain = get_placement_chain(usage);
+		for (size_t step = 0; step < chain.size(); step++)
+		{
+			uint32_t memory_type_index = find_memory_type(requirements.memoryTypeBits, chain[step].required, chain[step].avoided);
+			if (memory_type_index == UINT32_MAX)
+			{
+				continue;
+			}
+
+			allocation alloc = allocate_from_type(requirements, memory_type_index, kind);
+			if (!alloc.is_valid())
+			{
+				continue;
+			}
+
+			/* Falling past the first link means the preferred heap is missing or full : worth knowing about, once */
+			if (step > 0 && !m_usage_fell_back[(size_t)usage])
+			{
+				LOG_WARN("{} memory : {} landed in fallback memory type {} (flags {:#x}).", get_usage_name(usage), debug_name ? debug_name : "<unnamed>",
+					memory_type_index, m_memory_properties.memoryTypes[memory_type_index].propertyFlags);
+				m_usage_fell_back[(size_t)usage] = true;
+			}
+
+			alloc.usage = usage;
+			m_usage_bytes[(size_t)usage] += alloc.size;
+			m_usage_memory_types[(size_t)usage] |= 1u << memory_type_index;
+
+			return alloc;
+		}
+
+		LOG_ERROR("Failed to allocate {} bytes of {} memory for {}.", requirements.size, get_usage_name(usage), debug_name ? debug_name : "<unnamed>");
+		return {};
+	}
+
+	void memory_allocator::free(const allocation& alloc)
+	{
+		if (!alloc.is_valid())
+		{
+			return;
+		}
+
+		std::lock_guard lock(m_mutex);
+
+		assert(alloc.pool_index < m_pools.size());
+		pool& p = m_pools[alloc.pool_index];
+
+		auto it = std::find_if(p.blocks.begin(), p.blocks.end(), [&](const block& b) { return b.memory == alloc.memory; });
+		if (it == p.blocks.end())
+		{
+			LOG_ERROR("Freeing an allocation that does not belong to the allocator.");
+			assert(false);
+			return;
+		}
+
+		p.bytes_used -= alloc.size;
+		p.bytes_wasted -= alloc.offset - alloc.range_offset;
+
+		if (alloc.usage != memory_usage::COUNT)
+		{
+			m_usage_bytes[(size_t)alloc.usage] -= alloc.size;
+		}
+
+		block& b = *it;
+		assert(b.allocation_count > 0);
+		b.allocation_count--;
+
+		/* Give the range back and merge it with its neighbours */
+		VkDeviceSize offset = alloc.range_offset;
+		VkDeviceSize size = alloc.range_size;
+
+		auto next = b.free_ranges.lower_bound(offset);
+		if (next != b.free_ranges.end() && offset + size == next->first)
+		{
+			size += next->second;
+			next = b.free_ranges.erase(next);
+		}
+
+		if (next != b.free_ranges.begin())
+		{
+			auto prev = std::prev(next);
+			if (prev->first + prev->second == offset)
+			{
+				offset = prev->first;
+				size += prev->second;
+				b.free_ranges.erase(prev);
+			}
+		}
+
+		b.free_ranges.insert({ offset, size });
+
+		/* Release empty blocks, but keep one per pool around to avoid allocation churn */
+		if (b.allocation_count == 0)
+		{
+			size_t num_shared_blocks = std::count_if(p.blocks.begin(), p.blocks.end(), [](const block& other) { return !other.is_dedicated; });
+			if (b.is_dedicated || num_shared_blocks > 1)
+			{
+				destroy_block(b);
+				p.blocks.erase(it);
+			}
+		}
+	}
+
+	void memory_allocator::accumulate_stats(const pool& p, stats& out_stats) const
+	{
+		out_stats.bytes_used += p.bytes_used;
+		out_stats.bytes_wasted += p.bytes_wasted;
+
+		for (const block& b : p.blocks)
+		{
+			out_stats.bytes_allocated += b.size;
+			out_stats.allocation_count += b.allocation_count;
+			out_stats.block_count++;
+			out_stats.dedicated_block_count += b.is_dedicated ? 1 : 0;
+
+			for (const auto& [offset, size] : b.free_ranges)
+			{
+				out_stats.largest_free_range = std::max(out_stats.largest_free_range, size);
+			}
+		}
+	}
+
+	memory_allocator::stats memory_allocator::get_stats() const
+	{
+		std::lock_guard lock(m_mutex);
+
+		stats s;
+		for (const pool& p : m_pools)
+		{
+			accumulate_stats(p, s);
+		}
+		return s;
+	}
+
+	memory_allocator::stats memory_allocator::get_stats(uint32_t memory_type_index) const
+	{
+		std::lock_guard lock(m_mutex);
+
+		stats s;
+		accumulate_stats(m_pools[memory_type_index * 2 + 0], s);
+		accumulate_stats(m_pools[memory_type_index * 2 + 1], s);
+		return s;
+	}
+
+	void memory_allocator::log_stats() const
+	{
+		constexpr float to_mb = 1.0f / (1024.0f * 1024.0f);
+
+		for (uint32_t i = 0; i < m_memory_properties.memoryTypeCount; i++)
+		{
+			stats s = get_stats(i);
+			if (s.block_count == 0)
+			{
+				continue;
+			}
+
+			LOG_INFO("Memory type {} (heap {}, flags {:#x}) : {} blocks ({} dedicated), {} allocations, {:.2f} / {:.2f} MB used, {:.2f} KB wasted",
+				i, m_memory_properties.memoryTypes[i].heapIndex, m_memory_properties.memoryTypes[i].propertyFlags,
+				s.block_count, s.dedicated_block_count, s.allocation_count,
+				s.bytes_used * to_mb, s.bytes_allocated * to_mb, s.bytes_wasted / 1024.0f);
+		}
+
+		{
+			std::lock_guard lock(m_mutex);
+			for (size_t usage = 0; usage < (size_t)memory_usage::COUNT; usage++)
+			{
+				if (m_usage_memory_types[usage] == 0)
+				{
+					continue;
+				}
+
+				std::string types;
+				for (uint32_t i = 0; i < m_memory_properties.memoryTypeCount; i++)
+				{
+					if (m_usage_memory_types[usage] & (1u << i))
+					{
+						types += (types.empty() ? "" : ", ") + std::to_string(i);
+					}
+				}
+
+				LOG_INFO("{} resources : {:.2f} MB in memory types [{}]", get_usage_name((memory_usage)usage), m_usage_bytes[usage] * to_mb, types);
+			}
+		}
+
+		stats total = get_stats();
+		LOG_INFO("GPU memory : {:.2f} MB in {} blocks, {:.2f} MB used, {:.2f} KB wasted to alignment",
+			total.bytes_allocated * to_mb, total.block_count, total.bytes_used * to_mb, total.bytes_wasted / 1024.0f);
+	}
+}
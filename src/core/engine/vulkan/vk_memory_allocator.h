@@ -0,0 +1,127 @@
+#pragma once
+
+#include "core/engine/vulkan/vk_common.h"
+
+#include <map>
+#include <mutex>
+#include <vector>
+
+namespace vk
+{
+	/*
+		Placement policy. Each usage maps to a chain of memory properties tried in order, see vk_memory_allocator.cpp.
+		GPU_ONLY : device local, never host visible if the device has a choice (render targets, textures, meshes, GPU written buffers)
+		DYNAMIC	 : data written by the CPU every frame and read by the GPU : device local + host visible (BAR) first, then host memory
+		STAGING	 : host visible, not device local if possible. Upload source only.
+		READBACK : written by the GPU and read by the CPU : host cached first, BAR reads are uncached
+	*/
+	enum class memory_usage
+	{
+		GPU_ONLY, DYNAMIC, STAGING, READBACK, COUNT
+	};
+
+	/* Range of a VkDeviceMemory block handed out by the memory allocator */
+	struct allocation
+	{
+		VkDeviceMemory memory = VK_NULL_HANDLE;
+		VkDeviceSize offset = 0;			/* Aligned offset to bind the resource at */
+		VkDeviceSize size = 0;				/* Requested size */
+		void* mapped = nullptr;				/* Persistently mapped pointer to offset, null if the memory type is not host visible */
+
+		/* Bookkeeping */
+		uint32_t pool_index = UINT32_MAX;
+		VkDeviceSize range_offset = 0;		/* Start of the range taken from the free list, before alignment */
+		VkDeviceSize range_size = 0;
+		bool is_dedicated = false;
+		memory_usage usage = memory_usage::COUNT;
+
+		bool is_valid() const { return memory != VK_NULL_HANDLE; }
+	};
+
+	/*
+		Block based sub-allocator : resources get offsets inside large VkDeviceMemory blocks instead of
+		one vkAllocateMemory each. One pool per memory type and resource kind : linear (buffers) and
+		optimal-tiling (images) resources never share a block, which keeps bufferImageGranularity satisfied
+		without per-page tracking. Host visible blocks are persistently mapped.
+	*/
+	class memory_allocator
+	{
+	public:
+		enum class resource_kind { LINEAR, OPTIMAL };
+
+		struct stats
+		{
+			VkDeviceSize bytes_allocated = 0;	/* Total size of the VkDeviceMemory blocks */
+			VkDeviceSize bytes_used = 0;		/* Sum of the requested sizes */
+			VkDeviceSize bytes_wasted = 0;		/* Alignment padding inside live allocations */
+			VkDeviceSize largest_free_range = 0;
+			uint32_t block_count = 0;
+			uint32_t dedicated_block_count = 0;
+			uint32_t allocation_count = 0;
+		};
+
+		void init(VkDevice device, VkPhysicalDevice physical_device);
+		void destroy();
+
+		/* Walks the fallback chain of the usage until an allocation succeeds. Returns an invalid allocation on failure. */
+		allocation allocate(const VkMemoryRequirements& requirements, memory_usage usage, resource_kind kind, const char* debug_name = nullptr);
+
+		/* Memory type is picked from requirements.memoryTypeBits and the required properties, no fallback */
+		allocation allocate(const VkMemoryRequirements& requirements, VkMemoryPropertyFlags properties, resource_kind kind, const char* debug_name = nullptr);
+		void free(const allocation& alloc);
+
+		stats get_stats() const;
+		stats get_stats(uint32_t memory_type_index) const;
+		void log_stats() const;
+
+		/* Memory type each usage resolves to when nothing restricts memoryTypeBits */
+		void log_placement_policy() const;
+
+		/* Types with any of the avoided properties are only picked if nothing else matches. Returns UINT32_MAX if no memory type matches. */
+		uint32_t find_memory_type(uint32_t memory_type_bits, VkMemoryPropertyFlags properties, VkMemoryPropertyFlags avoided_properties = 0) const;
+
+		const VkPhysicalDeviceMemoryProperties& get_memory_properties() const { return m_memory_properties; }
+
+		/* Allocations larger than this get their own VkDeviceMemory */
+		VkDeviceSize get_block_size(uint32_t memory_type_index) const;
+
+	private:
+		struct block
+		{
+			VkDeviceMemory memory = VK_NULL_HANDLE;
+			VkDeviceSize size = 0;
+			uint8_t* mapped = nullptr;
+			bool is_dedicated = false;
+			uint32_t allocation_count = 0;
+
+			/* Free ranges : offset -> size, coalesced on free */
+			std::map<VkDeviceSize, VkDeviceSize> free_ranges;
+		};
+
+		struct pool
+		{
+			uint32_t memory_type_index = 0;
+			resource_kind kind = resource_kind::LINEAR;
+			std::vector<block> blocks;
+
+			VkDeviceSize bytes_used = 0;
+			VkDeviceSize bytes_wasted = 0;
+		};
+
+		allocation allocate_from_type(const VkMemoryRequirements& requirements, uint32_t memory_type_index, resource_kind kind);
+		bool create_block(pool& p, VkDeviceSize size, bool is_dedicated, block& out_block);
+		void destroy_block(block& b);
+		bool allocate_from_block(block& b, const VkMemoryRequirements& requirements, allocation& out_alloc);
+		void accumulate_stats(const pool& p, stats& out_stats) const;
+
+		VkDevice m_device = VK_NULL_HANDLE;
+		VkPhysicalDeviceMemoryProperties m_memory_properties = {};
+		std::vector<pool> m_pools;	/* memory_type_index * 2 + kind */
+
+		/* Where each usage actually landed */
+		VkDeviceSize m_usage_bytes[(size_t)memory_usage::COUNT] = {};
+		uint32_t m_usage_memory_types[(size_t)memory_usage::COUNT] = {};	/* Bitmask of memory type indices */
+		bool m_usage_fell_back[(size_t)memory_usage::COUNT] = {};
+		mutable std::mutex m_mutex;
+	};
+}
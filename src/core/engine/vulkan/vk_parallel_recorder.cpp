@@ -0,0 +1,144 @@
+#include "vk_parallel_recorder.h"
+#include "core/engine/job_system.h"
+#include "core/engine/logger.h"
+#include "core/engine/vulkan/objects/vk_device.h"
+
+#include <algorithm>
+#include <cassert>
+
+namespace vk
+{
+	void parallel_recorder::init(const vk::device& device, uint32_t queue_family_index, uint32_t num_frames)
+	{
+		m_device = device;
+
+		/* One pool per worker, plus one for the main thread */
+		job_system& js = job_system::get_instance();
+		js.init();
+		m_num_threads = js.get_num_threads() + 1;
+
+		VkCommandPoolCreateInfo cmd_pool_create_info
+		{
+			.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO,
+			.flags = VK_COMMAND_POOL_CREATE_TRANSIENT_BIT,
+			.queueFamilyIndex = queue_family_index,
+		};
+
+		m_pools.clear();
+		for (uint32_t i = 0; i < num_frames * m_num_threads; i++)
+		{
+			std::unique_ptr<thread_pool>& pool = m_pools.emplace_back(std::make_unique<thread_pool>());
+			VK_CHECK(vkCreateCommandPool(m_device, &cmd_pool_create_info, nullptr, &pool->cmd_pool));
+		}
+
+		LOG_INFO("Parallel recorder : {} command pools per frame.", m_num_threads);
+	}
+
+	void parallel_recorder::destroy()
+	{
+		for (std::unique_ptr<thread_pool>& pool : m_pools)
+		{
+			/* Frees the command buffers allocated from it */
+			vkDestroyCommandPool(m_device, pool->cmd_pool, nullptr);
+		}
+		m_pools.clear();
+	}
+
+	void parallel_recorder::reset(uint32_t frame_idx)
+	{
+		for (uint32_t i = 0; i < m_num_threads; i++)
+		{
+			thread_pool& pool = *m_pools[frame_idx * m_num_threads + i];
+			if (pool.num_used > 0)
+			{
+				VK_CHECK(vkResetCommandPool(m_device, pool.cmd_pool, 0));
+				pool.num_used = 0;
+			}
+		}
+	}
+
+	VkRenderingFlags parallel_recorder::get_rendering_flags() const
+	{
+		return enabled ? VK_RENDERING_CONTENTS_SECONDARY_COMMAND_BUFFERS_BIT : 0;
+	}
+
+	VkCommandBuffer parallel_recorder::get_cmd_buffer(uint32_t frame_idx)
+	{
+		unsigned int thread_index = job_system::get_thread_index();
+		assert(thread_index < m_num_threads);
+
+		thread_pool& pool = *m_pools[frame_idx * m_num_threads + thread_index];
+		if (pool.num_used == pool.cmd_buffers.size())
+		{
+			VkCommandBufferAllocateInfo allocate_info
+			{
+				.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO,
+				.commandPool = pool.cmd_pool,
+				.level = VK_COMMAND_BUFFER_LEVEL_SECONDARY,
+				.commandBufferCount = 1,
+			};
+
+			VkCommandBuffer cmd_buffer = VK_NULL_HANDLE;
+			VK_CHECK(vkAllocateCommandBuffers(m_device, &allocate_info, &cmd_buffer));
+			pool.cmd_buffers.push_back(cmd_buffer);
+		}
+
+		return pool.cmd_buffers[pool.num_used++];
+	}
+
+	void parallel_recorder::record(VkCommandBuffer cmd_buffer, uint32_t frame_idx, const secondary_rendering_info& info, size_t count, size_t min_chunk_size,
+		const std::function<void(VkCommandBuffer, size_t, size_t)>& func)
+	{
+		if (!enabled)
+		{
+			func(cmd_buffer, 0, count);
+			return;
+		}
+
+		if (count == 0)
+		{
+			return;
+		}
+
+		size_t num_chunks = std::clamp(count / std::max<size_t>(1, min_chunk_size), (size_t)1, (size_t)max_chunks);
+		size_t chunk_size = (count + num_chunks - 1) / num_chunks;
+		num_chunks = (count + chunk_size - 1) / chunk_size;
+
+		VkCommandBufferInheritanceRenderingInfo inheritance_rendering_info
+		{
+			.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_INHERITANCE_RENDERING_INFO,
+			.viewMask = info.view_mask,
+			.colorAttachmentCount = (uint32_t)info.color_formats.size(),
+			.pColorAttachmentFormats = info.color_formats.data(),
+			.depthAttachmentFormat = info.depth_format,
+			.stencilAttachmentFormat = VK_FORMAT_UNDEFINED,
+			.rasterizationSamples = VK_SAMPLE_COUNT_1_BIT,
+		};
+
+		VkCommandBufferInheritanceInfo inheritance_info
+		{
+			.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_INHERITANCE_INFO,
+			.pNext = &inheritance_rendering_info,
+		};
+
+		VkCommandBufferBeginInfo begin_info
+		{
+			.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO,
+			.flags = VK_COMMAND_BUFFER_USAGE_RENDER_PASS_CONTINUE_BIT | VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT,
+			.pInheritanceInfo = &inheritance_info,
+		};
+
+		/* Slot per chunk : executed in chunk order whichever thread recorded it */
+		std::vector<VkCommandBuffer> secondaries(num_chunks);
+		job_system::get_instance().parallel_for(num_chunks, [&](size_t chunk)
+		{
+			VkCommandBuffer secondary = get_cmd_buffer(frame_idx);
+			VK_CHECK(vkBeginCommandBuffer(secondary, &begin_info));
+			func(secondary, chunk * chunk_size, std::min(count, (chunk + 1) * chunk_size));
+			VK_CHECK(vkEndCommandBuffer(secondary));
+			secondaries[chunk] = secondary;
+		});
+
+		vkCmdExecuteCommands(cmd_buffer, (uint32_t)secondaries.size(), secondaries.data());
+	}
+}
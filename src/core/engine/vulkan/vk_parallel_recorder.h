@@ -0,0 +1,66 @@
+#pragma once
+
+#include "core/engine/vulkan/vk_common.h"
+
+#include <functional>
+#include <memory>
+#include <span>
+#include <vector>
+
+namespace vk
+{
+	class device;
+
+	/* Attachments of the dynamic render pass the secondary command buffers are executed in */
+	struct secondary_rendering_info
+	{
+		std::span<const VkFormat> color_formats;
+		VkFormat depth_format = VK_FORMAT_UNDEFINED;
+		uint32_t view_mask = 0;
+	};
+
+	/*
+		Records a render pass in parallel on the job system.
+		Each thread of the pool gets its own command pool per frame in flight, secondary command buffers are allocated
+		from the pool of the thread recording them and executed in chunk order by the primary, so the submission order
+		does not depend on scheduling. Secondaries do not inherit any state : func must bind the pipeline, descriptor
+		sets and dynamic state it uses.
+		reset() must be called once the fence of the frame has been waited.
+	*/
+	class parallel_recorder
+	{
+	public:
+		void init(const vk::device& device, uint32_t queue_family_index, uint32_t num_frames);
+		void destroy();
+
+		/* Recycles the command buffers recorded for frame_idx */
+		void reset(uint32_t frame_idx);
+
+		/* Flags the render pass has to be begun with before calling record() */
+		VkRenderingFlags get_rendering_flags() const;
+
+		/*
+			Calls func(cmd_buffer, begin, end) over [0, count) in chunks of at least min_chunk_size.
+			When disabled, func is called once on cmd_buffer instead.
+		*/
+		void record(VkCommandBuffer cmd_buffer, uint32_t frame_idx, const secondary_rendering_info& info, size_t count, size_t min_chunk_size,
+			const std::function<void(VkCommandBuffer, size_t, size_t)>& func);
+
+		bool enabled = true;
+		uint32_t max_chunks = 16;
+	private:
+		/* Owned by one thread, padded so that neighbouring threads do not share a cache line */
+		struct alignas(64) thread_pool
+		{
+			VkCommandPool cmd_pool = VK_NULL_HANDLE;
+			std::vector<VkCommandBuffer> cmd_buffers;
+			uint32_t num_used = 0;
+		};
+
+		VkCommandBuffer get_cmd_buffer(uint32_t frame_idx);
+
+		VkDevice m_device = VK_NULL_HANDLE;
+		uint32_t m_num_threads = 0;
+		std::vector<std::unique_ptr<thread_pool>> m_pools;	/* [frame_idx * m_num_threads + thread_index] */
+	};
+}
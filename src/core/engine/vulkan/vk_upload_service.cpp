@@ -0,0 +1,478 @@
+#include "vk_upload_service.h"
+#include "core/engine/logger.h"
+#include "core/engine/vulkan/objects/vk_device.h"
+#include "core/engine/vulkan/objects/vk_debug_marker.hpp"
+
+#include <algorithm>
+#include <cassert>
+#include <cstring>
+
+namespace vk
+{
+	static VkDeviceSize align_up(VkDeviceSize value, VkDeviceSize alignment)
+	{
+		return ((value + alignment - 1) / alignment) * alignment;
+	}
+
+	void upload_service::init(const vk::device& device, VkDeviceSize ring_size_bytes)
+	{
+		m_device = device;
+		m_transfer_queue = device.transfer_queue;
+		m_transfer_family = device.queue_family_indices[queue_family::transfer];
+		m_graphics_family = device.queue_family_indices[queue_family::graphics];
+		m_copy_alignment = std::max<VkDeviceSize>(16, device.limits.optimalBufferCopyOffsetAlignment);
+
+		VkCommandPoolCreateInfo cmd_pool_create_info
+		{
+			.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO,
+			.flags = VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT | VK_COMMAND_POOL_CREATE_TRANSIENT_BIT,
+			.queueFamilyIndex = m_transfer_family,
+		};
+		VK_CHECK(vkCreateCommandPool(m_device, &cmd_pool_create_info, nullptr, &m_cmd_pool));
+
+		VkSemaphoreTypeCreateInfo semaphore_type_info
+		{
+			.sType = VK_STRUCTURE_TYPE_SEMAPHORE_TYPE_CREATE_INFO,
+			.semaphoreType = VK_SEMAPHORE_TYPE_TIMELINE,
+			.initialValue = 0,
+		};
+		VkSemaphoreCreateInfo semaphore_info = { .sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO, .pNext = &semaphore_type_info };
+		VK_CHECK(vkCreateSemaphore(m_device, &semaphore_info, nullptr, &m_timeline_semaphore));
+		set_object_name(VK_OBJECT_TYPE_SEMAPHORE, (uint64_t)m_timeline_semaphore, "Upload Timeline Semaphore");
+
+		m_ring.init(vk::buffer::type::STAGING, ring_size_bytes, "Upload Ring Buffer");
+		m_ring.create();
+		m_ring_mapped = (uint8_t*)m_ring.map(m_device, 0, ring_size_bytes);
+		assert(m_ring_mapped);
+		m_ring_size = ring_size_bytes;
+
+		LOG_INFO("Upload service : {} MB ring, {} transfer queue.", m_ring_size / (1024 * 1024), has_dedicated_queue() ? "dedicated" : "no dedicated");
+	}
+
+	void upload_service::destroy()
+	{
+		wait(flush());
+		retire_completed_batches();
+		assert(m_in_flight.empty());
+
+		m_pending_acquires.clear();
+		m_ring.destroy();
+
+		vkDestroyCommandPool(m_device, m_cmd_pool, nullptr);
+		vkDestroySemaphore(m_device, m_timeline_semaphore, nullptr);
+		m_free_cmd_buffers.clear();
+	}
+
+	upload_service::batch& upload_service::get_recording_batch()
+	{
+		if (!m_is_recording)
+		{
+			if (m_free_cmd_buffers.empty())
+			{
+				VkCommandBufferAllocateInfo alloc_info
+				{
+					.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO,
+					.commandPool = m_cmd_pool,
+					.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY,
+					.commandBufferCount = 1,
+				};
+
+				VkCommandBuffer cmd_buffer = VK_NULL_HANDLE;
+				VK_CHECK(vkAllocateCommandBuffers(m_device, &alloc_info, &cmd_buffer));
+				m_free_cmd_buffers.push_back(cmd_buffer);
+			}
+
+			m_recording = {};
+			m_recording.cmd_buffer = m_free_cmd_buffers.back();
+			m_recording.value = m_last_submitted_value + 1;
+			m_free_cmd_buffers.pop_back();
+
+			VkCommandBufferBeginInfo begin_info = { .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO, .flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT };
+			VK_CHECK(vkBeginCommandBuffer(m_recording.cmd_buffer, &begin_info));
+
+			m_is_recording = true;
+		}
+
+		return m_recording;
+	}
+
+	bool upload_service::allocate_ring(VkDeviceSize size, VkDeviceSize alignment, VkDeviceSize& out_offset)
+	{
+		VkDeviceSize offset = align_up(m_ring_head, alignment);
+		VkDeviceSize padding = offset - m_ring_head;
+
+		/* Not enough room before the end : wrap around, the tail end of the ring is lost until the batch retires */
+		if (offset + size > m_ring_size)
+		{
+			padding = m_ring_size - m_ring_head;
+			offset = 0;
+		}
+
+		if (m_ring_used + padding + size > m_ring_size)
+		{
+			return false;
+		}
+
+		m_ring_head = (offset + size) % m_ring_size;
+		m_ring_used += padding + size;
+		get_recording_batch().ring_bytes += padding + size;
+
+		out_offset = offset;
+		return true;
+	}
+
+	VkDeviceSize upload_service::reserve_staging(VkDeviceSize size, VkBuffer& out_buffer, uint8_t*& out_mapped)
+	{
+		/* Uploads larger than half the ring would stall on every other batch : they get their own staging buffer */
+		if (size > m_ring_size / 2)
+		{
+			vk::buffer staging_buffer;
+			staging_buffer.init(vk::buffer::type::STAGING, size, "Upload Staging Buffer");
+			staging_buffer.create();
+
+			out_buffer = staging_buffer;
+			out_mapped = (uint8_t*)staging_buffer.map(m_device, 0, size);
+			get_recording_batch().staging_buffers.push_back(staging_buffer);
+			return 0;
+		}
+
+		VkDeviceSize offset = 0;
+		while (!allocate_ring(size, m_copy_alignment, offset))
+		{
+			/* Ring is full : submit what is recorded, then wait for the oldest batch */
+			if (m_is_recording && m_recording.ring_bytes > 0)
+			{
+				flush();
+			}
+			else
+			{
+				assert(!m_in_flight.empty());
+				wait({ m_in_flight.front().value });
+			}
+		}
+
+		out_buffer = m_ring;
+		out_mapped = m_ring_mapped + offset;
+		return offset;
+	}
+
+	upload_handle upload_service::upload(VkBuffer dst, VkDeviceSize dst_offset, const void* data, VkDeviceSize size, uint64_t frame_wait_value)
+	{
+		if (size == 0)
+		{
+			return { m_last_submitted_value };
+		}
+
+		const uint8_t* src = (const uint8_t*)data;
+		VkDeviceSize chunk_size_max = m_ring_size / 2;
+
+		while (size > 0)
+		{
+			VkDeviceSize chunk_size = std::min(size, chunk_size_max);
+
+			VkBuffer staging_buffer = VK_NULL_HANDLE;
+			uint8_t* staging_mapped = nullptr;
+			VkDeviceSize staging_offset = reserve_staging(chunk_size, staging_buffer, staging_mapped);
+			memcpy(staging_mapped, src, chunk_size);
+
+			/* Reserving may have flushed the previous batch : the wait goes to the one the copy is recorded in */
+			batch& b = get_recording_batch();
+			b.frame_wait_value = std::max(b.frame_wait_value, frame_wait_value);
+
+			VkBufferCopy region = { .srcOffset = staging_offset, .dstOffset = dst_offset, .size = chunk_size };
+			vkCmdCopyBuffer(b.cmd_buffer, staging_buffer, dst, 1, &region);
+
+			src += chunk_size;
+			dst_offset += chunk_size;
+			size -= chunk_size;
+		}
+
+		return { get_recording_batch().value };
+	}
+
+	upload_handle upload_service::upload(const image_upload_info& info, const void* data, VkDeviceSize size)
+	{
+		VkBuffer staging_buffer = VK_NULL_HANDLE;
+		uint8_t* staging_mapped = nullptr;
+		VkDeviceSize staging_offset = reserve_staging(size, staging_buffer, staging_mapped);
+		memcpy(staging_mapped, data, size);
+
+		batch& b = get_recording_batch();
+
+		const VkImageSubresourceRange full_range = { info.aspect, 0, info.mip_levels, 0, info.layer_count };
+
+		VkImageMemoryBarrier2 barrier =
+		{
+			.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER_2,
+			.srcStageMask = VK_PIPELINE_STAGE_2_NONE,
+			.srcAccessMask = VK_ACCESS_2_NONE,
+			.dstStageMask = VK_PIPELINE_STAGE_2_COPY_BIT,
+			.dstAccessMask = VK_ACCESS_2_TRANSFER_WRITE_BIT,
+			.oldLayout = VK_IMAGE_LAYOUT_UNDEFINED,
+			.newLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+			.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+			.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+			.image = info.image,
+			.subresourceRange = full_range,
+		};
+		VkDependencyInfo dependency = { .sType = VK_STRUCTURE_TYPE_DEPENDENCY_INFO, .imageMemoryBarrierCount = 1, .pImageMemoryBarriers = &barrier };
+		vkCmdPipelineBarrier2(b.cmd_buffer, &dependency);
+
+		std::vector<VkBufferImageCopy> regions(info.regions.begin(), info.regions.end());
+		for (VkBufferImageCopy& region : regions)
+		{
+			region.bufferOffset += staging_offset;
+		}
+		vkCmdCopyBufferToImage(b.cmd_buffer, staging_buffer, info.image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, (uint32_t)regions.size(), regions.data());
+
+		bool generate_mips = info.generate_mips && info.mip_levels > 1;
+
+		if (!has_dedicated_queue())
+		{
+			/* Transfer work runs on the graphics queue family : finish the image here */
+			if (generate_mips)
+			{
+				record_mip_chain(b.cmd_buffer, info);
+			}
+			else
+			{
+				barrier.srcStageMask = VK_PIPELINE_STAGE_2_COPY_BIT;
+				barrier.srcAccessMask = VK_ACCESS_2_TRANSFER_WRITE_BIT;
+				barrier.dstStageMask = VK_PIPELINE_STAGE_2_ALL_COMMANDS_BIT;
+				barrier.dstAccessMask = VK_ACCESS_2_MEMORY_READ_BIT;
+				barrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+				barrier.newLayout = info.final_layout;
+				vkCmdPipelineBarrier2(b.cmd_buffer, &dependency);
+			}
+
+			return { b.value };
+		}
+
+		/* Release to the graphics queue family. Mip generation needs blits : the image stays in TRANSFER_DST until then. */
+		barrier.srcStageMask = VK_PIPELINE_STAGE_2_COPY_BIT;
+		barrier.srcAccessMask = VK_ACCESS_2_TRANSFER_WRITE_BIT;
+		barrier.dstStageMask = VK_PIPELINE_STAGE_2_NONE;
+		barrier.dstAccessMask = VK_ACCESS_2_NONE;
+		barrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+		barrier.newLayout = generate_mips ? VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL : info.final_layout;
+		barrier.srcQueueFamilyIndex = m_transfer_family;
+		barrier.dstQueueFamilyIndex = m_graphics_family;
+		vkCmdPipelineBarrier2(b.cmd_buffer, &dependency);
+
+		/* Matching acquire */
+		pending_acquire acquire = { .value = b.value, .barrier = barrier, .info = info };
+		acquire.info.regions = {};
+		acquire.info.generate_mips = generate_mips;
+		acquire.barrier.srcStageMask = VK_PIPELINE_STAGE_2_NONE;
+		acquire.barrier.srcAccessMask = VK_ACCESS_2_NONE;
+		acquire.barrier.dstStageMask = generate_mips ? VK_PIPELINE_STAGE_2_ALL_TRANSFER_BIT : VK_PIPELINE_STAGE_2_ALL_COMMANDS_BIT;
+		acquire.barrier.dstAccessMask = generate_mips ? VK_ACCESS_2_TRANSFER_READ_BIT | VK_ACCESS_2_TRANSFER_WRITE_BIT : VK_ACCESS_2_MEMORY_READ_BIT;
+		m_pending_acquires.push_back(acquire);
+
+		return { b.value };
+	}
+
+	upload_handle upload_service::flush()
+	{
+		if (m_is_recording)
+		{
+			VK_CHECK(vkEndCommandBuffer(m_recording.cmd_buffer));
+
+			VkCommandBufferSubmitInfo cmd_buffer_info = { .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_SUBMIT_INFO, .commandBuffer = m_recording.cmd_buffer };
+			VkSemaphoreSubmitInfo wait_info =
+			{
+				.sType = VK_STRUCTURE_TYPE_SEMAPHORE_SUBMIT_INFO,
+				.semaphore = m_frame_timeline_semaphore,
+				.value = m_recording.frame_wait_value,
+				.stageMask = VK_PIPELINE_STAGE_2_COPY_BIT,
+			};
+			bool has_frame_wait = m_recording.frame_wait_value > 0;
+			assert(!has_frame_wait || m_frame_timeline_semaphore != VK_NULL_HANDLE);
+			VkSemaphoreSubmitInfo signal_info =
+			{
+				.sType = VK_STRUCTURE_TYPE_SEMAPHORE_SUBMIT_INFO,
+				.semaphore = m_timeline_semaphore,
+				.value = m_recording.value,
+				.stageMask = VK_PIPELINE_STAGE_2_ALL_COMMANDS_BIT,
+			};
+			VkSubmitInfo2 submit_info =
+			{
+				.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO_2,
+				.waitSemaphoreInfoCount = has_frame_wait ? 1u : 0u,
+				.pWaitSemaphoreInfos = &wait_info,
+				.commandBufferInfoCount = 1,
+				.pCommandBufferInfos = &cmd_buffer_info,
+				.signalSemaphoreInfoCount = 1,
+				.pSignalSemaphoreInfos = &signal_info,
+			};
+			VK_CHECK(vkQueueSubmit2(m_transfer_queue, 1, &submit_info, VK_NULL_HANDLE));
+
+			m_last_submitted_value = m_recording.value;
+			m_in_flight.push_back(std::move(m_recording));
+			m_recording = {};
+			m_is_recording = false;
+		}
+
+		retire_completed_batches();
+
+		return { m_last_submitted_value };
+	}
+
+	uint64_t upload_service::get_completed_value() const
+	{
+		uint64_t value = 0;
+		VK_CHECK(vkGetSemaphoreCounterValue(m_device, m_timeline_semaphore, &value));
+		return value;
+	}
+
+	bool upload_service::is_complete(upload_handle handle) const
+	{
+		return handle.value <= m_last_submitted_value && get_completed_value() >= handle.value;
+	}
+
+	void upload_service::wait(upload_handle handle)
+	{
+		if (!handle.is_valid())
+		{
+			return;
+		}
+
+		if (handle.value > m_last_submitted_value)
+		{
+			flush();
+		}
+
+		VkSemaphoreWaitInfo wait_info =
+		{
+			.sType = VK_STRUCTURE_TYPE_SEMAPHORE_WAIT_INFO,
+			.semaphoreCount = 1,
+			.pSemaphores = &m_timeline_semaphore,
+			.pValues = &handle.value,
+		};
+		VK_CHECK(vkWaitSemaphores(m_device, &wait_info, UINT64_MAX));
+
+		retire_completed_batches();
+	}
+
+	void upload_service::retire_completed_batches()
+	{
+		if (m_in_flight.empty())
+		{
+			return;
+		}
+
+		uint64_t completed_value = get_completed_value();
+
+		while (!m_in_flight.empty() && m_in_flight.front().value <= completed_value)
+		{
+			batch& b = m_in_flight.front();
+
+			m_ring_used -= b.ring_bytes;
+			for (vk::buffer& staging_buffer : b.staging_buffers)
+			{
+				staging_buffer.destroy();
+			}
+			m_free_cmd_buffers.push_back(b.cmd_buffer);
+
+			m_in_flight.pop_front();
+		}
+
+		/* Keep allocations contiguous when the ring drains */
+		if (m_ring_used == 0)
+		{
+			m_ring_head = 0;
+		}
+	}
+
+	void upload_service::record_acquires(VkCommandBuffer graphics_cmd_buffer)
+	{
+		flush();
+
+		if (m_pending_acquires.empty())
+		{
+			return;
+		}
+
+		std::vector<VkImageMemoryBarrier2> barriers(m_pending_acquires.size());
+		for (size_t i = 0; i < m_pending_acquires.size(); i++)
+		{
+			barriers[i] = m_pending_acquires[i].barrier;
+		}
+
+		VkDependencyInfo dependency = { .sType = VK_STRUCTURE_TYPE_DEPENDENCY_INFO, .imageMemoryBarrierCount = (uint32_t)barriers.size(), .pImageMemoryBarriers = barriers.data() };
+		vkCmdPipelineBarrier2(graphics_cmd_buffer, &dependency);
+
+		for (const pending_acquire& acquire : m_pending_acquires)
+		{
+			if (acquire.info.generate_mips)
+			{
+				record_mip_chain(graphics_cmd_buffer, acquire.info);
+			}
+		}
+
+		m_pending_acquires.clear();
+	}
+
+	void upload_service::record_mip_chain(VkCommandBuffer cmd_buffer, const image_upload_info& info)
+	{
+		VkImageMemoryBarrier2 barrier =
+		{
+			.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER_2,
+			.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+			.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+			.image = info.image,
+			.subresourceRange = { info.aspect, 0, 1, 0, info.layer_count },
+		};
+		VkDependencyInfo dependency = { .sType = VK_STRUCTURE_TYPE_DEPENDENCY_INFO, .imageMemoryBarrierCount = 1, .pImageMemoryBarriers = &barrier };
+
+		int32_t mip_width = (int32_t)info.width;
+		int32_t mip_height = (int32_t)info.height;
+
+		for (uint32_t mip_level = 1; mip_level < info.mip_levels; mip_level++)
+		{
+			/* Source level : written by the copy or by the previous blit */
+			barrier.subresourceRange.baseMipLevel = mip_level - 1;
+			barrier.srcStageMask = VK_PIPELINE_STAGE_2_ALL_TRANSFER_BIT;
+			barrier.srcAccessMask = VK_ACCESS_2_TRANSFER_WRITE_BIT;
+			barrier.dstStageMask = VK_PIPELINE_STAGE_2_BLIT_BIT;
+			barrier.dstAccessMask = VK_ACCESS_2_TRANSFER_READ_BIT;
+			barrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+			barrier.newLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
+			vkCmdPipelineBarrier2(cmd_buffer, &dependency);
+
+			int32_t next_width = mip_width > 1 ? mip_width / 2 : 1;
+			int32_t next_height = mip_height > 1 ? mip_height / 2 : 1;
+
+			VkImageBlit blit =
+			{
+				.srcSubresource = { info.aspect, mip_level - 1, 0, info.layer_count },
+				.srcOffsets = { { 0, 0, 0 }, { mip_width, mip_height, 1 } },
+				.dstSubresource = { info.aspect, mip_level, 0, info.layer_count },
+				.dstOffsets = { { 0, 0, 0 }, { next_width, next_height, 1 } },
+			};
+			vkCmdBlitImage(cmd_buffer, info.image, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, info.image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &blit, VK_FILTER_LINEAR);
+
+			/* Source level is done */
+			barrier.srcStageMask = VK_PIPELINE_STAGE_2_BLIT_BIT;
+			barrier.srcAccessMask = VK_ACCESS_2_NONE;
+			barrier.dstStageMask = VK_PIPELINE_STAGE_2_ALL_COMMANDS_BIT;
+			barrier.dstAccessMask = VK_ACCESS_2_MEMORY_READ_BIT;
+			barrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
+			barrier.newLayout = info.final_layout;
+			vkCmdPipelineBarrier2(cmd_buffer, &dependency);
+
+			mip_width = next_width;
+			mip_height = next_height;
+		}
+
+		/* Last level */
+		barrier.subresourceRange.baseMipLevel = info.mip_levels - 1;
+		barrier.srcStageMask = VK_PIPELINE_STAGE_2_ALL_TRANSFER_BIT;
+		barrier.srcAccessMask = VK_ACCESS_2_TRANSFER_WRITE_BIT;
+		barrier.dstStageMask = VK_PIPELINE_STAGE_2_ALL_COMMANDS_BIT;
+		barrier.dstAccessMask = VK_ACCESS_2_MEMORY_READ_BIT;
+		barrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+		barrier.newLayout = info.final_layout;
+		vkCmdPipelineBarrier2(cmd_buffer, &dependency);
+	}
+}
@@ -0,0 +1,120 @@
+#pragma once
+
+#include "core/engine/vulkan/vk_common.h"
+#include "core/engine/vulkan/objects/vk_buffer.h"
+
+#include <deque>
+#include <span>
+#include <vector>
+
+namespace vk
+{
+	class device;
+
+	/* Timeline value of the batch an upload belongs to */
+	struct upload_handle
+	{
+		uint64_t value = 0;
+		bool is_valid() const { return value != 0; }
+	};
+
+	/* Image upload. Region buffer offsets are relative to the uploaded data. */
+	struct image_upload_info
+	{
+		VkImage image = VK_NULL_HANDLE;
+		VkImageAspectFlags aspect = VK_IMAGE_ASPECT_COLOR_BIT;
+		uint32_t width = 0;
+		uint32_t height = 0;
+		uint32_t mip_levels = 1;
+		uint32_t layer_count = 1;
+		std::span<const VkBufferImageCopy> regions;
+		bool generate_mips = false;		/* Blits mip 0 down the chain, on the graphics queue */
+		VkImageLayout final_layout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+	};
+
+	/*
+		Uploads through a persistent ring staging buffer. Copies are batched into one command buffer and submitted
+		on the transfer queue, completion is tracked with a timeline semaphore.
+		Images change queue family ownership : the acquire barriers (and mip generation) are recorded on the graphics
+		side by record_acquires(), called at the start of the frame and of temporary command buffers.
+		Graphics submissions must wait on the timeline semaphore at flush().value.
+		Buffers that the frames in flight still read are written with a frame_wait_value : the batch then waits on the
+		frame timeline (see set_frame_timeline) so that the copy does not land before those frames complete.
+		Buffers written through the service are created with concurrent sharing, see vk::buffer.
+		Not thread safe : call from the thread that owns the queues.
+	*/
+	class upload_service
+	{
+	public:
+		void init(const vk::device& device, VkDeviceSize ring_size_bytes = 64ull * 1024 * 1024);
+		void destroy();
+
+		/* Timeline semaphore signaled by the graphics queue at the end of each frame */
+		void set_frame_timeline(VkSemaphore frame_timeline) { m_frame_timeline_semaphore = frame_timeline; }
+
+		upload_handle upload(VkBuffer dst, VkDeviceSize dst_offset, const void* data, VkDeviceSize size, uint64_t frame_wait_value = 0);
+		upload_handle upload(const image_upload_info& info, const void* data, VkDeviceSize size);
+
+		/* Submits the batch being recorded, if any. Returns the handle of the last submitted batch. */
+		upload_handle flush();
+		bool is_complete(upload_handle handle) const;
+		void wait(upload_handle handle);
+
+		/* Records ownership acquires and mip generation for every flushed image upload. Flushes first. */
+		void record_acquires(VkCommandBuffer graphics_cmd_buffer);
+
+		VkSemaphore get_timeline_semaphore() const { return m_timeline_semaphore; }
+		bool has_dedicated_queue() const { return m_graphics_family != m_transfer_family; }
+
+		/* Records the mip chain of an image whose levels are all in TRANSFER_DST_OPTIMAL, leaves every level in final_layout */
+		static void record_mip_chain(VkCommandBuffer cmd_buffer, const image_upload_info& info);
+
+	private:
+		struct batch
+		{
+			VkCommandBuffer cmd_buffer = VK_NULL_HANDLE;
+			uint64_t value = 0;
+			VkDeviceSize ring_bytes = 0;			/* Ring space consumed, including padding */
+			uint64_t frame_wait_value = 0;			/* Frame timeline value the copies wait for, 0 : none */
+			std::vector<vk::buffer> staging_buffers;	/* Uploads too large for the ring */
+		};
+
+		/* Graphics side work of an image upload */
+		struct pending_acquire
+		{
+			uint64_t value = 0;
+			VkImageMemoryBarrier2 barrier = {};
+			image_upload_info info;
+		};
+
+		batch& get_recording_batch();
+		bool allocate_ring(VkDeviceSize size, VkDeviceSize alignment, VkDeviceSize& out_offset);
+		VkDeviceSize reserve_staging(VkDeviceSize size, VkBuffer& out_buffer, uint8_t*& out_mapped);
+		void retire_completed_batches();
+		uint64_t get_completed_value() const;
+
+		VkDevice m_device = VK_NULL_HANDLE;
+		VkQueue m_transfer_queue = VK_NULL_HANDLE;
+		uint32_t m_transfer_family = 0;
+		uint32_t m_graphics_family = 0;
+		VkDeviceSize m_copy_alignment = 16;
+
+		VkCommandPool m_cmd_pool = VK_NULL_HANDLE;
+		std::vector<VkCommandBuffer> m_free_cmd_buffers;
+
+		VkSemaphore m_timeline_semaphore = VK_NULL_HANDLE;
+		VkSemaphore m_frame_timeline_semaphore = VK_NULL_HANDLE;
+		uint64_t m_last_submitted_value = 0;
+
+		vk::buffer m_ring;
+		uint8_t* m_ring_mapped = nullptr;
+		VkDeviceSize m_ring_size = 0;
+		VkDeviceSize m_ring_head = 0;
+		VkDeviceSize m_ring_used = 0;
+
+		bool m_is_recording = false;
+		batch m_recording;
+		std::deque<batch> m_in_flight;
+		std::vector<pending_acquire> m_pending_acquires;
+	};
+}
@@ -2,6 +2,10 @@
 
 #include "imgui.h"
 
+#include <algorithm>
+#include <fstream>
+#include <sstream>
+
 camera::camera()
 	: camera(glm::radians(45.0f), 1.0f, 0.5f, 50.0f)
 {
@@ -121,3 +125,62 @@ void camera::show_ui()
 	}
 	ImGui::End();
 }
+
+bool camera_path::load(const std::string& path)
+{
+	std::ifstream file(path);
+	if (!file)
+	{
+		LOG_ERROR("Cannot open camera path {}", path);
+		return false;
+	}
+
+	keyframes.clear();
+	std::string line;
+	while (std::getline(file, line))
+	{
+		if (line.empty() || line[0] == '#')
+		{
+			continue;
+		}
+
+		keyframe key;
+		std::istringstream stream(line);
+		if (stream >> key.time >> key.position.x >> key.position.y >> key.position.z >> key.forward.x >> key.forward.y >> key.forward.z)
+		{
+			key.forward = glm::normalize(key.forward);
+			keyframes.push_back(key);
+		}
+	}
+
+	std::sort(keyframes.begin(), keyframes.end(), [](const keyframe& a, const keyframe& b) { return a.time < b.time; });
+
+	LOG_INFO("Loaded camera path {} : {} keyframes", path, keyframes.size());
+	return !keyframes.empty();
+}
+
+void camera_path::evaluate(float t, camera& camera) const
+{
+	if (keyframes.empty())
+	{
+		return;
+	}
+
+	auto next = std::upper_bound(keyframes.begin(), keyframes.end(), t, [](float t, const keyframe& key) { return t < key.time; });
+	if (next == keyframes.begin() || next == keyframes.end())
+	{
+		const keyframe& key = next == keyframes.begin() ? keyframes.front() : keyframes.back();
+		camera.position = key.position;
+		camera.forward = key.forward;
+	}
+	else
+	{
+		const keyframe& a = *(next - 1);
+		const keyframe& b = *next;
+		float alpha = (t - a.time) / std::max(b.time - a.time, 1e-6f);
+		camera.position = glm::mix(a.position, b.position, alpha);
+		camera.forward = glm::normalize(glm::mix(a.forward, b.forward, alpha));
+	}
+
+	camera.update_view();
+}
@@ -2,6 +2,8 @@
 
 #include "core/engine/common.h"
 
+#include <string>
+
 class camera
 {
 public:
@@ -48,4 +50,26 @@ public:
 	glm::vec2 last_click_pos;
 };
 
+/*
+	Camera keyframes played back for benchmark runs. Text file, one keyframe per line :
+		time px py pz fx fy fz
+	time in seconds, position and forward direction in world space. Lines starting with '#' are skipped.
+*/
+struct camera_path
+{
+	struct keyframe
+	{
+		float time;
+		glm::vec3 position;
+		glm::vec3 forward;
+	};
+
+	bool load(const std::string& path);
 
+	/* Linear interpolation between the keyframes around t, clamped to the first/last */
+	void evaluate(float t, camera& camera) const;
+
+	bool is_empty() const { return keyframes.empty(); }
+
+	std::vector<keyframe> keyframes;
+};
@@ -1,6 +1,8 @@
 #pragma once
 
+#ifdef _WIN32
 #include <Windows.h>
+#endif // _WIN32
 #include "core/engine/logger.h"
 #include <array>
 
@@ -0,0 +1,437 @@
+#include "bvh.h"
+
+#include "core/engine/job_system.h"
+
+#include <algorithm>
+#include <atomic>
+#include <numeric>
+
+/* SAH costs are relative to the cost of testing one item */
+static constexpr float k_traversal_cost = 1.0f;
+static constexpr int k_num_bins = 16;
+static constexpr uint32_t k_min_leaf_split_items = 2;	/* Smaller nodes are always leaves */
+static constexpr uint32_t k_max_leaf_items = 16;		/* Larger nodes are always split */
+static constexpr uint32_t k_parallel_build_items = 4096;
+
+void aabb::expand(const glm::vec3& p)
+{
+	min = glm::min(min, p);
+	max = glm::max(max, p);
+}
+
+void aabb::expand(const aabb& other)
+{
+	min = glm::min(min, other.min);
+	max = glm::max(max, other.max);
+}
+
+float aabb::surface_area() const
+{
+	if (is_empty())
+	{
+		return 0.0f;
+	}
+
+	glm::vec3 d = max - min;
+	return 2.0f * (d.x * d.y + d.y * d.z + d.z * d.x);
+}
+
+aabb aabb::transformed(const glm::mat4& m) const
+{
+	glm::vec3 c = glm::vec3(m * glm::vec4(center(), 1.0f));
+	glm::vec3 e = 0.5f * (max - min);
+	glm::vec3 extents = glm::abs(glm::vec3(m[0])) * e.x + glm::abs(glm::vec3(m[1])) * e.y + glm::abs(glm::vec3(m[2])) * e.z;
+
+	return { c - extents, c + extents };
+}
+
+struct bvh::build_context
+{
+	std::span<const aabb> item_boxes;
+	std::vector<glm::vec3> centroids;
+	std::atomic<uint32_t> node_count = 0;
+};
+
+void bvh::build(std::span<const aabb> item_boxes)
+{
+	clear();
+
+	uint32_t num_items = (uint32_t)item_boxes.size();
+	if (num_items == 0)
+	{
+		return;
+	}
+
+	m_item_boxes.assign(item_boxes.begin(), item_boxes.end());
+	m_item_indices.resize(num_items);
+	std::iota(m_item_indices.begin(), m_item_indices.end(), 0);
+
+	build_context context;
+	context.item_boxes = m_item_boxes;
+	context.centroids.resize(num_items);
+	for (uint32_t i = 0; i < num_items; i++)
+	{
+		context.centroids[i] = m_item_boxes[i].center();
+	}
+
+	/* A leaf holds at least one item : at most 2N - 1 nodes */
+	m_nodes.resize(2 * (size_t)num_items - 1);
+	context.node_count = 1;
+	build_node(context, 0, 0, num_items);
+	m_nodes.resize(context.node_count);
+}
+
+void bvh::build_node(build_context& context, uint32_t node_idx, uint32_t first, uint32_t count)
+{
+	aabb bounds;
+	aabb centroid_bounds;
+	for (uint32_t i = first; i < first + count; i++)
+	{
+		uint32_t item = m_item_indices[i];
+		bounds.expand(context.item_boxes[item]);
+		centroid_bounds.expand(context.centroids[item]);
+	}
+
+	node& n = m_nodes[node_idx];
+	n.bbox_min = bounds.min;
+	n.bbox_max = bounds.max;
+
+	uint32_t left_count = count < k_min_leaf_split_items ? 0 : partition_sah(context, first, count, bounds, centroid_bounds);
+	if (left_count == 0)
+	{
+		n.left_or_first = first;
+		n.item_count = count;
+		return;
+	}
+
+	uint32_t left_idx = context.node_count.fetch_add(2);
+	n.left_or_first = left_idx;
+	n.item_count = 0;
+
+	if (count >= k_parallel_build_items)
+	{
+		job_system& js = job_system::get_instance();
+		job_counter counter;
+		js.run([this, &context, left_idx, first, left_count]() { build_node(context, left_idx, first, left_count); }, &counter);
+		build_node(context, left_idx + 1, first + left_count, count - left_count);
+		js.wait(counter);
+	}
+	else
+	{
+		build_node(context, left_idx, first, left_count);
+		build_node(context, left_idx + 1, first + left_count, count - left_count);
+	}
+}
+
+uint32_t bvh::partition_sah(const build_context& context, uint32_t first, uint32_t count, const aabb& bounds, const aabb& centroid_bounds)
+{
+	glm::vec3 extent = centroid_bounds.max - centroid_bounds.min;
+	int axis = extent.x > extent.y ? (extent.x > extent.z ? 0 : 2) : (extent.y > extent.z ? 1 : 2);
+
+	/* All centroids at the same place : no plane separates them */
+	if (extent[axis] <= 0.0f)
+	{
+		return count > k_max_leaf_items ? count / 2 : 0;
+	}
+
+	float axis_min = centroid_bounds.min[axis];
+	float scale = k_num_bins / extent[axis];
+	auto get_bin = [&](uint32_t item)
+	{
+		return std::min(int((context.centroids[item][axis] - axis_min) * scale), k_num_bins - 1);
+	};
+
+	aabb bin_bounds[k_num_bins];
+	uint32_t bin_counts[k_num_bins] = {};
+	for (uint32_t i = first; i < first + count; i++)
+	{
+		uint32_t item = m_item_indices[i];
+		int bin = get_bin(item);
+		bin_bounds[bin].expand(context.item_boxes[item]);
+		bin_counts[bin]++;
+	}
+
+	/* Cost of the split after bin b - 1, swept from both sides */
+	float left_area[k_num_bins - 1];
+	uint32_t left_counts[k_num_bins - 1];
+	aabb left;
+	uint32_t num_left = 0;
+	for (int b = 0; b < k_num_bins - 1; b++)
+	{
+		left.expand(bin_bounds[b]);
+		num_left += bin_counts[b];
+		left_area[b] = left.surface_area();
+		left_counts[b] = num_left;
+	}
+
+	float best_cost = FLT_MAX;
+	int best_split = 0;
+	aabb right;
+	uint32_t num_right = 0;
+	for (int b = k_num_bins - 1; b > 0; b--)
+	{
+		right.expand(bin_bounds[b]);
+		num_right += bin_counts[b];
+		if (left_counts[b - 1] == 0 || num_right == 0)
+		{
+			continue;
+		}
+
+		float cost = left_counts[b - 1] * left_area[b - 1] + num_right * right.surface_area();
+		if (cost < best_cost)
+		{
+			best_cost = cost;
+			best_split = b;
+		}
+	}
+
+	float area = std::max(bounds.surface_area(), FLT_MIN);
+	float split_cost = k_traversal_cost + best_cost / area;
+	if (best_split == 0 || (split_cost >= (float)count && count <= k_max_leaf_items))
+	{
+		return best_split == 0 && count > k_max_leaf_items ? count / 2 : 0;
+	}
+
+	uint32_t* begin = m_item_indices.data() + first;
+	uint32_t* middle = std::partition(begin, begin + count, [&](uint32_t item) { return get_bin(item) < best_split; });
+	return uint32_t(middle - begin);
+}
+
+void bvh::refit(std::span<const aabb> item_boxes)
+{
+	assert(item_boxes.size() == m_item_boxes.size());
+	m_item_boxes.assign(item_boxes.begin(), item_boxes.end());
+
+	/* Children are stored after their parent */
+	for (size_t node_idx = m_nodes.size(); node_idx-- > 0;)
+	{
+		node& n = m_nodes[node_idx];
+		aabb bounds;
+		if (n.is_leaf())
+		{
+			for (uint32_t i = n.left_or_first; i < n.left_or_first + n.item_count; i++)
+			{
+				bounds.expand(m_item_boxes[m_item_indices[i]]);
+			}
+		}
+		else
+		{
+			const node& left = m_nodes[n.left_or_first];
+			const node& right = m_nodes[n.left_or_first + 1];
+			bounds.min = glm::min(left.bbox_min, right.bbox_min);
+			bounds.max = glm::max(left.bbox_max, right.bbox_max);
+		}
+		n.bbox_min = bounds.min;
+		n.bbox_max = bounds.max;
+	}
+}
+
+void bvh::clear()
+{
+	m_nodes.clear();
+	m_item_indices.clear();
+	m_item_boxes.clear();
+}
+
+void bvh::append_subtree_items(uint32_t node_idx, std::vector<uint32_t>& out_items) const
+{
+	const node& n = m_nodes[node_idx];
+	if (n.is_leaf())
+	{
+		out_items.insert(out_items.end(), m_item_indices.begin() + n.left_or_first, m_item_indices.begin() + n.left_or_first + n.item_count);
+	}
+	else
+	{
+		append_subtree_items(n.left_or_first, out_items);
+		append_subtree_items(n.left_or_first + 1, out_items);
+	}
+}
+
+/* Outside : fully behind one plane. Inside : fully in front of all planes. */
+enum class frustum_test { outside, intersecting, inside };
+
+static frustum_test test_box_frustum(const glm::vec3& bbox_min, const glm::vec3& bbox_max, std::span<const glm::vec4> planes)
+{
+	frustum_test result = frustum_test::inside;
+	for (const glm::vec4& plane : planes)
+	{
+		glm::vec3 normal = glm::vec3(plane);
+		glm::vec3 farthest = glm::mix(bbox_min, bbox_max, glm::greaterThanEqual(normal, glm::vec3(0.0f)));
+		glm::vec3 nearest = glm::mix(bbox_max, bbox_min, glm::greaterThanEqual(normal, glm::vec3(0.0f)));
+
+		if (glm::dot(normal, farthest) + plane.w < 0.0f)
+		{
+			return frustum_test::outside;
+		}
+		if (glm::dot(normal, nearest) + plane.w < 0.0f)
+		{
+			result = frustum_test::intersecting;
+		}
+	}
+	return result;
+}
+
+void bvh::query_frustum(std::span<const glm::vec4> planes, std::vector<uint32_t>& out_items) const
+{
+	if (m_nodes.empty())
+	{
+		return;
+	}
+
+	std::vector<uint32_t> stack = { 0 };
+	while (!stack.empty())
+	{
+		uint32_t node_idx = stack.back();
+		stack.pop_back();
+
+		const node& n = m_nodes[node_idx];
+		frustum_test test = test_box_frustum(n.bbox_min, n.bbox_max, planes);
+		if (test == frustum_test::outside)
+		{
+			continue;
+		}
+
+		if (test == frustum_test::inside)
+		{
+			append_subtree_items(node_idx, out_items);
+		}
+		else if (n.is_leaf())
+		{
+			for (uint32_t i = n.left_or_first; i < n.left_or_first + n.item_count; i++)
+			{
+				const aabb& box = m_item_boxes[m_item_indices[i]];
+				if (test_box_frustum(box.min, box.max, planes) != frustum_test::outside)
+				{
+					out_items.push_back(m_item_indices[i]);
+				}
+			}
+		}
+		else
+		{
+			stack.push_back(n.left_or_first + 1);
+			stack.push_back(n.left_or_first);
+		}
+	}
+}
+
+static bool test_box_sphere(const glm::vec3& bbox_min, const glm::vec3& bbox_max, const glm::vec3& center, float radius)
+{
+	glm::vec3 d = center - glm::clamp(center, bbox_min, bbox_max);
+	return glm::dot(d, d) <= radius * radius;
+}
+
+void bvh::query_sphere(const glm::vec3& center, float radius, std::vector<uint32_t>& out_items) const
+{
+	if (m_nodes.empty())
+	{
+		return;
+	}
+
+	std::vector<uint32_t> stack = { 0 };
+	while (!stack.empty())
+	{
+		const node& n = m_nodes[stack.back()];
+		stack.pop_back();
+
+		if (!test_box_sphere(n.bbox_min, n.bbox_max, center, radius))
+		{
+			continue;
+		}
+
+		if (n.is_leaf())
+		{
+			for (uint32_t i = n.left_or_first; i < n.left_or_first + n.item_count; i++)
+			{
+				const aabb& box = m_item_boxes[m_item_indices[i]];
+				if (test_box_sphere(box.min, box.max, center, radius))
+				{
+					out_items.push_back(m_item_indices[i]);
+				}
+			}
+		}
+		else
+		{
+			stack.push_back(n.left_or_first + 1);
+			stack.push_back(n.left_or_first);
+		}
+	}
+}
+
+/* Distance along the ray where it enters the box, FLT_MAX when missed or farther than max_distance */
+static float intersect_ray_box(const glm::vec3& bbox_min, const glm::vec3& bbox_max, const glm::vec3& origin, const glm::vec3& inv_direction, float max_distance)
+{
+	glm::vec3 t0 = (bbox_min - origin) * inv_direction;
+	glm::vec3 t1 = (bbox_max - origin) * inv_direction;
+	glm::vec3 t_near = glm::min(t0, t1);
+	glm::vec3 t_far = glm::max(t0, t1);
+
+	float t_enter = std::max(std::max(t_near.x, t_near.y), std::max(t_near.z, 0.0f));
+	float t_exit = std::min(std::min(t_far.x, t_far.y), t_far.z);
+
+	return (t_enter <= t_exit && t_enter < max_distance) ? t_enter : FLT_MAX;
+}
+
+bool bvh::raycast(const glm::vec3& origin, const glm::vec3& direction, float max_distance, uint32_t& out_item, float& out_distance,
+	const std::function<float(uint32_t)>& intersect_item) const
+{
+	if (m_nodes.empty())
+	{
+		return false;
+	}
+
+	/* Clamped so that axis-parallel rays lying on a slab plane give 0 * FLT_MAX = 0 instead of 0 * inf = NaN : boxes are then half-open, hit on their min face and missed on their max face */
+	glm::vec3 inv_direction = glm::clamp(1.0f / direction, -FLT_MAX, FLT_MAX);
+	float closest = max_distance;
+	bool is_hit = false;
+
+	std::vector<uint32_t> stack = { 0 };
+	while (!stack.empty())
+	{
+		const node& n = m_nodes[stack.back()];
+		stack.pop_back();
+
+		if (intersect_ray_box(n.bbox_min, n.bbox_max, origin, inv_direction, closest) == FLT_MAX)
+		{
+			continue;
+		}
+
+		if (n.is_leaf())
+		{
+			for (uint32_t i = n.left_or_first; i < n.left_or_first + n.item_count; i++)
+			{
+				uint32_t item = m_item_indices[i];
+				float t = intersect_ray_box(m_item_boxes[item].min, m_item_boxes[item].max, origin, inv_direction, closest);
+				if (t != FLT_MAX && intersect_item)
+				{
+					t = intersect_item(item);
+					t = (t >= 0.0f && t < closest) ? t : FLT_MAX;
+				}
+
+				if (t != FLT_MAX)
+				{
+					closest = t;
+					out_item = item;
+					is_hit = true;
+				}
+			}
+			continue;
+		}
+
+		/* Nearest child popped first, so that the farther one is often pruned by the hit found in it */
+		uint32_t near_child = n.left_or_first;
+		uint32_t far_child = n.left_or_first + 1;
+		float t_near = intersect_ray_box(m_nodes[near_child].bbox_min, m_nodes[near_child].bbox_max, origin, inv_direction, closest);
+		float t_far = intersect_ray_box(m_nodes[far_child].bbox_min, m_nodes[far_child].bbox_max, origin, inv_direction, closest);
+		if (t_far < t_near)
+		{
+			std::swap(near_child, far_child);
+			std::swap(t_near, t_far);
+		}
+
+		if (t_far != FLT_MAX) stack.push_back(far_child);
+		if (t_near != FLT_MAX) stack.push_back(near_child);
+	}
+
+	out_distance = closest;
+	return is_hit;
+}
@@ -0,0 +1,79 @@
+#pragma once
+
+#include "core/engine/common.h"
+
+#include <cfloat>
+#include <functional>
+
+struct aabb
+{
+	glm::vec3 min = glm::vec3(FLT_MAX);
+	glm::vec3 max = glm::vec3(-FLT_MAX);
+
+	void expand(const glm::vec3& p);
+	void expand(const aabb& other);
+	bool is_empty() const { return min.x > max.x || min.y > max.y || min.z > max.z; }
+	glm::vec3 center() const { return 0.5f * (min + max); }
+	float surface_area() const;
+
+	/* Box enclosing this box once transformed */
+	aabb transformed(const glm::mat4& m) const;
+};
+
+/*
+	Bounding volume hierarchy over a set of boxes, the items, identified by their index in the span given to build().
+	Built top-down with binned SAH, large subtrees are built in parallel on the job system.
+	Nodes are 32 bytes, the two children of a node are stored next to each other and always after their parent :
+	refit() updates every box in a single reverse pass when items move but are neither added nor removed.
+*/
+class bvh
+{
+public:
+	struct node
+	{
+		glm::vec3 bbox_min;
+		uint32_t left_or_first;	/* Interior : left child, the right one follows. Leaf : first index in m_item_indices. */
+		glm::vec3 bbox_max;
+		uint32_t item_count;	/* 0 for interior nodes */
+
+		bool is_leaf() const { return item_count > 0; }
+	};
+
+	void build(std::span<const aabb> item_boxes);
+
+	/* item_boxes holds the same items as the last build(), at their new positions */
+	void refit(std::span<const aabb> item_boxes);
+
+	void clear();
+
+	/* Items whose box is on the inner side of all planes (xyz : inward normal), appended to out_items */
+	void query_frustum(std::span<const glm::vec4> planes, std::vector<uint32_t>& out_items) const;
+
+	/* Items whose box intersects the sphere, appended to out_items */
+	void query_sphere(const glm::vec3& center, float radius, std::vector<uint32_t>& out_items) const;
+
+	/*
+		Closest item whose box is hit by the ray before max_distance. When given, intersect_item(item) refines the hit
+		against the item itself : distance along the ray, or a negative value when missed.
+	*/
+	bool raycast(const glm::vec3& origin, const glm::vec3& direction, float max_distance, uint32_t& out_item, float& out_distance,
+		const std::function<float(uint32_t)>& intersect_item = nullptr) const;
+
+	bool is_empty() const { return m_nodes.empty(); }
+	size_t get_item_count() const { return m_item_boxes.size(); }
+	const std::vector<node>& get_nodes() const { return m_nodes; }
+
+private:
+	struct build_context;
+
+	void build_node(build_context& context, uint32_t node_idx, uint32_t first, uint32_t count);
+
+	/* Sorts the items of a node around the best SAH plane, returns the number of items on the left or 0 for a leaf */
+	uint32_t partition_sah(const build_context& context, uint32_t first, uint32_t count, const aabb& bounds, const aabb& centroid_bounds);
+
+	void append_subtree_items(uint32_t node_idx, std::vector<uint32_t>& out_items) const;
+
+	std::vector<node> m_nodes;
+	std::vector<uint32_t> m_item_indices;
+	std::vector<aabb> m_item_boxes;
+};
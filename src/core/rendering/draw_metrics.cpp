@@ -1,5 +1,7 @@
 #include "draw_metrics.h"
 
+#include <atomic>
+
 DrawMetricsEntry DrawMetricsManager::add_entry(const char* renderer_name)
 {
 	DrawMetricsEntry entry;
@@ -9,24 +11,56 @@ DrawMetricsEntry DrawMetricsManager::add_entry(const char* renderer_name)
 	num_vertices.push_back(0);
 	num_drawcalls.push_back(0);
 	num_instances.push_back(0);
+	vertex_data_kb.push_back(0);
+	cpu_record_ms.push_back(0.0f);
+	num_visible.push_back(0);
+	num_culled.push_back(0);
 
 	return entry;
 }
 
+static void atomic_add(unsigned int& value, unsigned int count)
+{
+	std::atomic_ref<unsigned int>(value).fetch_add(count, std::memory_order_relaxed);
+}
+
 void DrawMetricsEntry::increment_drawcall_count(unsigned int count) 
 {
-	DrawMetricsManager::num_drawcalls[id] += count;
-	DrawMetricsManager::total_drawcalls += count;
+	atomic_add(DrawMetricsManager::num_drawcalls[id], count);
+	atomic_add(DrawMetricsManager::total_drawcalls, count);
 };
 
 void DrawMetricsEntry::increment_vertex_count(unsigned int count)
 {
-	DrawMetricsManager::num_vertices[id] += count;
-	DrawMetricsManager::total_vertices += count;
+	atomic_add(DrawMetricsManager::num_vertices[id], count);
+	atomic_add(DrawMetricsManager::total_vertices, count);
 };
 
 void DrawMetricsEntry::increment_instance_count(unsigned int count)
 {
-	DrawMetricsManager::num_instances[id] += count;
-	DrawMetricsManager::total_instances += count;
+	atomic_add(DrawMetricsManager::num_instances[id], count);
+	atomic_add(DrawMetricsManager::total_instances, count);
+};
+
+void DrawMetricsEntry::increment_vertex_data_size(size_t size_bytes)
+{
+	unsigned int size_kb = (unsigned int)(size_bytes / 1024);
+	atomic_add(DrawMetricsManager::vertex_data_kb[id], size_kb);
+	atomic_add(DrawMetricsManager::total_vertex_data_kb, size_kb);
+};
+
+/* Main thread only */
+void DrawMetricsEntry::add_cpu_record_time(float ms)
+{
+	DrawMetricsManager::cpu_record_ms[id] += ms;
+	DrawMetricsManager::total_cpu_record_ms += ms;
+};
+
+/* Main thread only */
+void DrawMetricsEntry::set_culling_counts(unsigned int visible, unsigned int culled)
+{
+	DrawMetricsManager::total_visible += visible - DrawMetricsManager::num_visible[id];
+	DrawMetricsManager::total_culled += culled - DrawMetricsManager::num_culled[id];
+	DrawMetricsManager::num_visible[id] = visible;
+	DrawMetricsManager::num_culled[id] = culled;
 };
@@ -2,8 +2,12 @@
 
 #include "core/engine/common.h"
 
+#include <algorithm>
+#include <chrono>
+
 struct DrawMetricsManager;
 
+/* Increments are thread safe : passes can be recorded from several threads */
 struct DrawMetricsEntry
 {
 	size_t id;
@@ -11,6 +15,24 @@ struct DrawMetricsEntry
 	void increment_drawcall_count(unsigned int count);
 	void increment_vertex_count(unsigned int count);
 	void increment_instance_count(unsigned int count);
+	/* Vertex buffers bound by the draws, to compare vertex formats */
+	void increment_vertex_data_size(size_t size_bytes);
+	void add_cpu_record_time(float ms);
+	/* Instances that passed / failed culling, as read back from the GPU */
+	void set_culling_counts(unsigned int visible, unsigned int culled);
+};
+
+/* Adds the CPU time spent in its scope to the record time of the entry */
+struct ScopedRecordTimer
+{
+	ScopedRecordTimer(DrawMetricsEntry entry) : entry(entry), start(std::chrono::steady_clock::now()) {}
+	~ScopedRecordTimer()
+	{
+		entry.add_cpu_record_time(std::chrono::duration<float, std::milli>(std::chrono::steady_clock::now() - start).count());
+	}
+
+	DrawMetricsEntry entry;
+	std::chrono::steady_clock::time_point start;
 };
 
 struct DrawMetricsManager
@@ -19,10 +41,18 @@ struct DrawMetricsManager
 	static inline std::vector<unsigned int> num_vertices;
 	static inline std::vector<unsigned int> num_drawcalls;
 	static inline std::vector<unsigned int> num_instances;
+	static inline std::vector<unsigned int> vertex_data_kb;
+	static inline std::vector<float> cpu_record_ms;
+	static inline std::vector<unsigned int> num_visible;
+	static inline std::vector<unsigned int> num_culled;
 
 	static inline unsigned int total_drawcalls;
 	static inline unsigned int total_vertices;
 	static inline unsigned int total_instances;
+	static inline unsigned int total_vertex_data_kb;
+	static inline float total_cpu_record_ms;
+	static inline unsigned int total_visible;
+	static inline unsigned int total_culled;
 
 	static DrawMetricsEntry add_entry(const char* renderer_name);
 
@@ -31,10 +61,18 @@ struct DrawMetricsManager
 		total_drawcalls = 0;
 		total_vertices = 0;
 		total_instances = 0;
+		total_vertex_data_kb = 0;
+		total_cpu_record_ms = 0.0f;
+		total_visible = 0;
+		total_culled = 0;
 
 		memset(&num_vertices[0], 0, sizeof(unsigned int) * num_vertices.size());
 		memset(&num_drawcalls[0], 0, sizeof(unsigned int) * num_drawcalls.size());
 		memset(&num_instances[0], 0, sizeof(unsigned int) * num_instances.size());
+		std::fill(vertex_data_kb.begin(), vertex_data_kb.end(), 0u);
+		std::fill(cpu_record_ms.begin(), cpu_record_ms.end(), 0.0f);
+		std::fill(num_visible.begin(), num_visible.end(), 0u);
+		std::fill(num_culled.begin(), num_culled.end(), 0u);
 	}
 };
 
@@ -0,0 +1,171 @@
+#include "frustum_culling.h"
+
+#include "core/engine/job_system.h"
+
+#include <algorithm>
+#include <cassert>
+#include <cfloat>
+#include <immintrin.h>
+
+void aabb_soa::resize(size_t new_count)
+{
+	count = new_count;
+	size_t padded = (new_count + k_aabb_padding - 1) / k_aabb_padding * k_aabb_padding;
+
+	min_x.assign(padded, FLT_MAX);
+	min_y.assign(padded, FLT_MAX);
+	min_z.assign(padded, FLT_MAX);
+	max_x.assign(padded, -FLT_MAX);
+	max_y.assign(padded, -FLT_MAX);
+	max_z.assign(padded, -FLT_MAX);
+}
+
+void aabb_soa::set(size_t idx, const glm::vec3& min, const glm::vec3& max)
+{
+	min_x[idx] = min.x;
+	min_y[idx] = min.y;
+	min_z[idx] = min.z;
+	max_x[idx] = max.x;
+	max_y[idx] = max.y;
+	max_z[idx] = max.z;
+}
+
+void aabb_soa::set_unbounded(size_t idx)
+{
+	set(idx, glm::vec3(-FLT_MAX), glm::vec3(FLT_MAX));
+}
+
+void aabb_soa::set_transformed(size_t idx, const glm::mat4& model, const glm::vec3& min_os, const glm::vec3& max_os)
+{
+	glm::vec3 center = glm::vec3(model * glm::vec4(0.5f * (min_os + max_os), 1.0f));
+	glm::vec3 extents_os = 0.5f * (max_os - min_os);
+	glm::vec3 extents = glm::abs(glm::vec3(model[0])) * extents_os.x + glm::abs(glm::vec3(model[1])) * extents_os.y + glm::abs(glm::vec3(model[2])) * extents_os.z;
+
+	set(idx, center - extents, center + extents);
+}
+
+void extract_frustum_planes(const glm::mat4& view_proj, glm::vec4 out_planes[6])
+{
+	glm::vec4 row_x = glm::vec4(view_proj[0][0], view_proj[1][0], view_proj[2][0], view_proj[3][0]);
+	glm::vec4 row_y = glm::vec4(view_proj[0][1], view_proj[1][1], view_proj[2][1], view_proj[3][1]);
+	glm::vec4 row_z = glm::vec4(view_proj[0][2], view_proj[1][2], view_proj[2][2], view_proj[3][2]);
+	glm::vec4 row_w = glm::vec4(view_proj[0][3], view_proj[1][3], view_proj[2][3], view_proj[3][3]);
+
+	out_planes[0] = row_w + row_x;
+	out_planes[1] = row_w - row_x;
+	out_planes[2] = row_w + row_y;
+	out_planes[3] = row_w - row_y;
+	out_planes[4] = row_w - row_z;
+	out_planes[5] = row_z;
+
+	for (int i = 0; i < 6; i++)
+	{
+		out_planes[i] /= glm::length(glm::vec3(out_planes[i]));
+	}
+}
+
+/*
+	A box is outside a plane when its corner farthest along the plane normal is behind it.
+	That corner only depends on the signs of the normal : the component arrays are picked once per plane.
+*/
+struct plane_corner
+{
+	const float* x;
+	const float* y;
+	const float* z;
+	glm::vec4 plane;
+};
+
+static void get_plane_corners(const aabb_soa& boxes, std::span<const glm::vec4> planes, plane_corner* out_corners)
+{
+	for (size_t p = 0; p < planes.size(); p++)
+	{
+		out_corners[p].x = planes[p].x >= 0.0f ? boxes.max_x.data() : boxes.min_x.data();
+		out_corners[p].y = planes[p].y >= 0.0f ? boxes.max_y.data() : boxes.min_y.data();
+		out_corners[p].z = planes[p].z >= 0.0f ? boxes.max_z.data() : boxes.min_z.data();
+		out_corners[p].plane = planes[p];
+	}
+}
+
+void cull_aabbs(const aabb_soa& boxes, std::span<const glm::vec4> planes, size_t begin, size_t end, uint8_t* out_visible, bool accumulate)
+{
+	assert(begin % k_simd_width == 0);
+	assert(planes.size() <= 8);
+
+	plane_corner corners[8];
+	get_plane_corners(boxes, planes, corners);
+
+	end = std::min(end, boxes.padded_size());
+
+	for (size_t i = begin; i < end; i += k_simd_width)
+	{
+#if defined(__AVX__)
+		__m256 outside = _mm256_setzero_ps();
+		for (size_t p = 0; p < planes.size(); p++)
+		{
+			const plane_corner& c = corners[p];
+			__m256 dist = _mm256_add_ps(
+				_mm256_add_ps(_mm256_mul_ps(_mm256_set1_ps(c.plane.x), _mm256_loadu_ps(c.x + i)), _mm256_mul_ps(_mm256_set1_ps(c.plane.y), _mm256_loadu_ps(c.y + i))),
+				_mm256_add_ps(_mm256_mul_ps(_mm256_set1_ps(c.plane.z), _mm256_loadu_ps(c.z + i)), _mm256_set1_ps(c.plane.w)));
+			outside = _mm256_or_ps(outside, _mm256_cmp_ps(dist, _mm256_setzero_ps(), _CMP_LT_OQ));
+		}
+		int visible_mask = ~_mm256_movemask_ps(outside);
+#else
+		__m128 outside = _mm_setzero_ps();
+		for (size_t p = 0; p < planes.size(); p++)
+		{
+			const plane_corner& c = corners[p];
+			__m128 dist = _mm_add_ps(
+				_mm_add_ps(_mm_mul_ps(_mm_set1_ps(c.plane.x), _mm_loadu_ps(c.x + i)), _mm_mul_ps(_mm_set1_ps(c.plane.y), _mm_loadu_ps(c.y + i))),
+				_mm_add_ps(_mm_mul_ps(_mm_set1_ps(c.plane.z), _mm_loadu_ps(c.z + i)), _mm_set1_ps(c.plane.w)));
+			outside = _mm_or_ps(outside, _mm_cmplt_ps(dist, _mm_setzero_ps()));
+		}
+		int visible_mask = ~_mm_movemask_ps(outside);
+#endif
+
+		for (size_t lane = 0; lane < k_simd_width; lane++)
+		{
+			uint8_t visible = uint8_t((visible_mask >> lane) & 1);
+			out_visible[i + lane] = accumulate ? (out_visible[i + lane] | visible) : visible;
+		}
+	}
+
+	/* Padding boxes are already behind every plane, cleared anyway for degenerate planes */
+	for (size_t i = std::max(begin, boxes.size()); i < end; i++)
+	{
+		out_visible[i] = 0;
+	}
+}
+
+void cull_aabbs_scalar(const aabb_soa& boxes, std::span<const glm::vec4> planes, size_t begin, size_t end, uint8_t* out_visible, bool accumulate)
+{
+	plane_corner corners[8];
+	get_plane_corners(boxes, planes, corners);
+
+	end = std::min(end, boxes.size());
+
+	for (size_t i = begin; i < end; i++)
+	{
+		uint8_t visible = 1;
+		for (size_t p = 0; p < planes.size() && visible; p++)
+		{
+			const plane_corner& c = corners[p];
+			visible = (c.plane.x * c.x[i] + c.plane.y * c.y[i] + c.plane.z * c.z[i] + c.plane.w) >= 0.0f;
+		}
+		out_visible[i] = accumulate ? (out_visible[i] | visible) : visible;
+	}
+}
+
+void cull_aabbs_parallel(const aabb_soa& boxes, std::span<const glm::vec4> planes, uint8_t* out_visible, bool accumulate, size_t min_batch_size)
+{
+	size_t num_vectors = boxes.padded_size() / k_simd_width;
+	size_t min_batch_vectors = std::max<size_t>(min_batch_size / k_simd_width, 1);
+
+	job_system& js = job_system::get_instance();
+	job_counter counter;
+	js.run_range(num_vectors, min_batch_vectors, [&](size_t begin, size_t end)
+	{
+		cull_aabbs(boxes, planes, begin * k_simd_width, end * k_simd_width, out_visible, accumulate);
+	}, counter);
+	js.wait(counter);
+}
@@ -0,0 +1,54 @@
+#pragma once
+
+#include "core/engine/common.h"
+
+/*
+	CPU frustum culling of axis-aligned boxes, the fallback of the GPU culling pass.
+	Boxes are tested k_simd_width at a time with SSE, or AVX when the build enables it.
+*/
+
+#if defined(__AVX__)
+static constexpr size_t k_simd_width = 8;
+#else
+static constexpr size_t k_simd_width = 4;
+#endif
+
+/* Box arrays are padded to a multiple of this, for any SIMD width */
+static constexpr size_t k_aabb_padding = 8;
+
+/*
+	World space boxes, one array per component. Padding boxes are empty (min > max) and never visible.
+	An unbounded box, always visible, is set with set_unbounded().
+*/
+struct aabb_soa
+{
+	void resize(size_t count);
+	void set(size_t idx, const glm::vec3& min, const glm::vec3& max);
+	void set_unbounded(size_t idx);
+
+	/* Box of an object space box once transformed */
+	void set_transformed(size_t idx, const glm::mat4& model, const glm::vec3& min_os, const glm::vec3& max_os);
+
+	size_t size() const { return count; }
+	size_t padded_size() const { return min_x.size(); }
+
+	std::vector<float> min_x, min_y, min_z;
+	std::vector<float> max_x, max_y, max_z;
+	size_t count = 0;
+};
+
+/* Planes of the frustum of a view projection matrix with a [0, 1] depth range, in the order left, right, bottom, top, far, near. xyz is the inward normal. */
+void extract_frustum_planes(const glm::mat4& view_proj, glm::vec4 out_planes[6]);
+
+/*
+	out_visible[i] is 1 for boxes of [begin, end) on the inner side of all planes, 0 otherwise.
+	When accumulate is set, visible boxes are added to out_visible instead (union of several frustums).
+	begin must be a multiple of k_simd_width, out_visible holds boxes.padded_size() elements.
+*/
+void cull_aabbs(const aabb_soa& boxes, std::span<const glm::vec4> planes, size_t begin, size_t end, uint8_t* out_visible, bool accumulate = false);
+
+/* Same as cull_aabbs() one box at a time, reference for the benchmark */
+void cull_aabbs_scalar(const aabb_soa& boxes, std::span<const glm::vec4> planes, size_t begin, size_t end, uint8_t* out_visible, bool accumulate = false);
+
+/* cull_aabbs() over all boxes, split across the job system */
+void cull_aabbs_parallel(const aabb_soa& boxes, std::span<const glm::vec4> planes, uint8_t* out_visible, bool accumulate = false, size_t min_batch_size = 4096);
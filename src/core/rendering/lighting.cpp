@@ -45,7 +45,7 @@ void light_manager::create_ssbo()
 {
 	for (int i = 0; i < NUM_FRAMES; i++)
 	{
-		ssbo[i].init(vk::buffer::type::STORAGE, max_point_lights * sizeof(point_light) + sizeof(directional_light), "SSBO Lighting");
+		ssbo[i].init(vk::buffer::type::DYNAMIC, max_point_lights * sizeof(point_light) + sizeof(directional_light), "SSBO Lighting");
 		ssbo[i].create();
 	}
 }
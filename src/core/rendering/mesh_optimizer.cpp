@@ -0,0 +1,756 @@
+#include "mesh_optimizer.h"
+
+#include <glm/geometric.hpp>
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <numeric>
+#include <string_view>
+#include <unordered_map>
+
+namespace mesh_optimizer
+{
+	/*
+		FIFO cache modelled with timestamps : a vertex is in the cache if less than cache_size vertices were added since it was.
+		Timestamps start far enough in the past for every vertex to miss on first use.
+	*/
+	struct fifo_cache
+	{
+		fifo_cache(size_t num_vertices, uint32_t cache_size) : timestamps(num_vertices, 0), time(cache_size + 1), cache_size(cache_size) {}
+
+		/* Returns true on a miss, the vertex is then added */
+		bool access(unsigned int v)
+		{
+			if (time - timestamps[v] > cache_size)
+			{
+				timestamps[v] = time++;
+				return true;
+			}
+			return false;
+		}
+
+		std::vector<uint32_t> timestamps;
+		uint32_t time;
+		uint32_t cache_size;
+	};
+
+	cache_stats analyze_vertex_cache(std::span<const unsigned int> indices, size_t num_vertices, uint32_t cache_size)
+	{
+		cache_stats stats;
+		stats.num_triangles = uint32_t(indices.size() / 3);
+
+		fifo_cache cache(num_vertices, cache_size);
+		std::vector<bool> is_referenced(num_vertices, false);
+		for (unsigned int v : indices)
+		{
+			stats.num_invocations += cache.access(v) ? 1 : 0;
+			if (!is_referenced[v])
+			{
+				is_referenced[v] = true;
+				stats.num_vertices++;
+			}
+		}
+
+		return stats;
+	}
+
+	void weld_vertices(std::vector<VertexData>& vertices, std::span<unsigned int> indices)
+	{
+		/* VertexData has no padding : the bytes of a vertex are its key */
+		static_assert(sizeof(VertexData) == 9 * sizeof(float));
+
+		std::unordered_map<std::string_view, unsigned int> unique_idx;
+		unique_idx.reserve(vertices.size());
+
+		std::vector<unsigned int> remap(vertices.size());
+		std::vector<VertexData> unique_vertices;
+		unique_vertices.reserve(vertices.size());
+
+		for (size_t i = 0; i < vertices.size(); i++)
+		{
+			std::string_view key(reinterpret_cast<const char*>(&vertices[i]), sizeof(VertexData));
+			auto [it, inserted] = unique_idx.try_emplace(key, (unsigned int)unique_vertices.size());
+			if (inserted)
+			{
+				unique_vertices.push_back(vertices[i]);
+			}
+			remap[i] = it->second;
+		}
+
+		for (unsigned int& index : indices)
+		{
+			index = remap[index];
+		}
+
+		/* Keys point into the source vertices : swapped only once the map is no longer used */
+		unique_idx.clear();
+		vertices.swap(unique_vertices);
+	}
+
+	void optimize_vertex_cache(std::span<unsigned int> indices, size_t num_vertices, uint32_t cache_size)
+	{
+		size_t num_triangles = indices.size() / 3;
+		if (num_triangles == 0 || num_vertices == 0)
+		{
+			return;
+		}
+
+		/* Triangles using each vertex, and how many of them are not emitted yet (live) */
+		std::vector<uint32_t> live_count(num_vertices, 0);
+		for (size_t i = 0; i < num_triangles * 3; i++)
+		{
+			live_count[indices[i]]++;
+		}
+
+		std::vector<uint32_t> adjacency_offset(num_vertices + 1, 0);
+		std::partial_sum(live_count.begin(), live_count.end(), adjacency_offset.begin() + 1);
+
+		std::vector<uint32_t> adjacency(adjacency_offset.back());
+		std::vector<uint32_t> fill = adjacency_offset;
+		for (uint32_t t = 0; t < num_triangles; t++)
+		{
+			for (uint32_t k = 0; k < 3; k++)
+			{
+				adjacency[fill[indices[3 * t + k]]++] = t;
+			}
+		}
+
+		std::vector<unsigned int> output;
+		output.reserve(num_triangles * 3);
+
+		std::vector<bool> is_emitted(num_triangles, false);
+		std::vector<uint32_t> cache_time(num_vertices, 0);
+		uint32_t time = cache_size + 1;
+
+		std::vector<unsigned int> dead_end_stack;
+		std::vector<unsigned int> candidates;
+		size_t cursor = 0;
+
+		/* Next vertex with live triangles : most recently used first, then input order */
+		auto skip_dead_end = [&]() -> int64_t
+		{
+			while (!dead_end_stack.empty())
+			{
+				unsigned int v = dead_end_stack.back();
+				dead_end_stack.pop_back();
+				if (live_count[v] > 0)
+				{
+					return v;
+				}
+			}
+
+			for (; cursor < num_vertices; cursor++)
+			{
+				if (live_count[cursor] > 0)
+				{
+					return (int64_t)cursor;
+				}
+			}
+
+			return -1;
+		};
+
+		int64_t fanning = skip_dead_end();
+		while (fanning >= 0)
+		{
+			/* Emits every live triangle around the fanning vertex */
+			candidates.clear();
+			for (uint32_t a = adjacency_offset[fanning]; a < adjacency_offset[fanning + 1]; a++)
+			{
+				uint32_t t = adjacency[a];
+				if (is_emitted[t])
+				{
+					continue;
+				}
+
+				for (uint32_t k = 0; k < 3; k++)
+				{
+					unsigned int v = indices[3 * t + k];
+					output.push_back(v);
+					dead_end_stack.push_back(v);
+					candidates.push_back(v);
+					live_count[v]--;
+
+					if (time - cache_time[v] > cache_size)
+					{
+						cache_time[v] = time++;
+					}
+				}
+				is_emitted[t] = true;
+			}
+
+			/* Next fanning vertex : the oldest candidate still in the cache once its live triangles are emitted */
+			int64_t best = -1;
+			int64_t best_priority = -1;
+			for (unsigned int v : candidates)
+			{
+				if (live_count[v] == 0)
+				{
+					continue;
+				}
+
+				int64_t priority = 0;
+				if (time - cache_time[v] + 2 * live_count[v] <= cache_size)
+				{
+					priority = time - cache_time[v];
+				}
+
+				if (priority > best_priority)
+				{
+					best_priority = priority;
+					best = v;
+				}
+			}
+
+			fanning = best >= 0 ? best : skip_dead_end();
+		}
+
+		std::copy(output.begin(), output.end(), indices.begin());
+	}
+
+	void optimize_overdraw(std::span<unsigned int> indices, std::span<const VertexData> vertices, uint32_t cache_size)
+	{
+		size_t num_triangles = indices.size() / 3;
+		if (num_triangles < 2)
+		{
+			return;
+		}
+
+		struct cluster
+		{
+			size_t first_triangle;
+			size_t num_triangles;
+			glm::vec3 centroid = glm::vec3(0.0f);	/* Area weighted */
+			glm::vec3 normal = glm::vec3(0.0f);		/* Sum of the area weighted triangle normals */
+			float area = 0.0f;
+			float sort_key = 0.0f;
+		};
+
+		std::vector<cluster> clusters;
+		glm::vec3 mesh_centroid(0.0f);
+		float mesh_area = 0.0f;
+
+		fifo_cache cache(vertices.size(), cache_size);
+		for (size_t t = 0; t < num_triangles; t++)
+		{
+			const unsigned int* tri = &indices[3 * t];
+
+			uint32_t num_misses = 0;
+			for (uint32_t k = 0; k < 3; k++)
+			{
+				num_misses += cache.access(tri[k]) ? 1 : 0;
+			}
+
+			if (num_misses == 3 || clusters.empty())
+			{
+				clusters.push_back({ .first_triangle = t, .num_triangles = 0 });
+			}
+
+			const glm::vec3& p0 = vertices[tri[0]].pos;
+			const glm::vec3& p1 = vertices[tri[1]].pos;
+			const glm::vec3& p2 = vertices[tri[2]].pos;
+			glm::vec3 cross = glm::cross(p1 - p0, p2 - p0);
+			float area = 0.5f * glm::length(cross);
+			glm::vec3 centroid = (p0 + p1 + p2) / 3.0f;
+
+			cluster& c = clusters.back();
+			c.num_triangles++;
+			c.centroid += centroid * area;
+			c.normal += cross;
+			c.area += area;
+
+			mesh_centroid += centroid * area;
+			mesh_area += area;
+		}
+
+		if (clusters.size() < 2 || mesh_area <= 0.0f)
+		{
+			return;
+		}
+
+		mesh_centroid /= mesh_area;
+
+		for (cluster& c : clusters)
+		{
+			float normal_length = glm::length(c.normal);
+			if (c.area > 0.0f && normal_length > 0.0f)
+			{
+				c.sort_key = glm::dot(c.centroid / c.area - mesh_centroid, c.normal / normal_length);
+			}
+		}
+
+		/* Outwards facing clusters first, ties keep the cache order */
+		std::vector<uint32_t> order(clusters.size());
+		std::iota(order.begin(), order.end(), 0);
+		std::stable_sort(order.begin(), order.end(), [&](uint32_t a, uint32_t b) { return clusters[a].sort_key > clusters[b].sort_key; });
+
+		std::vector<unsigned int> output;
+		output.reserve(num_triangles * 3);
+		for (uint32_t cluster_idx : order)
+		{
+			const cluster& c = clusters[cluster_idx];
+			output.insert(output.end(), indices.begin() + 3 * c.first_triangle, indices.begin() + 3 * (c.first_triangle + c.num_triangles));
+		}
+
+		std::copy(output.begin(), output.end(), indices.begin());
+	}
+
+	void optimize_vertex_fetch(std::vector<VertexData>& vertices, std::span<unsigned int> indices)
+	{
+		static constexpr unsigned int k_unused = ~0u;
+
+		std::vector<unsigned int> remap(vertices.size(), k_unused);
+		std::vector<VertexData> fetch_ordered;
+		fetch_ordered.reserve(vertices.size());
+
+		for (unsigned int& index : indices)
+		{
+			if (remap[index] == k_unused)
+			{
+				remap[index] = (unsigned int)fetch_ordered.size();
+				fetch_ordered.push_back(vertices[index]);
+			}
+			index = remap[index];
+		}
+
+		vertices.swap(fetch_ordered);
+	}
+
+	/* Bounding sphere of the box of the vertices and normal cone of the triangles */
+	static Meshlet compute_meshlet_bounds(std::span<const unsigned int> indices, std::span<const VertexData> vertices, uint32_t first_index, uint32_t index_count)
+	{
+		Meshlet meshlet = { .cone = glm::vec4(0, 0, 1, 1), .first_index = first_index, .index_count = index_count };
+		std::span<const unsigned int> meshlet_indices = indices.subspan(first_index, index_count);
+
+		glm::vec3 bbox_min = vertices[meshlet_indices[0]].pos;
+		glm::vec3 bbox_max = bbox_min;
+		for (unsigned int v : meshlet_indices)
+		{
+			bbox_min = glm::min(bbox_min, vertices[v].pos);
+			bbox_max = glm::max(bbox_max, vertices[v].pos);
+		}
+
+		glm::vec3 center = 0.5f * (bbox_min + bbox_max);
+		float radius = 0.0f;
+		for (unsigned int v : meshlet_indices)
+		{
+			radius = std::max(radius, glm::length(vertices[v].pos - center));
+		}
+		meshlet.bounding_sphere = glm::vec4(center, radius);
+
+		std::vector<glm::vec3> normals;
+		normals.reserve(index_count / 3);
+		glm::vec3 axis(0.0f);
+		for (size_t t = 0; t + 2 < meshlet_indices.size(); t += 3)
+		{
+			const glm::vec3& p0 = vertices[meshlet_indices[t + 0]].pos;
+			const glm::vec3& p1 = vertices[meshlet_indices[t + 1]].pos;
+			const glm::vec3& p2 = vertices[meshlet_indices[t + 2]].pos;
+			glm::vec3 normal = glm::cross(p1 - p0, p2 - p0);
+			float length = glm::length(normal);
+			if (length > 0.0f)
+			{
+				normals.push_back(normal / length);
+				axis += normals.back();
+			}
+		}
+
+		float axis_length = glm::length(axis);
+		if (normals.empty() || axis_length == 0.0f)
+		{
+			return meshlet;
+		}
+		axis /= axis_length;
+
+		float min_dot = 1.0f;
+		for (const glm::vec3& normal : normals)
+		{
+			min_dot = std::min(min_dot, glm::dot(axis, normal));
+		}
+
+		/* Normals spread over almost a hemisphere or more : the cluster faces every direction */
+		if (min_dot <= 0.1f)
+		{
+			return meshlet;
+		}
+
+		/* Backfacing when the view direction is within 90 degrees minus the spread of the axis : cos(90 - a) = sin(a) */
+		meshlet.cone = glm::vec4(axis, std::sqrt(1.0f - min_dot * min_dot));
+		return meshlet;
+	}
+
+	std::vector<Meshlet> build_meshlets(std::span<const unsigned int> indices, std::span<const VertexData> vertices, uint32_t max_vertices, uint32_t max_triangles)
+	{
+		std::vector<Meshlet> meshlets;
+		size_t num_triangles = indices.size() / 3;
+		if (num_triangles == 0)
+		{
+			return meshlets;
+		}
+
+		/* Meshlet that last referenced each vertex, to count the new vertices of a triangle */
+		static constexpr uint32_t k_none = ~0u;
+		std::vector<uint32_t> vertex_meshlet(vertices.size(), k_none);
+
+		uint32_t current = 0;
+		uint32_t first_triangle = 0;
+		uint32_t num_meshlet_vertices = 0;
+
+		for (uint32_t t = 0; t < num_triangles; t++)
+		{
+			const unsigned int* tri = &indices[3 * t];
+
+			uint32_t num_new_vertices = 0;
+			for (uint32_t k = 0; k < 3; k++)
+			{
+				/* Degenerate triangles reference a vertex twice */
+				bool is_repeated = (k > 0 && tri[k] == tri[0]) || (k > 1 && tri[k] == tri[1]);
+				num_new_vertices += (vertex_meshlet[tri[k]] != current && !is_repeated) ? 1 : 0;
+			}
+
+			if (num_meshlet_vertices + num_new_vertices > max_vertices || t - first_triangle == max_triangles)
+			{
+				meshlets.push_back(compute_meshlet_bounds(indices, vertices, 3 * first_triangle, 3 * (t - first_triangle)));
+				current++;
+				first_triangle = t;
+				num_meshlet_vertices = 0;
+			}
+
+			for (uint32_t k = 0; k < 3; k++)
+			{
+				if (vertex_meshlet[tri[k]] != current)
+				{
+					vertex_meshlet[tri[k]] = current;
+					num_meshlet_vertices++;
+				}
+			}
+		}
+
+		meshlets.push_back(compute_meshlet_bounds(indices, vertices, 3 * first_triangle, 3 * ((uint32_t)num_triangles - first_triangle)));
+		return meshlets;
+	}
+
+	/* Sum of the squared distances to planes weighted by the area of their triangle : Q(p) = p.A.p + 2 b.p + c */
+	struct quadric
+	{
+		double a00 = 0.0, a11 = 0.0, a22 = 0.0, a01 = 0.0, a02 = 0.0, a12 = 0.0;
+		double b0 = 0.0, b1 = 0.0, b2 = 0.0;
+		double c = 0.0;
+		double weight = 0.0;
+
+		/* n is unit length, the plane is dot(n, p) + d = 0 */
+		void add_plane(const glm::dvec3& n, double d, double w)
+		{
+			a00 += w * n.x * n.x; a11 += w * n.y * n.y; a22 += w * n.z * n.z;
+			a01 += w * n.x * n.y; a02 += w * n.x * n.z; a12 += w * n.y * n.z;
+			b0 += w * n.x * d; b1 += w * n.y * d; b2 += w * n.z * d;
+			c += w * d * d;
+			weight += w;
+		}
+
+		void add(const quadric& q)
+		{
+			a00 += q.a00; a11 += q.a11; a22 += q.a22;
+			a01 += q.a01; a02 += q.a02; a12 += q.a12;
+			b0 += q.b0; b1 += q.b1; b2 += q.b2;
+			c += q.c;
+			weight += q.weight;
+		}
+
+		/* Mean squared distance of p to the planes */
+		double error(const glm::vec3& p) const
+		{
+			double x = p.x, y = p.y, z = p.z;
+			double q = a00 * x * x + a11 * y * y + a22 * z * z
+				+ 2.0 * (a01 * x * y + a02 * x * z + a12 * y * z)
+				+ 2.0 * (b0 * x + b1 * y + b2 * z)
+				+ c;
+			return weight > 0.0 ? std::max(q, 0.0) / weight : 0.0;
+		}
+	};
+
+	static uint64_t edge_key(unsigned int a, unsigned int b)
+	{
+		return a < b ? (uint64_t(a) << 32) | b : (uint64_t(b) << 32) | a;
+	}
+
+	std::vector<unsigned int> simplify(std::span<const unsigned int> indices, std::span<const VertexData> vertices, size_t target_index_count, float max_error, float* out_error)
+	{
+		std::vector<unsigned int> result(indices.begin(), indices.end());
+		if (out_error)
+		{
+			*out_error = 0.0f;
+		}
+
+		size_t num_vertices = vertices.size();
+		if (result.size() <= target_index_count || num_vertices == 0)
+		{
+			return result;
+		}
+
+		/* Unique edges sorted by key, with the number of triangles sharing them */
+		struct edge
+		{
+			uint64_t key;
+			uint32_t count;
+		};
+		std::vector<edge> edges;
+		std::vector<uint64_t> edge_keys;
+		auto count_edges = [&]()
+		{
+			edge_keys.clear();
+			for (size_t i = 0; i < result.size(); i += 3)
+			{
+				for (uint32_t k = 0; k < 3; k++)
+				{
+					edge_keys.push_back(edge_key(result[i + k], result[i + (k + 1) % 3]));
+				}
+			}
+			std::sort(edge_keys.begin(), edge_keys.end());
+
+			edges.clear();
+			for (uint64_t key : edge_keys)
+			{
+				if (edges.empty() || edges.back().key != key)
+				{
+					edges.push_back({ key, 0 });
+				}
+				edges.back().count++;
+			}
+		};
+		auto get_edge_count = [&](unsigned int a, unsigned int b)
+		{
+			uint64_t key = edge_key(a, b);
+			auto it = std::lower_bound(edges.begin(), edges.end(), key, [](const edge& e, uint64_t k) { return e.key < k; });
+			return it != edges.end() && it->key == key ? it->count : 0u;
+		};
+		count_edges();
+
+		/*
+			Vertices sharing their position with another one are on an attribute seam (UV or normal discontinuity) : moving
+			one would open the seam, they are locked as are the vertices of non-manifold edges.
+			Vertices of edges used by a single triangle are on a border of the surface.
+		*/
+		std::vector<bool> is_locked(num_vertices, false);
+		std::vector<bool> is_border(num_vertices, false);
+		{
+			std::unordered_map<std::string_view, unsigned int> position_vertex;
+			for (unsigned int index : result)
+			{
+				std::string_view key(reinterpret_cast<const char*>(&vertices[index].pos), sizeof(glm::vec3));
+				auto [it, inserted] = position_vertex.try_emplace(key, index);
+				if (!inserted && it->second != index)
+				{
+					is_locked[index] = true;
+					is_locked[it->second] = true;
+				}
+			}
+		}
+
+		std::vector<quadric> quadrics(num_vertices);
+		for (size_t i = 0; i < result.size(); i += 3)
+		{
+			glm::dvec3 p0 = vertices[result[i + 0]].pos;
+			glm::dvec3 p1 = vertices[result[i + 1]].pos;
+			glm::dvec3 p2 = vertices[result[i + 2]].pos;
+			glm::dvec3 n = glm::cross(p1 - p0, p2 - p0);
+			double double_area = glm::length(n);
+			if (double_area == 0.0)
+			{
+				continue;
+			}
+			n /= double_area;
+
+			for (uint32_t k = 0; k < 3; k++)
+			{
+				quadrics[result[i + k]].add_plane(n, -glm::dot(n, p0), 0.5 * double_area);
+			}
+
+			/* Border edges also get the plane through them orthogonal to the triangle, which keeps the border in place */
+			for (uint32_t k = 0; k < 3; k++)
+			{
+				unsigned int a = result[i + k];
+				unsigned int b = result[i + (k + 1) % 3];
+				uint32_t count = get_edge_count(a, b);
+				if (count > 2)
+				{
+					is_locked[a] = is_locked[b] = true;
+				}
+				else if (count == 1)
+				{
+					is_border[a] = is_border[b] = true;
+
+					static constexpr double k_border_weight = 10.0;
+					glm::dvec3 pa = vertices[a].pos;
+					glm::dvec3 edge = glm::dvec3(vertices[b].pos) - pa;
+					glm::dvec3 border_normal = glm::cross(edge, n);
+					double length = glm::length(border_normal);
+					if (length > 0.0)
+					{
+						border_normal /= length;
+						double w = k_border_weight * glm::dot(edge, edge);
+						quadrics[a].add_plane(border_normal, -glm::dot(border_normal, pa), w);
+						quadrics[b].add_plane(border_normal, -glm::dot(border_normal, pa), w);
+					}
+				}
+			}
+		}
+
+		struct collapse
+		{
+			unsigned int from;
+			unsigned int to;
+			double cost;
+		};
+		std::vector<collapse> collapses;
+
+		std::vector<unsigned int> remap(num_vertices);
+		std::iota(remap.begin(), remap.end(), 0u);
+		std::vector<bool> is_pass_locked(num_vertices, false);
+		std::vector<uint32_t> adjacency_offset(num_vertices + 1);
+		std::vector<uint32_t> adjacency;
+
+		static constexpr double k_no_collapse = std::numeric_limits<double>::max();
+		double max_cost = double(max_error) * double(max_error);
+		double result_cost = 0.0;
+
+		/*
+			Each pass collapses the cheapest edges whose vertices were not touched yet by the pass, so that the costs and
+			checks stay valid, then removes the triangles that became degenerate
+		*/
+		while (result.size() > target_index_count)
+		{
+			size_t num_triangles = result.size() / 3;
+
+			/* Triangles using each vertex */
+			std::fill(adjacency_offset.begin(), adjacency_offset.end(), 0);
+			for (unsigned int index : result)
+			{
+				adjacency_offset[index + 1]++;
+			}
+			std::partial_sum(adjacency_offset.begin(), adjacency_offset.end(), adjacency_offset.begin());
+			adjacency.resize(result.size());
+			std::vector<uint32_t> fill(adjacency_offset.begin(), adjacency_offset.end() - 1);
+			for (uint32_t t = 0; t < num_triangles; t++)
+			{
+				for (uint32_t k = 0; k < 3; k++)
+				{
+					adjacency[fill[result[3 * t + k]]++] = t;
+				}
+			}
+
+			/* A border vertex only moves along a border edge, onto another border vertex */
+			auto can_collapse = [&](unsigned int from, bool is_border_edge)
+			{
+				return !is_locked[from] && (!is_border[from] || is_border_edge);
+			};
+
+			collapses.clear();
+			for (const edge& e : edges)
+			{
+				unsigned int a = (unsigned int)(e.key >> 32);
+				unsigned int b = (unsigned int)(e.key & 0xffffffff);
+				if (a == b)
+				{
+					continue;
+				}
+
+				double cost_ab = can_collapse(a, e.count == 1) ? quadrics[a].error(vertices[b].pos) : k_no_collapse;
+				double cost_ba = can_collapse(b, e.count == 1) ? quadrics[b].error(vertices[a].pos) : k_no_collapse;
+				if (cost_ab == k_no_collapse && cost_ba == k_no_collapse)
+				{
+					continue;
+				}
+
+				collapses.push_back(cost_ab <= cost_ba ? collapse{ a, b, cost_ab } : collapse{ b, a, cost_ba });
+			}
+			std::sort(collapses.begin(), collapses.end(), [](const collapse& x, const collapse& y) { return x.cost < y.cost; });
+
+			/* Moving a vertex of a triangle must not flip it */
+			auto flips = [&](unsigned int from, unsigned int to)
+			{
+				for (uint32_t i = adjacency_offset[from]; i < adjacency_offset[from + 1]; i++)
+				{
+					const unsigned int* tri = &result[3 * adjacency[i]];
+					if (tri[0] == to || tri[1] == to || tri[2] == to)
+					{
+						continue;
+					}
+
+					glm::vec3 p[3];
+					glm::vec3 q[3];
+					for (uint32_t k = 0; k < 3; k++)
+					{
+						p[k] = vertices[remap[tri[k]]].pos;
+						q[k] = tri[k] == from ? vertices[to].pos : p[k];
+					}
+
+					glm::vec3 n0 = glm::cross(p[1] - p[0], p[2] - p[0]);
+					glm::vec3 n1 = glm::cross(q[1] - q[0], q[2] - q[0]);
+					if (glm::dot(n0, n1) <= 0.25f * glm::length(n0) * glm::length(n1))
+					{
+						return true;
+					}
+				}
+				return false;
+			};
+
+			/* An interior collapse removes two triangles */
+			size_t goal = (result.size() - target_index_count + 5) / 6;
+			size_t num_collapses = 0;
+
+			for (const collapse& c : collapses)
+			{
+				if (num_collapses >= goal || c.cost > max_cost)
+				{
+					break;
+				}
+
+				if (is_pass_locked[c.from] || is_pass_locked[c.to] || flips(c.from, c.to))
+				{
+					continue;
+				}
+
+				remap[c.from] = c.to;
+				quadrics[c.to].add(quadrics[c.from]);
+				is_pass_locked[c.from] = is_pass_locked[c.to] = true;
+				result_cost = std::max(result_cost, c.cost);
+				num_collapses++;
+			}
+
+			if (num_collapses == 0)
+			{
+				break;
+			}
+
+			size_t num_indices = 0;
+			for (size_t i = 0; i < result.size(); i += 3)
+			{
+				unsigned int a = remap[result[i + 0]];
+				unsigned int b = remap[result[i + 1]];
+				unsigned int c = remap[result[i + 2]];
+				if (a != b && b != c && a != c)
+				{
+					result[num_indices++] = a;
+					result[num_indices++] = b;
+					result[num_indices++] = c;
+				}
+			}
+			result.resize(num_indices);
+
+			for (const collapse& c : collapses)
+			{
+				remap[c.from] = c.from;
+				is_pass_locked[c.from] = is_pass_locked[c.to] = false;
+			}
+			count_edges();
+		}
+
+		if (out_error)
+		{
+			*out_error = float(std::sqrt(result_cost));
+		}
+		return result;
+	}
+}
@@ -0,0 +1,72 @@
+#pragma once
+
+#include "core/rendering/vulkan/VulkanMesh.h"
+
+#include <span>
+#include <vector>
+
+/*
+	Import time optimisation of indexed triangle lists, run on each primitive before it is merged into its mesh.
+	The usual order is weld_vertices(), optimize_vertex_cache(), optimize_overdraw() then optimize_vertex_fetch() :
+	the last one only renames vertices and keeps the triangle order of the previous steps.
+*/
+namespace mesh_optimizer
+{
+	/* FIFO size the GPU post-transform cache is modelled with when analyzing index buffers */
+	static constexpr uint32_t k_analyze_cache_size = 32;
+
+	/* Size assumed by the reordering : smaller than the real cache so that the order stays good on most GPUs */
+	static constexpr uint32_t k_optimize_cache_size = 16;
+
+	/* Vertex shader invocations of an indexed draw of an index buffer, with a FIFO post-transform cache */
+	struct cache_stats
+	{
+		uint32_t num_invocations = 0;
+		uint32_t num_triangles = 0;
+		uint32_t num_vertices = 0;
+
+		/* Average cache miss ratio : invocations per triangle, 0.5 at best for large regular grids, 3 at worst */
+		float get_acmr() const { return num_triangles ? float(num_invocations) / num_triangles : 0.0f; }
+		/* Average transformed vertex ratio : invocations per vertex, 1 at best */
+		float get_atvr() const { return num_vertices ? float(num_invocations) / num_vertices : 0.0f; }
+	};
+
+	cache_stats analyze_vertex_cache(std::span<const unsigned int> indices, size_t num_vertices, uint32_t cache_size = k_analyze_cache_size);
+
+	/* Merges bitwise identical vertices and remaps the indices. Unreferenced vertices are kept, see optimize_vertex_fetch(). */
+	void weld_vertices(std::vector<VertexData>& vertices, std::span<unsigned int> indices);
+
+	/* Reorders the triangles for the post-transform cache with Tipsify (Sander, Nehab, Barczak 2007) */
+	void optimize_vertex_cache(std::span<unsigned int> indices, size_t num_vertices, uint32_t cache_size = k_optimize_cache_size);
+
+	/*
+		Reorders clusters of triangles so that the ones facing outwards from the center of the primitive are drawn first,
+		they tend to occlude the others from most points of view. Clusters start where the cache is cold anyway
+		(a triangle missing all its vertices), so that the cache efficiency of optimize_vertex_cache() is kept.
+	*/
+	void optimize_overdraw(std::span<unsigned int> indices, std::span<const VertexData> vertices, uint32_t cache_size = k_optimize_cache_size);
+
+	/* Renames the vertices in the order the indices first reference them and drops the unreferenced ones */
+	void optimize_vertex_fetch(std::vector<VertexData>& vertices, std::span<unsigned int> indices);
+
+	/* Meshlet limits of common mesh shader implementations, kept so that the clusters could feed one */
+	static constexpr uint32_t k_meshlet_max_vertices = 64;
+	static constexpr uint32_t k_meshlet_max_triangles = 124;
+
+	/*
+		Splits the triangles into meshlets without reordering them : a meshlet ends when the next triangle would exceed
+		one of the limits. Run after optimize_vertex_cache(), whose fans are compact, so that the clusters are too.
+		Bounds are a sphere and a normal cone for backface culling ("Optimizing the Graphics Pipeline with Compute", Wihlidal 2016).
+	*/
+	std::vector<Meshlet> build_meshlets(std::span<const unsigned int> indices, std::span<const VertexData> vertices,
+		uint32_t max_vertices = k_meshlet_max_vertices, uint32_t max_triangles = k_meshlet_max_triangles);
+
+	/*
+		Simplifies the triangles with quadric error metrics (Garland, Heckbert 1997) by collapsing edges onto one of their
+		vertices : the result indexes the same vertices, which are not modified. Stops at target_index_count or when the
+		next collapse would move the surface by more than max_error. Vertices on attribute seams are kept, vertices on
+		borders only move along them.
+		Returns the new indices and writes in out_error the distance of the result to the input, in the units of the positions.
+	*/
+	std::vector<unsigned int> simplify(std::span<const unsigned int> indices, std::span<const VertexData> vertices, size_t target_index_count, float max_error, float* out_error = nullptr);
+}
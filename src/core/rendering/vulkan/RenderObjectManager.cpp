@@ -5,6 +5,9 @@
 #include "core/engine/Image.h"
 #include "core/rendering/vulkan/Renderers/IRenderer.h"
 #include "core/engine/vulkan/objects/vk_descriptor_set.hpp"
+#include "core/engine/job_system.h"
+
+#include <algorithm>
 
 using namespace vk;
 
@@ -34,22 +37,67 @@ uint32_t ObjectManager::add_material(const Material& material, std::string mater
 
 	m_material_id_from_hash.insert({ hash, material_idx });
 
-	m_materials_ssbo.upload(ctx.device, &m_materials.back(), material_idx * sizeof(Material), sizeof(Material));
+	/* Materials can be added while frames are in flight and read the buffer */
+	m_materials_ssbo.upload_after_frames(ctx.device, &m_materials.back(), material_idx * sizeof(Material), sizeof(Material));
 
 	return material_idx;
 }
 
 int ObjectManager::add_texture(const Texture2D& texture)
 {
+	if (m_textures.size() >= max_bindless_textures)
+	{
+		LOG_ERROR("Bindless texture array is full ({} textures), {} is not added.", max_bindless_textures, texture.info.debugName);
+		return -1;
+	}
+
 	int texture_idx = (int)m_textures.size();
 	m_textures.push_back(texture);
 	m_texture_id_from_name.insert({ texture.info.debugName, texture_idx });
 
-	m_descriptor_set_bindless_textures.write_descriptor_combined_image_sampler(texture_descriptor_array_binding, texture.view, texture.sampler, texture_idx, 1);
+	for (std::vector<int>& dirty_ids : m_dirty_texture_ids)
+	{
+		dirty_ids.push_back(texture_idx);
+	}
 
 	return texture_idx;
 }
 
+void ObjectManager::set_texture(int texture_id, const Texture2D& texture)
+{
+	assert(texture_id >= 0 && texture_id < (int)m_textures.size());
+	m_textures[texture_id] = texture;
+
+	for (std::vector<int>& dirty_ids : m_dirty_texture_ids)
+	{
+		dirty_ids.push_back(texture_id);
+	}
+}
+
+void ObjectManager::update_texture_descriptors(uint32_t frame_idx)
+{
+	std::vector<int>& dirty_ids = m_dirty_texture_ids[frame_idx];
+	if (dirty_ids.empty())
+	{
+		return;
+	}
+
+	std::sort(dirty_ids.begin(), dirty_ids.end());
+	dirty_ids.erase(std::unique(dirty_ids.begin(), dirty_ids.end()), dirty_ids.end());
+
+	std::vector<VkDescriptorImageInfo> image_infos(dirty_ids.size());
+	std::vector<VkWriteDescriptorSet> writes(dirty_ids.size());
+	for (size_t i = 0; i < dirty_ids.size(); i++)
+	{
+		const Texture2D& texture = m_textures[dirty_ids[i]];
+		image_infos[i] = { texture.sampler, texture.view, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL };
+		writes[i] = write_descriptor_set_image(m_descriptor_set_bindless_textures[frame_idx].vk_set, texture_descriptor_array_binding, image_infos[i], VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, dirty_ids[i], 1);
+	}
+
+	m_descriptor_set_bindless_textures[frame_idx].update(writes);
+	dirty_ids.clear();
+}
+
 int ObjectManager::get_texture_id(std::string_view name)
 {
 	auto ite = m_texture_id_from_name.find(name.data());
@@ -67,6 +115,76 @@ size_t ObjectManager::add_mesh(const VulkanMesh& mesh, std::string_view mesh_nam
 	m_mesh_id_from_name.insert({ mesh_name.data(), mesh_idx });
 	m_meshes.push_back(mesh);
 
+	GPUMeshDrawData draw_data
+	{
+		.first_primitive = (uint32_t)m_primitives.size(),
+		.num_primitives = (uint32_t)mesh.geometry_data.primitives.size(),
+		.first_meshlet = (uint32_t)m_meshlets.size(),
+		.num_meshlets = (uint32_t)mesh.geometry_data.meshlets.size(),
+	};
+
+	if (draw_data.first_primitive + draw_data.num_primitives > max_primitive_count)
+	{
+		LOG_ERROR("Primitive buffer is full ({} primitives), {} is not drawn.", max_primitive_count, mesh_name);
+		draw_data.num_primitives = 0;
+		draw_data.num_meshlets = 0;
+	}
+
+	/* Primitives are then culled as a whole */
+	if (draw_data.first_meshlet + draw_data.num_meshlets > max_meshlet_count)
+	{
+		LOG_ERROR("Meshlet buffer is full ({} meshlets), {} has no meshlets.", max_meshlet_count, mesh_name);
+		draw_data.num_meshlets = 0;
+	}
+
+	/* Primitives are then drawn at full detail */
+	uint32_t first_lod = (uint32_t)m_lods.size();
+	uint32_t num_lods = (uint32_t)mesh.geometry_data.lods.size();
+	if (first_lod + num_lods > max_lod_count)
+	{
+		LOG_ERROR("LOD buffer is full ({} LODs), {} has no LODs.", max_lod_count, mesh_name);
+		num_lods = 0;
+	}
+
+	for (uint32_t prim_idx = 0; prim_idx < draw_data.num_primitives; prim_idx++)
+	{
+		const Primitive& p = mesh.geometry_data.primitives[prim_idx];
+		uint32_t meshlet_count = draw_data.num_meshlets > 0 ? p.meshlet_count : 0;
+		uint32_t lod_count = num_lods > 0 ? p.lod_count : 0;
+		m_primitives.push_back({ p.model, (uint32_t)mesh_idx, (uint32_t)p.material_id, p.first_vertex, p.vertex_count, glm::vec4(p.bbox_min_os, 1.0f), glm::vec4(p.bbox_max_os, 1.0f),
+			(int32_t)p.base_vertex, draw_data.first_meshlet + p.first_meshlet, meshlet_count, first_lod + p.first_lod, lod_count });
+
+		for (uint32_t meshlet_idx = p.first_meshlet; meshlet_idx < p.first_meshlet + meshlet_count; meshlet_idx++)
+		{
+			const Meshlet& meshlet = mesh.geometry_data.meshlets[meshlet_idx];
+			m_meshlets.push_back({ meshlet.bounding_sphere, meshlet.cone, draw_data.first_primitive + prim_idx, meshlet.first_index, meshlet.index_count });
+		}
+	}
+
+	for (uint32_t lod_idx = 0; lod_idx < num_lods; lod_idx++)
+	{
+		const PrimitiveLod& lod = mesh.geometry_data.lods[lod_idx];
+		m_lods.push_back({ lod.first_index, lod.index_count, lod.error });
+	}
+
+	if (draw_data.num_primitives > 0)
+	{
+		m_primitives_ssbo.upload(ctx.device, &m_primitives[draw_data.first_primitive], draw_data.first_primitive * sizeof(GPUPrimitive), draw_data.num_primitives * sizeof(GPUPrimitive));
+	}
+
+	if (draw_data.num_meshlets > 0)
+	{
+		m_meshlets_ssbo.upload(ctx.device, &m_meshlets[draw_data.first_meshlet], draw_data.first_meshlet * sizeof(GPUMeshlet), draw_data.num_meshlets * sizeof(GPUMeshlet));
+	}
+
+	if (num_lods > 0)
+	{
+		m_lods_ssbo.upload(ctx.device, &m_lods[first_lod], first_lod * sizeof(GPUPrimitiveLod), num_lods * sizeof(GPUPrimitiveLod));
+	}
+
+	m_mesh_draw_data.push_back(draw_data);
+	update_mesh_draw_ranges();
+
 	GPUInstanceData data
 	{
 		.model = mesh.model * glm::mat4(transform)
@@ -85,7 +203,7 @@ size_t ObjectManager::add_mesh(const VulkanMesh& mesh, std::string_view mesh_nam
 	descriptor_set.write_descriptor_storage_buffer(0, mesh.m_vertex_index_buffer, 0, mesh.m_vertex_buf_size_bytes);
 	descriptor_set.write_descriptor_storage_buffer(1, mesh.m_vertex_index_buffer, mesh.m_vertex_buf_size_bytes, mesh.m_index_buf_size_bytes);
 	descriptor_set.write_descriptor_storage_buffer(2, m_mesh_instance_data_ssbo[mesh_idx], 0, VK_WHOLE_SIZE);
-	descriptor_set.write_descriptor_storage_buffer(3, m_materials_ssbo, mesh_idx * sizeof(Material), sizeof(Material));
+	descriptor_set.write_descriptor_storage_buffer(3, m_materials_ssbo, 0, VK_WHOLE_SIZE);
 
 	m_descriptor_sets.push_back(descriptor_set);
 
@@ -99,11 +217,14 @@ void ObjectManager::add_mesh_instance(std::string_view mesh_name, GPUInstanceDat
 	{
 		size_t mesh_idx = m_mesh_id_from_name.at(mesh_name.data());
 		m_mesh_instance_data[mesh_idx].push_back(data);
-		size_t offset = std::max(0ull, (m_mesh_instance_data[mesh_idx].size() - 1) * sizeof(data));
+		size_t offset = (m_mesh_instance_data[mesh_idx].size() - 1) * sizeof(data);
 
 		if ((offset + sizeof(data)) < (max_instance_count * sizeof(data)))
 		{
 			m_mesh_instance_data_ssbo[mesh_idx].upload(ctx.device, &m_mesh_instance_data[mesh_idx].back(), offset, sizeof(data));
+
+			m_mesh_draw_data[mesh_idx].instance_count = (uint32_t)m_mesh_instance_data[mesh_idx].size();
+			update_mesh_draw_ranges();
 		}
 	}
 }
@@ -114,12 +235,88 @@ void ObjectManager::update_instances_ssbo(std::string_view mesh_name)
 	{
 		size_t mesh_idx = m_mesh_id_from_name.at(mesh_name.data());
 		m_mesh_instance_data_ssbo[mesh_idx].upload(ctx.device, m_mesh_instance_data[mesh_idx].data(), 0, m_mesh_instance_data[mesh_idx].size() * sizeof(GPUInstanceData));
+		m_instances_revision++;
+		m_scene_bvh_needs_refit = true;
+	}
+}
+
+void ObjectManager::set_primitive_transform(size_t mesh_idx, size_t primitive_idx, const glm::mat4& model)
+{
+	const GPUMeshDrawData& draw_data = m_mesh_draw_data[mesh_idx];
+	if (primitive_idx >= draw_data.num_primitives)
+	{
+		return;
 	}
+
+	size_t idx = draw_data.first_primitive + primitive_idx;
+	m_primitives[idx].model = model;
+	/* Overwritten in place : the frames in flight must be done reading the previous transform */
+	m_primitives_ssbo.upload_after_frames(ctx.device, &m_primitives[idx], idx * sizeof(GPUPrimitive), sizeof(GPUPrimitive));
+
+	m_instances_revision++;
+	m_scene_bvh_needs_refit = true;
+}
+
+aabb ObjectManager::get_instance_bounds(uint32_t primitive_idx, uint32_t instance_idx) const
+{
+	const GPUPrimitive& primitive = m_primitives[primitive_idx];
+	aabb bounds_os = { glm::vec3(primitive.bbox_min_os), glm::vec3(primitive.bbox_max_os) };
+	if (bounds_os.is_empty())
+	{
+		return {};
+	}
+
+	return bounds_os.transformed(m_mesh_instance_data[primitive.mesh_idx][instance_idx].model * primitive.model);
+}
+
+const bvh& ObjectManager::get_scene_bvh()
+{
+	if (m_scene_bvh_needs_rebuild)
+	{
+		m_scene_items.clear();
+		for (uint32_t prim_idx = 0; prim_idx < (uint32_t)m_primitives.size(); prim_idx++)
+		{
+			const GPUPrimitive& primitive = m_primitives[prim_idx];
+			if (glm::any(glm::greaterThan(glm::vec3(primitive.bbox_min_os), glm::vec3(primitive.bbox_max_os))))
+			{
+				continue;
+			}
+
+			for (uint32_t instance_idx = 0; instance_idx < m_mesh_draw_data[primitive.mesh_idx].instance_count; instance_idx++)
+			{
+				m_scene_items.push_back({ prim_idx, instance_idx });
+			}
+		}
+	}
+
+	if (m_scene_bvh_needs_rebuild || m_scene_bvh_needs_refit)
+	{
+		std::vector<aabb> boxes(m_scene_items.size());
+		job_system::get_instance().parallel_for(boxes.size(), [&](size_t i)
+		{
+			boxes[i] = get_instance_bounds(m_scene_items[i].primitive_idx, m_scene_items[i].instance_idx);
+		}, 256);
+
+		if (m_scene_bvh_needs_rebuild)
+		{
+			m_scene_bvh.build(boxes);
+		}
+		else
+		{
+			m_scene_bvh.refit(boxes);
+		}
+
+		m_scene_bvh_needs_rebuild = false;
+		m_scene_bvh_needs_refit = false;
+	}
+
+	return m_scene_bvh;
 }
 
 void ObjectManager::init()
 {
 	create_materials_ssbo();
+	create_primitives_ssbo();
 
 	/*
 		Mesh descriptor set layout
@@ -149,14 +346,14 @@ void ObjectManager::create_instance_buffer()
 {
 	size_t num_meshes = m_mesh_instance_data.size();
 	
-	std::string buf_name = "InstanceData for Mesh #" + std::to_string(std::max(0ull, m_meshes.size() - 1));
+	std::string buf_name = "InstanceData for Mesh #" + std::to_string(m_meshes.empty() ? 0 : m_meshes.size() - 1);
 
 	m_mesh_instance_data.resize(max_instance_count);
 
 	size_t buf_size_bytes = max_instance_count * sizeof(GPUInstanceData);
 
 	vk::buffer instance_ssbo;
-	instance_ssbo.init(vk::buffer::type::STORAGE, buf_size_bytes, buf_name.c_str());
+	instance_ssbo.init(vk::buffer::type::DYNAMIC, buf_size_bytes, buf_name.c_str());
 	instance_ssbo.create();
 	m_mesh_instance_data_ssbo.push_back(instance_ssbo);
 }
@@ -173,40 +370,89 @@ void ObjectManager::create_materials_ssbo()
 	add_material(s_default_material, "Default Material");
 }
 
-void ObjectManager::create_textures_descriptor_set()
+void ObjectManager::create_primitives_ssbo()
 {
-	texture_descriptor_array_binding = 0;
-	m_bindless_layout.add_combined_image_sampler_binding(texture_descriptor_array_binding, VK_SHADER_STAGE_FRAGMENT_BIT, max_bindless_textures, "Bindless Textures");
+	m_primitives_ssbo.init(vk::buffer::type::STORAGE, max_primitive_count * sizeof(GPUPrimitive), "Primitives");
+	m_primitives_ssbo.create();
 
-	VkDescriptorSetLayoutBindingFlagsCreateInfo bindings_flags_info = {};
-	m_bindless_layout.binding_flags.push_back(VK_DESCRIPTOR_BINDING_PARTIALLY_BOUND_BIT_EXT);
+	m_meshlets_ssbo.init(vk::buffer::type::STORAGE, max_meshlet_count * sizeof(GPUMeshlet), "Meshlets");
+	m_meshlets_ssbo.create();
 
-	m_bindless_layout.create("Bindless Textures Descriptor Layout");
+	m_lods_ssbo.init(vk::buffer::type::STORAGE, max_lod_count * sizeof(GPUPrimitiveLod), "Primitive LODs");
+	m_lods_ssbo.create();
 
-	m_descriptor_set_bindless_textures.assign_layout(m_bindless_layout);
-	m_descriptor_set_bindless_textures.create("Bindless Textures Descriptor Set");
+	/* Instance counts change at runtime */
+	for (uint32_t i = 0; i < NUM_FRAMES; i++)
+	{
+		m_mesh_draw_data_ssbo[i].init(vk::buffer::type::DYNAMIC, max_mesh_count * sizeof(GPUMeshDrawData), "Mesh Draw Data");
+		m_mesh_draw_data_ssbo[i].create();
+	}
+}
 
+void ObjectManager::update_mesh_draw_ranges()
+{
+	uint32_t first_draw = 0;
+	for (GPUMeshDrawData& draw_data : m_mesh_draw_data)
+	{
+		/*
+			One draw per visible instance of each primitive and meshlet at most, or one per primitive and meshlet covering
+			all instances when there is no room. Primitives split into meshlets keep their slots : cluster culling can be toggled.
+		*/
+		uint32_t num_drawables = draw_data.num_primitives + draw_data.num_meshlets;
+		uint32_t capacity = num_drawables * std::max(draw_data.instance_count, 1u);
+		if (first_draw + capacity > max_draw_command_count)
+		{
+			capacity = num_drawables;
+		}
+
+		if (first_draw + capacity > max_draw_command_count)
+		{
+			LOG_ERROR("Draw command buffer is full ({} commands), some meshes are not drawn.", max_draw_command_count);
+			capacity = 0;
+		}
+
+		draw_data.first_draw = first_draw;
+		draw_data.draw_capacity = capacity;
+		first_draw += capacity;
+	}
+
+	m_mesh_draw_data_dirty.fill(true);
+	m_instances_revision++;
+	m_scene_bvh_needs_rebuild = true;
 }
 
-void ObjectManager::draw_mesh_list(VkCommandBuffer cmd_buffer, std::span<size_t> mesh_list, VkPipelineLayout pipeline_layout, std::span<VkDescriptorSet> additional_bound_descriptor_sets, DrawMetricsEntry& renderer_draw_metrics)
+void ObjectManager::update_mesh_draw_data(uint32_t frame_idx)
 {
-	for (size_t mesh_idx : mesh_list)
+	if (!m_mesh_draw_data_dirty[frame_idx])
 	{
-		/* Mesh descriptor set must always be the first */
-		vkCmdBindDescriptorSets(cmd_buffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipeline_layout, 0, 1, m_descriptor_sets[mesh_idx], 0, nullptr);
+		return;
+	}
 
-		const VulkanMesh& mesh = m_meshes[mesh_idx];
+	m_mesh_draw_data_ssbo[frame_idx].upload(ctx.device, m_mesh_draw_data.data(), 0, m_mesh_draw_data.size() * sizeof(GPUMeshDrawData));
+	m_mesh_draw_data_dirty[frame_idx] = false;
+}
 
-		uint32_t instance_count = (uint32_t)m_mesh_instance_data[mesh_idx].size();
-		renderer_draw_metrics.increment_instance_count(instance_count);
+void ObjectManager::create_textures_descriptor_set()
+{
+	texture_descriptor_array_binding = 0;
+	m_bindless_layout.add_combined_image_sampler_binding(texture_descriptor_array_binding, VK_SHADER_STAGE_FRAGMENT_BIT, max_bindless_textures, "Bindless Textures");
+	m_bindless_layout.add_storage_buffer_binding(texture_feedback_binding, VK_SHADER_STAGE_FRAGMENT_BIT, "Texture Mip Feedback");
 
-		for (int prim_idx = 0; prim_idx < mesh.geometry_data.primitives.size(); prim_idx++)
-		{
-			const Primitive& p = mesh.geometry_data.primitives[prim_idx];
-			vkCmdPushConstants(cmd_buffer, pipeline_layout, VK_SHADER_STAGE_VERTEX_BIT, 0, sizeof(glm::mat4), &p.model);
-			vkCmdDraw(cmd_buffer, p.vertex_count, instance_count, p.first_vertex, 0);
-			renderer_draw_metrics.increment_drawcall_count(1);
-			renderer_draw_metrics.increment_vertex_count(p.vertex_count * instance_count);
-		}
+	m_bindless_layout.binding_flags.push_back(VK_DESCRIPTOR_BINDING_PARTIALLY_BOUND_BIT_EXT);
+	m_bindless_layout.binding_flags.push_back(0);
+
+	m_bindless_layout.create("Bindless Textures Descriptor Layout");
+
+	for (uint32_t i = 0; i < NUM_FRAMES; i++)
+	{
+		m_texture_feedback_ssbo[i].init(vk::buffer::type::READBACK, max_bindless_textures * sizeof(uint32_t), "Texture Mip Feedback");
+		m_texture_feedback_ssbo[i].create();
+		memset(m_texture_feedback_ssbo[i].map(ctx.device, 0, max_bindless_textures * sizeof(uint32_t)), 0, max_bindless_textures * sizeof(uint32_t));
+		m_texture_feedback_ssbo[i].unmap(ctx.device);
+
+		m_descriptor_set_bindless_textures[i].assign_layout(m_bindless_layout);
+		m_descriptor_set_bindless_textures[i].create("Bindless Textures Descriptor Set");
+		m_descriptor_set_bindless_textures[i].write_descriptor_storage_buffer(texture_feedback_binding, m_texture_feedback_ssbo[i], 0, VK_WHOLE_SIZE);
 	}
-}
\ No newline at end of file
+
+}
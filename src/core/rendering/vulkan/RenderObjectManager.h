@@ -13,6 +13,7 @@
 #include "glm/gtx/euler_angles.hpp"
 #include "glm/ext/matrix_transform.hpp"
 #include "core/rendering/draw_metrics.h"
+#include "core/rendering/bvh.h"
 
 struct VulkanMesh;
 
@@ -45,11 +46,18 @@ public:
 
 	int add_texture(const Texture2D& texture);
 
+	/* Replaces the image behind a texture id. The caller owns the previous image and destroys it once no frame uses it. */
+	void set_texture(int texture_id, const Texture2D& texture);
+
+	/* Writes the texture descriptors added or replaced since the last update of this frame's set. The frame must not be in flight. */
+	void update_texture_descriptors(uint32_t frame_idx);
+
 	/* Returns -1 if texture is not found */
 	int get_texture_id(std::string_view name);
 	std::vector<Texture2D> m_textures;
 	std::vector<VkDescriptorImageInfo> m_texture_descriptors;
 	std::unordered_map<std::string, int> m_texture_id_from_name;
+	std::array<std::vector<int>, NUM_FRAMES> m_dirty_texture_ids;
 
 	/* Shader side instance data */
 	struct GPUInstanceData
@@ -76,24 +84,129 @@ public:
 			0: SSBO for Mesh Vertex Data
 			1: SSBO for Mesh Index Data
 			2: SSBO for Mesh Instance Data
-			3: UBO for Mesh Material Data
+			3: SSBO for all Materials, indexed by material id
 	*/
 	std::vector<vk::descriptor_set> m_descriptor_sets;
 
-	/* Descriptor set holding array of texture descriptors */
+	/* 
+		Descriptor set holding array of texture descriptors, one per frame in flight so that descriptors can be
+		replaced while the previous frame still samples the old image
+		Binding 1 is the mip feedback buffer of the frame : for each texture id, the largest texel size the
+		geometry pass needs. Read back by the texture streamer.
+	*/
 	uint32_t texture_descriptor_array_binding = 0;
-	vk::descriptor_set m_descriptor_set_bindless_textures;
+	uint32_t texture_feedback_binding = 1;
+	std::array<vk::descriptor_set, NUM_FRAMES> m_descriptor_set_bindless_textures;
 	vk::descriptor_set_layout m_bindless_layout; 
+	std::array<vk::buffer, NUM_FRAMES> m_texture_feedback_ssbo;
 	
 	/* Each element corresponds to an array of all the instances data for a mesh */
 	std::vector<std::vector<GPUInstanceData>> m_mesh_instance_data;
 
+	/* Shader side primitive data, primitives of all meshes are stored contiguously mesh after mesh */
+	struct GPUPrimitive
+	{
+		glm::mat4 model;
+		uint32_t mesh_idx;
+		uint32_t material_id;
+		uint32_t first_vertex;
+		uint32_t vertex_count;
+		glm::vec4 bbox_min_os;
+		glm::vec4 bbox_max_os;
+		int32_t base_vertex;
+		uint32_t first_meshlet;		/* In m_meshlets */
+		uint32_t meshlet_count;		/* 0 : culled as a whole */
+		uint32_t first_lod;			/* In m_lods */
+		uint32_t lod_count;			/* 0 : always drawn at full detail */
+		uint32_t pad[3];
+	};
+
+	/* Shader side LOD data, see PrimitiveLod. first_index is in the index buffer of the mesh. */
+	struct GPUPrimitiveLod
+	{
+		uint32_t first_index;
+		uint32_t index_count;
+		float error;
+		uint32_t pad;
+	};
+
+	/* Shader side meshlet data, see Meshlet. first_index is in the index buffer of the mesh. */
+	struct GPUMeshlet
+	{
+		glm::vec4 bounding_sphere;
+		glm::vec4 cone;
+		uint32_t primitive_idx;
+		uint32_t first_index;
+		uint32_t index_count;
+		uint32_t pad;
+	};
+
+	/* 
+		Shader side per mesh data : range of the mesh in the primitive, meshlet and draw command buffers.
+		Visible instances of a primitive or meshlet may be split into several draws, draw_capacity is the number of
+		commands reserved for the mesh.
+	*/
+	struct GPUMeshDrawData
+	{
+		uint32_t first_primitive;
+		uint32_t num_primitives;
+		uint32_t instance_count;
+		uint32_t first_draw;
+		uint32_t draw_capacity;
+		uint32_t first_meshlet;
+		uint32_t num_meshlets;
+		uint32_t pad;
+	};
+
+	std::vector<GPUPrimitive> m_primitives;
+	std::vector<GPUMeshlet> m_meshlets;
+	std::vector<GPUPrimitiveLod> m_lods;
+	std::vector<GPUMeshDrawData> m_mesh_draw_data;
+
+	/* Incremented when primitives, instance counts or instance transforms change, for CPU side caches of the scene */
+	uint32_t m_instances_revision = 0;
+
+	/* Primitive instance referenced by an item of the scene BVH */
+	struct SceneItem
+	{
+		uint32_t primitive_idx;
+		uint32_t instance_idx;
+	};
+
+	/*
+		BVH over the world space boxes of the primitive instances, item i being m_scene_items[i]. Primitives without
+		bounds are left out. Rebuilt when primitives or instances were added, refit when transforms changed.
+	*/
+	const bvh& get_scene_bvh();
+	std::vector<SceneItem> m_scene_items;
+
+	/* World space box of a primitive instance, empty when the primitive has no bounds */
+	aabb get_instance_bounds(uint32_t primitive_idx, uint32_t instance_idx) const;
+
+	/* Sets the model matrix of a primitive of a mesh (e.g. edited with the gizmo) on the GPU, the scene BVH is refit */
+	void set_primitive_transform(size_t mesh_idx, size_t primitive_idx, const glm::mat4& model);
+
+	vk::buffer m_primitives_ssbo;
+	vk::buffer m_meshlets_ssbo;
+	vk::buffer m_lods_ssbo;
+
+	/* One per frame in flight : instance counts change at runtime while previous frames still generate their draws */
+	std::array<vk::buffer, NUM_FRAMES> m_mesh_draw_data_ssbo;
+	std::array<bool, NUM_FRAMES> m_mesh_draw_data_dirty = {};
+
+	/* Writes the mesh draw data to this frame's buffer if it changed since its last update. The frame must not be in flight. */
+	void update_mesh_draw_data(uint32_t frame_idx);
+
 
 	/* Total pre-allocated number of resource */
 	uint32_t max_instance_count = 32768;
 	uint32_t max_mesh_count = 4096;
 	uint32_t max_material_count  = 4096;
 	uint32_t max_bindless_textures  = 4096;
+	uint32_t max_primitive_count = 65536;
+	uint32_t max_meshlet_count = 262144;
+	uint32_t max_lod_count = 262144;
+	uint32_t max_draw_command_count = 131072;
 	uint32_t default_material_id	 = 0;
 
 	/* Store for mesh at index i an SSBO containing the shader data for all instances of the mesh */
@@ -104,8 +217,6 @@ public:
 	// WIP
 	size_t current_selected_mesh_id = 0;
 
-	void draw_mesh_list(VkCommandBuffer cmd_buffer, std::span<size_t> mesh_list, VkPipelineLayout pipeline_layout, std::span<VkDescriptorSet> additional_bound_descriptor_sets, DrawMetricsEntry& renderer_draw_metrics);
-
 public:
 	void init();
 
@@ -128,8 +239,18 @@ protected:
 	/* Creates the SSBO storing all materials */
 	void create_materials_ssbo();
 
+	/* Creates the SSBOs storing all primitives, meshlets, LODs and the per mesh draw data */
+	void create_primitives_ssbo();
+
+	/* Lays out the draw command ranges of all meshes after an instance count changed, see update_mesh_draw_data() */
+	void update_mesh_draw_ranges();
+
 	/* Creates the SSBO storing all texture descriptors */
 	void create_textures_descriptor_set();
+
+	bvh m_scene_bvh;
+	bool m_scene_bvh_needs_rebuild = true;
+	bool m_scene_bvh_needs_refit = false;
 private:
 	ObjectManager() = default;
 };
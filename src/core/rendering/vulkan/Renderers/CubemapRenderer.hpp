@@ -54,6 +54,8 @@ struct CubemapRenderer
 
 	void render()
 	{
+		OPTICK_EVENT();
+
 		VkCommandBuffer cmd_buffer = begin_temp_cmd_buffer();
 		set_viewport_scissor(cmd_buffer, cubemap_attachment.info.width, cubemap_attachment.info.height);
 
@@ -68,11 +70,7 @@ struct CubemapRenderer
 		cubemap_attachment.transition(cmd_buffer, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL, VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT);
 		renderpass.begin(cmd_buffer, { cubemap_attachment.info.width, cubemap_attachment.info.height }, multiview_mask);
 		const ObjectManager& object_manager = ObjectManager::get_instance();
-		for (int prim_idx = 0; prim_idx < object_manager.m_meshes[mesh_skybox_id].geometry_data.primitives.size(); prim_idx++)
-		{
-			const Primitive& p = object_manager.m_meshes[mesh_skybox_id].geometry_data.primitives[prim_idx];
-			vkCmdDraw(cmd_buffer, p.vertex_count, 1, p.first_vertex, 0);
-		}
+		object_manager.m_meshes[mesh_skybox_id].draw(cmd_buffer);
 		renderpass.end(cmd_buffer);
 		cubemap_attachment.transition(cmd_buffer, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, VK_ACCESS_SHADER_READ_BIT);
 		end_temp_cmd_buffer(cmd_buffer);
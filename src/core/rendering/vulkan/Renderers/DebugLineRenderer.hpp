@@ -16,16 +16,10 @@ struct DebugLineRenderer : public IRenderer
 		vertex_buffer.init(vk::buffer::type::STORAGE, vtx_buffer_max_size, "DebugLineRenderer Vertex Buffer");
 		vertex_buffer.create();
 
-		vk::buffer staging;
-		staging.init(vk::buffer::type::STAGING, sizeof(VkDrawIndirectCommand), "");
-		staging.create();
-
 		VkDrawIndirectCommand init_indirect_cmd{0, 1, 0, 0};
-		staging.upload(ctx.device, &init_indirect_cmd, 0, sizeof(VkDrawIndirectCommand));
-
 		indirect_cmd_buffer.init(vk::buffer::type::INDIRECT, sizeof(VkDrawIndirectCommand), "DebugLineRenderer Indirect Command"); /* Device local */
 		indirect_cmd_buffer.create();
-		copy_from_buffer(staging, indirect_cmd_buffer, sizeof(VkDrawIndirectCommand));
+		indirect_cmd_buffer.upload(ctx.device, &init_indirect_cmd, 0, sizeof(VkDrawIndirectCommand));
 
 		debug_line_descriptor_set.layout.add_storage_buffer_binding(0, VK_SHADER_STAGE_COMPUTE_BIT | VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT, "DebugLineRenderer Vertex Buffer Binding");
 		debug_line_descriptor_set.layout.add_storage_buffer_binding(1, VK_SHADER_STAGE_COMPUTE_BIT | VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT, "DebugLineRenderer Indirect Command Binding");
@@ -71,6 +65,8 @@ struct DebugLineRenderer : public IRenderer
 
 	void render(VkCommandBuffer cmd_buffer) override
 	{
+		OPTICK_EVENT();
+
 		/* Dispatch compute shader populating vertex buffer */
 		if (!vtx_buffer_populated)
 		{
@@ -3,6 +3,7 @@
 #include "DeferredRenderer.hpp"
 
 #include "core/rendering/vulkan/Renderers/VolumetricLightRenderer.hpp"
+#include "core/rendering/vulkan/shader_compiler.h"
 
 int DeferredRenderer::render_size = 2048;
 float DeferredRenderer::inv_render_size = 1.0f / render_size;
@@ -27,7 +28,7 @@ void DeferredRenderer::GBuffer::init()
 		gbuffer.normal_attachment[i].create(ctx.device, VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_SAMPLED_BIT);
 		gbuffer.metalness_roughness_attachment[i].create(ctx.device, VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_SAMPLED_BIT);
 		gbuffer.depth_attachment[i].create(ctx.device, VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT | VK_IMAGE_USAGE_SAMPLED_BIT);
-		gbuffer.light_accumulation_attachment[i].create(ctx.device, VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_SAMPLED_BIT);
+		gbuffer.light_accumulation_attachment[i].create(ctx.device, VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT);	// Blitted to the target of headless runs
 
 		/* Create final attachment compositing all geometry information */
 		gbuffer.final_lighting[i].init(VulkanRendererCommon::get_instance().swapchain_color_format, render_size, render_size, 1, 0, "[Deferred Renderer] Composite Color Attachment");
@@ -52,7 +53,8 @@ void DeferredRenderer::UITextureIDs::init()
 void DeferredRenderer::init()
 {
 	name = "Deferred Renderer";
-	draw_metrics = DrawMetricsManager::add_entry(name.c_str());
+	geometry_pass.draw_metrics = DrawMetricsManager::add_entry("Deferred Geometry Pass");
+	lighting_pass.draw_metrics = DrawMetricsManager::add_entry("Deferred Lighting Pass");
 	GBuffer::init();
 	UITextureIDs::init();
 	create_renderpass();
@@ -72,12 +74,12 @@ void DeferredRenderer::GeometryPass::create_pipeline()
 	VkDescriptorSetLayout descriptor_set_layouts[] =
 	{
 		VulkanRendererCommon::get_instance().m_framedata_desc_set_layout,
-		ObjectManager::get_instance().m_descriptor_set_bindless_textures.layout.vk_set_layout,
+		ObjectManager::get_instance().m_bindless_layout.vk_set_layout,
 		ObjectManager::get_instance().mesh_descriptor_set_layout,
+		DrawCommandGenerator::descriptor_set_layout,
 	};
 
-	pipeline.layout.add_push_constant_range("Primitive Model Matrix", { .stageFlags = VK_SHADER_STAGE_VERTEX_BIT, .offset = 0, .size = sizeof(glm::mat4) });
-	pipeline.layout.add_push_constant_range("Material", { .stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT, .offset = sizeof(glm::mat4), .size = sizeof(Material) });
+	pipeline.layout.add_push_constant_range("Mesh Draw", { .stageFlags = VK_SHADER_STAGE_VERTEX_BIT, .offset = 0, .size = sizeof(DrawCommandGenerator::mesh_draw_constants) });
 
 	pipeline.layout.create(descriptor_set_layouts);
 	shader.create("Deferred Shading - Geometry Pass", "instanced_mesh_vert.vert.spv", "deferred_geometry_pass_frag.frag.spv");
@@ -96,6 +98,13 @@ void DeferredRenderer::GeometryPass::create_renderpass()
 		renderpass[i].add_color_attachment(gbuffer.metalness_roughness_attachment[i].view, VK_ATTACHMENT_LOAD_OP_CLEAR);
 		renderpass[i].add_color_attachment(gbuffer.light_accumulation_attachment[i].view, VK_ATTACHMENT_LOAD_OP_CLEAR);	// Render emissive materials to it
 		renderpass[i].add_depth_attachment(gbuffer.depth_attachment[i].view, VK_ATTACHMENT_LOAD_OP_CLEAR);
+
+		renderpass_late[i].reset();
+		renderpass_late[i].add_color_attachment(gbuffer.base_color_attachment[i].view, VK_ATTACHMENT_LOAD_OP_LOAD);
+		renderpass_late[i].add_color_attachment(gbuffer.normal_attachment[i].view, VK_ATTACHMENT_LOAD_OP_LOAD);
+		renderpass_late[i].add_color_attachment(gbuffer.metalness_roughness_attachment[i].view, VK_ATTACHMENT_LOAD_OP_LOAD);
+		renderpass_late[i].add_color_attachment(gbuffer.light_accumulation_attachment[i].view, VK_ATTACHMENT_LOAD_OP_LOAD);
+		renderpass_late[i].add_depth_attachment(gbuffer.depth_attachment[i].view, VK_ATTACHMENT_LOAD_OP_LOAD);
 	}
 }
 void DeferredRenderer::LightingPass::create_pipeline()
@@ -230,20 +239,7 @@ void DeferredRenderer::show_ui(camera camera)
 
 	if (ImGui::Begin("Deferred Renderer Toolbar"))
 	{
-		static bool reload_success = true;
-		if (ImGui::Button("Reload Shaders"))
-		{
-			reload_success = reload_pipeline();
-		}
-
-		if (reload_success)
-		{
-			ImGui::TextColored(ImVec4(0, 1, 0, 1), "Pipeline reload success");
-		}
-		else
-		{
-			ImGui::TextColored(ImVec4(1, 0, 0, 1), "Pipeline reload fail.");
-		}
+		shader_compiler::get_instance().show_ui();
 	}
 
 	cubemap_renderer.show_ui();
@@ -258,50 +254,25 @@ void DeferredRenderer::show_ui()
 
 bool DeferredRenderer::reload_pipeline()
 {
-	vkDeviceWaitIdle(ctx.device);
-
-	if (geometry_pass.shader.compile())
-	{
-		geometry_pass.pipeline.reload_pipeline();
-	}
-	else
-	{
-		return false;
-	}
-
-	if (lighting_pass.shader.compile())
-	{
-		lighting_pass.pipeline.reload_pipeline();
-	}
-	else
-	{
-		return false;
-	}
-
-
-	if (cubemap_renderer.write_cubemap_shader.compile())
-	{
-		cubemap_renderer.pipeline.reload_pipeline();
-		cubemap_renderer.render();
-	}
-	else
-	{
-		return false;
-	}
-
+	/* Compiled in the background, swapped in at the start of a later frame */
+	shader_compiler::get_instance().request_reload_all();
 	return true;
 }
 
-void DeferredRenderer::GeometryPass::render(VkCommandBuffer cmd_buffer, std::span<size_t> mesh_list)
+void DeferredRenderer::GeometryPass::render(VkCommandBuffer cmd_buffer, std::span<size_t> mesh_list, DrawCommandGenerator::view draw_view)
 {
-	VULKAN_RENDER_DEBUG_MARKER(cmd_buffer, "Deferred Geometry Pass");
+	const bool is_late = draw_view == DrawCommandGenerator::view_camera_late;
+	VULKAN_RENDER_DEBUG_MARKER(cmd_buffer, is_late ? "Deferred Geometry Pass (Late)" : "Deferred Geometry Pass");
 
-	set_viewport_scissor(cmd_buffer, render_size, render_size, true);
-
-	vkCmdBindPipeline(cmd_buffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipeline);
+	ObjectManager& object_manager = ObjectManager::get_instance();
 
-	vkCmdBindDescriptorSets(cmd_buffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipeline.layout, 0, 1, &VulkanRendererCommon::get_instance().m_framedata_desc_set[ctx.curr_frame_idx].vk_set, 0, nullptr);
-	vkCmdBindDescriptorSets(cmd_buffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipeline.layout, 1, 1, &ObjectManager::get_instance().m_descriptor_set_bindless_textures.vk_set, 0, nullptr);
+	/* Depth was last read by the Hi-Z pyramid build */
+	if (is_late)
+	{
+		gbuffer.depth_attachment[ctx.curr_frame_idx].barrier(cmd_buffer, VK_IMAGE_LAYOUT_DEPTH_ATTACHMENT_OPTIMAL,
+			VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT, VK_ACCESS_2_NONE,
+			VK_PIPELINE_STAGE_2_EARLY_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_2_LATE_FRAGMENT_TESTS_BIT, VK_ACCESS_2_DEPTH_STENCIL_ATTACHMENT_READ_BIT | VK_ACCESS_2_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT);
+	}
 
 	/* TODO : batch transitions ? */
 	gbuffer.base_color_attachment[ctx.curr_frame_idx].transition(cmd_buffer, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL, VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT);
@@ -311,29 +282,28 @@ void DeferredRenderer::GeometryPass::render(VkCommandBuffer cmd_buffer, std::spa
 	gbuffer.light_accumulation_attachment[ctx.curr_frame_idx].transition(cmd_buffer, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL, VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT);
 
 
-	renderpass[ctx.curr_frame_idx].begin(cmd_buffer, { render_size, render_size });
-	ObjectManager& object_manager = ObjectManager::get_instance();
+	vk::renderpass_dynamic& pass = is_late ? renderpass_late[ctx.curr_frame_idx] : renderpass[ctx.curr_frame_idx];
+	pass.begin(cmd_buffer, { render_size, render_size }, 0, ctx.recorder.get_rendering_flags());
 
-	for (size_t mesh_idx : mesh_list)
+	vk::secondary_rendering_info rendering_info = { .color_formats = pipeline.color_attachment_formats, .depth_format = pipeline.depth_attachment_format };
+	ctx.recorder.record(cmd_buffer, ctx.curr_frame_idx, rendering_info, mesh_list.size(), k_min_draws_per_chunk, [&](VkCommandBuffer chunk_cmd_buffer, size_t begin, size_t end)
 	{
-		/* Mesh descriptor set */
-		vkCmdBindDescriptorSets(cmd_buffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipeline.layout, 2, 1, &object_manager.m_descriptor_sets[mesh_idx].vk_set, 0, nullptr);
+		set_viewport_scissor(chunk_cmd_buffer, render_size, render_size, true);
 
-		const VulkanMesh& mesh = object_manager.m_meshes[mesh_idx];
+		vkCmdBindPipeline(chunk_cmd_buffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipeline);
 
-		uint32_t instance_count = (uint32_t)object_manager.m_mesh_instance_data[mesh_idx].size();
+		vkCmdBindDescriptorSets(chunk_cmd_buffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipeline.layout, 0, 1, &VulkanRendererCommon::get_instance().m_framedata_desc_set[ctx.curr_frame_idx].vk_set, 0, nullptr);
+		vkCmdBindDescriptorSets(chunk_cmd_buffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipeline.layout, 1, 1, &object_manager.m_descriptor_set_bindless_textures[ctx.curr_frame_idx].vk_set, 0, nullptr);
+		vkCmdBindDescriptorSets(chunk_cmd_buffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipeline.layout, 3, 1, &DrawCommandGenerator::descriptor_set[ctx.curr_frame_idx].vk_set, 0, nullptr);
 
-		for (int prim_idx = 0; prim_idx < mesh.geometry_data.primitives.size(); prim_idx++)
+		for (size_t mesh_idx : mesh_list.subspan(begin, end - begin))
 		{
-			const Primitive& p = mesh.geometry_data.primitives[prim_idx];
-
-			pipeline.cmd_push_constants(cmd_buffer, "Material", &object_manager.m_materials[p.material_id]);
-			pipeline.cmd_push_constants(cmd_buffer, "Primitive Model Matrix", &p.model);
-
-			vkCmdDraw(cmd_buffer, p.vertex_count, instance_count, p.first_vertex, 0);
+			/* Mesh descriptor set */
+			vkCmdBindDescriptorSets(chunk_cmd_buffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipeline.layout, 2, 1, &object_manager.m_descriptor_sets[mesh_idx].vk_set, 0, nullptr);
+			DrawCommandGenerator::draw_mesh(chunk_cmd_buffer, draw_view, mesh_idx, pipeline, draw_metrics);
 		}
-	}
-	renderpass[ctx.curr_frame_idx].end(cmd_buffer);
+	});
+	pass.end(cmd_buffer);
 
 	/* TODO : batch transitions ? */
 	gbuffer.base_color_attachment[ctx.curr_frame_idx].transition(cmd_buffer, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, VK_ACCESS_COLOR_ATTACHMENT_READ_BIT);
@@ -379,7 +349,7 @@ void DeferredRenderer::LightingPass::render(VkCommandBuffer cmd_buffer)
 		pipeline.cmd_push_constants(cmd_buffer, "Light Volume Pass View Proj", &identity);
 		pipeline.cmd_push_constants(cmd_buffer, "Light Volume Pass Additional Data", &light_volume_additional_data);
 
-		vkCmdDraw(cmd_buffer, (uint32_t)mesh_fs_quad.m_num_vertices, 1, 0, 0);
+		mesh_fs_quad.draw(cmd_buffer);
 	}
 
 	// Draw point light volumes
@@ -392,7 +362,7 @@ void DeferredRenderer::LightingPass::render(VkCommandBuffer cmd_buffer)
 		uint32_t instance_count = (uint32_t)object_manager.m_mesh_instance_data[light_manager::point_light_volume_mesh_id].size();
 		pipeline.cmd_push_constants(cmd_buffer, "Light Volume Pass View Proj", &view_proj);
 		pipeline.cmd_push_constants(cmd_buffer, "Light Volume Pass Additional Data", &light_volume_additional_data);
-		vkCmdDraw(cmd_buffer, (uint32_t)mesh_sphere.m_num_vertices, instance_count, 0, 0);
+		mesh_sphere.draw(cmd_buffer, instance_count);
 	}
 	renderpass[ctx.curr_frame_idx].end(cmd_buffer);
 
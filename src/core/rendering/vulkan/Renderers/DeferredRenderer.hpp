@@ -5,6 +5,7 @@
 #include "core/rendering/vulkan/VulkanUI.h"
 #include "core/rendering/vulkan/Renderers/IBLPrefiltering.hpp"
 #include "core/rendering/vulkan/Renderers/ShadowRenderer.hpp"
+#include "core/rendering/vulkan/Renderers/DrawCommandGenerator.hpp"
 
 #include "core/rendering/lighting.h"
 
@@ -43,11 +44,20 @@ struct DeferredRenderer : public IRenderer
 	{
 		void create_pipeline();
 		void create_renderpass();
-		void render(VkCommandBuffer cmd_buffer, std::span<size_t> mesh_list);
+		/* 
+			Draws a camera list of the draw command generator. view_camera clears the G-Buffers, view_camera_late
+			draws on top of it once the occlusion pass has run.
+		*/
+		void render(VkCommandBuffer cmd_buffer, std::span<size_t> mesh_list, DrawCommandGenerator::view draw_view = DrawCommandGenerator::view_camera);
+
+		/* One indirect draw per mesh */
+		static constexpr size_t k_min_draws_per_chunk = 64;
 
 		Pipeline pipeline;
 		vk::renderpass_dynamic renderpass[NUM_FRAMES];
+		vk::renderpass_dynamic renderpass_late[NUM_FRAMES];	/* Loads the attachments of the early draws */
 		VertexFragmentShader shader;
+		DrawMetricsEntry draw_metrics;
 	} geometry_pass;
 
 	/* Compositing render pass using G-Buffers to compute lighting and render to fullscreen quad */
@@ -62,6 +72,7 @@ struct DeferredRenderer : public IRenderer
 		VertexFragmentShader shader;
 		vk::descriptor_set sampled_images_descriptor_set[NUM_FRAMES];
 		vk::descriptor_set_layout sampled_images_descriptor_set_layout;
+		DrawMetricsEntry draw_metrics;
 
 		const int light_volume_type_directional = 1;
 		const int light_volume_type_point = 2;
@@ -95,6 +106,4 @@ struct DeferredRenderer : public IRenderer
 
 	VkDescriptorPool descriptor_pool;
 	vk::descriptor_set descriptor_set;
-
-	DrawMetricsEntry draw_metrics;
 };
\ No newline at end of file
@@ -0,0 +1,848 @@
+#pragma once
+
+#include "IRenderer.h"
+#include "core/rendering/vulkan/VulkanMesh.h"
+#include "core/rendering/frustum_culling.h"
+#include "core/engine/job_system.h"
+
+/*
+	Culls all primitive instances against the camera frustum and the shadow cascade frustums, and writes the
+	indirect draw commands of the visible ones on the GPU, one command list per view.
+	With cluster culling, primitives split into meshlets are culled and drawn meshlet by meshlet instead, the camera
+	views also culling the meshlets facing away from it. A meshlet draw is an index range of its primitive.
+	Commands of a mesh are packed from its first_draw index in the list of the view, the number of commands written
+	goes to draw_counts. A mesh is then drawn with a single vkCmdDrawIndexedIndirectCount on its index buffer, the vertex
+	shader fetches the primitive of a draw from draw_commands[first_draw + gl_DrawID].
+	generate() must be recorded before any render pass drawing with it.
+
+	Camera occlusion culling is two-phase. generate() lists the instances visible last frame for the early geometry
+	pass. Once the Hi-Z pyramid is built from its depth, generate_late() tests every instance against it, lists the
+	newly visible ones for the late geometry pass and stores the visibility of each instance for the next frame.
+
+	Each view draws a primitive instance at the coarsest LOD whose error, projected in the view, stays under a number of
+	pixels : at the distance of the instance for the camera, in texels of the finest cascade it is in for the shadows
+	(orthographic). Shadows allow a larger error, see lod_error_pixels. Primitives split into meshlets are drawn by their
+	meshlets at full detail only, and by their own command at coarser LODs.
+
+	With use_cpu_culling, the same command lists are built on the CPU instead (frustum culling only) and copied to the
+	GPU buffers : see generate_cpu().
+*/
+struct DrawCommandGenerator : public IRenderer
+{
+	/* VkDrawIndexedIndirectCommand of a primitive or meshlet followed by the index of the primitive, see DrawCommand in data.glsl */
+	struct GPUDrawCommand
+	{
+		VkDrawIndexedIndirectCommand command;
+		uint32_t primitive_idx;
+	};
+
+	/* Command lists */
+	enum view : uint32_t
+	{
+		view_camera = 0,		/* In the frustum and visible last frame */
+		view_camera_late = 1,	/* Not occluded in the Hi-Z pyramid of the early draws and not visible last frame */
+		view_shadow = 2,		/* Visible in any cascade : the cascades are rendered at once with multiview */
+		view_count
+	};
+
+	enum culling_phase : uint32_t
+	{
+		phase_early = 0,	/* view_camera and view_shadow */
+		phase_late = 1,		/* view_camera_late */
+	};
+
+	static constexpr uint32_t k_max_cascades = 4;
+
+	/* Frustum planes (xyz : inward normal, w : distance), in the order left, right, bottom, top, far, near */
+	struct GPUCullingData
+	{
+		glm::mat4 camera_view_proj;
+		glm::vec4 camera_position;
+		glm::vec4 camera_planes[6];
+		glm::vec4 cascade_planes[k_max_cascades][6];
+		glm::vec4 cascade_lod_scale;		/* Texels per world unit of each cascade */
+		uint32_t num_cascades;
+		uint32_t max_draw_commands;
+		uint32_t max_meshes;
+		uint32_t enable_culling;
+		uint32_t enable_occlusion;
+		uint32_t hiz_width;
+		uint32_t hiz_height;
+		uint32_t hiz_mip_count;
+		uint32_t enable_lods;
+		float camera_lod_scale;				/* Pixels per world unit at a distance of 1 */
+		float camera_lod_threshold;			/* Projected error allowed, in pixels */
+		float shadow_lod_threshold;
+	};
+	static_assert(k_max_cascades == 4, "cascade_lod_scale holds one scale per cascade");
+
+	struct GPUGenerateParams
+	{
+		uint32_t num_primitives;
+		uint32_t phase;
+		uint32_t num_meshlets;		/* 0 without cluster culling */
+	};
+
+	/* 
+		Instances drawn in each list. Culled instances are the ones outside the frustum for view_camera and view_shadow,
+		and the ones in the frustum but occluded for view_camera_late. Meshlet instances are counted apart.
+		frustum_triangles is what per primitive frustum culling alone would draw, to compare with visible_vertices / 3.
+	*/
+	struct GPUCullingStats
+	{
+		uint32_t visible[view_count];
+		uint32_t culled[view_count];
+		uint32_t visible_vertices[view_count];
+		uint32_t frustum_triangles[view_count];
+		uint32_t visible_meshlets[view_count];
+		uint32_t culled_meshlets[view_count];
+	};
+
+	void init() override
+	{
+		name = "Draw Command Generator";
+		culling_metrics[view_camera] = DrawMetricsManager::add_entry("Frustum Culling (Camera)");
+		culling_metrics[view_camera_late] = DrawMetricsManager::add_entry("Occlusion Culling (Camera)");
+		culling_metrics[view_shadow] = DrawMetricsManager::add_entry("Frustum Culling (Shadow Cascades)");
+
+		create_resources();
+		create_pipeline();
+
+		is_initialized = true;
+	}
+
+	void create_resources()
+	{
+		const ObjectManager& object_manager = ObjectManager::get_instance();
+
+		for (int frame_idx = 0; frame_idx < NUM_FRAMES; frame_idx++)
+		{
+			draw_commands[frame_idx].init(vk::buffer::type::INDIRECT, view_count * object_manager.max_draw_command_count * sizeof(GPUDrawCommand), "Draw Command Generator: Draw Commands");
+			draw_commands[frame_idx].create();
+			draw_counts[frame_idx].init(vk::buffer::type::INDIRECT, view_count * object_manager.max_mesh_count * sizeof(uint32_t), "Draw Command Generator: Draw Counts");
+			draw_counts[frame_idx].create();
+			culling_data_ssbo[frame_idx].init(vk::buffer::type::DYNAMIC, sizeof(GPUCullingData), "Draw Command Generator: Culling Data");
+			culling_data_ssbo[frame_idx].create();
+			culling_stats_ssbo[frame_idx].init(vk::buffer::type::READBACK, sizeof(GPUCullingStats), "Draw Command Generator: Culling Stats");
+			culling_stats_ssbo[frame_idx].create();
+			memset(culling_stats_ssbo[frame_idx].map(ctx.device, 0, sizeof(GPUCullingStats)), 0, sizeof(GPUCullingStats));
+			culling_stats_ssbo[frame_idx].unmap(ctx.device);
+		}
+
+		/* Written by the CPU culling path, copied to draw_commands and draw_counts */
+		for (int frame_idx = 0; frame_idx < NUM_FRAMES; frame_idx++)
+		{
+			cpu_draw_commands[frame_idx].init(vk::buffer::type::STAGING, view_count * object_manager.max_draw_command_count * sizeof(GPUDrawCommand), "Draw Command Generator: CPU Draw Commands");
+			cpu_draw_commands[frame_idx].create();
+			cpu_draw_counts[frame_idx].init(vk::buffer::type::STAGING, view_count * object_manager.max_mesh_count * sizeof(uint32_t), "Draw Command Generator: CPU Draw Counts");
+			cpu_draw_counts[frame_idx].create();
+		}
+
+		/* Shared by the frames : written by the late phase of a frame, read by the early phase of the next one. Cleared on first use. */
+		instance_visibility.init(vk::buffer::type::INDIRECT, object_manager.max_draw_command_count * sizeof(uint32_t), "Draw Command Generator: Instance Visibility");
+		instance_visibility.create();
+	}
+
+	void create_pipeline() override
+	{
+		const ObjectManager& object_manager = ObjectManager::get_instance();
+
+		const VkShaderStageFlags stages = VK_SHADER_STAGE_COMPUTE_BIT | VK_SHADER_STAGE_VERTEX_BIT;
+		descriptor_set_layout.add_storage_buffer_binding(0, stages, "Draw Commands");
+		descriptor_set_layout.add_storage_buffer_binding(1, stages, "Draw Counts");
+		descriptor_set_layout.add_storage_buffer_binding(2, stages, "Primitives");
+		descriptor_set_layout.add_storage_buffer_binding(3, stages, "Mesh Draw Data");
+		descriptor_set_layout.add_storage_buffer_array_binding(4, VK_SHADER_STAGE_COMPUTE_BIT, object_manager.max_mesh_count, "Mesh Instances");
+		descriptor_set_layout.add_storage_buffer_binding(5, VK_SHADER_STAGE_COMPUTE_BIT, "Culling Data");
+		descriptor_set_layout.add_storage_buffer_binding(6, VK_SHADER_STAGE_COMPUTE_BIT, "Culling Stats");
+		descriptor_set_layout.add_storage_buffer_binding(7, VK_SHADER_STAGE_COMPUTE_BIT, "Instance Visibility");
+		descriptor_set_layout.add_combined_image_sampler_binding(8, VK_SHADER_STAGE_COMPUTE_BIT, 1, "Hi-Z Pyramid");
+		descriptor_set_layout.add_storage_buffer_binding(9, VK_SHADER_STAGE_COMPUTE_BIT, "Meshlets");
+		descriptor_set_layout.add_storage_buffer_binding(10, VK_SHADER_STAGE_COMPUTE_BIT, "Primitive LODs");
+
+		/* Instance buffers are written as meshes are added, the Hi-Z pyramid once created : see set_depth_pyramid() */
+		descriptor_set_layout.binding_flags = { 0, 0, 0, 0, VK_DESCRIPTOR_BINDING_PARTIALLY_BOUND_BIT_EXT, 0, 0, 0, VK_DESCRIPTOR_BINDING_PARTIALLY_BOUND_BIT_EXT, 0, 0 };
+		descriptor_set_layout.create("Draw Command Generator Descriptor Set Layout");
+
+		for (int frame_idx = 0; frame_idx < NUM_FRAMES; frame_idx++)
+		{
+			descriptor_set[frame_idx].assign_layout(descriptor_set_layout);
+			descriptor_set[frame_idx].create("Draw Command Generator Descriptor Set");
+			descriptor_set[frame_idx].write_descriptor_storage_buffer(0, draw_commands[frame_idx], 0, VK_WHOLE_SIZE);
+			descriptor_set[frame_idx].write_descriptor_storage_buffer(1, draw_counts[frame_idx], 0, VK_WHOLE_SIZE);
+			descriptor_set[frame_idx].write_descriptor_storage_buffer(2, object_manager.m_primitives_ssbo, 0, VK_WHOLE_SIZE);
+			descriptor_set[frame_idx].write_descriptor_storage_buffer(3, object_manager.m_mesh_draw_data_ssbo[frame_idx], 0, VK_WHOLE_SIZE);
+			descriptor_set[frame_idx].write_descriptor_storage_buffer(5, culling_data_ssbo[frame_idx], 0, VK_WHOLE_SIZE);
+			descriptor_set[frame_idx].write_descriptor_storage_buffer(6, culling_stats_ssbo[frame_idx], 0, VK_WHOLE_SIZE);
+			descriptor_set[frame_idx].write_descriptor_storage_buffer(7, instance_visibility, 0, VK_WHOLE_SIZE);
+			descriptor_set[frame_idx].write_descriptor_storage_buffer(9, object_manager.m_meshlets_ssbo, 0, VK_WHOLE_SIZE);
+			descriptor_set[frame_idx].write_descriptor_storage_buffer(10, object_manager.m_lods_ssbo, 0, VK_WHOLE_SIZE);
+		}
+
+		compute_shader.create("generate_draw_commands_comp.comp.spv");
+
+		VkDescriptorSetLayout layouts[] = { descriptor_set_layout };
+		compute_pipeline.layout.add_push_constant_range("Generate Params", { .stageFlags = VK_SHADER_STAGE_COMPUTE_BIT, .offset = 0, .size = sizeof(GPUGenerateParams) });
+		compute_pipeline.layout.create(layouts);
+		compute_pipeline.create_compute(compute_shader);
+	}
+
+	void create_renderpass() override
+	{
+
+	}
+
+	void render(VkCommandBuffer cmd_buffer) override
+	{
+
+	}
+
+	/* Hi-Z pyramid the late phase tests against, read by compute shaders once built */
+	void set_depth_pyramid(const Texture2D& pyramid, uint32_t frame_idx)
+	{
+		descriptor_set[frame_idx].write_descriptor_combined_image_sampler(8, pyramid.view, VulkanRendererCommon::get_instance().smp_clamp_nearest);
+		hiz_width = pyramid.info.width;
+		hiz_height = pyramid.info.height;
+		hiz_mip_count = pyramid.info.mipLevels;
+	}
+
+	/* When false, the early phase draws every instance in the frustum and generate_late() must not be recorded */
+	bool is_occlusion_culling_active() const
+	{
+		return enable_culling && enable_occlusion && !use_cpu_culling && hiz_mip_count > 0;
+	}
+
+	/*
+		Culls against the camera and the shadow cascades, then writes the draw commands of the frame for the shadow pass
+		and the early geometry pass. The culling stats of the previous use of this frame's buffers go to the draw metrics.
+	*/
+	void generate(VkCommandBuffer cmd_buffer, const glm::mat4& camera_view_proj, const glm::vec3& camera_position, std::span<const glm::mat4> cascade_view_projs)
+	{
+		const ObjectManager& object_manager = ObjectManager::get_instance();
+
+		GPUCullingData culling_data = {};
+		culling_data.camera_view_proj = camera_view_proj;
+		culling_data.camera_position = glm::vec4(camera_position, 1.0f);
+		extract_frustum_planes(camera_view_proj, culling_data.camera_planes);
+		culling_data.num_cascades = (uint32_t)std::min<size_t>(cascade_view_projs.size(), k_max_cascades);
+		for (uint32_t c = 0; c < culling_data.num_cascades; c++)
+		{
+			extract_frustum_planes(cascade_view_projs[c], culling_data.cascade_planes[c]);
+			culling_data.cascade_lod_scale[c] = 0.5f * lod_shadow_size * get_projected_scale(cascade_view_projs[c]);
+		}
+		culling_data.max_draw_commands = object_manager.max_draw_command_count;
+		culling_data.max_meshes = object_manager.max_mesh_count;
+		culling_data.enable_culling = enable_culling ? 1 : 0;
+		culling_data.enable_occlusion = is_occlusion_culling_active() ? 1 : 0;
+		culling_data.hiz_width = hiz_width;
+		culling_data.hiz_height = hiz_height;
+		culling_data.hiz_mip_count = hiz_mip_count;
+		culling_data.enable_lods = enable_lods ? 1 : 0;
+		culling_data.camera_lod_scale = 0.5f * lod_camera_height * get_projected_scale(camera_view_proj);
+		culling_data.camera_lod_threshold = lod_error_pixels * std::exp2(lod_bias);
+		culling_data.shadow_lod_threshold = shadow_lod_factor * culling_data.camera_lod_threshold;
+
+		if (use_cpu_culling)
+		{
+			generate_cpu(cmd_buffer, culling_data);
+			return;
+		}
+
+		VULKAN_RENDER_DEBUG_MARKER(cmd_buffer, "Frustum Culling");
+
+		read_culling_stats();
+		update_instance_descriptors();
+
+		culling_data_ssbo[ctx.curr_frame_idx].upload(ctx.device, &culling_data, 0, sizeof(GPUCullingData));
+
+		vk::buffer& counts = draw_counts[ctx.curr_frame_idx];
+		vk::buffer& stats = culling_stats_ssbo[ctx.curr_frame_idx];
+
+		/* Counts of the late list are cleared too : it stays empty when the late phase is not recorded */
+		vkCmdFillBuffer(cmd_buffer, counts, 0, VK_WHOLE_SIZE, 0);
+		vkCmdFillBuffer(cmd_buffer, stats, 0, VK_WHOLE_SIZE, 0);
+		if (!is_visibility_cleared)
+		{
+			vkCmdFillBuffer(cmd_buffer, instance_visibility, 0, VK_WHOLE_SIZE, 0);
+			is_visibility_cleared = true;
+		}
+
+		VkBufferMemoryBarrier2 clear_barriers[3];
+		for (VkBufferMemoryBarrier2& barrier : clear_barriers)
+		{
+			barrier =
+			{
+				.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER_2,
+				.srcStageMask = VK_PIPELINE_STAGE_2_CLEAR_BIT,
+				.srcAccessMask = VK_ACCESS_2_TRANSFER_WRITE_BIT,
+				.dstStageMask = VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT,
+				.dstAccessMask = VK_ACCESS_2_SHADER_STORAGE_READ_BIT | VK_ACCESS_2_SHADER_STORAGE_WRITE_BIT,
+				.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+				.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+				.offset = 0,
+				.size = VK_WHOLE_SIZE,
+			};
+		}
+		clear_barriers[0].buffer = counts;
+		clear_barriers[1].buffer = stats;
+		/* Visibility written by the late phase of the previous frame */
+		clear_barriers[2].buffer = instance_visibility;
+		clear_barriers[2].srcStageMask |= VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT;
+		clear_barriers[2].srcAccessMask |= VK_ACCESS_2_SHADER_STORAGE_WRITE_BIT;
+
+		VkDependencyInfo clear_dependency = { .sType = VK_STRUCTURE_TYPE_DEPENDENCY_INFO, .bufferMemoryBarrierCount = 3, .pBufferMemoryBarriers = clear_barriers };
+		vkCmdPipelineBarrier2(cmd_buffer, &clear_dependency);
+
+		dispatch(cmd_buffer, phase_early);
+	}
+
+	/*
+		Occlusion culling of the camera against the Hi-Z pyramid of the frame, writes the draw commands of the late
+		geometry pass. Recorded after the pyramid is built, only if is_occlusion_culling_active().
+	*/
+	void generate_late(VkCommandBuffer cmd_buffer)
+	{
+		VULKAN_RENDER_DEBUG_MARKER(cmd_buffer, "Occlusion Culling");
+		dispatch(cmd_buffer, phase_late);
+	}
+
+	/* Vertex push constants of the mesh passes, see instanced_mesh_vert.vert */
+	struct mesh_draw_constants
+	{
+		uint32_t first_draw;
+		uint32_t vertex_format;		/* VertexFormat of the mesh */
+	};
+
+	/*
+		Draws the visible primitives of a mesh in the list of a view with one indirect draw.
+		The pipeline must have a "Mesh Draw" vertex push constant range and descriptor_set of the frame bound.
+	*/
+	static void draw_mesh(VkCommandBuffer cmd_buffer, view draw_view, size_t mesh_idx, Pipeline& pipeline, DrawMetricsEntry& renderer_draw_metrics)
+	{
+		const ObjectManager& object_manager = ObjectManager::get_instance();
+		const ObjectManager::GPUMeshDrawData& mesh_draw_data = object_manager.m_mesh_draw_data[mesh_idx];
+
+		if (mesh_draw_data.draw_capacity == 0 || mesh_draw_data.instance_count == 0)
+		{
+			return;
+		}
+
+		uint32_t first_draw = draw_view * object_manager.max_draw_command_count + mesh_draw_data.first_draw;
+		uint32_t count_idx = draw_view * object_manager.max_mesh_count + (uint32_t)mesh_idx;
+
+		const VulkanMesh& mesh = object_manager.m_meshes[mesh_idx];
+
+		/* Indices follow the vertices in the buffer of the mesh */
+		mesh.bind_index_buffer(cmd_buffer);
+
+		mesh_draw_constants constants = { first_draw, (uint32_t)mesh.vertex_format };
+		pipeline.cmd_push_constants(cmd_buffer, "Mesh Draw", &constants);
+		fpCmdDrawIndexedIndirectCountKHR(cmd_buffer,
+			draw_commands[ctx.curr_frame_idx], first_draw * sizeof(GPUDrawCommand),
+			draw_counts[ctx.curr_frame_idx], count_idx * sizeof(uint32_t),
+			mesh_draw_data.draw_capacity, sizeof(GPUDrawCommand));
+
+		renderer_draw_metrics.increment_drawcall_count(1);
+		renderer_draw_metrics.increment_instance_count(mesh_draw_data.instance_count);
+		renderer_draw_metrics.increment_vertex_data_size(mesh.m_vertex_buf_size_bytes);
+	}
+
+	void show_ui() override
+	{
+		if (ImGui::Begin("GPU Culling"))
+		{
+			ImGui::Checkbox("Frustum Culling", &enable_culling);
+			ImGui::BeginDisabled(!enable_culling);
+			ImGui::Checkbox("CPU Culling (SIMD)", &use_cpu_culling);
+			ImGui::BeginDisabled(use_cpu_culling);
+			ImGui::Checkbox("Occlusion Culling (Hi-Z)", &enable_occlusion);
+			ImGui::Checkbox("Cluster Culling (Meshlets)", &enable_meshlet_culling);
+			ImGui::EndDisabled();
+			ImGui::EndDisabled();
+
+			ImGui::SeparatorText("LODs");
+			ImGui::Checkbox("Enabled", &enable_lods);
+			ImGui::BeginDisabled(!enable_lods);
+			ImGui::SliderFloat("Bias", &lod_bias, -2.0f, 4.0f, "%.1f");
+			ImGui::SliderFloat("Shadow Factor", &shadow_lod_factor, 1.0f, 8.0f, "%.1f");
+			ImGui::Text("Error allowed : %.2f pixels, %.2f shadow texels", lod_error_pixels * std::exp2(lod_bias), shadow_lod_factor * lod_error_pixels * std::exp2(lod_bias));
+			ImGui::EndDisabled();
+
+			/* Triangle throughput : per primitive frustum culling alone against what the enabled culling draws */
+			uint32_t camera_triangles = (last_stats.visible_vertices[view_camera] + last_stats.visible_vertices[view_camera_late]) / 3;
+			uint32_t shadow_triangles = last_stats.visible_vertices[view_shadow] / 3;
+			ImGui::SeparatorText("Triangles");
+			ImGui::Text("Camera : %u -> %u", last_stats.frustum_triangles[view_camera], camera_triangles);
+			ImGui::Text("Shadow : %u -> %u", last_stats.frustum_triangles[view_shadow], shadow_triangles);
+			ImGui::Text("Meshlets (camera) : %u drawn, %u culled", last_stats.visible_meshlets[view_camera] + last_stats.visible_meshlets[view_camera_late],
+				last_stats.culled_meshlets[view_camera] + last_stats.culled_meshlets[view_camera_late]);
+		}
+		ImGui::End();
+	}
+
+	bool reload_pipeline() override
+	{
+		return false;
+	}
+
+	static constexpr uint32_t k_thread_group_size = 64;
+
+	static inline vk::descriptor_set_layout descriptor_set_layout;
+	static inline vk::descriptor_set descriptor_set[NUM_FRAMES];
+	static inline vk::buffer draw_commands[NUM_FRAMES];
+	static inline vk::buffer draw_counts[NUM_FRAMES];
+
+	vk::buffer culling_data_ssbo[NUM_FRAMES];
+	vk::buffer culling_stats_ssbo[NUM_FRAMES];
+	DrawMetricsEntry culling_metrics[view_count];
+	bool enable_culling = true;
+	bool enable_occlusion = true;
+	bool enable_meshlet_culling = true;
+	bool use_cpu_culling = false;
+
+	/*
+		Camera LODs may move the surface by lod_error_pixels * 2^lod_bias pixels, shadow LODs by shadow_lod_factor times
+		more texels. Errors are projected on targets of lod_camera_height and lod_shadow_size pixels.
+	*/
+	bool enable_lods = true;
+	float lod_bias = 0.0f;
+	float lod_error_pixels = 1.0f;
+	float shadow_lod_factor = 2.0f;
+	float lod_camera_height = 1080.0f;
+	float lod_shadow_size = 2048.0f;
+
+	/* Triangles drawn per view since the start, from the stats read back, to compare LOD settings over a run */
+	uint64_t total_camera_triangles = 0;
+	uint64_t total_shadow_triangles = 0;
+	uint32_t num_stats_frames = 0;
+
+	/* Stats of the last frame read back, shown in the UI */
+	GPUCullingStats last_stats = {};
+
+	/* Per primitive instance, indexed like the draw command slots of its mesh : non zero if visible last frame */
+	vk::buffer instance_visibility;
+	bool is_visibility_cleared = false;
+
+	uint32_t hiz_width = 0;
+	uint32_t hiz_height = 0;
+	uint32_t hiz_mip_count = 0;
+
+	vk::buffer cpu_draw_commands[NUM_FRAMES];
+	vk::buffer cpu_draw_counts[NUM_FRAMES];
+
+	/* World space box of each primitive instance, ordered by primitive then instance. See update_instance_bounds(). */
+	aabb_soa instance_bounds;
+	std::vector<uint32_t> primitive_first_bounds;
+	uint32_t instance_bounds_revision = UINT32_MAX;
+	std::vector<uint8_t> cpu_visibility[view_count];
+
+	Pipeline compute_pipeline;
+	ComputeShader compute_shader;
+
+	static inline bool is_initialized = false;
+
+private:
+	/*
+		One thread per primitive then one per meshlet. Commands and counts are then read by the indirect draws, stats by the host,
+		visibility by the next phase.
+	*/
+	void dispatch(VkCommandBuffer cmd_buffer, culling_phase phase)
+	{
+		const ObjectManager& object_manager = ObjectManager::get_instance();
+		GPUGenerateParams params =
+		{
+			.num_primitives = (uint32_t)object_manager.m_primitives.size(),
+			.phase = phase,
+			.num_meshlets = enable_culling && enable_meshlet_culling ? (uint32_t)object_manager.m_meshlets.size() : 0,
+		};
+
+		uint32_t num_threads = params.num_primitives + params.num_meshlets;
+		if (num_threads > 0)
+		{
+			compute_pipeline.bind(cmd_buffer);
+			vkCmdBindDescriptorSets(cmd_buffer, VK_PIPELINE_BIND_POINT_COMPUTE, compute_pipeline.layout, 0, 1, descriptor_set[ctx.curr_frame_idx], 0, nullptr);
+			compute_pipeline.cmd_push_constants(cmd_buffer, "Generate Params", &params);
+			vkCmdDispatch(cmd_buffer, (num_threads + k_thread_group_size - 1) / k_thread_group_size, 1, 1);
+		}
+
+		VkBufferMemoryBarrier2 generate_barriers[4];
+		for (VkBufferMemoryBarrier2& barrier : generate_barriers)
+		{
+			barrier =
+			{
+				.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER_2,
+				.srcStageMask = VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT,
+				.srcAccessMask = VK_ACCESS_2_SHADER_STORAGE_WRITE_BIT,
+				.dstStageMask = VK_PIPELINE_STAGE_2_DRAW_INDIRECT_BIT | VK_PIPELINE_STAGE_2_VERTEX_SHADER_BIT,
+				.dstAccessMask = VK_ACCESS_2_INDIRECT_COMMAND_READ_BIT | VK_ACCESS_2_SHADER_STORAGE_READ_BIT,
+				.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+				.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+				.offset = 0,
+				.size = VK_WHOLE_SIZE,
+			};
+		}
+		generate_barriers[0].buffer = draw_commands[ctx.curr_frame_idx];
+		generate_barriers[1].buffer = draw_counts[ctx.curr_frame_idx];
+		generate_barriers[2].buffer = culling_stats_ssbo[ctx.curr_frame_idx];
+		generate_barriers[2].dstStageMask = VK_PIPELINE_STAGE_2_HOST_BIT | VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT;
+		generate_barriers[2].dstAccessMask = VK_ACCESS_2_HOST_READ_BIT | VK_ACCESS_2_SHADER_STORAGE_READ_BIT | VK_ACCESS_2_SHADER_STORAGE_WRITE_BIT;
+		generate_barriers[3].buffer = instance_visibility;
+		generate_barriers[3].srcAccessMask = VK_ACCESS_2_SHADER_STORAGE_READ_BIT | VK_ACCESS_2_SHADER_STORAGE_WRITE_BIT;
+		generate_barriers[3].dstStageMask = VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT;
+		generate_barriers[3].dstAccessMask = VK_ACCESS_2_SHADER_STORAGE_READ_BIT | VK_ACCESS_2_SHADER_STORAGE_WRITE_BIT;
+
+		VkDependencyInfo generate_dependency = { .sType = VK_STRUCTURE_TYPE_DEPENDENCY_INFO, .bufferMemoryBarrierCount = 4, .pBufferMemoryBarriers = generate_barriers };
+		vkCmdPipelineBarrier2(cmd_buffer, &generate_dependency);
+	}
+
+	/*
+		CPU fallback of generate() : culls the instance boxes with SIMD across the job system, compacts the visible
+		instances of each mesh into the command lists like the compute shader does, and copies them to the GPU buffers.
+		Only frustum culling of whole primitives : the late list stays empty and meshlets are not used.
+	*/
+	void generate_cpu(VkCommandBuffer cmd_buffer, const GPUCullingData& culling_data)
+	{
+		VULKAN_RENDER_DEBUG_MARKER(cmd_buffer, "Frustum Culling (CPU)");
+
+		const ObjectManager& object_manager = ObjectManager::get_instance();
+		job_system& js = job_system::get_instance();
+
+		update_instance_bounds();
+
+		uint8_t* visible_camera = cpu_visibility[view_camera].data();
+		uint8_t* visible_shadow = cpu_visibility[view_shadow].data();
+		if (enable_culling)
+		{
+			cull_aabbs_parallel(instance_bounds, culling_data.camera_planes, visible_camera);
+
+			/* Union of the cascades, without their near planes like the compute shader */
+			std::fill(cpu_visibility[view_shadow].begin(), cpu_visibility[view_shadow].end(), uint8_t(0));
+			for (uint32_t c = 0; c < culling_data.num_cascades; c++)
+			{
+				cull_aabbs_parallel(instance_bounds, std::span(culling_data.cascade_planes[c], 5), visible_shadow, true);
+			}
+		}
+		else
+		{
+			std::fill(cpu_visibility[view_camera].begin(), cpu_visibility[view_camera].end(), uint8_t(1));
+			std::fill(cpu_visibility[view_shadow].begin(), cpu_visibility[view_shadow].end(), uint8_t(1));
+		}
+
+		GPUDrawCommand* commands = (GPUDrawCommand*)cpu_draw_commands[ctx.curr_frame_idx].map(ctx.device, 0, view_count * object_manager.max_draw_command_count * sizeof(GPUDrawCommand));
+		uint32_t* counts = (uint32_t*)cpu_draw_counts[ctx.curr_frame_idx].map(ctx.device, 0, view_count * object_manager.max_mesh_count * sizeof(uint32_t));
+		memset(counts, 0, view_count * object_manager.max_mesh_count * sizeof(uint32_t));
+
+		/* Meshes own disjoint command ranges and counts */
+		size_t num_meshes = std::min<size_t>(object_manager.m_mesh_draw_data.size(), object_manager.max_mesh_count);
+		std::vector<GPUCullingStats> mesh_stats(num_meshes, GPUCullingStats{});
+		js.parallel_for(num_meshes, [&](size_t mesh_idx)
+		{
+			compact_mesh_commands(culling_data, mesh_idx, view_camera, visible_camera, commands, counts, mesh_stats[mesh_idx]);
+			compact_mesh_commands(culling_data, mesh_idx, view_shadow, visible_shadow, commands, counts, mesh_stats[mesh_idx]);
+		}, 16);
+
+		std::vector<VkBufferCopy> command_regions;
+		GPUCullingStats stats = {};
+		for (size_t mesh_idx = 0; mesh_idx < num_meshes; mesh_idx++)
+		{
+			for (uint32_t v = 0; v < view_count; v++)
+			{
+				stats.visible[v] += mesh_stats[mesh_idx].visible[v];
+				stats.culled[v] += mesh_stats[mesh_idx].culled[v];
+				stats.visible_vertices[v] += mesh_stats[mesh_idx].visible_vertices[v];
+				stats.frustum_triangles[v] += mesh_stats[mesh_idx].frustum_triangles[v];
+
+				uint32_t count = counts[v * object_manager.max_mesh_count + mesh_idx];
+				if (count > 0)
+				{
+					VkDeviceSize offset = (v * object_manager.max_draw_command_count + object_manager.m_mesh_draw_data[mesh_idx].first_draw) * sizeof(GPUDrawCommand);
+					command_regions.push_back({ .srcOffset = offset, .dstOffset = offset, .size = count * sizeof(GPUDrawCommand) });
+				}
+			}
+		}
+
+		cpu_draw_commands[ctx.curr_frame_idx].unmap(ctx.device);
+		cpu_draw_counts[ctx.curr_frame_idx].unmap(ctx.device);
+
+		set_culling_stats(stats);
+
+		if (!command_regions.empty())
+		{
+			vkCmdCopyBuffer(cmd_buffer, cpu_draw_commands[ctx.curr_frame_idx], draw_commands[ctx.curr_frame_idx], (uint32_t)command_regions.size(), command_regions.data());
+		}
+		VkBufferCopy counts_region = { .srcOffset = 0, .dstOffset = 0, .size = view_count * object_manager.max_mesh_count * sizeof(uint32_t) };
+		vkCmdCopyBuffer(cmd_buffer, cpu_draw_counts[ctx.curr_frame_idx], draw_counts[ctx.curr_frame_idx], 1, &counts_region);
+
+		VkBufferMemoryBarrier2 copy_barriers[2];
+		for (VkBufferMemoryBarrier2& barrier : copy_barriers)
+		{
+			barrier =
+			{
+				.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER_2,
+				.srcStageMask = VK_PIPELINE_STAGE_2_COPY_BIT,
+				.srcAccessMask = VK_ACCESS_2_TRANSFER_WRITE_BIT,
+				.dstStageMask = VK_PIPELINE_STAGE_2_DRAW_INDIRECT_BIT | VK_PIPELINE_STAGE_2_VERTEX_SHADER_BIT,
+				.dstAccessMask = VK_ACCESS_2_INDIRECT_COMMAND_READ_BIT | VK_ACCESS_2_SHADER_STORAGE_READ_BIT,
+				.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+				.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+				.offset = 0,
+				.size = VK_WHOLE_SIZE,
+			};
+		}
+		copy_barriers[0].buffer = draw_commands[ctx.curr_frame_idx];
+		copy_barriers[1].buffer = draw_counts[ctx.curr_frame_idx];
+
+		VkDependencyInfo copy_dependency = { .sType = VK_STRUCTURE_TYPE_DEPENDENCY_INFO, .bufferMemoryBarrierCount = 2, .pBufferMemoryBarriers = copy_barriers };
+		vkCmdPipelineBarrier2(cmd_buffer, &copy_dependency);
+	}
+
+	/* Rebuilt when instances or primitives changed, see ObjectManager::m_instances_revision */
+	void update_instance_bounds()
+	{
+		const ObjectManager& object_manager = ObjectManager::get_instance();
+		if (instance_bounds_revision == object_manager.m_instances_revision)
+		{
+			return;
+		}
+
+		size_t num_primitives = object_manager.m_primitives.size();
+		primitive_first_bounds.resize(num_primitives);
+
+		size_t num_bounds = 0;
+		for (size_t prim_idx = 0; prim_idx < num_primitives; prim_idx++)
+		{
+			primitive_first_bounds[prim_idx] = (uint32_t)num_bounds;
+			num_bounds += object_manager.m_mesh_draw_data[object_manager.m_primitives[prim_idx].mesh_idx].instance_count;
+		}
+
+		instance_bounds.resize(num_bounds);
+		for (std::vector<uint8_t>& visibility : cpu_visibility)
+		{
+			visibility.assign(instance_bounds.padded_size(), 0);
+		}
+
+		job_system::get_instance().parallel_for(num_primitives, [&](size_t prim_idx)
+		{
+			const ObjectManager::GPUPrimitive& primitive = object_manager.m_primitives[prim_idx];
+			const std::vector<ObjectManager::GPUInstanceData>& instances = object_manager.m_mesh_instance_data[primitive.mesh_idx];
+			uint32_t instance_count = object_manager.m_mesh_draw_data[primitive.mesh_idx].instance_count;
+			bool has_bounds = glm::all(glm::lessThanEqual(glm::vec3(primitive.bbox_min_os), glm::vec3(primitive.bbox_max_os)));
+
+			for (uint32_t instance_idx = 0; instance_idx < instance_count; instance_idx++)
+			{
+				size_t bounds_idx = primitive_first_bounds[prim_idx] + instance_idx;
+				if (has_bounds)
+				{
+					instance_bounds.set_transformed(bounds_idx, instances[instance_idx].model * primitive.model, primitive.bbox_min_os, primitive.bbox_max_os);
+				}
+				else
+				{
+					instance_bounds.set_unbounded(bounds_idx);
+				}
+			}
+		}, 64);
+
+		instance_bounds_revision = object_manager.m_instances_revision;
+	}
+
+	/* NDC units per world unit along y : 1 / tan(fov / 2) for a perspective projection, at a distance of 1 */
+	static float get_projected_scale(const glm::mat4& view_proj)
+	{
+		return glm::length(glm::vec3(view_proj[0][1], view_proj[1][1], view_proj[2][1]));
+	}
+
+	/* Same as select_lod() in generate_draw_commands_comp.comp */
+	static uint32_t select_lod(const GPUCullingData& culling_data, view draw_view, const ObjectManager::GPUPrimitive& primitive, const glm::mat4& model)
+	{
+		const ObjectManager& object_manager = ObjectManager::get_instance();
+
+		glm::vec3 bbox_min = primitive.bbox_min_os;
+		glm::vec3 bbox_max = primitive.bbox_max_os;
+		if (culling_data.enable_lods == 0 || primitive.lod_count < 2 || glm::any(glm::greaterThan(bbox_min, bbox_max)))
+		{
+			return 0;
+		}
+
+		glm::vec3 center = model * glm::vec4(0.5f * (bbox_max + bbox_min), 1.0f);
+		glm::vec3 extents_os = 0.5f * (bbox_max - bbox_min);
+		float max_scale = std::max({ glm::length(glm::vec3(model[0])), glm::length(glm::vec3(model[1])), glm::length(glm::vec3(model[2])) });
+
+		float pixels_per_unit = 0.0f;
+		float threshold = 0.0f;
+		if (draw_view == view_shadow)
+		{
+			glm::mat3 abs_model = glm::mat3(glm::abs(glm::vec3(model[0])), glm::abs(glm::vec3(model[1])), glm::abs(glm::vec3(model[2])));
+			glm::vec3 extents = abs_model * extents_os;
+			for (uint32_t c = 0; c < culling_data.num_cascades; c++)
+			{
+				bool inside = true;
+				for (uint32_t i = 0; i < 5 && inside; i++)
+				{
+					const glm::vec4& plane = culling_data.cascade_planes[c][i];
+					inside = glm::dot(glm::vec3(plane), center) + plane.w + glm::dot(glm::abs(glm::vec3(plane)), extents) >= 0.0f;
+				}
+
+				if (inside)
+				{
+					pixels_per_unit = std::max(pixels_per_unit, culling_data.cascade_lod_scale[c]);
+				}
+			}
+			threshold = culling_data.shadow_lod_threshold;
+		}
+		else
+		{
+			float distance = glm::length(center - glm::vec3(culling_data.camera_position)) - glm::length(extents_os) * max_scale;
+			if (distance <= 0.0f)
+			{
+				return 0;
+			}
+			pixels_per_unit = culling_data.camera_lod_scale / distance;
+			threshold = culling_data.camera_lod_threshold;
+		}
+
+		float error_scale = max_scale * pixels_per_unit;
+		uint32_t lod = 0;
+		while (lod + 1 < primitive.lod_count && object_manager.m_lods[primitive.first_lod + lod + 1].error * error_scale <= threshold)
+		{
+			lod++;
+		}
+		return lod;
+	}
+
+	/* Same runs, LODs and capacity rules as write_command() in generate_draw_commands_comp.comp */
+	void compact_mesh_commands(const GPUCullingData& culling_data, size_t mesh_idx, view draw_view, const uint8_t* visible, GPUDrawCommand* commands, uint32_t* counts, GPUCullingStats& stats) const
+	{
+		const ObjectManager& object_manager = ObjectManager::get_instance();
+		const ObjectManager::GPUMeshDrawData& mesh = object_manager.m_mesh_draw_data[mesh_idx];
+
+		if (mesh.instance_count == 0 || mesh.draw_capacity == 0)
+		{
+			return;
+		}
+
+		bool split_instances = mesh.draw_capacity >= (mesh.num_primitives + mesh.num_meshlets) * mesh.instance_count;
+		GPUDrawCommand* mesh_commands = commands + draw_view * object_manager.max_draw_command_count + mesh.first_draw;
+		uint32_t& count = counts[draw_view * object_manager.max_mesh_count + mesh_idx];
+
+		const std::vector<ObjectManager::GPUInstanceData>& instances = object_manager.m_mesh_instance_data[mesh_idx];
+
+		for (uint32_t prim_idx = mesh.first_primitive; prim_idx < mesh.first_primitive + mesh.num_primitives; prim_idx++)
+		{
+			const ObjectManager::GPUPrimitive& primitive = object_manager.m_primitives[prim_idx];
+			const uint8_t* instance_visible = visible + primitive_first_bounds[prim_idx];
+
+			auto get_index_range = [&](uint32_t lod)
+			{
+				const ObjectManager::GPUPrimitiveLod* primitive_lod = lod > 0 ? &object_manager.m_lods[primitive.first_lod + lod] : nullptr;
+				return primitive_lod ? std::pair(primitive_lod->first_index, primitive_lod->index_count) : std::pair(primitive.first_vertex, primitive.vertex_count);
+			};
+
+			auto write_command = [&](uint32_t first_instance, uint32_t instance_count, uint32_t lod)
+			{
+				if (count < mesh.draw_capacity)
+				{
+					auto [first_index, index_count] = get_index_range(lod);
+					mesh_commands[count++] = { .command = { index_count, instance_count, first_index, primitive.base_vertex, first_instance }, .primitive_idx = prim_idx };
+				}
+			};
+
+			bool use_lods = culling_data.enable_lods != 0 && primitive.lod_count > 1;
+
+			uint32_t run_start = 0;
+			uint32_t run_length = 0;
+			uint32_t run_lod = 0;
+			uint32_t min_lod = UINT32_MAX;
+			uint32_t num_drawn = 0;
+			uint32_t num_drawn_indices = 0;
+			for (uint32_t instance_idx = 0; instance_idx < mesh.instance_count; instance_idx++)
+			{
+				if (instance_visible[instance_idx])
+				{
+					uint32_t lod = use_lods ? select_lod(culling_data, draw_view, primitive, instances[instance_idx].model * primitive.model) : 0;
+					if (run_length > 0 && lod != run_lod && split_instances)
+					{
+						write_command(run_start, run_length, run_lod);
+						run_length = 0;
+					}
+
+					num_drawn++;
+					num_drawn_indices += get_index_range(lod).second;
+					min_lod = std::min(min_lod, lod);
+					if (run_length == 0)
+					{
+						run_start = instance_idx;
+						run_lod = lod;
+					}
+					run_length++;
+				}
+				else if (run_length > 0 && split_instances)
+				{
+					write_command(run_start, run_length, run_lod);
+					run_length = 0;
+				}
+			}
+
+			if (num_drawn > 0)
+			{
+				if (split_instances)
+				{
+					if (run_length > 0) write_command(run_start, run_length, run_lod);
+				}
+				else
+				{
+					write_command(0, mesh.instance_count, min_lod);
+				}
+			}
+
+			stats.visible[draw_view] += num_drawn;
+			stats.culled[draw_view] += mesh.instance_count - num_drawn;
+			stats.visible_vertices[draw_view] += num_drawn_indices;
+			stats.frustum_triangles[draw_view] += num_drawn * (primitive.vertex_count / 3);
+		}
+	}
+
+	/* Visible/culled instances of the last frame that used this frame's buffers : the frame fence has been waited */
+	void read_culling_stats()
+	{
+		GPUCullingStats stats = {};
+		memcpy(&stats, culling_stats_ssbo[ctx.curr_frame_idx].map(ctx.device, 0, sizeof(GPUCullingStats)), sizeof(GPUCullingStats));
+		culling_stats_ssbo[ctx.curr_frame_idx].unmap(ctx.device);
+
+		set_culling_stats(stats);
+	}
+
+	void set_culling_stats(const GPUCullingStats& stats)
+	{
+		for (uint32_t v = 0; v < view_count; v++)
+		{
+			culling_metrics[v].set_culling_counts(stats.visible[v], stats.culled[v]);
+			culling_metrics[v].increment_vertex_count(stats.visible_vertices[v]);
+		}
+		last_stats = stats;
+
+		/* Buffers of frames not recorded yet hold no stats */
+		uint32_t camera_triangles = (stats.visible_vertices[view_camera] + stats.visible_vertices[view_camera_late]) / 3;
+		uint32_t shadow_triangles = stats.visible_vertices[view_shadow] / 3;
+		if (camera_triangles + shadow_triangles > 0)
+		{
+			total_camera_triangles += camera_triangles;
+			total_shadow_triangles += shadow_triangles;
+			num_stats_frames++;
+		}
+	}
+
+	/* Instance buffers of the meshes added since the last update of this frame's set */
+	void update_instance_descriptors()
+	{
+		const ObjectManager& object_manager = ObjectManager::get_instance();
+		uint32_t& num_written = num_written_instance_descriptors[ctx.curr_frame_idx];
+
+		uint32_t num_meshes = (uint32_t)std::min<size_t>(object_manager.m_mesh_instance_data_ssbo.size(), object_manager.max_mesh_count);
+		for (; num_written < num_meshes; num_written++)
+		{
+			descriptor_set[ctx.curr_frame_idx].write_descriptor_storage_buffer(4, object_manager.m_mesh_instance_data_ssbo[num_written], 0, VK_WHOLE_SIZE, num_written);
+		}
+	}
+
+	uint32_t num_written_instance_descriptors[NUM_FRAMES] = {};
+};
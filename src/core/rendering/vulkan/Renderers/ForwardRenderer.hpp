@@ -1,6 +1,7 @@
 #pragma once
 
 #include "DebugLineRenderer.hpp"
+#include "DrawCommandGenerator.hpp"
 #include "core/rendering/vulkan/VulkanUI.h"
 
 struct ForwardRenderer : public IRenderer
@@ -30,13 +31,13 @@ struct ForwardRenderer : public IRenderer
 		std::vector<VkDescriptorSetLayout> layouts = 
 		{ 
 			VulkanRendererCommon::get_instance().m_framedata_desc_set_layout,
-			ObjectManager::get_instance().m_descriptor_set_bindless_textures.layout.vk_set_layout,
+			ObjectManager::get_instance().m_bindless_layout.vk_set_layout,
 			ObjectManager::get_instance().mesh_descriptor_set_layout, 
+			DrawCommandGenerator::descriptor_set_layout,
 			descriptor_set.layout.vk_set_layout,
 		};
 
-		pipeline.layout.add_push_constant_range("Primitive Model Matrix", { .stageFlags = VK_SHADER_STAGE_VERTEX_BIT, .offset = 0, .size = sizeof(glm::mat4) });
-		pipeline.layout.add_push_constant_range("Material", { .stageFlags =  VK_SHADER_STAGE_FRAGMENT_BIT, .offset = sizeof(glm::mat4), .size = sizeof(Material) });
+		pipeline.layout.add_push_constant_range("Mesh Draw", { .stageFlags = VK_SHADER_STAGE_VERTEX_BIT, .offset = 0, .size = sizeof(DrawCommandGenerator::mesh_draw_constants) });
 
 		pipeline.layout.create(layouts);
 		pipeline.create_graphics(shader, std::span<VkFormat>(&color_format, 1), depth_format, Pipeline::Flags::ENABLE_DEPTH_STATE, pipeline.layout, VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST, VK_CULL_MODE_BACK_BIT, VK_FRONT_FACE_COUNTER_CLOCKWISE);
@@ -66,10 +67,11 @@ struct ForwardRenderer : public IRenderer
 
 		vkCmdBindPipeline(cmd_buffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipeline.pipeline);
 
-		/* Frame level descriptor sets 1,2,3 */
+		/* Frame level descriptor sets 0,1,3,4 */
 		vkCmdBindDescriptorSets(cmd_buffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipeline.layout, 0, 1, &VulkanRendererCommon::get_instance().m_framedata_desc_set[ctx.curr_frame_idx].vk_set, 0, nullptr);
-		vkCmdBindDescriptorSets(cmd_buffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipeline.layout, 1, 1, &ObjectManager::get_instance().m_descriptor_set_bindless_textures.vk_set, 0, nullptr);
-		vkCmdBindDescriptorSets(cmd_buffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipeline.layout, 3, 1, &descriptor_set.vk_set, 0, nullptr);
+		vkCmdBindDescriptorSets(cmd_buffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipeline.layout, 1, 1, &ObjectManager::get_instance().m_descriptor_set_bindless_textures[ctx.curr_frame_idx].vk_set, 0, nullptr);
+		vkCmdBindDescriptorSets(cmd_buffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipeline.layout, 3, 1, &DrawCommandGenerator::descriptor_set[ctx.curr_frame_idx].vk_set, 0, nullptr);
+		vkCmdBindDescriptorSets(cmd_buffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipeline.layout, 4, 1, &descriptor_set.vk_set, 0, nullptr);
 
 		renderpass[ctx.curr_frame_idx].begin(cmd_buffer, { ctx.swapchain->info.width, ctx.swapchain->info.height });
 
@@ -78,23 +80,9 @@ struct ForwardRenderer : public IRenderer
 		{
 			/* Mesh descriptor set */
 			vkCmdBindDescriptorSets(cmd_buffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipeline.layout, 2, 1, &object_manager.m_descriptor_sets[mesh_idx].vk_set, 0, nullptr);
-
-			const VulkanMesh& mesh = object_manager.m_meshes[mesh_idx];
-
-			uint32_t instance_count = (uint32_t)object_manager.m_mesh_instance_data[mesh_idx].size();
-			draw_metrics.increment_instance_count(instance_count);
-
-			for (int prim_idx = 0; prim_idx < mesh.geometry_data.primitives.size(); prim_idx++)
-			{
-				const Primitive& p = mesh.geometry_data.primitives[prim_idx];
-				draw_metrics.increment_vertex_count(p.vertex_count * instance_count);
-
-				pipeline.cmd_push_constants(cmd_buffer, "Material", &object_manager.m_materials[p.material_id]);
-				pipeline.cmd_push_constants(cmd_buffer, "Primitive Model Matrix", &p.model);
-
-				vkCmdDraw(cmd_buffer, p.vertex_count, instance_count, p.first_vertex, 0);
-				draw_metrics.increment_drawcall_count(1);
-			}
+			/* Instances visible last frame, then the newly visible ones if the occlusion pass ran */
+			DrawCommandGenerator::draw_mesh(cmd_buffer, DrawCommandGenerator::view_camera, mesh_idx, pipeline, draw_metrics);
+			DrawCommandGenerator::draw_mesh(cmd_buffer, DrawCommandGenerator::view_camera_late, mesh_idx, pipeline, draw_metrics);
 		}
 		renderpass[ctx.curr_frame_idx].end(cmd_buffer);
 	}
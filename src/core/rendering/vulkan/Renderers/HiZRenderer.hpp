@@ -0,0 +1,158 @@
+#pragma once
+
+#include "DeferredRenderer.hpp"
+#include "core/rendering/vulkan/shader_compiler.h"
+
+/*
+	Hierarchical depth pyramid of the deferred geometry pass depth buffer, read by the occlusion culling pass.
+	Each texel holds the farthest depth of the depth texels it covers. Mip 0 is half the depth buffer resolution,
+	each mip is built by a compute dispatch reading the previous one.
+*/
+struct HiZRenderer : public IRenderer
+{
+	static constexpr uint32_t k_thread_group_size = 8;
+	static constexpr VkFormat k_format = VK_FORMAT_R32_SFLOAT;
+
+	struct DownsampleParams
+	{
+		glm::uvec2 source_size;
+		glm::uvec2 destination_size;
+	};
+
+	void init() override
+	{
+		name = "Hi-Z Renderer";
+		draw_metrics = DrawMetricsManager::add_entry("Hi-Z Pyramid");
+
+		create_resources();
+		create_pipeline();
+
+		is_initialized = true;
+	}
+
+	void create_resources()
+	{
+		const Texture2D& depth = DeferredRenderer::gbuffer.depth_attachment[0];
+		uint32_t width = std::max(depth.info.width / 2, 1u);
+		uint32_t height = std::max(depth.info.height / 2, 1u);
+
+		for (int frame_idx = 0; frame_idx < NUM_FRAMES; frame_idx++)
+		{
+			pyramid[frame_idx].init(k_format, width, height, 1, true, "[Hi-Z Renderer] Depth Pyramid");
+			pyramid[frame_idx].create(ctx.device, VK_IMAGE_USAGE_STORAGE_BIT | VK_IMAGE_USAGE_SAMPLED_BIT);
+			pyramid[frame_idx].transition_immediate(VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, VK_ACCESS_SHADER_READ_BIT);
+
+			mip_views[frame_idx].resize(pyramid[frame_idx].info.mipLevels);
+			ui_texture_ids[frame_idx].resize(pyramid[frame_idx].info.mipLevels);
+			for (uint32_t mip = 0; mip < pyramid[frame_idx].info.mipLevels; mip++)
+			{
+				Texture2D::create_texture_2d_mip_view(mip_views[frame_idx][mip], pyramid[frame_idx], ctx.device, mip);
+				ui_texture_ids[frame_idx][mip] = static_cast<ImTextureID>(ImGui_ImplVulkan_AddTexture(VulkanRendererCommon::get_instance().smp_clamp_nearest, mip_views[frame_idx][mip], VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL));
+			}
+		}
+	}
+
+	void create_pipeline() override
+	{
+		VkSampler sampler_clamp_nearest = VulkanRendererCommon::get_instance().smp_clamp_nearest;
+
+		descriptor_set_layout.add_combined_image_sampler_binding(0, VK_SHADER_STAGE_COMPUTE_BIT, 1, "Source Depth");
+		descriptor_set_layout.add_storage_image_binding(1, "Destination Mip");
+		descriptor_set_layout.create("Hi-Z Downsample Descriptor Set Layout");
+
+		/* One set per mip : mip N reads mip N-1, mip 0 reads the depth buffer */
+		for (int frame_idx = 0; frame_idx < NUM_FRAMES; frame_idx++)
+		{
+			descriptor_sets[frame_idx].resize(mip_views[frame_idx].size());
+			for (size_t mip = 0; mip < mip_views[frame_idx].size(); mip++)
+			{
+				VkImageView source_view = mip == 0 ? DeferredRenderer::gbuffer.depth_attachment[frame_idx].view : mip_views[frame_idx][mip - 1];
+
+				descriptor_sets[frame_idx][mip].assign_layout(descriptor_set_layout);
+				descriptor_sets[frame_idx][mip].create("Hi-Z Downsample Descriptor Set");
+				descriptor_sets[frame_idx][mip].write_descriptor_combined_image_sampler(0, source_view, sampler_clamp_nearest);
+				descriptor_sets[frame_idx][mip].write_descriptor_storage_image(1, mip_views[frame_idx][mip]);
+			}
+		}
+
+		compute_shader.create("hiz_downsample_comp.comp.spv");
+
+		VkDescriptorSetLayout layouts[] = { descriptor_set_layout };
+		compute_pipeline.layout.add_push_constant_range("Downsample Params", { .stageFlags = VK_SHADER_STAGE_COMPUTE_BIT, .offset = 0, .size = sizeof(DownsampleParams) });
+		compute_pipeline.layout.create(layouts);
+		compute_pipeline.create_compute(compute_shader);
+	}
+
+	void create_renderpass() override
+	{
+
+	}
+
+	/* Builds the pyramid of the frame from the depth written so far by the geometry pass. The pyramid is left readable by compute shaders. */
+	void render(VkCommandBuffer cmd_buffer) override
+	{
+		VULKAN_RENDER_DEBUG_MARKER(cmd_buffer, "Hi-Z Pyramid");
+
+		Texture2D& depth = DeferredRenderer::gbuffer.depth_attachment[ctx.curr_frame_idx];
+		Texture2D& hiz = pyramid[ctx.curr_frame_idx];
+
+		depth.barrier(cmd_buffer, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+			VK_PIPELINE_STAGE_2_LATE_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_2_FRAGMENT_SHADER_BIT, VK_ACCESS_2_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT,
+			VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT, VK_ACCESS_2_SHADER_SAMPLED_READ_BIT);
+
+		/* Every mip is rewritten : the previous contents, read by the last occlusion pass, are discarded */
+		hiz.barrier(cmd_buffer, VK_IMAGE_LAYOUT_GENERAL,
+			VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT, VK_ACCESS_2_NONE,
+			VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT, VK_ACCESS_2_SHADER_STORAGE_WRITE_BIT);
+
+		compute_pipeline.bind(cmd_buffer);
+
+		DownsampleParams params = { .source_size = { depth.info.width, depth.info.height } };
+		for (uint32_t mip = 0; mip < hiz.info.mipLevels; mip++)
+		{
+			params.destination_size = { std::max(hiz.info.width >> mip, 1u), std::max(hiz.info.height >> mip, 1u) };
+
+			vkCmdBindDescriptorSets(cmd_buffer, VK_PIPELINE_BIND_POINT_COMPUTE, compute_pipeline.layout, 0, 1, descriptor_sets[ctx.curr_frame_idx][mip], 0, nullptr);
+			compute_pipeline.cmd_push_constants(cmd_buffer, "Downsample Params", &params);
+			vkCmdDispatch(cmd_buffer, (params.destination_size.x + k_thread_group_size - 1) / k_thread_group_size, (params.destination_size.y + k_thread_group_size - 1) / k_thread_group_size, 1);
+
+			VkImageSubresourceRange mip_range = { .aspectMask = VK_IMAGE_ASPECT_COLOR_BIT, .baseMipLevel = mip, .levelCount = 1, .baseArrayLayer = 0, .layerCount = 1 };
+			hiz.barrier(cmd_buffer, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+				VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT, VK_ACCESS_2_SHADER_STORAGE_WRITE_BIT,
+				VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT, VK_ACCESS_2_SHADER_SAMPLED_READ_BIT, &mip_range);
+
+			params.source_size = params.destination_size;
+		}
+	}
+
+	void show_ui() override
+	{
+		if (ImGui::Begin("Hi-Z Pyramid"))
+		{
+			ImGui::SliderInt("Mip", &ui_mip, 0, (int)ui_texture_ids[ctx.curr_frame_idx].size() - 1);
+			ImGui::Image(ui_texture_ids[ctx.curr_frame_idx][ui_mip], { 512, 512 });
+		}
+		ImGui::End();
+	}
+
+	bool reload_pipeline() override
+	{
+		/* The compute pipeline is registered with the shader compiler : rebuilt in the background, swapped in at the start of a later frame */
+		shader_compiler::get_instance().request_reload_all();
+		return true;
+	}
+
+	static inline std::array<Texture2D, NUM_FRAMES> pyramid;
+	std::array<std::vector<VkImageView>, NUM_FRAMES> mip_views;
+	std::array<std::vector<ImTextureID>, NUM_FRAMES> ui_texture_ids;
+	int ui_mip = 0;
+
+	vk::descriptor_set_layout descriptor_set_layout;
+	std::array<std::vector<vk::descriptor_set>, NUM_FRAMES> descriptor_sets;
+
+	Pipeline compute_pipeline;
+	ComputeShader compute_shader;
+	DrawMetricsEntry draw_metrics;
+
+	static inline bool is_initialized = false;
+};
@@ -1,6 +1,8 @@
 #pragma once
 
 #include "core/rendering/vulkan/Renderers/CubemapRenderer.hpp"
+#include "core/rendering/vulkan/pipeline_cache.h"
+#include "core/rendering/vulkan/VkResourceManager.h"
 
 static const std::string env_map_folder("../../../data/textures/env/");
 static constexpr VkFormat env_map_format = VK_FORMAT_R32G32B32A32_SFLOAT;
@@ -30,10 +32,14 @@ struct IBLRenderer
 		init_assets(false);
 		init_ubo();
 		init_pipeline(spherical_env_map);
+
+		/* Maps are rendered right away : pipelines queued by a startup batch must exist */
+		pipeline_cache::get_instance().create_pending();
 		render();
 		is_initialized = true;
 
 		cubemap_renderer.init(spherical_env_map);
+		pipeline_cache::get_instance().create_pending();
 		cubemap_renderer.render();
 	}
 
@@ -76,9 +82,10 @@ struct IBLRenderer
 	{
 		if (size_changed)
 		{
-			vkDeviceWaitIdle(ctx.device);
-			prefiltered_diffuse_env_map.destroy();
-			ImGui_ImplVulkan_RemoveTexture(static_cast<VkDescriptorSet>(prefiltered_diffuse_env_map_ui_id));
+			/* The frames in flight may still sample the previous map or draw its UI thumbnail */
+			prefiltered_diffuse_env_map.retire();
+			VkDescriptorSet ui_set = static_cast<VkDescriptorSet>(prefiltered_diffuse_env_map_ui_id);
+			VkResourceManager::get_instance(ctx.device)->retire([ui_set]() { ImGui_ImplVulkan_RemoveTexture(ui_set); }, ctx.frame_count);
 			render_pass.reset();
 		}
 
@@ -155,6 +162,8 @@ struct IBLRenderer
 	/* Renders the prefiltered diffuse env map */
 	void render()
 	{
+		OPTICK_EVENT();
+
 		/*
 			We want to solve the rendering equation, i.e find the outgoing radiance in the viewing direction give an incoming light direction.
 			We solve this by integrating over the contributions of all incoming radiances multiplied by the surface brdf, in the hemisphere over the surface patch.
@@ -2,8 +2,9 @@
 
 #include "IRenderer.h"
 #include "core/rendering/vulkan/RenderObjectManager.h"
-#include "core/rendering/camera.h"
+#include "core/rendering/Camera.h"
 #include "core/rendering/vulkan/VulkanMesh.h"
+#include "DrawCommandGenerator.hpp"
 
 struct ShadowRenderer : public IRenderer
 {
@@ -11,6 +12,8 @@ struct ShadowRenderer : public IRenderer
 	static constexpr uint32_t k_depth_size = 2048;
 	static constexpr unsigned k_num_cascades = 4;
 	static constexpr uint32_t view_mask = 0b00001111;
+	/* One indirect draw per mesh */
+	static constexpr size_t k_min_draws_per_chunk = 64;
 
 	void init() override
 	{
@@ -30,7 +33,7 @@ struct ShadowRenderer : public IRenderer
 		{
 			// Buffers
 			cascades_data[frame_idx].num_cascades = k_num_cascades;
-			ssbo_cascades_data[frame_idx].init(vk::buffer::type::STORAGE, sizeof(CascadesData), "Shadow Renderer: Cascades Data");
+			ssbo_cascades_data[frame_idx].init(vk::buffer::type::DYNAMIC, sizeof(CascadesData), "Shadow Renderer: Cascades Data");
 			ssbo_cascades_data[frame_idx].create();
 			// Textures
 			shadow_cascades_depth[frame_idx].init(k_depth_format, { k_depth_size, k_depth_size }, k_num_cascades, false, "Shadow Maps Array");
@@ -68,9 +71,9 @@ struct ShadowRenderer : public IRenderer
 		}
 
 		// Pipeline
-		pipeline.layout.add_push_constant_range("Primitive Model Matrix", { .stageFlags = VK_SHADER_STAGE_VERTEX_BIT, .offset = 0, .size = sizeof(glm::mat4) });
+		pipeline.layout.add_push_constant_range("Mesh Draw", { .stageFlags = VK_SHADER_STAGE_VERTEX_BIT, .offset = 0, .size = sizeof(DrawCommandGenerator::mesh_draw_constants) });
 
-		VkDescriptorSetLayout layouts[] { ObjectManager::get_instance().mesh_descriptor_set_layout, descriptor_set_layout };
+		VkDescriptorSetLayout layouts[] { ObjectManager::get_instance().mesh_descriptor_set_layout, descriptor_set_layout, DrawCommandGenerator::descriptor_set_layout };
 		pipeline.layout.create(layouts);
 		pipeline.create_graphics(shader, {}, k_depth_format, Pipeline::Flags::ENABLE_DEPTH_STATE, pipeline.layout, VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST, VK_CULL_MODE_BACK_BIT, VK_FRONT_FACE_COUNTER_CLOCKWISE, view_mask);
 	}
@@ -83,25 +86,39 @@ struct ShadowRenderer : public IRenderer
 		}
 	}
 
-	void render(VkCommandBuffer cmd_buffer, std::span<size_t> mesh_list, camera& camera, const VulkanRendererCommon::FrameData frame_data, glm::vec4 directional_light_dir)
+	/* Cascades of the frame, must be updated before the draw commands are generated : they are culled against */
+	void update_cascades(camera& camera, glm::vec4 directional_light_dir)
 	{
-		VULKAN_RENDER_DEBUG_MARKER(cmd_buffer, "Cascaded Shadow Pass");
 		compute_cascade_splits(camera.znear, camera.zfar, lambda);
 		compute_cascade_projection(camera, directional_light_dir);
+	}
 
-		set_viewport_scissor(cmd_buffer, k_depth_size, k_depth_size, true);
+	void render(VkCommandBuffer cmd_buffer, std::span<size_t> mesh_list)
+	{
+		VULKAN_RENDER_DEBUG_MARKER(cmd_buffer, "Cascaded Shadow Pass");
 
 		ObjectManager& object_manager = ObjectManager::get_instance();
 
-		VkDescriptorSet bound_descriptor_sets[] = { descriptor_set[ctx.curr_frame_idx] };
-
-		pipeline.bind(cmd_buffer);
-		vkCmdBindDescriptorSets(cmd_buffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipeline.layout, 1, 1, bound_descriptor_sets, 0, nullptr);
+		VkDescriptorSet bound_descriptor_sets[] = { descriptor_set[ctx.curr_frame_idx], DrawCommandGenerator::descriptor_set[ctx.curr_frame_idx] };
 
 		shadow_cascades_depth[ctx.curr_frame_idx].transition(cmd_buffer, VK_IMAGE_LAYOUT_DEPTH_ATTACHMENT_OPTIMAL, VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT);
-		renderpass[ctx.curr_frame_idx].begin(cmd_buffer, { k_depth_size, k_depth_size }, view_mask);
+		renderpass[ctx.curr_frame_idx].begin(cmd_buffer, { k_depth_size, k_depth_size }, view_mask, ctx.recorder.get_rendering_flags());
 
-		object_manager.draw_mesh_list(cmd_buffer, mesh_list, pipeline.layout, bound_descriptor_sets, draw_metrics);
+		/* All cascades are rendered at once (multiview) : chunks split the draws */
+		vk::secondary_rendering_info rendering_info = { .depth_format = k_depth_format, .view_mask = view_mask };
+		ctx.recorder.record(cmd_buffer, ctx.curr_frame_idx, rendering_info, mesh_list.size(), k_min_draws_per_chunk, [&](VkCommandBuffer chunk_cmd_buffer, size_t begin, size_t end)
+		{
+			set_viewport_scissor(chunk_cmd_buffer, k_depth_size, k_depth_size, true);
+			pipeline.bind(chunk_cmd_buffer);
+			vkCmdBindDescriptorSets(chunk_cmd_buffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipeline.layout, 1, 2, bound_descriptor_sets, 0, nullptr);
+
+			for (size_t mesh_idx : mesh_list.subspan(begin, end - begin))
+			{
+				/* Mesh descriptor set */
+				vkCmdBindDescriptorSets(chunk_cmd_buffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipeline.layout, 0, 1, &object_manager.m_descriptor_sets[mesh_idx].vk_set, 0, nullptr);
+				DrawCommandGenerator::draw_mesh(chunk_cmd_buffer, DrawCommandGenerator::view_shadow, mesh_idx, pipeline, draw_metrics);
+			}
+		});
 		renderpass[ctx.curr_frame_idx].end(cmd_buffer);
 		shadow_cascades_depth[ctx.curr_frame_idx].transition(cmd_buffer, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, VK_ACCESS_SHADER_READ_BIT);
 	}
@@ -73,12 +73,13 @@ struct SkyboxRenderer : public IRenderer
 		renderpass[ctx.curr_frame_idx].begin(cmd_buffer, render_size);
 
 		const ObjectManager& object_manager = ObjectManager::get_instance();
+		object_manager.m_meshes[id_mesh_skybox].bind_index_buffer(cmd_buffer);
 		for (int prim_idx = 0; prim_idx < object_manager.m_meshes[id_mesh_skybox].geometry_data.primitives.size(); prim_idx++)
 		{
 			const Primitive& p = object_manager.m_meshes[id_mesh_skybox].geometry_data.primitives[prim_idx];
 			pipeline.cmd_push_constants(cmd_buffer, "Primitive Model Matrix", &p.model);
 
-			vkCmdDraw(cmd_buffer, p.vertex_count, 1, p.first_vertex, 0);
+			vkCmdDrawIndexed(cmd_buffer, p.vertex_count, 1, p.first_vertex, (int32_t)p.base_vertex, 0);
 		}
 
 		renderpass[ctx.curr_frame_idx].end(cmd_buffer);
@@ -126,7 +126,7 @@ struct VolumetricLightRenderer : IRenderer
 
 		ps_fragment.inv_deferred_render_size = DeferredRenderer::inv_render_size;
 		volumetric_sunlight_pipeline.cmd_push_constants(cmd_buffer, "Sunlight Push Constants Fragment", &ps_fragment);
-		vkCmdDraw(cmd_buffer, (uint32_t)mesh_fs_quad.m_num_vertices, 1, 0, 0);
+		mesh_fs_quad.draw(cmd_buffer);
 	}
 
 	void render_volumetric_point_lights(VkCommandBuffer cmd_buffer, uint32_t frame_index)
@@ -148,7 +148,7 @@ struct VolumetricLightRenderer : IRenderer
 		volumetric_point_light_pipeline.cmd_push_constants(cmd_buffer, "Inv Screen Size", &DeferredRenderer::inv_render_size);
 
 		uint32_t instance_count = (uint32_t)ObjectManager::get_instance().m_mesh_instance_data[light_manager::point_light_volume_mesh_id].size();
-		vkCmdDraw(cmd_buffer, (uint32_t)mesh_sphere.m_num_vertices, instance_count, 0, 0);
+		mesh_sphere.draw(cmd_buffer, instance_count);
 	}
 
 	virtual void render(VkCommandBuffer cmd_buffer)
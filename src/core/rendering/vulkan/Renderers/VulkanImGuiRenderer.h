@@ -5,7 +5,9 @@
 #include "core/rendering/vulkan/VulkanShader.h"
 
 #include "../imgui/imgui.h"
+#ifdef _WIN32
 #include "../imgui/backends/imgui_impl_win32.h"
+#endif // _WIN32
 #include "../imgui/backends/imgui_impl_vulkan.h"
 #include "../imgui/widgets/imguizmo/ImGuizmo.h"
 
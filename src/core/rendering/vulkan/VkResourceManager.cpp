@@ -1,5 +1,8 @@
 #include "VkResourceManager.h"
 #include "core/engine/logger.h"
+#include "core/engine/vulkan/vk_context.h"
+
+#include <algorithm>
 
 VkResourceManager* VkResourceManager::s_instance;
 
@@ -23,22 +26,29 @@ VkResourceManager* VkResourceManager::get_instance(VkDevice device)
 	return s_instance;
 }
 
-size_t VkResourceManager::add_buffer(VkBuffer buffer, VkDeviceMemory memory)
+void VkResourceManager::init_allocator(VkPhysicalDevice physical_device)
+{
+	m_allocator.init(m_device, physical_device);
+}
+
+size_t VkResourceManager::add_buffer(VkBuffer buffer, const vk::allocation& allocation)
 {
 	size_t hash = std::hash<VkBuffer>{}(buffer);
-	hash_combine<VkDeviceMemory>(hash, memory);
-	m_buffers.insert({ hash , { buffer, memory } });
+	hash_combine<VkDeviceMemory>(hash, allocation.memory);
+	hash_combine<VkDeviceSize>(hash, allocation.offset);
+	m_buffers.insert({ hash , { buffer, allocation } });
 
 	LOG_INFO("Created buffer. Total buffers: {}", m_buffers.size());
 
 	return hash;
 }
 
-size_t VkResourceManager::add_image(VkImage image, VkDeviceMemory memory)
+size_t VkResourceManager::add_image(VkImage image, const vk::allocation& allocation)
 {
 	size_t hash = std::hash<VkImage>{}(image);
-	hash_combine<VkDeviceMemory>(hash, memory);
-	m_images.insert({ hash, { image, memory } });
+	hash_combine<VkDeviceMemory>(hash, allocation.memory);
+	hash_combine<VkDeviceSize>(hash, allocation.offset);
+	m_images.insert({ hash, { image, allocation } });
 	LOG_INFO("Created image. Total images: {}", m_images.size());
 	return hash;
 }
@@ -100,14 +110,10 @@ void VkResourceManager::destroy_buffer(size_t buffer_hash)
 		if (VK_NULL_HANDLE != ite->second.first)
 		{
 			vkDestroyBuffer(m_device, ite->second.first, nullptr);
-			ite->second.first = VK_NULL_HANDLE;
 		}
 
-		if (VK_NULL_HANDLE != ite->second.second)
-		{
-			vkFreeMemory(m_device, ite->second.second, nullptr);
-			ite->second.second = VK_NULL_HANDLE;
-		}
+		m_allocator.free(ite->second.second);
+		m_buffers.erase(ite);
 	}
 
 	LOG_INFO("Destroyed buffer. Total buffers: {}", m_buffers.size());
@@ -118,22 +124,15 @@ void VkResourceManager::destroy_image(size_t image_hash)
 	auto ite = m_images.find(image_hash);
 	if (ite != m_images.end())
 	{
-		VkImage& image = ite->second.first;
+		VkImage image = ite->second.first;
 		if (VK_NULL_HANDLE != image)
 		{
 			vkDestroyImage(m_device, image, nullptr);
-			image = VK_NULL_HANDLE;
 		}
 
-		VkDeviceMemory& memory = ite->second.second;
-		if (VK_NULL_HANDLE != memory)
-		{
-			vkFreeMemory(m_device, memory, nullptr);
-			memory = VK_NULL_HANDLE;
-		}
+		m_allocator.free(ite->second.second);
+		m_images.erase(ite);
 	}
-
-	m_images.erase(ite->first);
 }
 
 void VkResourceManager::destroy_image_view(size_t image_view_hash)
@@ -147,9 +146,9 @@ void VkResourceManager::destroy_image_view(size_t image_view_hash)
 			vkDestroyImageView(m_device, image_view, nullptr);
 			image_view = VK_NULL_HANDLE;
 		}
-	}
 
-	m_image_views.erase(ite->first);
+		m_image_views.erase(ite);
+	}
 
 	LOG_INFO("Destroyed image view. Total image views: {}", m_image_views.size());
 }
@@ -165,8 +164,9 @@ void VkResourceManager::destroy_shader_module(size_t module_hash)
 			vkDestroyShaderModule(m_device, module, nullptr);
 			module = VK_NULL_HANDLE;
 		}
+
+		m_shader_modules.erase(ite);
 	}
-	m_shader_modules.erase(ite->first);
 
 	LOG_INFO("Destroyed shader module. Total shader modules: {}", m_shader_modules.size());
 }
@@ -246,8 +246,98 @@ void VkResourceManager::destroy_sampler(size_t sampler_hash)
 	LOG_INFO("Destroyed sampler. Total samplers: {}", m_samplers.size());
 }
 
+void VkResourceManager::retire_buffer(size_t buffer_hash, uint32_t last_used_frame)
+{
+	auto ite = m_buffers.find(buffer_hash);
+	size_t size_bytes = ite != m_buffers.end() ? ite->second.second.size : 0;
+	m_retired.push_back({ retired_kind::BUFFER, buffer_hash, last_used_frame, size_bytes });
+}
+
+void VkResourceManager::retire_image(size_t image_hash, uint32_t last_used_frame)
+{
+	auto ite = m_images.find(image_hash);
+	size_t size_bytes = ite != m_images.end() ? ite->second.second.size : 0;
+	m_retired.push_back({ retired_kind::IMAGE, image_hash, last_used_frame, size_bytes });
+}
+
+void VkResourceManager::retire_image_view(size_t image_view_hash, uint32_t last_used_frame)
+{
+	m_retired.push_back({ retired_kind::IMAGE_VIEW, image_view_hash, last_used_frame });
+}
+
+void VkResourceManager::retire_shader_module(size_t module_hash, uint32_t last_used_frame)
+{
+	m_retired.push_back({ retired_kind::SHADER_MODULE, module_hash, last_used_frame });
+}
+
+void VkResourceManager::retire_pipeline(size_t pipeline_hash, uint32_t last_used_frame)
+{
+	m_retired.push_back({ retired_kind::PIPELINE, pipeline_hash, last_used_frame });
+}
+
+void VkResourceManager::retire(std::function<void()> destroy_func, uint32_t last_used_frame)
+{
+	m_retired.push_back({ .kind = retired_kind::CALLBACK, .frame = last_used_frame, .destroy_func = std::move(destroy_func) });
+}
+
+void VkResourceManager::destroy_retired_resource(retired_resource& resource)
+{
+	switch (resource.kind)
+	{
+	case retired_kind::BUFFER:			destroy_buffer(resource.hash); break;
+	case retired_kind::IMAGE:			destroy_image(resource.hash); break;
+	case retired_kind::IMAGE_VIEW:		destroy_image_view(resource.hash); break;
+	case retired_kind::SHADER_MODULE:	destroy_shader_module(resource.hash); break;
+	case retired_kind::PIPELINE:		destroy_pipeline(resource.hash); break;
+	case retired_kind::CALLBACK:		resource.destroy_func(); break;
+	}
+}
+
+void VkResourceManager::destroy_retired(uint32_t frame_count)
+{
+	/* Resources can be retired for a later frame than the previous ones : not sorted, the list stays short */
+	m_num_destroyed_last_update = 0;
+	std::erase_if(m_retired, [this, frame_count](retired_resource& resource)
+	{
+		if (frame_count < resource.frame + NUM_FRAMES)
+		{
+			return false;
+		}
+
+		destroy_retired_resource(resource);
+		m_num_destroyed_last_update++;
+		return true;
+	});
+}
+
+std::vector<VkResourceManager::retired_stats> VkResourceManager::get_retired_stats() const
+{
+	std::vector<retired_stats> stats;
+	for (const retired_resource& resource : m_retired)
+	{
+		auto ite = std::find_if(stats.begin(), stats.end(), [&resource](const retired_stats& s) { return s.frame == resource.frame; });
+		if (ite == stats.end())
+		{
+			stats.push_back({ resource.frame });
+			ite = stats.end() - 1;
+		}
+		ite->count++;
+		ite->size_bytes += resource.size_bytes;
+	}
+
+	std::sort(stats.begin(), stats.end(), [](const retired_stats& a, const retired_stats& b) { return a.frame < b.frame; });
+	return stats;
+}
+
 void VkResourceManager::destroy_all_resources()
 {
+	/* The device is idle */
+	for (retired_resource& resource : m_retired)
+	{
+		destroy_retired_resource(resource);
+	}
+	m_retired.clear();
+
 	destroy_all_buffers();
 	destroy_all_images();
 	destroy_all_image_views();
@@ -257,42 +347,41 @@ void VkResourceManager::destroy_all_resources()
 	destroy_all_descriptor_pools();
 	destroy_all_descriptor_set_layouts();
 	destroy_all_samplers();
+
+	m_allocator.log_stats();
+	m_allocator.destroy();
 }
 
 
 void VkResourceManager::destroy_all_buffers()
 {
-	for (auto it = m_buffers.begin(); it != m_buffers.end();) 
+	while (!m_buffers.empty())
 	{
-		destroy_buffer(it->first);
-		it = m_buffers.erase(it);
+		destroy_buffer(m_buffers.begin()->first);
 	}
 }
 
 void VkResourceManager::destroy_all_images()
 {
-	for (auto it = m_images.begin(); it != m_images.end();)
+	while (!m_images.empty())
 	{
-		destroy_image(it->first);
-		it = m_images.erase(it);
+		destroy_image(m_images.begin()->first);
 	}
 }
 
 void VkResourceManager::destroy_all_image_views()
 {
-	for (auto it = m_image_views.begin(); it != m_image_views.end();)
+	while (!m_image_views.empty())
 	{
-		destroy_image_view(it->first);
-		it = m_image_views.erase(it);
+		destroy_image_view(m_image_views.begin()->first);
 	}
 }
 
 void VkResourceManager::destroy_all_shader_modules()
 {
-	for (auto it = m_shader_modules.begin(); it != m_shader_modules.end();)
+	while (!m_shader_modules.empty())
 	{
-		destroy_shader_module(it->first);
-		it = m_shader_modules.erase(it);
+		destroy_shader_module(m_shader_modules.begin()->first);
 	}
 }
 
@@ -2,15 +2,22 @@
 
 #include <unordered_map>
 #include <functional>
+#include <vector>
 #include "vulkan/vulkan.hpp"
+#include "core/engine/vulkan/vk_memory_allocator.h"
 
 class VkResourceManager
 {
 public:
 	static VkResourceManager* get_instance(VkDevice device);
 
-	size_t add_buffer(VkBuffer buffer, VkDeviceMemory memory);
-	size_t add_image(VkImage image, VkDeviceMemory memory);
+	/* Must be called once the device is created, before any buffer or image */
+	void init_allocator(VkPhysicalDevice physical_device);
+	vk::memory_allocator& get_allocator() { return m_allocator; }
+
+	/* The allocation is given back to the allocator when the resource is destroyed */
+	size_t add_buffer(VkBuffer buffer, const vk::allocation& allocation);
+	size_t add_image(VkImage image, const vk::allocation& allocation);
 	size_t add_image_view(VkImageView image_view);
 	size_t add_shader_module(VkShaderModule module);
 	size_t add_pipeline(VkPipeline pipeline);
@@ -30,6 +37,34 @@ public:
 	void destroy_sampler(size_t sampler_hash);
 	void destroy_all_resources();
 
+	/*
+		Deferred destruction : the resource is destroyed by destroy_retired() once last_used_frame (a ctx.frame_count)
+		has completed, i.e. once its fence_queue_submitted has signalled. No device idle needed for resources still
+		referenced by the frames in flight.
+	*/
+	void retire_buffer(size_t buffer_hash, uint32_t last_used_frame);
+	void retire_image(size_t image_hash, uint32_t last_used_frame);
+	void retire_image_view(size_t image_view_hash, uint32_t last_used_frame);
+	void retire_shader_module(size_t module_hash, uint32_t last_used_frame);
+	void retire_pipeline(size_t pipeline_hash, uint32_t last_used_frame);
+
+	/* Anything else the frames in flight may use, e.g. a descriptor set freed back to its pool */
+	void retire(std::function<void()> destroy_func, uint32_t last_used_frame);
+
+	/* Call once the fence of frame_count has been waited : destroys what frames up to frame_count - NUM_FRAMES used */
+	void destroy_retired(uint32_t frame_count);
+
+	struct retired_stats
+	{
+		uint32_t frame = 0;
+		uint32_t count = 0;
+		size_t size_bytes = 0;		/* Memory of the buffers and images */
+	};
+
+	/* Pending destructions grouped by last used frame */
+	std::vector<retired_stats> get_retired_stats() const;
+	uint32_t get_num_destroyed_last_update() const { return m_num_destroyed_last_update; }
+
 protected:
 	VkResourceManager(VkDevice device);
 	static VkResourceManager* s_instance;
@@ -45,11 +80,24 @@ private:
 	void destroy_all_descriptor_set_layouts();
 	void destroy_all_samplers();
 
+	enum class retired_kind { BUFFER, IMAGE, IMAGE_VIEW, SHADER_MODULE, PIPELINE, CALLBACK };
+
+	struct retired_resource
+	{
+		retired_kind kind;
+		size_t hash = 0;
+		uint32_t frame = 0;
+		size_t size_bytes = 0;
+		std::function<void()> destroy_func;
+	};
+
+	void destroy_retired_resource(retired_resource& resource);
 
 private:
 	VkDevice m_device = VK_NULL_HANDLE;
-	std::unordered_map<size_t, std::pair<VkBuffer, VkDeviceMemory>> m_buffers;
-	std::unordered_map<size_t, std::pair<VkImage, VkDeviceMemory>> m_images;
+	vk::memory_allocator m_allocator;
+	std::unordered_map<size_t, std::pair<VkBuffer, vk::allocation>> m_buffers;
+	std::unordered_map<size_t, std::pair<VkImage, vk::allocation>> m_images;
 	std::unordered_map<size_t, VkImageView> m_image_views;
 	std::unordered_map<size_t, VkShaderModule> m_shader_modules;
 	std::unordered_map<size_t, VkPipeline> m_pipelines;
@@ -60,6 +108,9 @@ private:
 	std::unordered_map<size_t, VkDescriptorPool> m_descriptor_pools;
 	std::unordered_map<size_t, VkDescriptorSet> m_descriptor_sets;
 	std::unordered_map<size_t, VkDescriptorSetLayout> m_descriptor_set_layouts;
+
+	std::vector<retired_resource> m_retired;	/* In retirement order */
+	uint32_t m_num_destroyed_last_update = 0;
 };
 
 /* Add a vk object to the map */
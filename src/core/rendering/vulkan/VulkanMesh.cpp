@@ -2,13 +2,23 @@
 #include "core/rendering/vulkan/VulkanRenderInterface.h"
 #include "core/rendering/vulkan/VulkanRendererBase.h"
 #include "core/engine/Image.h"
+#include "core/engine/dds.h"
 #include "RenderObjectManager.h"
+#include "core/engine/job_system.h"
+#include "mesh_cache.h"
+#include "texture_streamer.h"
+#include "core/rendering/mesh_optimizer.h"
 
 #include "glm/gtx/euler_angles.hpp"
+#include "glm/gtc/packing.hpp"
+#include "optick.h"
 
+#include <algorithm>
 #include <vector>
 #include <span>
 #include <unordered_set>
+#include <chrono>
+#include <filesystem>
 
 #define CGLTF_IMPLEMENTATION
 #include "cgltf.h"
@@ -19,13 +29,24 @@ std::unordered_map<const char*, size_t> uri_to_texture_id;
 
 void VulkanMesh::create_from_file(const std::string& filename)
 {
+	OPTICK_EVENT();
+	OPTICK_TAG("File", filename.c_str());
+
 	std::string_view ext = get_extension(filename);
 
 	std::string models_path = "../../../data/models/";
+	std::string source_path = models_path + filename;
+	std::string cache_path = mesh_cache::get_path(source_path);
+
+	/* Pre-baked cache takes precedence as long as the source asset has not been modified since */
+	if (mesh_cache::is_up_to_date(source_path, cache_path) && create_from_cache(cache_path))
+	{
+		return;
+	}
 	
 	if (ext == "glb" || ext == "gltf")
 	{
-		create_from_file_gltf(models_path + filename);
+		create_from_file_gltf(source_path);
 	}
 	else
 	{
@@ -36,7 +57,7 @@ void VulkanMesh::create_from_file(const std::string& filename)
 
 
 template<typename VERTEX_TYPE, typename INDEX_TYPE>
-static vk::buffer create_vertex_index_buffer(std::span<VERTEX_TYPE> vtx_data, size_t& out_vtx_buffer_size_bytes, std::span<INDEX_TYPE> idx_data, size_t& out_idx_buffer_size_bytes)
+static vk::buffer create_vertex_index_buffer(std::span<const VERTEX_TYPE> vtx_data, size_t& out_vtx_buffer_size_bytes, std::span<const INDEX_TYPE> idx_data, size_t& out_idx_buffer_size_bytes)
 {
 	/* Compute a good alignment */
 	out_vtx_buffer_size_bytes = round_to(vtx_data.size() * sizeof(VERTEX_TYPE), ctx.device.limits.minStorageBufferOffsetAlignment);
@@ -44,32 +65,116 @@ static vk::buffer create_vertex_index_buffer(std::span<VERTEX_TYPE> vtx_data, si
 
 	size_t total_size_bytes = out_vtx_buffer_size_bytes + out_idx_buffer_size_bytes;
 
-	// Staging buffer
-	vk::buffer stagingBuffer;
-	stagingBuffer.init(vk::buffer::type::STAGING, total_size_bytes, "Vertex/Index Staging Buffer");
-	stagingBuffer.create();
-
-	// Copy vertex + index data to staging buffer
-	void* pData = stagingBuffer.map(ctx.device, 0, total_size_bytes);
-	memcpy(pData, vtx_data.data(), out_vtx_buffer_size_bytes);
-	memcpy((uint8_t*)pData + out_vtx_buffer_size_bytes, idx_data.data(), out_idx_buffer_size_bytes);
-	stagingBuffer.unmap(ctx.device);
-
 	// Create storage buffer containing non-interleaved vertex + index data 
 	vk::buffer result;
-	result.init(vk::buffer::type::STORAGE, total_size_bytes, "Vertex/Index SSBO");
+	result.init(vk::buffer::type::GEOMETRY, total_size_bytes, "Vertex/Index SSBO");
 	result.create();
-	copy_from_buffer(stagingBuffer, result, total_size_bytes);
+
+	// Source may be a mapped mesh cache file : only read the actual data size, not the aligned one.
+	ctx.uploader.upload(result, 0, vtx_data.data(), vtx_data.size_bytes());
+	ctx.uploader.upload(result, out_vtx_buffer_size_bytes, idx_data.data(), idx_data.size_bytes());
 
 	return result;
 }
 
-void VulkanMesh::create_from_data(std::span<VertexData> vertices, std::span<unsigned int> indices)
+/* Maps a unit vector to the [-1,1] square, see "A Survey of Efficient Representations for Independent Unit Vectors" */
+static glm::vec2 encode_octahedral(glm::vec3 n)
+{
+	n /= glm::abs(n.x) + glm::abs(n.y) + glm::abs(n.z);
+	glm::vec2 p(n.x, n.y);
+	if (n.z < 0.0f)
+	{
+		glm::vec2 sign_not_zero(p.x >= 0.0f ? 1.0f : -1.0f, p.y >= 0.0f ? 1.0f : -1.0f);
+		p = (1.0f - glm::abs(glm::vec2(p.y, p.x))) * sign_not_zero;
+	}
+	return p;
+}
+
+static PackedVertexData pack_vertex(const VertexData& v, glm::vec3 bbox_min, glm::vec3 inv_extent)
+{
+	glm::vec3 pos = glm::clamp((v.pos - bbox_min) * inv_extent, 0.0f, 1.0f);
+	glm::vec3 normal = glm::length(v.normal) > 0.0f ? v.normal : glm::vec3(0, 0, 1);
+
+	return PackedVertexData
+	{
+		.pos_xy = glm::packUnorm2x16(glm::vec2(pos.x, pos.y)),
+		.pos_z = glm::packUnorm2x16(glm::vec2(pos.z, 0.0f)),
+		.normal = glm::packSnorm2x16(encode_octahedral(normal)),
+		.uv = glm::packHalf2x16(glm::vec2(v.uv.x, v.uv.y))
+	};
+}
+
+/* 
+	Positions are quantized to the bounds of the primitive referencing them : the shader gets the same bounds from the
+	primitive buffer. Vertices are not shared between primitives.
+*/
+static std::vector<PackedVertexData> pack_vertices(std::span<const VertexData> vertices, std::span<const unsigned int> indices, std::span<const Primitive> primitives)
+{
+	std::vector<PackedVertexData> packed(vertices.size());
+
+	job_system::get_instance().parallel_for(primitives.size(), [&](size_t i)
+	{
+		const Primitive& p = primitives[i];
+		glm::vec3 extent = p.bbox_max_os - p.bbox_min_os;
+		glm::vec3 inv_extent = glm::vec3(extent.x > 0.0f ? 1.0f / extent.x : 0.0f, extent.y > 0.0f ? 1.0f / extent.y : 0.0f, extent.z > 0.0f ? 1.0f / extent.z : 0.0f);
+
+		for (uint32_t idx = p.first_vertex; idx < p.first_vertex + p.vertex_count; idx++)
+		{
+			unsigned int vertex_idx = p.base_vertex + indices[idx];
+			packed[vertex_idx] = pack_vertex(vertices[vertex_idx], p.bbox_min_os, inv_extent);
+		}
+	});
+
+	return packed;
+}
+
+void VulkanMesh::create_from_data(std::span<const VertexData> vertices, std::span<const unsigned int> indices)
 {
 	m_num_vertices = vertices.size();
 	m_num_indices = indices.size();
 
-	m_vertex_index_buffer = create_vertex_index_buffer<VertexData, unsigned int>(vertices, m_vertex_buf_size_bytes, indices, m_index_buf_size_bytes);
+	/* Every primitive needs bounds to dequantize its positions */
+	bool can_pack = !geometry_data.primitives.empty() && std::none_of(geometry_data.primitives.begin(), geometry_data.primitives.end(), [](const Primitive& p)
+	{
+		return glm::any(glm::greaterThan(p.bbox_min_os, p.bbox_max_os));
+	});
+
+	if (vertex_format == VertexFormat::PACKED && !can_pack)
+	{
+		LOG_WARN("Mesh has primitives without bounds, vertices are not packed.");
+		vertex_format = VertexFormat::FLOAT;
+	}
+
+	/* Indices are local to their primitive : 16 bits are enough unless one of them references 65536 vertices or more */
+	std::vector<uint16_t> indices_16;
+	index_type = VK_INDEX_TYPE_UINT32;
+	if (!indices.empty() && *std::max_element(indices.begin(), indices.end()) <= UINT16_MAX)
+	{
+		index_type = VK_INDEX_TYPE_UINT16;
+		indices_16.assign(indices.begin(), indices.end());
+		LOG_INFO("16 bit indices : {} KB ({} KB as 32 bit)", indices_16.size() * sizeof(uint16_t) / 1024, indices.size_bytes() / 1024);
+	}
+
+	auto create_buffer = [&](auto vtx_data)
+	{
+		using VERTEX_TYPE = typename decltype(vtx_data)::value_type;
+		if (index_type == VK_INDEX_TYPE_UINT16)
+		{
+			return create_vertex_index_buffer<VERTEX_TYPE, uint16_t>(vtx_data, m_vertex_buf_size_bytes, indices_16, m_index_buf_size_bytes);
+		}
+		return create_vertex_index_buffer<VERTEX_TYPE, unsigned int>(vtx_data, m_vertex_buf_size_bytes, indices, m_index_buf_size_bytes);
+	};
+
+	if (vertex_format == VertexFormat::PACKED)
+	{
+		std::vector<PackedVertexData> packed = pack_vertices(vertices, indices, geometry_data.primitives);
+		m_vertex_index_buffer = create_buffer(std::span<const PackedVertexData>(packed));
+		LOG_INFO("Packed vertex data : {} KB ({} KB as float)", packed.size() * sizeof(PackedVertexData) / 1024, vertices.size_bytes() / 1024);
+	}
+	else
+	{
+		m_vertex_index_buffer = create_buffer(vertices);
+	}
 }
 
 void VulkanMesh::destroy()
@@ -77,8 +182,62 @@ void VulkanMesh::destroy()
 	m_vertex_index_buffer.destroy();
 }
 
-static void load_vertices(Primitive& p, cgltf_primitive* primitive, GeometryData& geometry)
+void VulkanMesh::bind_index_buffer(VkCommandBuffer cmd_buffer) const
 {
+	vkCmdBindIndexBuffer(cmd_buffer, m_vertex_index_buffer, m_vertex_buf_size_bytes, index_type);
+}
+
+void VulkanMesh::draw(VkCommandBuffer cmd_buffer, uint32_t instance_count) const
+{
+	bind_index_buffer(cmd_buffer);
+
+	if (geometry_data.primitives.empty())
+	{
+		vkCmdDrawIndexed(cmd_buffer, (uint32_t)m_num_indices, instance_count, 0, 0, 0);
+		return;
+	}
+
+	for (const Primitive& p : geometry_data.primitives)
+	{
+		vkCmdDrawIndexed(cmd_buffer, p.vertex_count, instance_count, p.first_vertex, (int32_t)p.base_vertex, 0);
+	}
+}
+
+/* CPU-side result of unpacking one glTF primitive. Filled on worker threads then merged in node order. */
+struct PrimitiveImportData
+{
+	cgltf_node* node = nullptr;
+	cgltf_primitive* primitive = nullptr;
+	Primitive p = {};
+	std::vector<VertexData> vertices;
+	std::vector<unsigned int> indices;
+	glm::vec4 bbox_min_os {};
+	glm::vec4 bbox_max_os {};
+	bool has_min = false;
+	bool has_max = false;
+	mesh_optimizer::cache_stats source_stats;		/* Index buffer of the asset */
+	mesh_optimizer::cache_stats optimized_stats;
+	std::vector<Meshlet> meshlets;					/* Indices relative to the primitive */
+	std::vector<PrimitiveLod> lods;					/* Indices relative to the primitive, appended after its own */
+};
+
+/* A unique image referenced by the materials of the file, decoded on a worker thread */
+struct TextureImportData
+{
+	std::string name;
+	std::string path;						/* File to decode when the image is not embedded */
+	std::span<const uint8_t> encoded_data;	/* Encoded image bytes when embedded in the asset */
+	VkFormat format = VK_FORMAT_UNDEFINED;
+	bool calc_mip = false;
+	Image image;
+	compressed_image compressed;			/* Offline baked version, used instead of image when present */
+};
+
+static void load_vertices(PrimitiveImportData& import)
+{
+	cgltf_primitive* primitive = import.primitive;
+	Primitive& p = import.p;
+
 	std::vector<glm::vec3> positionsBuffer;
 	std::vector<glm::vec3> normalsBuffer;
 	std::vector<glm::vec2> texCoordBuffer;
@@ -96,58 +255,53 @@ static void load_vertices(Primitive& p, cgltf_primitive* primitive, GeometryData
 		{
 		case cgltf_attribute_type_position:
 		{
-			for (int i = 0; i < attribute->data->count; ++i)
-			{
-				glm::vec3 pos;
-				cgltf_accessor_read_float(attribute->data, i, &pos.x, 3);
-				positionsBuffer.push_back(pos);
+			positionsBuffer.resize(attribute->data->count);
+			cgltf_accessor_unpack_floats(attribute->data, (float*)positionsBuffer.data(), positionsBuffer.size() * 3);
 
+			for (const glm::vec3& pos : positionsBuffer)
+			{
 				p.world_center += pos;
+				p.bbox_min_os = glm::min(p.bbox_min_os, pos);
+				p.bbox_max_os = glm::max(p.bbox_max_os, pos);
 			}
 
 			// Also get bounding box for this primitive
 			if (attribute->data->has_min)
 			{
-				geometry.bbox_min_os = glm::vec4(attribute->data->min[0], attribute->data->min[1], attribute->data->min[2], 1.0f);
+				import.has_min = true;
+				import.bbox_min_os = glm::vec4(attribute->data->min[0], attribute->data->min[1], attribute->data->min[2], 1.0f);
 			}
 
 			if (attribute->data->has_max)
 			{
-				geometry.bbox_max_os = glm::vec4(attribute->data->max[0], attribute->data->max[1], attribute->data->max[2], 1.0f);
+				import.has_max = true;
+				import.bbox_max_os = glm::vec4(attribute->data->max[0], attribute->data->max[1], attribute->data->max[2], 1.0f);
 			}
 		}
 		break;
 
 		case cgltf_attribute_type_normal:
 		{
-			glm::vec3 normal;
-			for (int i = 0; i < attribute->data->count; ++i)
-			{
-				cgltf_accessor_read_float(attribute->data, i, &normal.x, 3);
-				normalsBuffer.push_back(normal);
-			}
+			normalsBuffer.resize(attribute->data->count);
+			cgltf_accessor_unpack_floats(attribute->data, (float*)normalsBuffer.data(), normalsBuffer.size() * 3);
 		}
 		break;
 
 		case cgltf_attribute_type_texcoord:
 		{
-			for (int i = 0; i < attribute->data->count; i++)
-			{
-				glm::vec2 texcoord;
-				cgltf_accessor_read_float(attribute->data, i, &texcoord.x, 2);
-				texCoordBuffer.push_back(texcoord);
-			}
-
+			texCoordBuffer.resize(attribute->data->count);
+			cgltf_accessor_unpack_floats(attribute->data, (float*)texCoordBuffer.data(), texCoordBuffer.size() * 2);
 		}
 		break;
 
 		case cgltf_attribute_type_tangent:
 		{
-			for (int i = 0; i < attribute->data->count; ++i)
+			std::vector<glm::vec4> t(attribute->data->count);
+			cgltf_accessor_unpack_floats(attribute->data, (float*)t.data(), t.size() * 4);
+			tangentBuffer.reserve(t.size());
+			for (const glm::vec4& v : t)
 			{
-				glm::vec4 t;
-				cgltf_accessor_read_float(attribute->data, i, &t.x, 4);
-				tangentBuffer.push_back(glm::vec3(t.x, t.y, t.z) * t.w);
+				tangentBuffer.push_back(glm::vec3(v.x, v.y, v.z) * v.w);
 			}
 		}
 		break;
@@ -158,59 +312,154 @@ static void load_vertices(Primitive& p, cgltf_primitive* primitive, GeometryData
 	p.world_center = glm::vec3(p.model * glm::vec4(p.world_center, 1));
 	p.model_world_center = glm::translate(glm::identity<glm::mat4>(), p.world_center);
 	// Build vertices
+	import.vertices.resize(positionsBuffer.size());
 	for (int i = 0; i < positionsBuffer.size(); ++i)
 	{
-		VertexData vertex;
+		VertexData& vertex = import.vertices[i];
 		vertex.pos = positionsBuffer[i];
 		vertex.normal = normalsBuffer[i];
-		if (texCoordBuffer.size())
+		vertex.uv = texCoordBuffer.size() ? glm::vec3(texCoordBuffer[i], 0.0) : glm::vec3(0.0);
+	}
+}
+
+static std::string get_texture_name(cgltf_texture* tex)
+{
+	const char* uri = tex->image->uri;
+	return uri ? base_path + uri : base_path + tex->image->name;
+}
+
+static std::span<const uint8_t> get_embedded_image_data(cgltf_texture* tex)
+{
+	if (tex->image->uri)
+	{
+		return {};
+	}
+
+	const uint8_t* buffer_view = cgltf_buffer_view_data(tex->image->buffer_view);
+	size_t buffer_view_size = tex->image->buffer_view->size;
+	return { buffer_view, buffer_view_size };
+}
+
+/* Runs on a worker thread : decode only, no Vulkan calls */
+static void decode_tex(TextureImportData& import)
+{
+	/* Prefer the offline baked block-compressed version, it comes with its mip chain */
+	if (ctx.device.is_texture_compression_bc_supported())
+	{
+		std::string baked_path = dds::get_baked_path(import.name);
+		bool is_up_to_date = import.path.empty() ? std::filesystem::exists(baked_path) : mesh_cache::is_up_to_date(import.path, baked_path);
+		/* When streaming, only the mip tail is loaded here, the streamer brings in the larger mips on demand */
+		texture_streamer& streamer = texture_streamer::get_instance();
+		if (is_up_to_date && dds::load(baked_path, import.compressed, streamer.enabled ? streamer.tail_size : 0))
 		{
-			vertex.uv = glm::vec3(texCoordBuffer[i], 0.0);
+			return;
 		}
+	}
 
-		geometry.vertices.push_back(vertex);
+	if (import.encoded_data.empty())
+	{
+		import.image.load_from_file(import.path);
+	}
+	else
+	{
+		import.image.load_from_buffer(import.encoded_data.data(), import.encoded_data.size());
 	}
 }
 
-
-static int load_tex(TextureType tex_type, cgltf_texture* tex, VkFormat format, bool calc_mip)
+/* Runs on the main thread : creates the GPU texture from the decoded image */
+static int upload_tex(TextureImportData& import)
 {
-	const char* uri = tex->image->uri;
-	std::string name = uri ? base_path + uri : base_path + tex->image->name;
-
 	ObjectManager& object_manager = ObjectManager::get_instance();
 
-	/* Load image */
-	int texture_id = object_manager.get_texture_id(name);
+	int texture_id = object_manager.get_texture_id(import.name);
 
 	if (texture_id != -1)
 	{
 		return texture_id;
 	}
 
-	Image image;
+	if (import.compressed.first_mip > 0)
+	{
+		return texture_streamer::get_instance().add_texture(import.name, dds::get_baked_path(import.name), std::move(import.compressed));
+	}
 
-	if (uri)
+	Texture2D texture;
+	if (!import.compressed.data.empty())
 	{
-		image.load_from_file(base_path + uri);
+		texture.init(import.compressed.format, import.compressed.w, import.compressed.h, 1, false, import.name);
+		texture.create_from_data(import.compressed);
 	}
 	else
 	{
-		const uint8_t* buffer_view = cgltf_buffer_view_data(tex->image->buffer_view);
-		size_t buffer_view_size = tex->image->buffer_view->size;
-		image.load_from_buffer(buffer_view, buffer_view_size);
+		texture.init(import.format, import.image.w, import.image.h, 1, import.calc_mip, import.name);
+		texture.create_from_data(&import.image);
 	}
-
-	/* Create texture */
-	Texture2D texture;
-	texture.init(format, image.w, image.h, 1, calc_mip, name);
-	texture.create_from_data(&image);
 	texture.create_view(ctx.device, { VK_IMAGE_VIEW_TYPE_2D, VK_IMAGE_ASPECT_COLOR_BIT, 0, texture.info.mipLevels });
 	texture.sampler = VulkanRendererCommon::get_instance().smp_repeat_linear;
 
 	return object_manager.add_texture(texture);
 }
 
+/* Every texture referenced by the file has been uploaded by upload_tex before materials are loaded : this only looks its id up */
+static int find_loaded_texture(cgltf_texture* tex)
+{
+	int texture_id = ObjectManager::get_instance().get_texture_id(get_texture_name(tex));
+	assert(texture_id != -1);
+	return texture_id;
+}
+
+/* Calls fn(texture, format, calc_mip) for each texture slot of the materials of the file, with the uncompressed format it is decoded to */
+template<typename Fn>
+static void for_each_material_texture(cgltf_data* data, Fn&& fn)
+{
+	const VulkanRendererCommon& common = VulkanRendererCommon::get_instance();
+
+	auto visit = [&](cgltf_texture* tex, VkFormat format, bool calc_mip)
+	{
+		if (tex)
+		{
+			fn(tex, format, calc_mip);
+		}
+	};
+
+	for (size_t i = 0; i < data->materials_count; i++)
+	{
+		cgltf_material* gltf_mat = &data->materials[i];
+
+		visit(gltf_mat->normal_texture.texture, common.tex_normal_map_format, true);
+		visit(gltf_mat->emissive_texture.texture, common.tex_emissive_format, false);
+
+		if (gltf_mat->has_pbr_metallic_roughness)
+		{
+			visit(gltf_mat->pbr_metallic_roughness.base_color_texture.texture, common.tex_base_color_format, true);
+			visit(gltf_mat->pbr_metallic_roughness.metallic_roughness_texture.texture, common.tex_metallic_roughness_format, false);
+		}
+	}
+}
+
+/* Lists the unique textures referenced by the materials of the file, along with the format they are going to be created with */
+static void gather_textures(cgltf_data* data, std::vector<TextureImportData>& out_textures)
+{
+	std::unordered_set<std::string> names;
+	ObjectManager& object_manager = ObjectManager::get_instance();
+
+	for_each_material_texture(data, [&](cgltf_texture* tex, VkFormat format, bool calc_mip)
+	{
+		std::string name = get_texture_name(tex);
+		if (names.contains(name) || object_manager.get_texture_id(name) != -1)
+		{
+			return;
+		}
+
+		names.insert(name);
+		TextureImportData& import = out_textures.emplace_back();
+		import.name = name;
+		import.path = tex->image->uri ? base_path + tex->image->uri : "";
+		import.encoded_data = get_embedded_image_data(tex);
+		import.format = format;
+		import.calc_mip = calc_mip;
+	});
+}
 
 static void load_material(cgltf_primitive* gltf_primitive, Primitive& primitive)
 {
@@ -231,13 +480,13 @@ static void load_material(cgltf_primitive* gltf_primitive, Primitive& primitive)
 		cgltf_texture* tex_normal = gltf_mat->normal_texture.texture;
 		if (tex_normal)
 		{
-			material.texture_normal_map_idx = load_tex(TextureType::NORMAL_MAP, tex_normal, VulkanRendererCommon::get_instance().tex_normal_map_format, true);
+			material.texture_normal_map_idx = find_loaded_texture(tex_normal);
 		}
 
 		cgltf_texture* tex_emissive = gltf_mat->emissive_texture.texture;
 		if (tex_emissive)
 		{
-			material.texture_emissive_map_idx = load_tex(TextureType::EMISSIVE_MAP, tex_emissive, VulkanRendererCommon::get_instance().tex_emissive_format, false);
+			material.texture_emissive_map_idx = find_loaded_texture(tex_emissive);
 		}
 
 		if (gltf_mat->has_pbr_metallic_roughness)
@@ -245,13 +494,13 @@ static void load_material(cgltf_primitive* gltf_primitive, Primitive& primitive)
 			cgltf_texture* tex_base_color = gltf_mat->pbr_metallic_roughness.base_color_texture.texture;
 			if (tex_base_color)
 			{
-				material.texture_base_color_idx = load_tex(TextureType::ALBEDO_MAP, tex_base_color, VulkanRendererCommon::get_instance().tex_base_color_format, true);
+				material.texture_base_color_idx = find_loaded_texture(tex_base_color);
 			}
 
 			cgltf_texture* tex_metallic_roughness = gltf_mat->pbr_metallic_roughness.metallic_roughness_texture.texture;
 			if (tex_metallic_roughness)
 			{
-				material.texture_metalness_roughness_idx = load_tex(TextureType::METALLIC_ROUGHNESS_MAP, tex_metallic_roughness, VulkanRendererCommon::get_instance().tex_metallic_roughness_format, false);
+				material.texture_metalness_roughness_idx = find_loaded_texture(tex_metallic_roughness);
 			}
 
 			/* Factors */
@@ -277,40 +526,162 @@ static void load_material(cgltf_primitive* gltf_primitive, Primitive& primitive)
 #endif
 }
 
-static void load_primitive(cgltf_node* node, cgltf_primitive* primitive, Node* engine_node, GeometryData& geometry)
+/*
+	Each LOD halves the triangles of the previous one. The chain ends when the simplification stalls, on seams or once
+	the error would get close to the size of the primitive, or when the primitive becomes small.
+*/
+static constexpr uint32_t k_max_lods = 5;
+static constexpr uint32_t k_min_lod_triangles = 64;
+static constexpr float k_max_lod_relative_error = 0.1f;
+
+static void build_lods(PrimitiveImportData& import)
 {
-	Primitive p = {};
-	p.first_vertex = (uint32_t)geometry.indices.size();
-	p.vertex_count = (uint32_t)primitive->indices->count;
-	
-	if (node->name)
+	if (import.indices.size() < 6 * k_min_lod_triangles || import.vertices.empty())
 	{
-		p.name = node->name;
+		return;
 	}
-	else
+
+	glm::vec3 bbox_min = import.vertices[0].pos;
+	glm::vec3 bbox_max = import.vertices[0].pos;
+	for (const VertexData& v : import.vertices)
 	{
-		std::string unnamed_primitive = "Unnamed Primitive #" + std::to_string(geometry.primitives.size());
-		p.name = unnamed_primitive;
+		bbox_min = glm::min(bbox_min, v.pos);
+		bbox_max = glm::max(bbox_max, v.pos);
+	}
+	float max_error = k_max_lod_relative_error * glm::length(bbox_max - bbox_min);
+
+	/* Every LOD is simplified from the full detail triangles, so that its error is measured against them */
+	const std::vector<unsigned int> source_indices = import.indices;
+	import.lods.push_back({ 0, (uint32_t)source_indices.size(), 0.0f });
+
+	while (import.lods.size() < k_max_lods)
+	{
+		uint32_t previous_count = import.lods.back().index_count;
+		size_t target_index_count = (previous_count / 6) * 3;
+		if (target_index_count < 3 * k_min_lod_triangles)
+		{
+			break;
+		}
+
+		float error = 0.0f;
+		std::vector<unsigned int> lod_indices = mesh_optimizer::simplify(source_indices, import.vertices, target_index_count, max_error, &error);
+		if (lod_indices.size() > previous_count * 9 / 10)
+		{
+			break;
+		}
+
+		mesh_optimizer::optimize_vertex_cache(lod_indices, import.vertices.size());
+		import.lods.push_back({ (uint32_t)import.indices.size(), (uint32_t)lod_indices.size(), error });
+		import.indices.insert(import.indices.end(), lod_indices.begin(), lod_indices.end());
 	}
 
+	/* A single LOD would only be the primitive itself */
+	if (import.lods.size() < 2)
+	{
+		import.lods.clear();
+	}
+}
+
+/*
+	Welds the vertices, reorders triangles then vertices for the post-transform cache and overdraw, splits the result
+	into meshlets and builds its LODs, see mesh_optimizer.h
+*/
+static void optimize_primitive(PrimitiveImportData& import)
+{
+	import.source_stats = mesh_optimizer::analyze_vertex_cache(import.indices, import.vertices.size());
+
+	mesh_optimizer::weld_vertices(import.vertices, import.indices);
+	mesh_optimizer::optimize_vertex_cache(import.indices, import.vertices.size());
+	mesh_optimizer::optimize_overdraw(import.indices, import.vertices);
+	mesh_optimizer::optimize_vertex_fetch(import.vertices, import.indices);
+
+	import.optimized_stats = mesh_optimizer::analyze_vertex_cache(import.indices, import.vertices.size());
+
+	/* A single meshlet would only duplicate the culling of the primitive */
+	import.meshlets = mesh_optimizer::build_meshlets(import.indices, import.vertices);
+	if (import.meshlets.size() < 2)
+	{
+		import.meshlets.clear();
+	}
+
+	build_lods(import);
+}
+
+/* Runs on a worker thread : unpacks indices and vertex attributes, indices are local to the primitive */
+static void load_primitive(PrimitiveImportData& import)
+{
+	cgltf_node* node = import.node;
+	cgltf_primitive* primitive = import.primitive;
+	Primitive& p = import.p;
+
+	p.vertex_count = (uint32_t)primitive->indices->count;
+
 	glm::mat4 mesh_local_mat;
 	cgltf_node_transform_world(node, glm::value_ptr(mesh_local_mat));
 	p.model = mesh_local_mat;
-	
+
 	/* Load indices */
+	import.indices.resize(p.vertex_count);
 	for (uint32_t idx = 0; idx < p.vertex_count; idx++)
 	{
-		size_t index = cgltf_accessor_read_index(primitive->indices, idx);
-		geometry.indices.push_back((unsigned int)(index + geometry.vertices.size()));
+		import.indices[idx] = (unsigned int)cgltf_accessor_read_index(primitive->indices, idx);
+	}
+
+	load_vertices(import);
+	optimize_primitive(import);
+}
+
+/* Runs on the main thread : appends the primitive to the geometry, its indices stay local to it */
+static void merge_primitive(PrimitiveImportData& import, GeometryData& geometry)
+{
+	Primitive& p = import.p;
+	p.first_vertex = (uint32_t)geometry.indices.size();
+
+	if (import.node->name)
+	{
+		p.name = import.node->name;
+	}
+	else
+	{
+		std::string unnamed_primitive = "Unnamed Primitive #" + std::to_string(geometry.primitives.size());
+		p.name = unnamed_primitive;
+	}
+
+	p.base_vertex = (uint32_t)geometry.vertices.size();
+	geometry.indices.insert(geometry.indices.end(), import.indices.begin(), import.indices.end());
+
+	p.first_meshlet = (uint32_t)geometry.meshlets.size();
+	p.meshlet_count = (uint32_t)import.meshlets.size();
+	for (Meshlet meshlet : import.meshlets)
+	{
+		meshlet.first_index += p.first_vertex;
+		geometry.meshlets.push_back(meshlet);
+	}
+
+	p.first_lod = (uint32_t)geometry.lods.size();
+	p.lod_count = (uint32_t)import.lods.size();
+	for (PrimitiveLod lod : import.lods)
+	{
+		lod.first_index += p.first_vertex;
+		geometry.lods.push_back(lod);
+	}
+	geometry.vertices.insert(geometry.vertices.end(), import.vertices.begin(), import.vertices.end());
+
+	if (import.has_min)
+	{
+		geometry.bbox_min_os = import.bbox_min_os;
+	}
+	if (import.has_max)
+	{
+		geometry.bbox_max_os = import.bbox_max_os;
 	}
 
-	load_vertices(p, primitive, geometry);
-	load_material(primitive, p);
+	load_material(import.primitive, p);
 
 	geometry.primitives.push_back(p);
 }
 
-static void process_node(cgltf_node* p_node, Node* parent, VulkanMesh& model)
+static void process_node(cgltf_node* p_node, Node* parent, VulkanMesh& model, std::span<PrimitiveImportData> node_primitives)
 {
 	Node* node = new Node{};
 	
@@ -319,9 +690,9 @@ static void process_node(cgltf_node* p_node, Node* parent, VulkanMesh& model)
 
 	if (p_node->mesh)
 	{	
-		for (int i = 0; i < p_node->mesh->primitives_count; ++i)
+		for (PrimitiveImportData& import : node_primitives)
 		{
-			load_primitive(p_node, &p_node->mesh->primitives[i], node, model.geometry_data);
+			merge_primitive(import, model.geometry_data);
 		}
 	}
 
@@ -368,6 +739,7 @@ static void process_node(cgltf_node* p_node, Node* parent, VulkanMesh& model)
 			}
 
 			light_manager::add_point_light(p);
+			model.geometry_data.point_lights.push_back(p);
 			
 		}
 
@@ -377,6 +749,7 @@ static void process_node(cgltf_node* p_node, Node* parent, VulkanMesh& model)
 			d.color = glm::vec4(color, 1.0);
 			d.dir = glm::vec4(0, -1, 0, 0); // set a default direction
 			light_manager::set_directional_light(d);
+			model.geometry_data.directional_lights.push_back(d);
 		}
 	}
 
@@ -395,53 +768,255 @@ static void process_node(cgltf_node* p_node, Node* parent, VulkanMesh& model)
 	//}
 }
 
-static void load_textures(cgltf_texture* textures, size_t texture_count)
+/* Bakes the imported mesh and everything it references into a cache file, see mesh_cache.h */
+static void write_mesh_cache(const std::string& cache_path, const VulkanMesh& mesh, cgltf_data* data)
 {
-	//std::function load_tex = [](cgltf_texture* tex, VkFormat format, bool calc_mip) -> int
-	//	{
-	//		const char* uri = tex->image->uri;
-	//		std::string name = uri ? base_path + uri : base_path + tex->image->name;
-
-	//		const ObjectManager& object_manager = ObjectManager::get_instance();
-
-	//		/* Load from file path */
-	//		int texture_id = ObjectManager::get_instance().get_texture_id(name.c_str());
-
-	//		if (texture_id != -1)
-	//		{
-	//			return texture_id;
-	//		}
-
-	//		if (uri)
-	//		{
-	//			Image im = load_image_from_file(base_path + uri);
-	//			Texture2D texture;
-	//			texture.init(format, im.w, im.h, 1, false, name);
-	//			texture.create_from_data(&im);
-	//			texture.create_view(ctx.device, { VK_IMAGE_VIEW_TYPE_2D, VK_IMAGE_ASPECT_COLOR_BIT, 0, texture.info.mipLevels });
-	//			texture.sampler = VulkanRendererCommon::get_instance().s_SamplerRepeatLinear;
-	//			texture.info.debugName = name.c_str();
-
-	//			return ObjectManager::get_instance().add_texture(texture);
-	//		}
-	//		else
-	//		{
-	//			/* Load from buffer */
-	//			assert(false);
-	//			return 0;
-	//		}
-	//	};
-
-	//for (size_t i = 0; i < texture_count; i++)
-	//{
-	//	printf("Texture %sz URI: %s\n", i, textures[i].image->uri);
-	//}
+	const ObjectManager& object_manager = ObjectManager::get_instance();
+	const GeometryData& geometry = mesh.geometry_data;
+
+	/*
+		The GPU textures may have been created from their baked DDS : the cache records the source format instead,
+		so that loading it falls back to decoding the source image correctly when the DDS is stale or missing.
+		Embedded images are not reachable from their name only either, keep a way to get their encoded bytes back.
+	*/
+	struct source_texture
+	{
+		cgltf_texture* gltf_texture;
+		VkFormat format;
+		bool calc_mip;
+	};
+
+	std::unordered_map<std::string, source_texture> source_texture_from_name;
+	for_each_material_texture(data, [&](cgltf_texture* tex, VkFormat format, bool calc_mip)
+	{
+		source_texture_from_name.insert({ get_texture_name(tex), { tex, format, calc_mip } });
+	});
+
+	std::unordered_map<int, std::string> texture_name_from_id;
+	for (const auto& [name, id] : object_manager.m_texture_id_from_name)
+	{
+		texture_name_from_id.insert({ id, name });
+	}
+
+	mesh_cache::writer writer;
+	std::unordered_map<int, int> local_texture_idx;
+	std::unordered_map<int, int> local_material_idx;
+
+	auto add_texture = [&](int texture_id) -> int
+	{
+		if (texture_id < 0)
+		{
+			return -1;
+		}
+
+		auto ite = local_texture_idx.find(texture_id);
+		if (ite != local_texture_idx.end())
+		{
+			return ite->second;
+		}
+
+		const std::string& name = texture_name_from_id[texture_id];
+
+		auto source = source_texture_from_name.find(name);
+		assert(source != source_texture_from_name.end());
+
+		mesh_cache::texture cache_texture = {};
+		cache_texture.name = writer.add_string(name);
+		cache_texture.format = source->second.format;
+		cache_texture.calc_mip = source->second.calc_mip;
+		cache_texture.embedded_data = writer.add_embedded(get_embedded_image_data(source->second.gltf_texture));
+
+		int idx = (int)writer.textures.size();
+		writer.textures.push_back(cache_texture);
+		local_texture_idx.insert({ texture_id, idx });
+		return idx;
+	};
+
+	auto add_material = [&](int material_id) -> int
+	{
+		auto ite = local_material_idx.find(material_id);
+		if (ite != local_material_idx.end())
+		{
+			return ite->second;
+		}
+
+		mesh_cache::material cache_material = {};
+		cache_material.material = object_manager.m_materials[material_id];
+		cache_material.material.texture_base_color_idx = add_texture(cache_material.material.texture_base_color_idx);
+		cache_material.material.texture_normal_map_idx = add_texture(cache_material.material.texture_normal_map_idx);
+		cache_material.material.texture_metalness_roughness_idx = add_texture(cache_material.material.texture_metalness_roughness_idx);
+		cache_material.material.texture_emissive_map_idx = add_texture(cache_material.material.texture_emissive_map_idx);
+		cache_material.name = writer.add_string(object_manager.m_material_names[material_id]);
+
+		int idx = (int)writer.materials.size();
+		writer.materials.push_back(cache_material);
+		local_material_idx.insert({ material_id, idx });
+		return idx;
+	};
+
+	for (const Primitive& p : geometry.primitives)
+	{
+		mesh_cache::primitive cache_primitive = {};
+		cache_primitive.first_vertex = p.first_vertex;
+		cache_primitive.vertex_count = p.vertex_count;
+		cache_primitive.material_idx = add_material(p.material_id);
+		cache_primitive.base_vertex = p.base_vertex;
+		cache_primitive.first_meshlet = p.first_meshlet;
+		cache_primitive.meshlet_count = p.meshlet_count;
+		cache_primitive.first_lod = p.first_lod;
+		cache_primitive.lod_count = p.lod_count;
+		cache_primitive.model = p.model;
+		cache_primitive.world_center = glm::vec4(p.world_center, 1.0f);
+		cache_primitive.bbox_min_os = glm::vec4(p.bbox_min_os, 1.0f);
+		cache_primitive.bbox_max_os = glm::vec4(p.bbox_max_os, 1.0f);
+		cache_primitive.name = writer.add_string(p.name);
+		writer.primitives.push_back(cache_primitive);
+	}
+
+	writer.vertices = geometry.vertices;
+	writer.indices = geometry.indices;
+	writer.meshlets = geometry.meshlets;
+	writer.lods = geometry.lods;
+	writer.point_lights = geometry.point_lights;
+	writer.directional_lights = geometry.directional_lights;
+	writer.hdr.world_mat = geometry.world_mat;
+	writer.hdr.bbox_min_os = geometry.bbox_min_os;
+	writer.hdr.bbox_max_os = geometry.bbox_max_os;
+
+	writer.write(cache_path);
 }
 
+bool VulkanMesh::create_from_cache(const std::string& cache_filename)
+{
+	using clock = std::chrono::steady_clock;
+	auto start = clock::now();
+
+	mesh_cache::reader cache;
+	if (!cache.open(cache_filename))
+	{
+		return false;
+	}
+
+	ObjectManager& object_manager = ObjectManager::get_instance();
+
+	/* Textures : only decode the ones that are not already loaded */
+	std::vector<int> texture_ids(cache.textures.size(), -1);
+	std::vector<size_t> import_texture_idx;
+	std::vector<TextureImportData> textures;
+	textures.reserve(cache.textures.size());
+
+	for (size_t i = 0; i < cache.textures.size(); i++)
+	{
+		const mesh_cache::texture& cache_texture = cache.textures[i];
+		std::string name(cache.get_string(cache_texture.name));
+
+		texture_ids[i] = object_manager.get_texture_id(name);
+		if (texture_ids[i] != -1)
+		{
+			continue;
+		}
+
+		TextureImportData& import = textures.emplace_back();
+		import.name = name;
+		import.encoded_data = cache.get_embedded(cache_texture.embedded_data);
+		import.path = import.encoded_data.empty() ? name : "";
+		import.format = cache_texture.format;
+		import.calc_mip = cache_texture.calc_mip != 0;
+		import_texture_idx.push_back(i);
+	}
+
+	job_system::get_instance().parallel_for(textures.size(), [&](size_t i)
+	{
+		decode_tex(textures[i]);
+	});
+
+	for (size_t i = 0; i < textures.size(); i++)
+	{
+		texture_ids[import_texture_idx[i]] = upload_tex(textures[i]);
+	}
+
+	/* Materials : remap texture indices to the object manager ones */
+	auto remap_texture = [&](int idx) { return idx < 0 ? -1 : texture_ids[idx]; };
+
+	std::vector<uint32_t> material_ids(cache.materials.size());
+	for (size_t i = 0; i < cache.materials.size(); i++)
+	{
+		Material material = cache.materials[i].material;
+		material.texture_base_color_idx = remap_texture(material.texture_base_color_idx);
+		material.texture_normal_map_idx = remap_texture(material.texture_normal_map_idx);
+		material.texture_metalness_roughness_idx = remap_texture(material.texture_metalness_roughness_idx);
+		material.texture_emissive_map_idx = remap_texture(material.texture_emissive_map_idx);
+
+		material_ids[i] = object_manager.add_material(material, std::string(cache.get_string(cache.materials[i].name)));
+	}
+
+	/* Primitives */
+	geometry_data.primitives.reserve(cache.primitives.size());
+	for (const mesh_cache::primitive& cache_primitive : cache.primitives)
+	{
+		Primitive p = {};
+		p.first_vertex = cache_primitive.first_vertex;
+		p.vertex_count = cache_primitive.vertex_count;
+		p.base_vertex = cache_primitive.base_vertex;
+		p.first_meshlet = cache_primitive.first_meshlet;
+		p.meshlet_count = cache_primitive.meshlet_count;
+		p.first_lod = cache_primitive.first_lod;
+		p.lod_count = cache_primitive.lod_count;
+		p.model = cache_primitive.model;
+		p.material_id = cache_primitive.material_idx < 0 ? (int)object_manager.default_material_id : (int)material_ids[cache_primitive.material_idx];
+		p.name = cache.get_string(cache_primitive.name);
+		p.world_center = glm::vec3(cache_primitive.world_center);
+		p.model_world_center = glm::translate(glm::identity<glm::mat4>(), p.world_center);
+		p.bbox_min_os = glm::vec3(cache_primitive.bbox_min_os);
+		p.bbox_max_os = glm::vec3(cache_primitive.bbox_max_os);
+		geometry_data.primitives.push_back(p);
+	}
+
+	geometry_data.meshlets.assign(cache.meshlets.begin(), cache.meshlets.end());
+	geometry_data.lods.assign(cache.lods.begin(), cache.lods.end());
+
+	/* Lights */
+	for (const point_light& p : cache.point_lights)
+	{
+		light_manager::add_point_light(p);
+		geometry_data.point_lights.push_back(p);
+	}
+
+	for (const directional_light& d : cache.directional_lights)
+	{
+		light_manager::set_directional_light(d);
+		geometry_data.directional_lights.push_back(d);
+	}
+
+	geometry_data.world_mat = cache.hdr->world_mat;
+	geometry_data.bbox_min_os = cache.hdr->bbox_min_os;
+	geometry_data.bbox_max_os = cache.hdr->bbox_max_os;
+
+	m_num_vertices = cache.vertices.size();
+	m_num_indices = cache.indices.size();
+
+	model = geometry_data.world_mat;
+
+	/* Vertex and index data go straight from the mapped file to the staging buffer, no CPU copy is kept */
+	create_from_data(cache.vertices, cache.indices);
+
+	auto end = clock::now();
+	LOG_WARN("Loaded mesh cache {} in {:.2f} ms : {} Primitives, {} Meshlets, {} LODs, {} Textures ({} decoded), {} Vertices, {} Indices", cache_filename,
+		std::chrono::duration<double, std::milli>(end - start).count(), cache.primitives.size(), cache.meshlets.size(), cache.lods.size(), cache.textures.size(), textures.size(),
+		m_num_vertices, m_num_indices);
+
+	return true;
+}
 
 void VulkanMesh::create_from_file_gltf(const std::string& filename)
 {
-	auto start = std::chrono::steady_clock::now();
+	OPTICK_EVENT();
+
+	using clock = std::chrono::steady_clock;
+	auto to_ms = [](clock::duration d) { return std::chrono::duration<double, std::milli>(d).count(); };
+
+	/* Parse */
+	auto start = clock::now();
 
 	cgltf_options options = { };
 	cgltf_data* data = NULL;
@@ -451,41 +1026,111 @@ void VulkanMesh::create_from_file_gltf(const std::string& filename)
 	
 	base_path = filename.substr(0, pos + 1);
 	
-	if (result == cgltf_result_success)
+	if (result != cgltf_result_success)
 	{
-		result = cgltf_load_buffers(&options, data, filename.c_str());
-		
-		if (result == cgltf_result_success)
-		{
-			load_textures(data->textures, data->textures_count);
+		LOG_ERROR("Could not read GLTF/GLB file. [error code : {0}]", (int)result);
+		assert(false);
+		return;
+	}
+
+	result = cgltf_load_buffers(&options, data, filename.c_str());
 
-			for (size_t i = 0; i < data->nodes_count; ++i)
+	if (result != cgltf_result_success)
+	{
+		LOG_ERROR("Could not load GLTF/GLB buffers. [error code : {0}]", (int)result);
+		cgltf_free(data);
+		assert(false);
+		return;
+	}
+
+	std::vector<TextureImportData> textures;
+	gather_textures(data, textures);
+
+	/* Primitives are listed in node order so that merging them gives the same layout as a serial load */
+	std::vector<PrimitiveImportData> primitives;
+	std::vector<size_t> node_first_primitive(data->nodes_count + 1, 0);
+	for (size_t i = 0; i < data->nodes_count; ++i)
+	{
+		node_first_primitive[i] = primitives.size();
+		cgltf_node* node = &data->nodes[i];
+		if (node->mesh)
+		{
+			for (size_t j = 0; j < node->mesh->primitives_count; ++j)
 			{
-				process_node(&data->nodes[i], nullptr, *this);
+				PrimitiveImportData& import = primitives.emplace_back();
+				import.node = node;
+				import.primitive = &node->mesh->primitives[j];
 			}
 		}
+	}
+	node_first_primitive[data->nodes_count] = primitives.size();
 
-		m_num_vertices = geometry_data.vertices.size();
-		m_num_indices  = geometry_data.indices.size();
-
-		m_index_buf_size_bytes = m_num_indices * sizeof(unsigned int);
-		m_vertex_buf_size_bytes = m_num_vertices * sizeof(VertexData);
+	auto end_parse = clock::now();
 
-		model = geometry_data.world_mat;
+	/* Decode : image decoding and accessor unpacking are independent, run them all as jobs */
+	job_system::get_instance().parallel_for(textures.size() + primitives.size(), [&](size_t i)
+	{
+		if (i < textures.size())
+		{
+			decode_tex(textures[i]);
+		}
+		else
+		{
+			load_primitive(primitives[i - textures.size()]);
+		}
+	});
 
-		create_from_data(geometry_data.vertices, geometry_data.indices);
+	auto end_decode = clock::now();
 
-		//LOG_INFO("Loaded {} : {} Materials, {} Textures, Meshes : {} Point Lights: {}", filename, data->materials_count, data->textures_count, data->meshes_count);
+	/* Upload : everything touching Vulkan or the object manager stays on the main thread */
+	for (TextureImportData& import : textures)
+	{
+		upload_tex(import);
+	}
 
-		cgltf_free(data);
+	for (size_t i = 0; i < data->nodes_count; ++i)
+	{
+		std::span<PrimitiveImportData> node_primitives(primitives.data() + node_first_primitive[i], node_first_primitive[i + 1] - node_first_primitive[i]);
+		process_node(&data->nodes[i], nullptr, *this, node_primitives);
 	}
-	else
+
+	m_num_vertices = geometry_data.vertices.size();
+	m_num_indices  = geometry_data.indices.size();
+
+	model = geometry_data.world_mat;
+
+	create_from_data(geometry_data.vertices, geometry_data.indices);
+
+	auto end_upload = clock::now();
+
+	/* Before : one invocation per index with a non-indexed draw. LODs are left out. */
+	uint32_t num_source_indices = 0;
+	uint32_t num_source_invocations = 0;
+	uint32_t num_optimized_invocations = 0;
+	uint32_t num_lod_triangles[k_max_lods] = {};
+	for (const PrimitiveImportData& import : primitives)
 	{
-		LOG_ERROR("Could not read GLTF/GLB file. [error code : {0}]", result);
-		assert(false);
+		num_source_indices += 3 * import.source_stats.num_triangles;
+		num_source_invocations += import.source_stats.num_invocations;
+		num_optimized_invocations += import.optimized_stats.num_invocations;
+
+		/* Primitives without LODs count at full detail at every level */
+		for (uint32_t lod = 0; lod < k_max_lods; lod++)
+		{
+			num_lod_triangles[lod] += import.lods.empty() ? import.source_stats.num_triangles : import.lods[std::min<size_t>(lod, import.lods.size() - 1)].index_count / 3;
+		}
 	}
-	
-	auto end = std::chrono::steady_clock::now();
-	std::chrono::duration<double> elapsed_seconds = end-start;
-	LOG_WARN("Loaded GLTF model in {} s", elapsed_seconds.count());
+
+	LOG_INFO("Loaded {} : {} Primitives, {} Meshlets, {} LODs, {} Textures, {} Vertices, {} Indices", filename, primitives.size(), geometry_data.meshlets.size(), geometry_data.lods.size(),
+		textures.size(), m_num_vertices, m_num_indices);
+	LOG_INFO("Vertex shader invocations : {} non-indexed, {} indexed, {} optimized (ACMR {:.3f} -> {:.3f})", num_source_indices, num_source_invocations, num_optimized_invocations,
+		num_source_indices ? 3.0f * num_source_invocations / num_source_indices : 0.0f, num_source_indices ? 3.0f * num_optimized_invocations / num_source_indices : 0.0f);
+	static_assert(k_max_lods == 5);
+	LOG_INFO("Triangles per LOD : {} {} {} {} {}", num_lod_triangles[0], num_lod_triangles[1], num_lod_triangles[2], num_lod_triangles[3], num_lod_triangles[4]);
+	LOG_WARN("Loaded GLTF model in {:.2f} ms [parse {:.2f} ms | decode {:.2f} ms ({} threads) | upload {:.2f} ms]",
+		to_ms(end_upload - start), to_ms(end_parse - start), to_ms(end_decode - end_parse), job_system::get_instance().get_num_threads(), to_ms(end_upload - end_decode));
+
+	write_mesh_cache(mesh_cache::get_path(filename), *this, data);
+
+	cgltf_free(data);
 }
@@ -10,6 +10,7 @@
 #include <glm/mat4x4.hpp>
 #include <glm/gtx/hash.hpp>
 
+#include <limits>
 #include <span>
 #include <string>
 #include <vector>
@@ -23,6 +24,25 @@ struct VertexData
 	glm::vec3 uv;
 };
 
+/*
+	Compact vertex (16 bytes) for vertex pulling, see vertex.glsl unpack_vertex().
+	Positions are quantized to the bounds of their primitive, normals are octahedral encoded.
+*/
+struct PackedVertexData
+{
+	uint32_t pos_xy;	/* 2x unorm16 */
+	uint32_t pos_z;		/* unorm16, high half unused */
+	uint32_t normal;	/* 2x snorm16 */
+	uint32_t uv;		/* 2x half */
+};
+
+/* Layout of the vertex data of a mesh on the GPU. Values match VERTEX_FORMAT_* in vertex.glsl. */
+enum class VertexFormat : uint32_t
+{
+	FLOAT = 0,		/* VertexData */
+	PACKED = 1		/* PackedVertexData */
+};
+
 struct SimpleVertexData
 {
 	glm::vec3 pos;
@@ -40,17 +60,57 @@ struct Primitive
 	glm::vec3 world_center;
 	glm::mat4 model_world_center = glm::identity<glm::mat4>();
 
+	/* Bounds of the primitive vertices before model is applied. Empty (min > max) when unknown, such a primitive is never culled. */
+	glm::vec3 bbox_min_os = glm::vec3(std::numeric_limits<float>::max());
+	glm::vec3 bbox_max_os = glm::vec3(std::numeric_limits<float>::lowest());
+
+	/* Indices of the primitive are local to it : added to each of them when drawing (vertexOffset of indexed draws) */
+	uint32_t base_vertex = 0;
+
+	/* Range in GeometryData::meshlets, empty for primitives small enough to be culled as a whole */
+	uint32_t first_meshlet = 0;
+	uint32_t meshlet_count = 0;
+
+	/* Range in GeometryData::lods, the first one is the primitive itself. Empty for meshes created from raw data. */
+	uint32_t first_lod = 0;
+	uint32_t lod_count = 0;
+
 	// WIP
 	glm::mat4 offset;
 };
 
+/*
+	Cluster of triangles of a primitive, culled on its own on the GPU, see mesh_optimizer::build_meshlets().
+	Its triangles are a contiguous range of the index buffer : relative to the primitive on import, to the mesh once merged.
+*/
+struct Meshlet
+{
+	glm::vec4 bounding_sphere;	/* Object space center and radius */
+	glm::vec4 cone;				/* Normal cone axis and cutoff, a cutoff of 1 or more never culls */
+	uint32_t first_index;
+	uint32_t index_count;
+};
+
+/*
+	Simplified version of a primitive, see mesh_optimizer::simplify(). Its triangles index the vertices of the primitive
+	and are a contiguous range of the index buffer, after the ones of the primitive : relative to it on import, to the mesh once merged.
+*/
+struct PrimitiveLod
+{
+	uint32_t first_index;
+	uint32_t index_count;
+	float error;				/* Object space distance to the full detail primitive */
+};
+
 struct GeometryData
 {
 	std::vector<VertexData> vertices{};
-	std::vector<unsigned int> indices{};
+	std::vector<unsigned int> indices{};	/* Local to each primitive, see Primitive::base_vertex */
 	std::vector<Primitive>  primitives{};
-	std::vector<glm::vec4> punctual_lights_positions;
-	std::vector<glm::vec4> punctual_lights_colors;
+	std::vector<Meshlet> meshlets{};
+	std::vector<PrimitiveLod> lods{};
+	std::vector<point_light> point_lights;
+	std::vector<directional_light> directional_lights;
 
 
 	glm::mat4 world_mat = glm::identity<glm::mat4>();
@@ -87,9 +147,17 @@ struct VulkanMesh
 {
 	void create_from_file(const std::string& filename);
 	void create_from_file_gltf(const std::string& filename);
-	void create_from_data(std::span<VertexData> vertices, std::span<unsigned int> indices);
+	/* Returns false if the cache file is missing or invalid */
+	bool create_from_cache(const std::string& cache_filename);
+	void create_from_data(std::span<const VertexData> vertices, std::span<const unsigned int> indices);
 	void destroy();
 
+	/* The index data starts at m_vertex_buf_size_bytes in m_vertex_index_buffer */
+	void bind_index_buffer(VkCommandBuffer cmd_buffer) const;
+
+	/* Indexed draw of every primitive, or of all indices when the mesh has none. Transforms are left to the caller. */
+	void draw(VkCommandBuffer cmd_buffer, uint32_t instance_count = 1) const;
+
 	size_t m_vertex_buf_size_bytes;
 	size_t m_index_buf_size_bytes;
 	size_t m_num_vertices;
@@ -97,6 +165,12 @@ struct VulkanMesh
 
 	size_t material_id = 0;
 
+	/* Set before creating the mesh. Packing needs the primitives : meshes created from raw data stay FLOAT. */
+	VertexFormat vertex_format = VertexFormat::FLOAT;
+
+	/* UINT16 when every primitive references less than 65536 vertices, chosen in create_from_data() */
+	VkIndexType index_type = VK_INDEX_TYPE_UINT32;
+
 	glm::mat4 model;
 
 	/* Non-interleaved vertex and index data. Used for vertex pulling. */
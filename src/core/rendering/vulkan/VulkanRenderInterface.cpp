@@ -1,8 +1,14 @@
 #include "VulkanRenderInterface.h"
 #include "VulkanRendererBase.h"
 #include "core/rendering/vulkan/VkResourceManager.h"
+#include "core/rendering/vulkan/texture_streamer.h"
+#include "core/rendering/vulkan/pipeline_cache.h"
+#include "core/rendering/vulkan/shader_compiler.h"
 
 #include "core/engine/Window.h"
+#include "core/engine/vulkan/objects/vk_debug_marker.hpp"
+
+#include "optick.h"
 
 #include <vector>
 
@@ -10,16 +16,19 @@ vk::context ctx;
 
 static void GetInstanceExtensionNames(std::vector<const char*>& extensions);
 static void GetInstanceLayerNames(std::vector<const char*>& layers);
+static void init_optick_gpu();
 
 RenderInterface::RenderInterface(const char* name, int maj, int min, int patch)
 	: m_name(name), min_ver(min), maj_ver(maj), patch_ver(patch), m_init_success(false)
 {
 }
 
-void RenderInterface::init()
+void RenderInterface::init(bool headless)
 {
 	// Init Vulkan context
-	create_device();
+	create_device(headless);
+	pipeline_cache::get_instance().init(ctx.device);
+	shader_compiler::get_instance().init();
 
 	// Init frames
 	create_command_structures();
@@ -33,25 +42,77 @@ void RenderInterface::init()
 void RenderInterface::terminate()
 {
 	vkDeviceWaitIdle(ctx.device);
+	/* Destroys the query pools and command buffers of the Optick GPU profiler */
+	OPTICK_SHUTDOWN();
+	texture_streamer::get_instance().destroy();
+	ctx.uploader.destroy();
+	ctx.recorder.destroy();
+	ctx.profiler.destroy();
+	shader_compiler::get_instance().destroy();
+	pipeline_cache::get_instance().destroy();
 	VkResourceManager::get_instance(ctx.device)->destroy_all_resources();
 
 	for (uint32_t i = 0; i < NUM_FRAMES; i++)
 	{
 		destroy(ctx.device, ctx.frames[i]);
 	}
+	vkDestroySemaphore(ctx.device, ctx.frame_timeline_semaphore, nullptr);
 
 	vkDestroyCommandPool(ctx.device, ctx.temp_cmd_pool, nullptr);
 
 	ctx.swapchain->destroy();
-	vkDestroySurfaceKHR(ctx.device.instance, surface, nullptr);
+	if (surface != VK_NULL_HANDLE)
+	{
+		vkDestroySurfaceKHR(ctx.device.instance, surface, nullptr);
+	}
 
 	vkDestroyDevice(ctx.device, nullptr);
 	vkDestroyInstance(ctx.device.instance, nullptr);
 }
 
-void RenderInterface::create_device()
+void RenderInterface::create_device(bool headless)
+{
+	VK_CHECK(ctx.device.create(headless));
+	VkResourceManager::get_instance(ctx.device)->init_allocator(ctx.device.physical_device);
+	ctx.uploader.init(ctx.device);
+	ctx.recorder.init(ctx.device, ctx.device.queue_family_indices[vk::queue_family::graphics], NUM_FRAMES);
+	ctx.profiler.init(ctx.device, ctx.device.queue_family_indices[vk::queue_family::graphics], NUM_FRAMES);
+	init_optick_gpu();
+}
+
+/* GPU events of Optick captures (see vk::debug_marker), timed on the graphics queue */
+static void init_optick_gpu()
 {
-	ctx.device.create();
+#if USE_OPTICK
+	/* Optick declares the Vulkan prototypes with plain integer types instead of the Vulkan enums/typedefs */
+	Optick::VulkanFunctions functions =
+	{
+		.vkGetPhysicalDeviceProperties	= reinterpret_cast<PFN_vkGetPhysicalDeviceProperties_>(vkGetPhysicalDeviceProperties),
+		.vkCreateQueryPool				= reinterpret_cast<PFN_vkCreateQueryPool_>(vkCreateQueryPool),
+		.vkCreateCommandPool			= reinterpret_cast<PFN_vkCreateCommandPool_>(vkCreateCommandPool),
+		.vkAllocateCommandBuffers		= reinterpret_cast<PFN_vkAllocateCommandBuffers_>(vkAllocateCommandBuffers),
+		.vkCreateFence					= reinterpret_cast<PFN_vkCreateFence_>(vkCreateFence),
+		.vkCmdResetQueryPool			= reinterpret_cast<PFN_vkCmdResetQueryPool_>(vkCmdResetQueryPool),
+		.vkQueueSubmit					= reinterpret_cast<PFN_vkQueueSubmit_>(vkQueueSubmit),
+		.vkWaitForFences				= reinterpret_cast<PFN_vkWaitForFences_>(vkWaitForFences),
+		.vkResetCommandBuffer			= reinterpret_cast<PFN_vkResetCommandBuffer_>(vkResetCommandBuffer),
+		.vkCmdWriteTimestamp			= reinterpret_cast<PFN_vkCmdWriteTimestamp_>(vkCmdWriteTimestamp),
+		.vkGetQueryPoolResults			= reinterpret_cast<PFN_vkGetQueryPoolResults_>(vkGetQueryPoolResults),
+		.vkBeginCommandBuffer			= reinterpret_cast<PFN_vkBeginCommandBuffer_>(vkBeginCommandBuffer),
+		.vkEndCommandBuffer				= reinterpret_cast<PFN_vkEndCommandBuffer_>(vkEndCommandBuffer),
+		.vkResetFences					= reinterpret_cast<PFN_vkResetFences_>(vkResetFences),
+		.vkDestroyCommandPool			= reinterpret_cast<PFN_vkDestroyCommandPool_>(vkDestroyCommandPool),
+		.vkDestroyQueryPool				= reinterpret_cast<PFN_vkDestroyQueryPool_>(vkDestroyQueryPool),
+		.vkDestroyFence					= reinterpret_cast<PFN_vkDestroyFence_>(vkDestroyFence),
+		.vkFreeCommandBuffers			= reinterpret_cast<PFN_vkFreeCommandBuffers_>(vkFreeCommandBuffers),
+	};
+
+	VkDevice device = ctx.device;
+	VkPhysicalDevice physical_device = ctx.device.physical_device;
+	VkQueue queue = ctx.device.graphics_queue;
+	uint32_t queue_family = ctx.device.queue_family_indices[vk::queue_family::graphics];
+	OPTICK_GPU_INIT_VULKAN(&device, &physical_device, &queue, &queue_family, 1, &functions);
+#endif
 }
 
 void RenderInterface::create_command_structures()
@@ -75,13 +136,21 @@ void RenderInterface::create_synchronization_structures()
 		VK_CHECK(vkCreateSemaphore(ctx.device, &semaphoreInfo, nullptr, &ctx.frames[i].semaphore_swapchain_acquire));
 		VK_CHECK(vkCreateSemaphore(ctx.device, &semaphoreInfo, nullptr, &ctx.frames[i].smp_queue_submitted));
 	}
+
+	VkSemaphoreTypeCreateInfo timeline_type_info = { .sType = VK_STRUCTURE_TYPE_SEMAPHORE_TYPE_CREATE_INFO, .semaphoreType = VK_SEMAPHORE_TYPE_TIMELINE, .initialValue = 0 };
+	VkSemaphoreCreateInfo timeline_info = { .sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO, .pNext = &timeline_type_info };
+	VK_CHECK(vkCreateSemaphore(ctx.device, &timeline_info, nullptr, &ctx.frame_timeline_semaphore));
+	vk::set_object_name(VK_OBJECT_TYPE_SEMAPHORE, (uint64_t)ctx.frame_timeline_semaphore, "Frame Timeline Semaphore");
+	ctx.uploader.set_frame_timeline(ctx.frame_timeline_semaphore);
 }
 
+#ifdef _WIN32
 struct WindowData
 {
 	HWND hWnd;
 	HINSTANCE hInstance;
 };
+#endif // _WIN32
 
 void RenderInterface::create_surface(Window* window)
 {
@@ -112,6 +181,14 @@ void RenderInterface::create_swapchain()
 	                        VulkanRendererCommon::get_instance().swapchain_depth_format);
 }
 
+void RenderInterface::create_offscreen_targets(uint32_t width, uint32_t height)
+{
+	ctx.swapchain.reset(new vk::swapchain());
+	ctx.swapchain->init_offscreen(width, height,
+	                              VulkanRendererCommon::get_instance().swapchain_color_format,
+	                              VulkanRendererCommon::get_instance().swapchain_depth_format);
+}
+
 vk::frame& RenderInterface::get_current_frame()
 {
 	return ctx.frames[ctx.frame_count % NUM_FRAMES];
@@ -151,6 +228,9 @@ vk::frame& RenderInterface::get_current_frame()
 
 	VK_CHECK(vkBeginCommandBuffer(temp_cmd_buffer, &beginInfo));
 
+	/* Images uploaded so far must be owned by the graphics queue before one-shot work touches them */
+	ctx.uploader.record_acquires(temp_cmd_buffer);
+
 	return temp_cmd_buffer;
 }
 
@@ -158,11 +238,27 @@ void end_temp_cmd_buffer(VkCommandBuffer cmd_buffer)
 {
 	VK_CHECK(vkEndCommandBuffer(cmd_buffer));
 
-	/* Submit commands and signal fence when done */
+	/* Submit commands and signal fence when done, after pending uploads have landed */
+	vk::upload_handle uploads = ctx.uploader.flush();
+	VkSemaphore timeline_semaphore = ctx.uploader.get_timeline_semaphore();
+	VkPipelineStageFlags wait_stage = VK_PIPELINE_STAGE_ALL_COMMANDS_BIT;
+
+	VkTimelineSemaphoreSubmitInfo timeline_info = {};
+	timeline_info.sType = VK_STRUCTURE_TYPE_TIMELINE_SEMAPHORE_SUBMIT_INFO;
+	timeline_info.waitSemaphoreValueCount = 1;
+	timeline_info.pWaitSemaphoreValues = &uploads.value;
+
 	VkSubmitInfo submit_info = {};
 	submit_info.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
 	submit_info.commandBufferCount = 1;
 	submit_info.pCommandBuffers = &cmd_buffer;
+	if (uploads.is_valid())
+	{
+		submit_info.pNext = &timeline_info;
+		submit_info.waitSemaphoreCount = 1;
+		submit_info.pWaitSemaphores = &timeline_semaphore;
+		submit_info.pWaitDstStageMask = &wait_stage;
+	}
 
 	VkFenceCreateInfo submit_fence_info
 	{
@@ -375,15 +471,12 @@ void Pipeline::create_graphics(VertexFragmentShader& shader, uint32_t numColorAt
 		.primitiveRestartEnable = VK_FALSE
 	};
 
-	VkViewport viewport = { .x = 0, .y = 0, .width = 0, .height = 0, .minDepth=0.0f, .maxDepth=1.0f };
-
-	VkRect2D scissor = { .offset = {0,0}, .extent = {.width = (uint32_t)viewport.width, .height = (uint32_t)viewport.height } };
-
+	/* Viewport and scissor are dynamic states */
 	viewportState.sType = VK_STRUCTURE_TYPE_PIPELINE_VIEWPORT_STATE_CREATE_INFO;
 	viewportState.viewportCount = 1;
-	viewportState.pViewports = &viewport;
+	viewportState.pViewports = nullptr;
 	viewportState.scissorCount = 1;
-	viewportState.pScissors = &scissor;
+	viewportState.pScissors = nullptr;
 
 	raster_state_info.sType = VK_STRUCTURE_TYPE_PIPELINE_RASTERIZATION_STATE_CREATE_INFO;
 	raster_state_info.polygonMode = polygonMode;
@@ -472,7 +565,15 @@ void Pipeline::create_graphics(VertexFragmentShader& shader, uint32_t numColorAt
 		.basePipelineIndex=0
 	};
 
-	VK_CHECK(vkCreateGraphicsPipelines(ctx.device, VK_NULL_HANDLE, 1, &graphics_pipeline_create_info, nullptr, &pipeline));
+	shader_compiler::get_instance().add_pipeline(this);
+
+	if (pipeline_cache::get_instance().is_batching())
+	{
+		pipeline_cache::get_instance().enqueue(this);
+		return;
+	}
+
+	create_vk_pipeline();
 
 	/* Add to resource manager */
 	VkResourceManager::get_instance(ctx.device)->add_pipeline(pipeline);
@@ -489,12 +590,34 @@ void Pipeline::create_compute(ComputeShader& shader)
 	compute_pipeline_create_info.stage = shader.stages[0];
 	compute_pipeline_create_info.layout = layout;
 
-	VK_CHECK(vkCreateComputePipelines(ctx.device, VK_NULL_HANDLE, 1, &compute_pipeline_create_info, nullptr, &pipeline));
+	shader_compiler::get_instance().add_pipeline(this);
+
+	if (pipeline_cache::get_instance().is_batching())
+	{
+		pipeline_cache::get_instance().enqueue(this);
+		return;
+	}
+
+	create_vk_pipeline();
 
 	/* Add to resource manager */
 	VkResourceManager::get_instance(ctx.device)->add_pipeline(pipeline);
 }
 
+void Pipeline::create_vk_pipeline()
+{
+	VkPipelineCache cache = pipeline_cache::get_instance().get();
+
+	if (is_graphics)
+	{
+		VK_CHECK(vkCreateGraphicsPipelines(ctx.device, cache, 1, &graphics_pipeline_create_info, nullptr, &pipeline));
+	}
+	else
+	{
+		VK_CHECK(vkCreateComputePipelines(ctx.device, cache, 1, &compute_pipeline_create_info, nullptr, &pipeline));
+	}
+}
+
 bool Pipeline::reload_pipeline()
 {
 	VkPipeline ppl;
@@ -507,7 +630,7 @@ bool Pipeline::reload_pipeline()
 			return false;
 		}
 
-		result = vkCreateGraphicsPipelines(ctx.device, VK_NULL_HANDLE, 1, &graphics_pipeline_create_info, nullptr, &ppl);
+		result = vkCreateGraphicsPipelines(ctx.device, pipeline_cache::get_instance().get(), 1, &graphics_pipeline_create_info, nullptr, &ppl);
 
 	}
 	else // Compute pipeline
@@ -518,7 +641,7 @@ bool Pipeline::reload_pipeline()
 		}
 
 		compute_pipeline_create_info.stage = h_compute_shader->stages[0];
-		result = vkCreateComputePipelines(ctx.device, VK_NULL_HANDLE, 1, &compute_pipeline_create_info, nullptr, &ppl);
+		result = vkCreateComputePipelines(ctx.device, pipeline_cache::get_instance().get(), 1, &compute_pipeline_create_info, nullptr, &ppl);
 	}
 
 	if (result == VK_SUCCESS)
@@ -535,6 +658,9 @@ bool Pipeline::reload_pipeline()
 
 void Pipeline::bind(VkCommandBuffer cmd_buffer) const
 {
+	/* Null while queued in a pipeline_cache batch : see pipeline_cache::create_pending() */
+	assert(pipeline != VK_NULL_HANDLE);
+
 	VkPipelineBindPoint bind_point = is_graphics ? VK_PIPELINE_BIND_POINT_GRAPHICS : VK_PIPELINE_BIND_POINT_COMPUTE;
 	vkCmdBindPipeline(cmd_buffer, bind_point, pipeline);
 }
@@ -37,13 +37,15 @@ class RenderInterface
 public:
 	RenderInterface(const char* name, int maj, int min, int patch);
 
-	void init();
+	/* headless : no surface nor swapchain, call create_offscreen_targets() instead of create_surface/create_swapchain */
+	void init(bool headless = false);
 	void terminate();
 	bool m_init_success;
 
-	void create_device();
+	void create_device(bool headless = false);
 	void create_surface(Window* window);
 	void create_swapchain();
+	void create_offscreen_targets(uint32_t width, uint32_t height);
 
 	void create_command_structures();
 	void create_synchronization_structures();
@@ -55,7 +57,7 @@ public:
 
 	static inline VkPhysicalDeviceLimits device_limits = {};
 
-	VkSurfaceKHR surface;
+	VkSurfaceKHR surface = VK_NULL_HANDLE;
 
 private:
 
@@ -151,7 +153,7 @@ struct Pipeline
 
 	} layout;
 
-	VkPipeline pipeline;
+	VkPipeline pipeline = VK_NULL_HANDLE;
 
 	operator VkPipeline() { return pipeline; }
 
@@ -163,6 +165,9 @@ struct Pipeline
 	void create_compute(ComputeShader& shader);
 	bool reload_pipeline();
 
+	/* Creates pipeline from the saved create info, through the pipeline cache. Thread safe, see pipeline_cache::create_pending(). */
+	void create_vk_pipeline();
+
 	void bind(VkCommandBuffer cmd_buffer) const;
 
 	bool is_graphics = false;
@@ -3,12 +3,11 @@
 #include "core/engine/logger.h"
 #include "core/rendering/vulkan/VkResourceManager.h"
 #include "VulkanRenderInterface.h"
+#include "shader_compiler.h"
 
-static constexpr uint32_t SPIRV_FOURCC = 0x07230203;
+#include <cerrno>
 
-static std::string shader_src_folder("../../../data/shaders/vulkan/");
-static std::string shader_spirv_folder("../../../data/shaders/vulkan/spirv/");
-static std::string shader_header_folder("../../../data/shaders/vulkan/headers/");
+static constexpr uint32_t SPIRV_FOURCC = 0x07230203;
 
 static VkPipelineShaderStageCreateInfo pipeline_shader_stage_create_info(VkShaderModule shaderModule, VkShaderStageFlagBits shaderStage, const char* entryPoint)
 {
@@ -35,12 +34,11 @@ bool Shader::create_shader_module(const VkShaderStageFlagBits stage, std::string
 		return false;
 	}
 
-	FILE* fp = nullptr;
-	errno_t fopenresult = fopen_s(&fp, (shader_spirv_folder + spirv_filename.data()).c_str(), "rb");
+	FILE* fp = fopen((shader_compiler::spirv_folder + spirv_filename.data()).c_str(), "rb");
 	
 	if (fp == nullptr)
 	{
-		LOG_ERROR("Cannot open shader file {0} : {1}.", spirv_filename, strerror(fopenresult));
+		LOG_ERROR("Cannot open shader file {0} : {1}.", spirv_filename, strerror(errno));
 		assert(false);
 	}
 
@@ -116,17 +114,7 @@ bool VertexFragmentShader::compile()
 
 bool Shader::compile(std::string_view shader_file)
 {
-	char command[1500];
-
-	std::string src_path = shader_src_folder + shader_file.data();
-	std::string dst_path = shader_spirv_folder + shader_file.data() + ".spv";
-	std::string header_path = shader_header_folder;
-
-	sprintf(command, "%s\\Bin\\glslc.exe %s -g -I %s -o %s", std::getenv("VULKAN_SDK"), src_path.c_str(), header_path.c_str(), dst_path.c_str());
-
-	bool result = system(command);
-
-	return result == 0;
+	return shader_compiler::get_instance().compile_to_file(shader_file);
 }
 
 bool VertexFragmentShader::recreate_modules()
@@ -1,13 +1,19 @@
 #include "VulkanTexture.h"
 
 #include "core/engine/Image.h"
+#include "core/engine/dds.h"
 #include "core/rendering/vulkan/VkResourceManager.h"
 #include "core/rendering/vulkan/VulkanRenderInterface.h"
 #include "core/engine/vulkan/objects/vk_debug_marker.hpp"
 
+#include "optick.h"
+
+#include <algorithm>
+
 static VkAccessFlags get_src_access_mask(VkImageLayout layout);
 
 static uint32_t GetBytesPerPixelFromFormat(VkFormat format);
+static VkDeviceSize GetImageSizeBytesFromFormat(VkFormat format, uint32_t width, uint32_t height);
 static void GetSrcDstPipelineStage(VkImageLayout oldLayout, VkImageLayout newLayout, VkPipelineStageFlags& out_srcStageMask, VkPipelineStageFlags& out_dstStageMask);
 
 static uint32_t calc_mip_levels(uint32_t width, uint32_t height)
@@ -48,6 +54,8 @@ void Texture2D::create_from_file(
     bool                use_mipmaps
 )
 {
+    OPTICK_EVENT();
+
     Image image;
     image.load_from_file(filename);
 
@@ -59,7 +67,7 @@ void Texture2D::create_from_file(
     create_view(ctx.device, ImageViewTexture2D);
 }
 
-void Texture2D::create_from_data(
+vk::upload_handle Texture2D::create_from_data(
     void*               data,
     int                 data_size_bytes,
     VkImageUsageFlags	imageUsage,
@@ -67,28 +75,73 @@ void Texture2D::create_from_data(
 {
 	assert(initialized);
     create_vk_image(ctx.device, false, imageUsage);
-    
-    transition_immediate(VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_ACCESS_TRANSFER_WRITE_BIT);
-
-    upload_data(ctx.device, data, data_size_bytes);
-
-    if (info.mipLevels > 1)
-    {
-        generate_mipmaps();
-    }
-    else
-    {
-        transition_immediate(VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, VK_ACCESS_SHADER_READ_BIT);
-    }
 
+    /* Mips are generated from level 0 once the upload lands */
+    return upload_data(data, data_size_bytes, layout);
 }
 
-void Texture2D::create_from_data(
+vk::upload_handle Texture2D::create_from_data(
 	Image*               image,
 	VkImageUsageFlags	imageUsage,
 	VkImageLayout		layout)
 {
-	create_from_data(image->get_data(), image->data_size_bytes, imageUsage, layout);
+	return create_from_data(image->get_data(), image->data_size_bytes, imageUsage, layout);
+}
+
+vk::upload_handle Texture2D::create_from_data(
+    const compressed_image& compressed,
+    VkImageUsageFlags	imageUsage,
+    VkImageLayout		layout)
+{
+    assert(initialized);
+    assert(info.imageFormat == compressed.format);
+
+    /* Mip chain comes pre-built with the image : no runtime generation. Mips before first_mip are left out of the image. */
+    info.width = std::max(1u, compressed.w >> compressed.first_mip);
+    info.height = std::max(1u, compressed.h >> compressed.first_mip);
+    info.mipLevels = compressed.mip_levels - compressed.first_mip;
+    info.mipImageLayouts.resize(info.mipLevels);
+    std::fill(info.mipImageLayouts.begin(), info.mipImageLayouts.end(), VK_IMAGE_LAYOUT_UNDEFINED);
+
+    create_vk_image(ctx.device, false, imageUsage);
+
+    std::vector<VkBufferImageCopy> regions(info.mipLevels);
+    for (uint32_t mip = 0; mip < info.mipLevels; mip++)
+    {
+        regions[mip] =
+        {
+            .bufferOffset       { compressed.mip_offsets[compressed.first_mip + mip] },
+            .bufferRowLength    { 0 },
+            .bufferImageHeight  { 0 },
+            .imageSubresource
+            {
+                .aspectMask     { VK_IMAGE_ASPECT_COLOR_BIT },
+                .mipLevel       { mip },
+                .baseArrayLayer { 0 },
+                .layerCount     { 1 }
+            },
+            .imageOffset {.x = 0, .y = 0, .z = 0 },
+            .imageExtent { std::max(1u, info.width >> mip), std::max(1u, info.height >> mip), 1 }
+        };
+    }
+
+    vk::image_upload_info upload_info =
+    {
+        .image = image,
+        .aspect = info.aspect,
+        .width = info.width,
+        .height = info.height,
+        .mip_levels = info.mipLevels,
+        .layer_count = info.layerCount,
+        .regions = regions,
+        .generate_mips = false,
+        .final_layout = layout
+    };
+
+    info.imageLayout = layout;
+    std::fill(info.mipImageLayouts.begin(), info.mipImageLayouts.end(), layout);
+
+    return ctx.uploader.upload(upload_info, compressed.data.data(), compressed.data.size());
 }
 
 void Texture2D::create(VkDevice device, VkImageUsageFlags imageUsage)
@@ -135,52 +188,23 @@ void Texture::create_vk_image(VkDevice device, bool isCubemap, VkImageUsageFlags
     // Image memory
     VkMemoryRequirements imageMemReq = {};
     vkGetImageMemoryRequirements(device, image, &imageMemReq);
-    
-    VkMemoryAllocateInfo allocInfo =
-    {
-        .sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO,
-        .allocationSize = imageMemReq.size,
-        .memoryTypeIndex = ctx.device.find_memory_type(imageMemReq.memoryTypeBits, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT)
-    };
-    
-    VK_CHECK(vkAllocateMemory(device, &allocInfo, nullptr, &deviceMemory));
-    VK_CHECK(vkBindImageMemory(device, image, deviceMemory, 0));
 
-    /* Add to resource manager */
-    hash = VkResourceManager::get_instance(device)->add_image(image, deviceMemory);
+    VkResourceManager* resource_manager = VkResourceManager::get_instance(device);
+    vk::allocation allocation = resource_manager->get_allocator().allocate(imageMemReq, vk::memory_usage::GPU_ONLY, vk::memory_allocator::resource_kind::OPTIMAL, info.debugName);
+    assert(allocation.is_valid());
+    deviceMemory = allocation.memory;
 
-    vk::set_object_name(VK_OBJECT_TYPE_IMAGE, (uint64_t)image, info.debugName);
-}
+    VK_CHECK(vkBindImageMemory(device, image, deviceMemory, allocation.offset));
 
-void Texture::copy_from_buffer(VkCommandBuffer cmdBuffer, VkBuffer srcBuffer)
-{
-	VkBufferImageCopy imageRegion =
-	{
-		.bufferOffset       { 0 },
-		.bufferRowLength    { 0 },
-		.bufferImageHeight  { 0 },
-		.imageSubresource
-		{
-			.aspectMask     { VK_IMAGE_ASPECT_COLOR_BIT },
-			.mipLevel       { 0 },
-			.baseArrayLayer { 0 },
-			.layerCount     { info.layerCount }
-		},
-		.imageOffset {.x = 0, .y = 0, .z = 0 },
-		.imageExtent { info.width, info.height, 1 }
-	};
+    /* Add to resource manager */
+    hash = resource_manager->add_image(image, allocation);
 
-	vkCmdCopyBufferToImage(
-		cmdBuffer,
-		srcBuffer,
-		image,
-		VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &imageRegion);
+    vk::set_object_name(VK_OBJECT_TYPE_IMAGE, (uint64_t)image, info.debugName);
 }
 
-void Texture::upload_data(VkDevice device, void* data, int data_size_bytes)
+vk::upload_handle Texture::upload_data(const void* data, int data_size_bytes, VkImageLayout final_layout)
 {
-    uint32_t bpp = GetBytesPerPixelFromFormat(info.imageFormat);
-    VkDeviceSize layer_size_bytes = info.width * info.height * bpp;
+    VkDeviceSize layer_size_bytes = GetImageSizeBytesFromFormat(info.imageFormat, info.width, info.height);
     VkDeviceSize image_size_bytes = layer_size_bytes * info.layerCount;
 
     if (data_size_bytes != -1)
@@ -188,15 +212,41 @@ void Texture::upload_data(VkDevice device, void* data, int data_size_bytes)
         image_size_bytes = std::min((int)image_size_bytes, data_size_bytes);
     }
 
-    // Create temp CPU-GPU visible buffer holding image data 
-    vk::buffer staging_buffer;
-	staging_buffer.init(vk::buffer::type::STAGING, image_size_bytes, "Image Staging Buffer");
-    staging_buffer.create();
-	staging_buffer.upload(ctx.device, data, 0, image_size_bytes);
+    /* Level 0 of every layer, the rest of the chain is blitted from it */
+    VkBufferImageCopy region =
+    {
+        .bufferOffset       { 0 },
+        .bufferRowLength    { 0 },
+        .bufferImageHeight  { 0 },
+        .imageSubresource
+        {
+            .aspectMask     { info.aspect },
+            .mipLevel       { 0 },
+            .baseArrayLayer { 0 },
+            .layerCount     { info.layerCount }
+        },
+        .imageOffset {.x = 0, .y = 0, .z = 0 },
+        .imageExtent { info.width, info.height, 1 }
+    };
+
+    vk::image_upload_info upload_info =
+    {
+        .image = image,
+        .aspect = info.aspect,
+        .width = info.width,
+        .height = info.height,
+        .mip_levels = info.mipLevels,
+        .layer_count = info.layerCount,
+        .regions = { &region, 1 },
+        .generate_mips = info.mipLevels > 1,
+        .final_layout = final_layout
+    };
 
-    VkCommandBuffer cmd_buffer = begin_temp_cmd_buffer();
-    copy_from_buffer(cmd_buffer, staging_buffer);
-    end_temp_cmd_buffer(cmd_buffer);
+    /* Layout the image has once the upload is acquired on the graphics queue */
+    info.imageLayout = final_layout;
+    std::fill(info.mipImageLayouts.begin(), info.mipImageLayouts.end(), final_layout);
+
+    return ctx.uploader.upload(upload_info, data, image_size_bytes);
 }
 
 void Texture::create_view(VkDevice device, const ImageViewInitInfo& viewInfo)
@@ -234,6 +284,21 @@ void Texture::destroy()
     *this = {};
 }
 
+void Texture::retire()
+{
+    if (view_hash)
+    {
+        VkResourceManager::get_instance(ctx.device)->retire_image_view(view_hash, ctx.frame_count);
+    }
+
+    if (hash)
+    {
+        VkResourceManager::get_instance(ctx.device)->retire_image(hash, ctx.frame_count);
+    }
+
+    *this = {};
+}
+
 void Texture::generate_mipmaps()
 {
     //   VkCommandBuffer cbuf = begin_temp_cmd_buffer();
@@ -410,6 +475,66 @@ void Texture::transition(VkCommandBuffer cmdBuffer, VkImageLayout new_layout, Vk
     }
 }
 
+void Texture::barrier(VkCommandBuffer cmd_buffer, VkImageLayout new_layout, VkPipelineStageFlags2 src_stage, VkAccessFlags2 src_access, VkPipelineStageFlags2 dst_stage, VkAccessFlags2 dst_access, VkImageSubresourceRange* subresourceRange)
+{
+    VkImageLayout old_layout = subresourceRange ? info.mipImageLayouts[subresourceRange->baseMipLevel] : info.imageLayout;
+
+    VkImageAspectFlags aspect = info.aspect;
+    if ((info.imageFormat == VK_FORMAT_D16_UNORM) || (info.imageFormat == VK_FORMAT_X8_D24_UNORM_PACK32) || (info.imageFormat == VK_FORMAT_D32_SFLOAT))
+    {
+        aspect = VK_IMAGE_ASPECT_DEPTH_BIT;
+    }
+    else if ((info.imageFormat == VK_FORMAT_D16_UNORM_S8_UINT) || (info.imageFormat == VK_FORMAT_D24_UNORM_S8_UINT) || (info.imageFormat == VK_FORMAT_D32_SFLOAT_S8_UINT))
+    {
+        aspect = VK_IMAGE_ASPECT_DEPTH_BIT | VK_IMAGE_ASPECT_STENCIL_BIT;
+    }
+
+    VkImageMemoryBarrier2 image_barrier =
+    {
+        .sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER_2,
+        .srcStageMask = src_stage,
+        .srcAccessMask = src_access,
+        .dstStageMask = dst_stage,
+        .dstAccessMask = dst_access,
+        .oldLayout = old_layout,
+        .newLayout = new_layout,
+        .srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+        .dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+        .image = image,
+        .subresourceRange = subresourceRange ? *subresourceRange :
+        VkImageSubresourceRange
+        {
+            .aspectMask = aspect,
+            .baseMipLevel = 0,
+            .levelCount = info.mipLevels,
+            .baseArrayLayer = 0,
+            .layerCount = info.layerCount,
+        }
+    };
+
+    VkDependencyInfo dependency_info = { .sType = VK_STRUCTURE_TYPE_DEPENDENCY_INFO, .imageMemoryBarrierCount = 1, .pImageMemoryBarriers = &image_barrier };
+    vkCmdPipelineBarrier2(cmd_buffer, &dependency_info);
+
+    if (subresourceRange)
+    {
+        for (uint32_t i = 0; i < subresourceRange->levelCount; i++)
+        {
+            info.mipImageLayouts[subresourceRange->baseMipLevel + i] = new_layout;
+        }
+
+        /* Whole image in the same layout once every mip has been transitioned */
+        if (std::all_of(info.mipImageLayouts.begin(), info.mipImageLayouts.end(), [new_layout](VkImageLayout layout) { return layout == new_layout; }))
+        {
+            info.imageLayout = new_layout;
+        }
+    }
+    else
+    {
+        info.imageLayout = new_layout;
+        std::fill(info.mipImageLayouts.begin(), info.mipImageLayouts.end(), new_layout);
+    }
+}
+
 /* The image layout transition is executed immediately */
 void Texture::transition_immediate(VkImageLayout new_layout, VkAccessFlags dst_access_mask, VkImageSubresourceRange* subresourceRange)
 {
@@ -452,6 +577,18 @@ VkAccessFlags get_src_access_mask(VkImageLayout layout)
     return VK_ACCESS_NONE;
 }
 
+VkDeviceSize GetImageSizeBytesFromFormat(VkFormat format, uint32_t width, uint32_t height)
+{
+    /* Block-compressed formats store 4x4 texel blocks, partial blocks on the edges take a full block */
+    uint32_t block_size_bytes = dds::get_block_size_bytes(format);
+    if (block_size_bytes)
+    {
+        return dds::get_mip_size_bytes(format, width, height);
+    }
+
+    return VkDeviceSize(width) * height * GetBytesPerPixelFromFormat(format);
+}
+
 uint32_t GetBytesPerPixelFromFormat(VkFormat format)
 {
     switch (format)
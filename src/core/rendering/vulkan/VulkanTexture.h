@@ -3,8 +3,10 @@
 #include <vulkan/vulkan.hpp>
 #include <string_view>
 #include "core/engine/common.h"
+#include "core/engine/vulkan/vk_upload_service.h"
 
 class Image;
+struct compressed_image;
 
 struct TextureInfo
 {
@@ -61,12 +63,16 @@ struct Texture
 	TextureInfo			  info;
 
 	void create_view(VkDevice device, const ImageViewInitInfo& info);
-	void copy_from_buffer(VkCommandBuffer cmdBuffer, VkBuffer srcBuffer);
-	void upload_data(VkDevice device, void* data, int data_size_bytes);
+	/* Queues data for mip 0 of every layer on the upload service. The image is in final_layout once the upload is acquired. */
+	vk::upload_handle upload_data(const void* data, int data_size_bytes, VkImageLayout final_layout);
 	void transition(VkCommandBuffer cmdBuffer, VkImageLayout new_layout, VkAccessFlags dst_access_mask, VkImageSubresourceRange* subresourceRange = nullptr);
 	void transition_immediate(VkImageLayout new_layout, VkAccessFlags dst_access_mask, VkImageSubresourceRange* subresourceRange = nullptr);
+	/* Layout transition with explicit stages and accesses, for uses the layout alone does not tell (e.g compute reads of a depth attachment). Emitted even if the layout does not change. */
+	void barrier(VkCommandBuffer cmd_buffer, VkImageLayout new_layout, VkPipelineStageFlags2 src_stage, VkAccessFlags2 src_access, VkPipelineStageFlags2 dst_stage, VkAccessFlags2 dst_access, VkImageSubresourceRange* subresourceRange = nullptr);
 
 	void destroy();
+	/* Destroyed once the frames in flight have completed, see VkResourceManager::retire_image */
+	void retire();
 	void generate_mipmaps();
 
 	/* Create and allocated memory for a Vulkan image */
@@ -95,17 +101,23 @@ struct Texture2D : public Texture
 		bool                use_mipmaps = false
 	);
 
-	void create_from_data(
+	vk::upload_handle create_from_data(
 		void*				data,
 		int                 data_size_bytes,
 		VkImageUsageFlags	imageUsage = VK_IMAGE_USAGE_SAMPLED_BIT,
 		VkImageLayout		layout     = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
 
-	void create_from_data(
+	vk::upload_handle create_from_data(
 		Image*				pImage,
 		VkImageUsageFlags	imageUsage = VK_IMAGE_USAGE_SAMPLED_BIT,
 		VkImageLayout		layout     = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
 
+	/* Uploads every loaded mip level of a block-compressed image, no mip generation. The image starts at compressed.first_mip. */
+	vk::upload_handle create_from_data(
+		const compressed_image& compressed,
+		VkImageUsageFlags	imageUsage = VK_IMAGE_USAGE_SAMPLED_BIT,
+		VkImageLayout		layout     = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+
 	void create(VkDevice device, VkImageUsageFlags imageUsage);
 
 
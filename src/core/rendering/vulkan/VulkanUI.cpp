@@ -2,6 +2,7 @@
 #include "core/rendering/Camera.h"
 #include "core/rendering/FrameCounter.h"
 #include "core/rendering/vulkan/RenderObjectManager.h"
+#include "core/rendering/vulkan/VkResourceManager.h"
 #include "core/rendering/vulkan/VulkanRendererBase.h"
 #include "core/rendering/vulkan/VulkanUI.h"
 
@@ -46,6 +47,29 @@ void VulkanGUI::show_toolbar()
 static Primitive* selected_primitive = nullptr;
 static VulkanMesh* selected_mesh = nullptr;
 
+/* Selects the primitive whose box is the closest under the cursor, through the scene BVH */
+static void pick_primitive(const glm::vec2& cursor_uv, const camera& camera, ObjectManager& object_manager)
+{
+	/* The scene is rendered with a flipped viewport : NDC y = 1 is the first row */
+	glm::vec2 ndc = { cursor_uv.x * 2.0f - 1.0f, 1.0f - cursor_uv.y * 2.0f };
+	glm::mat4 inv_view_proj = glm::inverse(camera.projection * camera.view);
+	glm::vec4 near_ws = inv_view_proj * glm::vec4(ndc, 0.0f, 1.0f);
+	glm::vec4 far_ws = inv_view_proj * glm::vec4(ndc, 1.0f, 1.0f);
+	glm::vec3 origin = glm::vec3(near_ws) / near_ws.w;
+	glm::vec3 direction = glm::vec3(far_ws) / far_ws.w - origin;
+
+	uint32_t item = 0;
+	float distance = 0.0f;
+	if (object_manager.get_scene_bvh().raycast(origin, glm::normalize(direction), glm::length(direction), item, distance))
+	{
+		const ObjectManager::GPUPrimitive& primitive = object_manager.m_primitives[object_manager.m_scene_items[item].primitive_idx];
+		size_t prim_idx = object_manager.m_scene_items[item].primitive_idx - object_manager.m_mesh_draw_data[primitive.mesh_idx].first_primitive;
+
+		selected_mesh = &object_manager.m_meshes[primitive.mesh_idx];
+		selected_primitive = &selected_mesh->geometry_data.primitives[prim_idx];
+	}
+}
+
 void VulkanGUI::show_hierarchy(ObjectManager& object_manager)
 {
 	ImGui::ShowDemoWindow();
@@ -151,6 +175,15 @@ void VulkanGUI::show_draw_metrics()
 		ImGui::BulletText("Draw calls : %u", DrawMetricsManager::num_drawcalls[i]);
 		ImGui::BulletText("Num Vertices : %u", DrawMetricsManager::num_vertices[i]);
 		ImGui::BulletText("Num Instances : %u", DrawMetricsManager::num_instances[i]);
+		if (DrawMetricsManager::vertex_data_kb[i] > 0)
+		{
+			ImGui::BulletText("Vertex Data : %.2f MB", DrawMetricsManager::vertex_data_kb[i] / 1024.0f);
+		}
+		ImGui::BulletText("CPU Record : %.3f ms", DrawMetricsManager::cpu_record_ms[i]);
+		if (DrawMetricsManager::num_visible[i] + DrawMetricsManager::num_culled[i] > 0)
+		{
+			ImGui::BulletText("Visible / Culled : %u / %u", DrawMetricsManager::num_visible[i], DrawMetricsManager::num_culled[i]);
+		}
 
 		ImGui::Unindent();
 	}
@@ -159,6 +192,17 @@ void VulkanGUI::show_draw_metrics()
 	ImGui::BulletText("Draw calls : %u", DrawMetricsManager::total_drawcalls);
 	ImGui::BulletText("Num Vertices : %u", DrawMetricsManager::total_vertices);
 	ImGui::BulletText("Num Instances : %u", DrawMetricsManager::total_instances);
+	ImGui::BulletText("Vertex Data : %.2f MB", DrawMetricsManager::total_vertex_data_kb / 1024.0f);
+	ImGui::BulletText("CPU Record : %.3f ms", DrawMetricsManager::total_cpu_record_ms);
+	ImGui::BulletText("Visible / Culled : %u / %u", DrawMetricsManager::total_visible, DrawMetricsManager::total_culled);
+
+	VkResourceManager* resource_manager = VkResourceManager::get_instance(ctx.device);
+	ImGui::Text("Pending destruction:");
+	for (const VkResourceManager::retired_stats& stats : resource_manager->get_retired_stats())
+	{
+		ImGui::BulletText("Frame %u : %u resources, %.2f MB", stats.frame, stats.count, stats.size_bytes / (1024.0 * 1024.0));
+	}
+	ImGui::BulletText("Destroyed this frame : %u", resource_manager->get_num_destroyed_last_update());
 
 	ImGui::End();
 }
@@ -247,6 +291,13 @@ void VulkanGUI::show_viewport_window(ImTextureID scene_image_id, camera& camera,
 		ImGui::Image(scene_image_id, window_size);
 		viewport_aspect_ratio = window_size.x / window_size.y;
 
+		if (ImGui::IsItemClicked(ImGuiMouseButton_Left) && !ImGuizmo::IsOver())
+		{
+			ImVec2 image_min = ImGui::GetItemRectMin();
+			ImVec2 mouse = ImGui::GetMousePos();
+			pick_primitive({ (mouse.x - image_min.x) / window_size.x, (mouse.y - image_min.y) / window_size.y }, camera, object_manager);
+		}
+
 		/* Gizmos */
 		ImGuizmo::BeginFrame();
 		ImGuizmo::SetDrawlist(ImGui::GetWindowDrawList());
@@ -265,7 +316,8 @@ void VulkanGUI::show_viewport_window(ImTextureID scene_image_id, camera& camera,
 			{
 				glm::mat4 orig = selected_primitive->model_world_center;
 
-				if (ImGuizmo::Manipulate(view, proj, gizmo_operation, transform_mode, glm::value_ptr(selected_primitive->model_world_center)))
+				bool is_edited = ImGuizmo::Manipulate(view, proj, gizmo_operation, transform_mode, glm::value_ptr(selected_primitive->model_world_center));
+				if (is_edited)
 				{
 					selected_primitive->offset += selected_primitive->model_world_center - orig;
 				}
@@ -275,6 +327,14 @@ void VulkanGUI::show_viewport_window(ImTextureID scene_image_id, camera& camera,
 				selected_primitive->model[3].z += selected_primitive->offset[3].z;
 
 				selected_primitive->offset = glm::mat4(0);
+
+				/* Moves the primitive on the GPU, the scene BVH is refit instead of rebuilt */
+				if (is_edited && selected_mesh != nullptr)
+				{
+					size_t mesh_idx = selected_mesh - object_manager.m_meshes.data();
+					size_t prim_idx = selected_primitive - selected_mesh->geometry_data.primitives.data();
+					object_manager.set_primitive_transform(mesh_idx, prim_idx, selected_primitive->model);
+				}
 			}
 		}
 
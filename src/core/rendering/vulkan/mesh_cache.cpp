@@ -0,0 +1,332 @@
+#include "mesh_cache.h"
+#include "core/engine/logger.h"
+
+#include <cstdio>
+#include <filesystem>
+
+namespace mesh_cache
+{
+	static size_t align_section(size_t offset)
+	{
+		return (offset + section_alignment - 1) & ~(section_alignment - 1);
+	}
+
+	std::string get_path(std::string_view source_path)
+	{
+		return std::string(source_path) + ".meshcache";
+	}
+
+	bool is_up_to_date(std::string_view source_path, std::string_view cache_path)
+	{
+		std::error_code ec;
+		auto source_time = std::filesystem::last_write_time(source_path, ec);
+		if (ec)
+		{
+			return false;
+		}
+
+		auto cache_time = std::filesystem::last_write_time(cache_path, ec);
+		if (ec)
+		{
+			return false;
+		}
+
+		return cache_time > source_time;
+	}
+
+	blob_range writer::add_string(std::string_view str)
+	{
+		blob_range range = { strings.size(), str.size() };
+		strings.insert(strings.end(), str.begin(), str.end());
+		return range;
+	}
+
+	blob_range writer::add_embedded(std::span<const uint8_t> data)
+	{
+		blob_range range = { embedded.size(), data.size() };
+		embedded.insert(embedded.end(), data.begin(), data.end());
+		return range;
+	}
+
+	/* Writes a section at the next aligned offset of the file */
+	static bool write_section(FILE* file, size_t& offset, const void* data, size_t size_bytes)
+	{
+		static constexpr uint8_t padding[section_alignment] = {};
+
+		size_t aligned = align_section(offset);
+		if (aligned != offset && fwrite(padding, 1, aligned - offset, file) != aligned - offset)
+		{
+			return false;
+		}
+		offset = aligned;
+
+		if (size_bytes && fwrite(data, 1, size_bytes, file) != size_bytes)
+		{
+			return false;
+		}
+		offset += size_bytes;
+
+		return true;
+	}
+
+	bool writer::write(std::string_view cache_path)
+	{
+		hdr.magic = magic;
+		hdr.version = version;
+		hdr.vertex_stride = sizeof(VertexData);
+		hdr.index_stride = sizeof(unsigned int);
+		hdr.num_vertices = vertices.size();
+		hdr.num_indices = indices.size();
+		hdr.num_primitives = primitives.size();
+		hdr.num_meshlets = meshlets.size();
+		hdr.num_lods = lods.size();
+		hdr.num_materials = materials.size();
+		hdr.num_textures = textures.size();
+		hdr.num_point_lights = point_lights.size();
+		hdr.num_directional_lights = directional_lights.size();
+		hdr.strings_size_bytes = strings.size();
+		hdr.embedded_size_bytes = embedded.size();
+
+		/* Write to a temporary file first so that an interrupted write never leaves a valid-looking cache behind */
+		std::string tmp_path = std::string(cache_path) + ".tmp";
+
+		FILE* file = fopen(tmp_path.c_str(), "wb");
+		if (!file)
+		{
+			LOG_ERROR("Could not open mesh cache file for writing : {}", tmp_path);
+			return false;
+		}
+
+		size_t offset = 0;
+		bool ok = write_section(file, offset, &hdr, sizeof(hdr))
+			&& write_section(file, offset, vertices.data(), vertices.size_bytes())
+			&& write_section(file, offset, indices.data(), indices.size_bytes())
+			&& write_section(file, offset, primitives.data(), primitives.size() * sizeof(primitive))
+			&& write_section(file, offset, meshlets.data(), meshlets.size_bytes())
+			&& write_section(file, offset, lods.data(), lods.size_bytes())
+			&& write_section(file, offset, materials.data(), materials.size() * sizeof(material))
+			&& write_section(file, offset, textures.data(), textures.size() * sizeof(texture))
+			&& write_section(file, offset, point_lights.data(), point_lights.size() * sizeof(point_light))
+			&& write_section(file, offset, directional_lights.data(), directional_lights.size() * sizeof(directional_light))
+			&& write_section(file, offset, strings.data(), strings.size())
+			&& write_section(file, offset, embedded.data(), embedded.size());
+
+		fclose(file);
+
+		std::error_code ec;
+		if (ok)
+		{
+			std::filesystem::rename(tmp_path, cache_path, ec);
+			ok = !ec;
+		}
+
+		if (!ok)
+		{
+			std::filesystem::remove(tmp_path, ec);
+			LOG_ERROR("Failed to write mesh cache : {}", cache_path);
+			return false;
+		}
+
+		LOG_INFO("Wrote mesh cache {} ({} KB)", cache_path, offset / 1024);
+		return true;
+	}
+
+	/* Points out to a typed view over the next section. Returns false if the file is too small. */
+	template<typename T>
+	static bool read_section(const uint8_t* data, size_t file_size, size_t& offset, uint64_t count, std::span<const T>& out)
+	{
+		/* The count comes from the file : compared without multiplying so that it cannot overflow */
+		offset = align_section(offset);
+		if (offset > file_size || count > (file_size - offset) / sizeof(T))
+		{
+			return false;
+		}
+
+		out = std::span<const T>(reinterpret_cast<const T*>(data + offset), (size_t)count);
+		offset += (size_t)count * sizeof(T);
+		return true;
+	}
+
+	static bool is_in_range(uint64_t first, uint64_t count, uint64_t size)
+	{
+		return first <= size && count <= size - first;
+	}
+
+	static bool is_in_range(blob_range range, uint64_t size)
+	{
+		return is_in_range(range.offset, range.size, size);
+	}
+
+	/* Index values are added to the primitive base vertex and used to address the vertex section, on the CPU too when packing */
+	static bool are_indices_in_range(std::span<const unsigned int> indices, uint64_t base_vertex, uint64_t num_vertices)
+	{
+		for (unsigned int idx : indices)
+		{
+			if (base_vertex + idx >= num_vertices)
+			{
+				return false;
+			}
+		}
+		return true;
+	}
+
+	static bool is_valid_texture_idx(int idx, uint64_t num_textures)
+	{
+		return idx < 0 || (uint64_t)idx < num_textures;
+	}
+
+	bool reader::validate() const
+	{
+		const uint64_t strings_size = hdr->strings_size_bytes;
+		const uint64_t embedded_size = hdr->embedded_size_bytes;
+
+		/* Meshlets and LODs are checked through the primitive that draws them, their indices are relative to its base vertex */
+		for (const primitive& p : primitives)
+		{
+			bool is_valid = is_in_range(p.first_vertex, p.vertex_count, indices.size())
+				&& p.base_vertex <= vertices.size()
+				&& is_in_range(p.first_meshlet, p.meshlet_count, meshlets.size())
+				&& is_in_range(p.first_lod, p.lod_count, lods.size())
+				&& (p.material_idx < 0 || (uint64_t)p.material_idx < materials.size())
+				&& is_in_range(p.name, strings_size)
+				&& are_indices_in_range(indices.subspan(p.first_vertex, p.vertex_count), p.base_vertex, vertices.size());
+			if (!is_valid)
+			{
+				return false;
+			}
+
+			for (const Meshlet& meshlet : meshlets.subspan(p.first_meshlet, p.meshlet_count))
+			{
+				if (!is_in_range(meshlet.first_index, meshlet.index_count, indices.size())
+					|| !are_indices_in_range(indices.subspan(meshlet.first_index, meshlet.index_count), p.base_vertex, vertices.size()))
+				{
+					return false;
+				}
+			}
+
+			for (const PrimitiveLod& lod : lods.subspan(p.first_lod, p.lod_count))
+			{
+				if (!is_in_range(lod.first_index, lod.index_count, indices.size())
+					|| !are_indices_in_range(indices.subspan(lod.first_index, lod.index_count), p.base_vertex, vertices.size()))
+				{
+					return false;
+				}
+			}
+		}
+
+		for (const material& m : materials)
+		{
+			bool is_valid = is_valid_texture_idx(m.material.texture_base_color_idx, textures.size())
+				&& is_valid_texture_idx(m.material.texture_normal_map_idx, textures.size())
+				&& is_valid_texture_idx(m.material.texture_metalness_roughness_idx, textures.size())
+				&& is_valid_texture_idx(m.material.texture_emissive_map_idx, textures.size())
+				&& is_in_range(m.name, strings_size);
+			if (!is_valid)
+			{
+				return false;
+			}
+		}
+
+		for (const texture& t : textures)
+		{
+			if (!is_in_range(t.name, strings_size) || !is_in_range(t.embedded_data, embedded_size))
+			{
+				return false;
+			}
+		}
+
+		return true;
+	}
+
+	bool reader::open(std::string_view cache_path)
+	{
+		close();
+
+		if (!m_file.open(cache_path))
+		{
+			return false;
+		}
+
+		const uint8_t* data = m_file.data();
+		size_t file_size = m_file.size();
+
+		if (file_size < sizeof(header))
+		{
+			close();
+			return false;
+		}
+
+		hdr = reinterpret_cast<const header*>(data);
+
+		if (hdr->magic != magic || hdr->version != version || hdr->vertex_stride != sizeof(VertexData) || hdr->index_stride != sizeof(unsigned int))
+		{
+			LOG_WARN("Mesh cache {} is outdated (version {}, expected {}), ignoring it.", cache_path, hdr->version, version);
+			close();
+			return false;
+		}
+
+		std::span<const char> strings;
+		std::span<const uint8_t> embedded;
+
+		size_t offset = sizeof(header);
+		bool ok = read_section(data, file_size, offset, hdr->num_vertices, vertices)
+			&& read_section(data, file_size, offset, hdr->num_indices, indices)
+			&& read_section(data, file_size, offset, hdr->num_primitives, primitives)
+			&& read_section(data, file_size, offset, hdr->num_meshlets, meshlets)
+			&& read_section(data, file_size, offset, hdr->num_lods, lods)
+			&& read_section(data, file_size, offset, hdr->num_materials, materials)
+			&& read_section(data, file_size, offset, hdr->num_textures, textures)
+			&& read_section(data, file_size, offset, hdr->num_point_lights, point_lights)
+			&& read_section(data, file_size, offset, hdr->num_directional_lights, directional_lights)
+			&& read_section(data, file_size, offset, hdr->strings_size_bytes, strings)
+			&& read_section(data, file_size, offset, hdr->embedded_size_bytes, embedded);
+
+		if (!ok)
+		{
+			LOG_WARN("Mesh cache {} is truncated, ignoring it.", cache_path);
+			close();
+			return false;
+		}
+
+		m_strings = strings.data();
+		m_embedded = embedded.data();
+
+		/* Every offset, count and index the loader uses is checked against its section : a corrupted file is rebuilt from the source */
+		if (!validate())
+		{
+			LOG_WARN("Mesh cache {} is corrupted, ignoring it.", cache_path);
+			close();
+			return false;
+		}
+
+		return true;
+	}
+
+	void reader::close()
+	{
+		m_file.close();
+
+		hdr = nullptr;
+		vertices = {};
+		indices = {};
+		primitives = {};
+		meshlets = {};
+		lods = {};
+		materials = {};
+		textures = {};
+		point_lights = {};
+		directional_lights = {};
+		m_strings = nullptr;
+		m_embedded = nullptr;
+	}
+
+	std::string_view reader::get_string(blob_range range) const
+	{
+		return std::string_view(m_strings + range.offset, (size_t)range.size);
+	}
+
+	std::span<const uint8_t> reader::get_embedded(blob_range range) const
+	{
+		return std::span<const uint8_t>(m_embedded + range.offset, (size_t)range.size);
+	}
+}
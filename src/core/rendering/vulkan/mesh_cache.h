@@ -0,0 +1,145 @@
+#pragma once
+
+#include "VulkanMesh.h"
+#include "core/engine/mapped_file.h"
+#include "core/rendering/Material.hpp"
+#include "core/rendering/lighting.h"
+
+#include <span>
+#include <string>
+#include <string_view>
+#include <vector>
+
+/*
+	Versioned binary cache of an imported model, written next to the source asset (<source>.meshcache).
+	Holds the final vertex/index arrays, the primitive table, materials, texture references and lights,
+	so that a load is a file mapping plus a few memcpy into staging memory.
+
+	Layout : header followed by the sections below, each one aligned on mesh_cache::section_alignment.
+		vertices | indices | primitives | meshlets | lods | materials | textures | point lights | directional lights | strings | embedded images
+*/
+namespace mesh_cache
+{
+	static constexpr uint32_t magic = 0x48534D43; /* "CMSH" */
+	static constexpr uint32_t version = 7;
+	static constexpr size_t section_alignment = 16;
+
+	/* Strings and embedded images are stored in blobs and referenced by offset/size */
+	struct blob_range
+	{
+		uint64_t offset = 0;
+		uint64_t size = 0;
+	};
+
+	struct header
+	{
+		uint32_t magic;
+		uint32_t version;
+		uint32_t vertex_stride;
+		uint32_t index_stride;
+
+		uint64_t num_vertices;
+		uint64_t num_indices;
+		uint64_t num_primitives;
+		uint64_t num_meshlets;
+		uint64_t num_lods;
+		uint64_t num_materials;
+		uint64_t num_textures;
+		uint64_t num_point_lights;
+		uint64_t num_directional_lights;
+		uint64_t strings_size_bytes;
+		uint64_t embedded_size_bytes;
+
+		glm::mat4 world_mat;
+		glm::vec4 bbox_min_os;
+		glm::vec4 bbox_max_os;
+	};
+
+	struct primitive
+	{
+		uint32_t first_vertex;
+		uint32_t vertex_count;
+		int32_t material_idx;		/* Index into the material section of this file */
+		uint32_t base_vertex;		/* Indices are local to the primitive */
+		uint32_t first_meshlet;
+		uint32_t meshlet_count;
+		uint32_t first_lod;
+		uint32_t lod_count;
+		glm::mat4 model;
+		glm::vec4 world_center;
+		glm::vec4 bbox_min_os;
+		glm::vec4 bbox_max_os;
+		blob_range name;
+	};
+
+	struct material
+	{
+		Material material;			/* Texture indices refer to the texture section of this file */
+		blob_range name;
+	};
+
+	struct texture
+	{
+		blob_range name;			/* Name in the object manager. Also the file path when the image is not embedded. */
+		blob_range embedded_data;	/* Encoded image bytes for images embedded in the source asset, empty otherwise */
+		VkFormat format;			/* Uncompressed format of the decoded source image, the baked DDS carries its own */
+		uint32_t calc_mip;
+	};
+
+	/* Path of the cache file for a given source asset */
+	std::string get_path(std::string_view source_path);
+
+	/* True if the cache file exists and is newer than the source asset */
+	bool is_up_to_date(std::string_view source_path, std::string_view cache_path);
+
+	/* Accumulates the content of a cache file before writing it to disk */
+	struct writer
+	{
+		header hdr = {};
+		std::span<const VertexData> vertices;
+		std::span<const unsigned int> indices;
+		std::vector<primitive> primitives;
+		std::span<const Meshlet> meshlets;
+		std::span<const PrimitiveLod> lods;
+		std::vector<material> materials;
+		std::vector<texture> textures;
+		std::vector<point_light> point_lights;
+		std::vector<directional_light> directional_lights;
+		std::vector<char> strings;
+		std::vector<uint8_t> embedded;
+
+		blob_range add_string(std::string_view str);
+		blob_range add_embedded(std::span<const uint8_t> data);
+
+		bool write(std::string_view cache_path);
+	};
+
+	/* Read-only view of a mapped cache file. Spans stay valid as long as the reader is open. */
+	struct reader
+	{
+		bool open(std::string_view cache_path);
+		void close();
+
+		const header* hdr = nullptr;
+		std::span<const VertexData> vertices;
+		std::span<const unsigned int> indices;
+		std::span<const primitive> primitives;
+		std::span<const Meshlet> meshlets;
+		std::span<const PrimitiveLod> lods;
+		std::span<const material> materials;
+		std::span<const texture> textures;
+		std::span<const point_light> point_lights;
+		std::span<const directional_light> directional_lights;
+
+		/* Ranges are checked by open() */
+		std::string_view get_string(blob_range range) const;
+		std::span<const uint8_t> get_embedded(blob_range range) const;
+
+	private:
+		bool validate() const;
+
+		mapped_file m_file;
+		const char* m_strings = nullptr;
+		const uint8_t* m_embedded = nullptr;
+	};
+}
@@ -0,0 +1,196 @@
+#include "pipeline_cache.h"
+#include "core/engine/job_system.h"
+#include "core/rendering/vulkan/VulkanRenderInterface.h"
+#include "core/rendering/vulkan/VkResourceManager.h"
+
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+
+void pipeline_cache::init(const vk::device& device)
+{
+	m_device = device;
+	vkGetPhysicalDeviceProperties(device.physical_device, &m_device_properties);
+
+	std::vector<uint8_t> data = load_file();
+	m_is_warm = !data.empty();
+
+	VkPipelineCacheCreateInfo cache_info =
+	{
+		.sType = VK_STRUCTURE_TYPE_PIPELINE_CACHE_CREATE_INFO,
+		.initialDataSize = data.size(),
+		.pInitialData = data.empty() ? nullptr : data.data()
+	};
+
+	VK_CHECK(vkCreatePipelineCache(m_device, &cache_info, nullptr, &m_cache));
+
+	LOG_INFO("Pipeline cache : {} ({} KB)", m_is_warm ? "loaded" : "cold start", data.size() / 1024);
+}
+
+std::vector<uint8_t> pipeline_cache::load_file() const
+{
+	FILE* file = fopen(path.c_str(), "rb");
+	if (!file)
+	{
+		return {};
+	}
+
+	std::vector<uint8_t> data;
+	file_header hdr = {};
+	bool is_valid = fread(&hdr, sizeof(hdr), 1, file) == 1
+		&& hdr.magic == k_magic
+		&& hdr.version == k_version
+		&& hdr.vendor_id == m_device_properties.vendorID
+		&& hdr.device_id == m_device_properties.deviceID
+		&& hdr.driver_version == m_device_properties.driverVersion
+		&& memcmp(hdr.pipeline_cache_uuid, m_device_properties.pipelineCacheUUID, VK_UUID_SIZE) == 0;
+
+	/* The header size is not trusted : a truncated or corrupted file must not make us allocate it */
+	if (is_valid)
+	{
+		long data_offset = ftell(file);
+		is_valid = data_offset >= 0 && fseek(file, 0, SEEK_END) == 0;
+		long file_size = is_valid ? ftell(file) : -1;
+		is_valid = is_valid && file_size >= data_offset
+			&& hdr.data_size_bytes <= uint64_t(file_size - data_offset)
+			&& fseek(file, data_offset, SEEK_SET) == 0;
+	}
+
+	if (is_valid)
+	{
+		data.resize(hdr.data_size_bytes);
+		is_valid = fread(data.data(), 1, data.size(), file) == data.size();
+	}
+	fclose(file);
+
+	/* The driver data starts with a VkPipelineCacheHeaderVersionOne : checked too in case the file was tampered with */
+	if (is_valid && data.size() >= sizeof(VkPipelineCacheHeaderVersionOne))
+	{
+		VkPipelineCacheHeaderVersionOne driver_hdr;
+		memcpy(&driver_hdr, data.data(), sizeof(driver_hdr));
+		is_valid = driver_hdr.headerVersion == VK_PIPELINE_CACHE_HEADER_VERSION_ONE
+			&& driver_hdr.vendorID == m_device_properties.vendorID
+			&& driver_hdr.deviceID == m_device_properties.deviceID
+			&& memcmp(driver_hdr.pipelineCacheUUID, m_device_properties.pipelineCacheUUID, VK_UUID_SIZE) == 0;
+	}
+
+	if (!is_valid)
+	{
+		LOG_WARN("Pipeline cache {} was written by another device or driver, ignored.", path);
+		return {};
+	}
+
+	return data;
+}
+
+void pipeline_cache::destroy()
+{
+	if (m_cache == VK_NULL_HANDLE)
+	{
+		return;
+	}
+
+	size_t data_size = 0;
+	std::vector<uint8_t> data;
+	if (vkGetPipelineCacheData(m_device, m_cache, &data_size, nullptr) == VK_SUCCESS && data_size > 0)
+	{
+		data.resize(data_size);
+		if (vkGetPipelineCacheData(m_device, m_cache, &data_size, data.data()) != VK_SUCCESS)
+		{
+			data.clear();
+		}
+		data.resize(data_size);
+	}
+
+	if (!data.empty())
+	{
+		file_header hdr =
+		{
+			.magic = k_magic,
+			.version = k_version,
+			.vendor_id = m_device_properties.vendorID,
+			.device_id = m_device_properties.deviceID,
+			.driver_version = m_device_properties.driverVersion,
+			.data_size_bytes = data.size()
+		};
+		memcpy(hdr.pipeline_cache_uuid, m_device_properties.pipelineCacheUUID, VK_UUID_SIZE);
+
+		/* Written to a temporary file first so that an interrupted write never leaves a truncated cache behind */
+		std::string tmp_path = path + ".tmp";
+		FILE* file = fopen(tmp_path.c_str(), "wb");
+		bool ok = file && fwrite(&hdr, sizeof(hdr), 1, file) == 1 && fwrite(data.data(), 1, data.size(), file) == data.size();
+		if (file)
+		{
+			fclose(file);
+		}
+
+		std::error_code ec;
+		if (ok)
+		{
+			std::filesystem::rename(tmp_path, path, ec);
+			ok = !ec;
+		}
+
+		if (ok)
+		{
+			LOG_INFO("Saved pipeline cache {} ({} KB)", path, data.size() / 1024);
+		}
+		else
+		{
+			std::filesystem::remove(tmp_path, ec);
+			LOG_ERROR("Failed to save pipeline cache : {}", path);
+		}
+	}
+
+	vkDestroyPipelineCache(m_device, m_cache, nullptr);
+	m_cache = VK_NULL_HANDLE;
+}
+
+void pipeline_cache::begin_batch()
+{
+	assert(!m_is_batching);
+	m_is_batching = true;
+	m_batch_pipeline_count = 0;
+	m_batch_create_ms = 0.0;
+}
+
+void pipeline_cache::end_batch()
+{
+	create_pending();
+	m_is_batching = false;
+
+	LOG_INFO("Created {} pipelines in {:.1f} ms ({} pipeline cache, {} threads)", m_batch_pipeline_count, m_batch_create_ms,
+		m_is_warm ? "warm" : "cold", job_system::get_instance().get_num_threads() + 1);
+}
+
+void pipeline_cache::enqueue(Pipeline* pipeline)
+{
+	assert(m_is_batching);
+	m_pending.push_back(pipeline);
+}
+
+void pipeline_cache::create_pending()
+{
+	if (m_pending.empty())
+	{
+		return;
+	}
+
+	auto start = std::chrono::steady_clock::now();
+
+	/* vkCreate*Pipelines is free-threaded, the cache is internally synchronized */
+	job_system::get_instance().parallel_for(m_pending.size(), [this](size_t i)
+	{
+		m_pending[i]->create_vk_pipeline();
+	});
+
+	for (Pipeline* pipeline : m_pending)
+	{
+		VkResourceManager::get_instance(m_device)->add_pipeline(pipeline->pipeline);
+	}
+
+	m_batch_create_ms += std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+	m_batch_pipeline_count += (uint32_t)m_pending.size();
+	m_pending.clear();
+}
@@ -0,0 +1,76 @@
+#pragma once
+
+#include "core/engine/vulkan/objects/vk_device.h"
+
+#include <string>
+#include <vector>
+
+struct Pipeline;
+
+/*
+	Persistent VkPipelineCache used by every pipeline creation.
+	Loaded from disk at startup when it was written by the same device and driver, saved on exit.
+	Between begin_batch() and end_batch(), Pipeline::create_graphics/create_compute only record their create info :
+	the pipelines are compiled in parallel on the job system by create_pending(), which must run before any of them
+	is bound (e.g. by a renderer drawing during its init).
+*/
+class pipeline_cache
+{
+public:
+	static pipeline_cache& get_instance()
+	{
+		static pipeline_cache instance;
+		return instance;
+	}
+
+	void init(const vk::device& device);
+
+	/* Saves the cache then destroys it */
+	void destroy();
+
+	VkPipelineCache get() const { return m_cache; }
+
+	void begin_batch();
+	void end_batch();
+	bool is_batching() const { return m_is_batching; }
+
+	/* Pipeline::create_graphics/create_compute during a batch */
+	void enqueue(Pipeline* pipeline);
+
+	/* Compiles the queued pipelines across the job system and waits for them */
+	void create_pending();
+
+	std::string path = "../../../data/pipeline_cache.bin";
+
+	pipeline_cache(const pipeline_cache&) = delete;
+	pipeline_cache& operator=(const pipeline_cache&) = delete;
+private:
+	pipeline_cache() = default;
+
+	/* Prepended to the driver data : the driver header alone does not identify the driver version */
+	struct file_header
+	{
+		uint32_t magic;
+		uint32_t version;
+		uint32_t vendor_id;
+		uint32_t device_id;
+		uint32_t driver_version;
+		uint8_t pipeline_cache_uuid[VK_UUID_SIZE];
+		uint64_t data_size_bytes;
+	};
+
+	static constexpr uint32_t k_magic = 0x43505043; /* "CPPC" */
+	static constexpr uint32_t k_version = 1;
+
+	std::vector<uint8_t> load_file() const;
+
+	VkPipelineCache m_cache = VK_NULL_HANDLE;
+	VkDevice m_device = VK_NULL_HANDLE;
+	VkPhysicalDeviceProperties m_device_properties = {};
+	bool m_is_warm = false;
+
+	bool m_is_batching = false;
+	std::vector<Pipeline*> m_pending;
+	uint32_t m_batch_pipeline_count = 0;
+	double m_batch_create_ms = 0.0;
+};
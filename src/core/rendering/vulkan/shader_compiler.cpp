@@ -0,0 +1,570 @@
+#include "shader_compiler.h"
+#include "core/engine/logger.h"
+#include "core/rendering/vulkan/VulkanRenderInterface.h"
+#include "core/rendering/vulkan/VkResourceManager.h"
+#include "core/rendering/vulkan/pipeline_cache.h"
+
+#include "imgui.h"
+#include "optick.h"
+
+#include <shaderc/shaderc.hpp>
+
+#include <algorithm>
+#include <cctype>
+#include <fstream>
+#include <sstream>
+
+namespace fs = std::filesystem;
+
+static std::string to_key(const fs::path& path)
+{
+	return path.lexically_normal().generic_string();
+}
+
+/* Includes are written with the case of the Windows file system (e.g. "headers/brdf.glsl" for Headers/BRDF.glsl) */
+static fs::path find_file(const fs::path& path)
+{
+	std::error_code ec;
+	if (fs::is_regular_file(path, ec))
+	{
+		return path;
+	}
+
+	fs::path found;
+	for (const fs::path& part : path.lexically_normal())
+	{
+		fs::path candidate = found / part;
+		if (part == "." || part == ".." || fs::exists(candidate, ec))
+		{
+			found = candidate;
+			continue;
+		}
+
+		bool matched = false;
+		for (const fs::directory_entry& entry : fs::directory_iterator(found.empty() ? fs::path(".") : found, ec))
+		{
+			std::string name = entry.path().filename().string();
+			std::string wanted = part.string();
+			if (std::equal(name.begin(), name.end(), wanted.begin(), wanted.end(), [](char a, char b) { return std::tolower(a) == std::tolower(b); }))
+			{
+				found /= entry.path().filename();
+				matched = true;
+				break;
+			}
+		}
+
+		if (!matched)
+		{
+			return {};
+		}
+	}
+
+	return fs::is_regular_file(found, ec) ? found : fs::path();
+}
+
+/* Relative to the including file, then to the source and header folders */
+static fs::path resolve_include(std::string_view requested, const fs::path& requesting_file)
+{
+	for (const fs::path& dir : { requesting_file.parent_path(), fs::path(shader_compiler::source_folder), fs::path(shader_compiler::header_folder) })
+	{
+		fs::path path = find_file(dir / requested);
+		if (!path.empty())
+		{
+			return path;
+		}
+	}
+	return {};
+}
+
+static bool read_file(const fs::path& path, std::string& out_content)
+{
+	std::ifstream file(path, std::ios::binary);
+	if (!file)
+	{
+		return false;
+	}
+
+	std::stringstream ss;
+	ss << file.rdbuf();
+	out_content = ss.str();
+	return true;
+}
+
+class includer : public shaderc::CompileOptions::IncluderInterface
+{
+	struct include_data
+	{
+		shaderc_include_result result;
+		std::string name;
+		std::string content;
+	};
+
+public:
+	shaderc_include_result* GetInclude(const char* requested_source, shaderc_include_type type, const char* requesting_source, size_t include_depth) override
+	{
+		include_data* data = new include_data;
+
+		fs::path path = resolve_include(requested_source, requesting_source);
+		if (!path.empty() && read_file(path, data->content))
+		{
+			data->name = to_key(path);
+		}
+		else
+		{
+			/* An empty name reports the error, content is the message */
+			data->content = std::string("Cannot find include file ") + requested_source;
+		}
+
+		data->result = { data->name.c_str(), data->name.size(), data->content.c_str(), data->content.size(), data };
+		return &data->result;
+	}
+
+	void ReleaseInclude(shaderc_include_result* result) override
+	{
+		delete static_cast<include_data*>(result->user_data);
+	}
+};
+
+static shaderc_shader_kind get_shader_kind(std::string_view shader_file)
+{
+	if (shader_file.ends_with(".vert")) return shaderc_vertex_shader;
+	if (shader_file.ends_with(".frag")) return shaderc_fragment_shader;
+	if (shader_file.ends_with(".comp")) return shaderc_compute_shader;
+	return shaderc_glsl_infer_from_source;
+}
+
+bool shader_compiler::compile(std::string_view shader_file, std::vector<uint32_t>& out_spirv, std::string& out_errors) const
+{
+	fs::path src_path = fs::path(source_folder) / shader_file;
+
+	std::string source;
+	if (!read_file(src_path, source))
+	{
+		out_errors = "Cannot open shader file " + to_key(src_path);
+		return false;
+	}
+
+	shaderc::CompileOptions options;
+	options.SetTargetEnvironment(shaderc_target_env_vulkan, shaderc_env_version_vulkan_1_3);
+	options.SetGenerateDebugInfo();
+	options.SetIncluder(std::make_unique<includer>());
+
+	/* shaderc::Compiler is cheap to create and not shared : compile() runs on the watcher thread too */
+	shaderc::Compiler compiler;
+	shaderc::SpvCompilationResult result = compiler.CompileGlslToSpv(source, get_shader_kind(shader_file), to_key(src_path).c_str(), options);
+
+	if (result.GetCompilationStatus() != shaderc_compilation_status_success)
+	{
+		out_errors = result.GetErrorMessage();
+		return false;
+	}
+
+	out_spirv.assign(result.cbegin(), result.cend());
+	return true;
+}
+
+bool shader_compiler::compile_to_file(std::string_view shader_file) const
+{
+	std::vector<uint32_t> spirv;
+	std::string errors;
+	if (!compile(shader_file, spirv, errors))
+	{
+		LOG_ERROR("{}", errors);
+		return false;
+	}
+
+	std::string dst_path = spirv_folder + shader_file.data() + ".spv";
+	std::ofstream file(dst_path, std::ios::binary);
+	file.write((const char*)spirv.data(), spirv.size() * sizeof(uint32_t));
+	if (!file)
+	{
+		LOG_ERROR("Cannot write SPIR-V file {}", dst_path);
+		return false;
+	}
+
+	return true;
+}
+
+void shader_compiler::init()
+{
+	scan_sources();
+	m_thread = std::thread(&shader_compiler::watch_loop, this);
+}
+
+void shader_compiler::destroy()
+{
+	{
+		std::lock_guard lock(m_mutex);
+		m_stop = true;
+	}
+	m_wake.notify_all();
+
+	if (m_thread.joinable())
+	{
+		m_thread.join();
+	}
+
+	/* Swaps that never happened : their pipelines and modules were not registered */
+	for (reloaded_shader& reloaded : m_reloaded)
+	{
+		for (auto& [pipeline, vk_pipeline] : reloaded.pipelines)
+		{
+			vkDestroyPipeline(ctx.device, vk_pipeline, nullptr);
+		}
+		for (VkPipelineShaderStageCreateInfo& stage : reloaded.stages)
+		{
+			vkDestroyShaderModule(ctx.device, stage.module, nullptr);
+		}
+	}
+	m_reloaded.clear();
+}
+
+void shader_compiler::add_pipeline(Pipeline* pipeline)
+{
+	std::lock_guard lock(m_mutex);
+	if (std::find(m_pipelines.begin(), m_pipelines.end(), pipeline) == m_pipelines.end())
+	{
+		m_pipelines.push_back(pipeline);
+	}
+}
+
+void shader_compiler::request_reload_all()
+{
+	{
+		std::lock_guard lock(m_mutex);
+		m_reload_all = true;
+	}
+	m_wake.notify_all();
+}
+
+std::vector<fs::path> shader_compiler::scan_sources()
+{
+	std::vector<fs::path> changed;
+
+	std::error_code ec;
+	for (auto it = fs::recursive_directory_iterator(source_folder, ec); !ec && it != fs::recursive_directory_iterator(); it.increment(ec))
+	{
+		if (it->is_directory(ec) && it->path().filename() == "spirv")
+		{
+			it.disable_recursion_pending();
+			continue;
+		}
+
+		fs::path ext = it->path().extension();
+		if (ext != ".vert" && ext != ".frag" && ext != ".comp" && ext != ".glsl")
+		{
+			continue;
+		}
+
+		/* Editors saving by replacing the file make it briefly disappear : skipped until the next scan */
+		fs::file_time_type write_time = it->last_write_time(ec);
+		if (ec)
+		{
+			ec.clear();
+			continue;
+		}
+
+		auto [entry, inserted] = m_write_times.try_emplace(to_key(it->path()), write_time);
+		if (!inserted && entry->second != write_time)
+		{
+			entry->second = write_time;
+			changed.push_back(it->path());
+		}
+	}
+
+	return changed;
+}
+
+static void collect_includes(const fs::path& path, std::vector<fs::path>& out_files)
+{
+	for (const fs::path& file : out_files)
+	{
+		if (to_key(file) == to_key(path))
+		{
+			return;
+		}
+	}
+	out_files.push_back(path);
+
+	std::string source;
+	if (!read_file(path, source))
+	{
+		return;
+	}
+
+	std::istringstream lines(source);
+	std::string line;
+	while (std::getline(lines, line))
+	{
+		size_t directive = line.find("#include");
+		size_t open = line.find('"', directive);
+		size_t close = line.find('"', open + 1);
+		if (directive == std::string::npos || open == std::string::npos || close == std::string::npos)
+		{
+			continue;
+		}
+
+		fs::path include = resolve_include(std::string_view(line).substr(open + 1, close - open - 1), path);
+		if (!include.empty())
+		{
+			collect_includes(include, out_files);
+		}
+	}
+}
+
+std::vector<fs::path> shader_compiler::get_dependencies(const Pipeline& pipeline) const
+{
+	std::vector<fs::path> files;
+	if (pipeline.is_graphics)
+	{
+		collect_includes(fs::path(source_folder) / pipeline.h_vertex_fragment_shader->vertex_shader_filename, files);
+		collect_includes(fs::path(source_folder) / pipeline.h_vertex_fragment_shader->fragment_shader_filename, files);
+	}
+	else
+	{
+		collect_includes(fs::path(source_folder) / pipeline.h_compute_shader->compute_shader_filename, files);
+	}
+	return files;
+}
+
+void shader_compiler::watch_loop()
+{
+	OPTICK_THREAD("Shader Watcher");
+
+	while (true)
+	{
+		bool reload_all = false;
+		std::vector<Pipeline*> pipelines;
+		{
+			std::unique_lock lock(m_mutex);
+			m_wake.wait_for(lock, std::chrono::milliseconds(poll_interval_ms), [this]() { return m_stop || m_reload_all; });
+			if (m_stop)
+			{
+				return;
+			}
+
+			reload_all = m_reload_all;
+			m_reload_all = false;
+			pipelines = m_pipelines;
+		}
+
+		std::vector<fs::path> changed = scan_sources();
+		if (!reload_all && (!watch_files || changed.empty()))
+		{
+			continue;
+		}
+
+		/* Pipelines grouped by shader : they share the new modules */
+		std::vector<std::pair<Shader*, std::vector<Pipeline*>>> shaders;
+		for (Pipeline* pipeline : pipelines)
+		{
+			bool is_affected = reload_all;
+			if (!is_affected)
+			{
+				std::vector<fs::path> dependencies = get_dependencies(*pipeline);
+				is_affected = std::any_of(changed.begin(), changed.end(), [&dependencies](const fs::path& file)
+				{
+					std::error_code ec;
+					return std::any_of(dependencies.begin(), dependencies.end(), [&](const fs::path& dependency) { return fs::equivalent(file, dependency, ec); });
+				});
+			}
+
+			if (!is_affected)
+			{
+				continue;
+			}
+
+			Shader* shader = pipeline->is_graphics ? (Shader*)pipeline->h_vertex_fragment_shader : (Shader*)pipeline->h_compute_shader;
+			auto it = std::find_if(shaders.begin(), shaders.end(), [shader](const auto& entry) { return entry.first == shader; });
+			if (it == shaders.end())
+			{
+				shaders.push_back({ shader, { pipeline } });
+			}
+			else
+			{
+				it->second.push_back(pipeline);
+			}
+		}
+
+		for (auto& [shader, shader_pipelines] : shaders)
+		{
+			reload(shader, shader_pipelines);
+		}
+	}
+}
+
+void shader_compiler::reload(Shader* shader, const std::vector<Pipeline*>& pipelines)
+{
+	OPTICK_EVENT();
+
+	const Pipeline& first = *pipelines.front();
+
+	std::vector<std::pair<std::string, VkShaderStageFlagBits>> sources;
+	if (first.is_graphics)
+	{
+		sources.push_back({ first.h_vertex_fragment_shader->vertex_shader_filename, VK_SHADER_STAGE_VERTEX_BIT });
+		sources.push_back({ first.h_vertex_fragment_shader->fragment_shader_filename, VK_SHADER_STAGE_FRAGMENT_BIT });
+	}
+	else
+	{
+		sources.push_back({ first.h_compute_shader->compute_shader_filename, VK_SHADER_STAGE_COMPUTE_BIT });
+	}
+
+	reloaded_shader reloaded = { .shader = shader };
+	for (auto& [filename, stage] : sources)
+	{
+		std::vector<uint32_t> spirv;
+		std::string errors;
+		if (!compile(filename, spirv, errors))
+		{
+			LOG_ERROR("Shader reload failed : {}", errors);
+			{
+				std::lock_guard lock(m_mutex);
+				m_last_error = errors;
+			}
+			m_num_failed++;
+
+			for (VkPipelineShaderStageCreateInfo& created : reloaded.stages)
+			{
+				vkDestroyShaderModule(ctx.device, created.module, nullptr);
+			}
+			return;
+		}
+
+		{
+			std::lock_guard lock(m_mutex);
+			m_last_error.clear();
+		}
+
+		/* Written back so that the next run starts from the new code */
+		std::ofstream file(spirv_folder + filename + ".spv", std::ios::binary);
+		file.write((const char*)spirv.data(), spirv.size() * sizeof(uint32_t));
+
+		VkShaderModuleCreateInfo module_info =
+		{
+			.sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO,
+			.codeSize = spirv.size() * sizeof(uint32_t),
+			.pCode = spirv.data()
+		};
+
+		VkShaderModule module = VK_NULL_HANDLE;
+		VK_CHECK(vkCreateShaderModule(ctx.device, &module_info, nullptr, &module));
+
+		reloaded.stages.push_back(
+		{
+			.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO,
+			.stage = stage,
+			.module = module,
+			.pName = "main"
+		});
+	}
+
+	for (Pipeline* pipeline : pipelines)
+	{
+		VkPipeline vk_pipeline = VK_NULL_HANDLE;
+		VkResult result;
+
+		/* The saved create info is only modified by update(), under the same lock */
+		std::unique_lock lock(m_mutex);
+		if (pipeline->is_graphics)
+		{
+			VkGraphicsPipelineCreateInfo create_info = pipeline->graphics_pipeline_create_info;
+			create_info.stageCount = (uint32_t)reloaded.stages.size();
+			create_info.pStages = reloaded.stages.data();
+			result = vkCreateGraphicsPipelines(ctx.device, pipeline_cache::get_instance().get(), 1, &create_info, nullptr, &vk_pipeline);
+		}
+		else
+		{
+			VkComputePipelineCreateInfo create_info = pipeline->compute_pipeline_create_info;
+			create_info.stage = reloaded.stages[0];
+			result = vkCreateComputePipelines(ctx.device, pipeline_cache::get_instance().get(), 1, &create_info, nullptr, &vk_pipeline);
+		}
+		lock.unlock();
+
+		if (result == VK_SUCCESS)
+		{
+			reloaded.pipelines.push_back({ pipeline, vk_pipeline });
+		}
+		else
+		{
+			LOG_ERROR("Pipeline reload failed with error : {}", string_VkResult(result));
+			m_num_failed++;
+		}
+	}
+
+	LOG_INFO("Reloaded {} ({} pipelines)", sources.back().first, reloaded.pipelines.size());
+
+	std::lock_guard lock(m_mutex);
+	m_reloaded.push_back(std::move(reloaded));
+}
+
+void shader_compiler::update()
+{
+	VkResourceManager* resource_manager = VkResourceManager::get_instance(ctx.device);
+
+	/* The previous frame may still use the old objects */
+	const uint32_t last_used_frame = ctx.frame_count - 1;
+
+	std::lock_guard lock(m_mutex);
+	for (reloaded_shader& reloaded : m_reloaded)
+	{
+		if (reloaded.stages.size() == 2)
+		{
+			VertexFragmentShader* shader = static_cast<VertexFragmentShader*>(reloaded.shader);
+			resource_manager->retire_shader_module(shader->hash_vertex_module, last_used_frame);
+			resource_manager->retire_shader_module(shader->hash_fragment_module, last_used_frame);
+			shader->hash_vertex_module = resource_manager->add_shader_module(reloaded.stages[0].module);
+			shader->hash_fragment_module = resource_manager->add_shader_module(reloaded.stages[1].module);
+		}
+		else
+		{
+			ComputeShader* compute_shader = static_cast<ComputeShader*>(reloaded.shader);
+			resource_manager->retire_shader_module(compute_shader->hash_compute_module, last_used_frame);
+			compute_shader->hash_compute_module = resource_manager->add_shader_module(reloaded.stages[0].module);
+		}
+		reloaded.shader->stages = reloaded.stages;
+
+		for (auto& [pipeline, vk_pipeline] : reloaded.pipelines)
+		{
+			resource_manager->retire_pipeline(std::hash<VkPipeline>{}(pipeline->pipeline), last_used_frame);
+			pipeline->pipeline = vk_pipeline;
+			resource_manager->add_pipeline(vk_pipeline);
+
+			if (pipeline->is_graphics)
+			{
+				pipeline->graphics_pipeline_create_info.stageCount = (uint32_t)reloaded.shader->stages.size();
+				pipeline->graphics_pipeline_create_info.pStages = reloaded.shader->stages.data();
+			}
+			else
+			{
+				pipeline->compute_pipeline_create_info.stage = reloaded.shader->stages[0];
+			}
+		}
+
+		m_num_reloaded++;
+	}
+	m_reloaded.clear();
+}
+
+void shader_compiler::show_ui()
+{
+	bool watch = watch_files;
+	if (ImGui::Checkbox("Hot Reload Shaders", &watch))
+	{
+		watch_files = watch;
+	}
+
+	ImGui::SameLine();
+	if (ImGui::Button("Reload Shaders"))
+	{
+		request_reload_all();
+	}
+
+	ImGui::Text("Reloaded : %u Failed : %u", m_num_reloaded.load(), m_num_failed.load());
+
+	std::lock_guard lock(m_mutex);
+	if (!m_last_error.empty())
+	{
+		ImGui::TextColored(ImVec4(1, 0, 0, 1), "%s", m_last_error.c_str());
+	}
+}
@@ -0,0 +1,101 @@
+#pragma once
+
+#include "core/engine/vulkan/vk_common.h"
+
+#include <atomic>
+#include <condition_variable>
+#include <filesystem>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+struct Pipeline;
+struct Shader;
+
+/*
+	In-process GLSL to SPIR-V compilation (libshaderc) and shader hot reload.
+	Pipelines register themselves on creation. A background thread watches the shader sources : when a source or
+	one of its includes changes, the shaders using it are recompiled and their pipelines created again on that thread.
+	update() swaps the new pipelines in at the start of a frame, the old pipelines and modules are retired to the
+	VkResourceManager. The previous pipeline is kept when compilation fails.
+*/
+class shader_compiler
+{
+public:
+	static shader_compiler& get_instance()
+	{
+		static shader_compiler instance;
+		return instance;
+	}
+
+	static inline const std::string source_folder = "../../../data/shaders/vulkan/";
+	static inline const std::string spirv_folder = source_folder + "spirv/";
+	static inline const std::string header_folder = source_folder + "headers/";
+
+	/* Starts watching the shader sources */
+	void init();
+
+	/* Stops the watcher. Call once the device is idle. */
+	void destroy();
+
+	/* Compiles a file of source_folder (e.g. "forward_frag.frag"), the stage is given by the extension */
+	bool compile(std::string_view shader_file, std::vector<uint32_t>& out_spirv, std::string& out_errors) const;
+
+	/* Compiles a file of source_folder to spirv_folder/<shader_file>.spv */
+	bool compile_to_file(std::string_view shader_file) const;
+
+	/* Pipeline::create_graphics/create_compute */
+	void add_pipeline(Pipeline* pipeline);
+
+	/* Recompiles every registered shader in the background */
+	void request_reload_all();
+
+	/* Call once the fence of the frame has been waited : swaps reloaded pipelines */
+	void update();
+
+	/* Widgets drawn in the current window */
+	void show_ui();
+
+	std::atomic<bool> watch_files = true;
+	uint32_t poll_interval_ms = 250;
+
+	shader_compiler(const shader_compiler&) = delete;
+	shader_compiler& operator=(const shader_compiler&) = delete;
+private:
+	shader_compiler() = default;
+
+	/* New modules of a shader and the pipelines created from them, built on the watcher thread */
+	struct reloaded_shader
+	{
+		Shader* shader = nullptr;
+		std::vector<VkPipelineShaderStageCreateInfo> stages;
+		std::vector<std::pair<Pipeline*, VkPipeline>> pipelines;
+	};
+
+	void watch_loop();
+
+	/* Source files whose last write time changed since the previous scan */
+	std::vector<std::filesystem::path> scan_sources();
+
+	/* Source files of the shader and everything they include */
+	std::vector<std::filesystem::path> get_dependencies(const Pipeline& pipeline) const;
+
+	void reload(Shader* shader, const std::vector<Pipeline*>& pipelines);
+
+	std::thread m_thread;
+	std::mutex m_mutex;					/* Pipelines, reloaded shaders, saved create infos */
+	std::condition_variable m_wake;
+	bool m_stop = false;
+	bool m_reload_all = false;
+
+	std::vector<Pipeline*> m_pipelines;
+	std::vector<reloaded_shader> m_reloaded;
+	std::unordered_map<std::string, std::filesystem::file_time_type> m_write_times;
+
+	std::atomic<uint32_t> m_num_reloaded = 0;
+	std::atomic<uint32_t> m_num_failed = 0;
+	std::string m_last_error;			/* Under m_mutex */
+};
@@ -0,0 +1,309 @@
+#include "texture_streamer.h"
+#include "core/engine/logger.h"
+#include "core/rendering/vulkan/RenderObjectManager.h"
+#include "core/rendering/vulkan/VulkanRenderInterface.h"
+#include "core/rendering/vulkan/VulkanRendererBase.h"
+
+#include "imgui.h"
+#include "optick.h"
+
+#include <algorithm>
+#include <cstring>
+
+size_t texture_streamer::get_size_bytes(const streamed_texture& st, uint32_t first_mip)
+{
+	size_t size_bytes = 0;
+	for (uint32_t mip = first_mip; mip < st.mip_levels; mip++)
+	{
+		size_bytes += dds::get_mip_size_bytes(st.format, std::max(1u, st.w >> mip), std::max(1u, st.h >> mip));
+	}
+	return size_bytes;
+}
+
+int texture_streamer::add_texture(std::string_view name, std::string_view baked_path, compressed_image&& image)
+{
+	streamed_texture& st = m_textures.emplace_back();
+	st.name = name;
+	st.path = baked_path;
+	st.format = image.format;
+	st.w = image.w;
+	st.h = image.h;
+	st.mip_levels = image.mip_levels;
+	st.tail_mip = image.first_mip;
+	st.resident_mip = image.first_mip;
+	st.requested_mip = image.first_mip;
+	st.tail = std::move(image);
+
+	create_texture(st, st.tail);
+	if (st.texture_id == -1)
+	{
+		m_textures.pop_back();
+		return -1;
+	}
+
+	m_resident_bytes += get_size_bytes(st, st.resident_mip);
+	return st.texture_id;
+}
+
+void texture_streamer::create_texture(streamed_texture& st, const compressed_image& image)
+{
+	Texture2D texture;
+	texture.init(st.format, st.w, st.h, 1, false, st.name);
+	texture.create_from_data(image);
+	texture.create_view(ctx.device, { VK_IMAGE_VIEW_TYPE_2D, VK_IMAGE_ASPECT_COLOR_BIT, 0, texture.info.mipLevels });
+	texture.sampler = VulkanRendererCommon::get_instance().smp_repeat_linear;
+
+	ObjectManager& object_manager = ObjectManager::get_instance();
+	if (st.texture_id == -1)
+	{
+		st.texture_id = object_manager.add_texture(texture);
+		if (st.texture_id == -1)
+		{
+			texture.destroy();
+		}
+		return;
+	}
+
+	object_manager.m_textures[st.texture_id].retire();
+	object_manager.set_texture(st.texture_id, texture);
+}
+
+void texture_streamer::update(uint32_t frame_idx)
+{
+	if (m_textures.empty())
+	{
+		return;
+	}
+
+	read_feedback(frame_idx);
+
+	/* Swap in the mips loaded since the last update */
+	std::vector<completed_load> completed;
+	{
+		std::lock_guard lock(m_completed_mutex);
+		completed.swap(m_completed);
+	}
+
+	for (completed_load& load : completed)
+	{
+		streamed_texture& st = m_textures[load.index];
+		size_t resident_size_bytes = get_size_bytes(st, st.resident_mip);
+		m_pending_bytes -= st.pending_bytes;
+		st.pending_bytes = 0;
+		st.is_loading = false;
+
+		if (!load.success || load.image.first_mip >= st.resident_mip)
+		{
+			LOG_WARN("Texture streaming : could not load mips of {}", st.path);
+			continue;
+		}
+
+		create_texture(st, load.image);
+		m_resident_bytes += get_size_bytes(st, load.image.first_mip) - resident_size_bytes;
+		st.resident_mip = load.image.first_mip;
+		m_stats.num_loads++;
+	}
+
+	/* Budget lowered from the UI */
+	if (m_resident_bytes > budget_bytes)
+	{
+		evict_until(budget_bytes);
+	}
+
+	if (enabled)
+	{
+		schedule_loads();
+	}
+
+	m_stats.resident_bytes = m_resident_bytes;
+	m_stats.num_textures = (uint32_t)m_textures.size();
+	m_stats.num_pending_loads = m_pending_loads.get_value();
+	m_stats.requested_bytes = 0;
+	for (const streamed_texture& st : m_textures)
+	{
+		m_stats.requested_bytes += get_size_bytes(st, std::min(st.requested_mip, st.resident_mip));
+	}
+}
+
+void texture_streamer::read_feedback(uint32_t frame_idx)
+{
+	ObjectManager& object_manager = ObjectManager::get_instance();
+	size_t feedback_size_bytes = object_manager.max_bindless_textures * sizeof(uint32_t);
+
+	vk::buffer& feedback_ssbo = object_manager.m_texture_feedback_ssbo[frame_idx];
+	uint32_t* requested_sizes = (uint32_t*)feedback_ssbo.map(ctx.device, 0, feedback_size_bytes);
+
+	for (streamed_texture& st : m_textures)
+	{
+		uint32_t requested_size = requested_sizes[st.texture_id];
+		if (requested_size == 0)
+		{
+			/* Not sampled for a while : the top mips are not needed anymore */
+			if (ctx.frame_count - st.last_requested_frame > eviction_delay_frames)
+			{
+				st.requested_mip = st.tail_mip;
+			}
+			continue;
+		}
+
+		/* Smallest mip still at least as large as the requested size */
+		uint32_t mip = 0;
+		while (mip < st.tail_mip && std::max(st.w >> (mip + 1), st.h >> (mip + 1)) >= requested_size)
+		{
+			mip++;
+		}
+
+		st.requested_mip = mip;
+		st.last_requested_frame = ctx.frame_count;
+	}
+
+	/* The GPU is done with this frame : reset for its next use */
+	memset(requested_sizes, 0, feedback_size_bytes);
+	feedback_ssbo.unmap(ctx.device);
+}
+
+void texture_streamer::schedule_loads()
+{
+	m_stats.is_over_budget = false;
+
+	std::vector<size_t> candidates;
+	for (size_t i = 0; i < m_textures.size(); i++)
+	{
+		const streamed_texture& st = m_textures[i];
+		if (!st.is_loading && st.requested_mip < st.resident_mip)
+		{
+			candidates.push_back(i);
+		}
+	}
+
+	/* Largest resolution deficit first, most recently requested first */
+	std::sort(candidates.begin(), candidates.end(), [this](size_t a, size_t b)
+	{
+		const streamed_texture& st_a = m_textures[a];
+		const streamed_texture& st_b = m_textures[b];
+		uint32_t deficit_a = st_a.resident_mip - st_a.requested_mip;
+		uint32_t deficit_b = st_b.resident_mip - st_b.requested_mip;
+		return deficit_a != deficit_b ? deficit_a > deficit_b : st_a.last_requested_frame > st_b.last_requested_frame;
+	});
+
+	for (size_t index : candidates)
+	{
+		if (m_pending_loads.get_value() >= max_pending_loads)
+		{
+			break;
+		}
+
+		streamed_texture& st = m_textures[index];
+		size_t extra_bytes = get_size_bytes(st, st.requested_mip) - get_size_bytes(st, st.resident_mip);
+		if (m_resident_bytes + m_pending_bytes + extra_bytes > budget_bytes && !evict_until(budget_bytes - std::min(budget_bytes, m_pending_bytes + extra_bytes)))
+		{
+			m_stats.is_over_budget = true;
+			continue;
+		}
+
+		m_pending_bytes += extra_bytes;
+		st.pending_bytes = extra_bytes;
+		load(index);
+	}
+}
+
+void texture_streamer::load(size_t index)
+{
+	streamed_texture& st = m_textures[index];
+	st.is_loading = true;
+
+	uint32_t max_size = std::max(1u, std::max(st.w >> st.requested_mip, st.h >> st.requested_mip));
+	job_system::get_instance().run([this, index, path = st.path, max_size]()
+	{
+		OPTICK_EVENT("Load streamed texture");
+		OPTICK_TAG("Path", path.c_str());
+
+		completed_load load = { .index = index };
+		load.success = dds::load(path, load.image, max_size);
+
+		std::lock_guard lock(m_completed_mutex);
+		m_completed.push_back(std::move(load));
+	}, &m_pending_loads);
+}
+
+void texture_streamer::evict(streamed_texture& st)
+{
+	m_resident_bytes -= get_size_bytes(st, st.resident_mip) - get_size_bytes(st, st.tail_mip);
+	create_texture(st, st.tail);
+	st.resident_mip = st.tail_mip;
+	m_stats.num_evictions++;
+}
+
+bool texture_streamer::evict_until(size_t target_resident_bytes)
+{
+	/* Least recently requested first, only textures nothing asked for recently */
+	std::vector<streamed_texture*> candidates;
+	for (streamed_texture& st : m_textures)
+	{
+		if (!st.is_loading && st.resident_mip < st.tail_mip && ctx.frame_count - st.last_requested_frame > eviction_delay_frames)
+		{
+			candidates.push_back(&st);
+		}
+	}
+
+	std::sort(candidates.begin(), candidates.end(), [](const streamed_texture* a, const streamed_texture* b)
+	{
+		return a->last_requested_frame < b->last_requested_frame;
+	});
+
+	for (streamed_texture* st : candidates)
+	{
+		if (m_resident_bytes <= target_resident_bytes)
+		{
+			break;
+		}
+		evict(*st);
+	}
+
+	return m_resident_bytes <= target_resident_bytes;
+}
+
+void texture_streamer::destroy()
+{
+	job_system::get_instance().wait(m_pending_loads);
+
+	m_completed.clear();
+	m_textures.clear();
+	m_resident_bytes = 0;
+	m_pending_bytes = 0;
+	m_stats = {};
+}
+
+void texture_streamer::show_ui()
+{
+	if (ImGui::Begin("Texture Streaming"))
+	{
+		static constexpr double to_mb = 1.0 / (1024.0 * 1024.0);
+
+		ImGui::Checkbox("Enabled", &enabled);
+
+		int budget_mb = int(budget_bytes / (1024 * 1024));
+		if (ImGui::SliderInt("Budget (MB)", &budget_mb, 16, 4096))
+		{
+			budget_bytes = size_t(budget_mb) * 1024 * 1024;
+		}
+
+		int max_loads = (int)max_pending_loads;
+		if (ImGui::SliderInt("Max Pending Loads", &max_loads, 1, 64))
+		{
+			max_pending_loads = (uint32_t)max_loads;
+		}
+
+		ImGui::SeparatorText("Stats");
+		ImGui::Text("Streamed textures : %u", m_stats.num_textures);
+		ImGui::Text("Resident : %.2f MB / %.2f MB", m_stats.resident_bytes * to_mb, budget_bytes * to_mb);
+		ImGui::Text("Requested : %.2f MB", m_stats.requested_bytes * to_mb);
+		ImGui::Text("Pending loads : %u", m_stats.num_pending_loads);
+		ImGui::Text("Loads : %u Evictions : %u", m_stats.num_loads, m_stats.num_evictions);
+		if (m_stats.is_over_budget)
+		{
+			ImGui::TextColored({ 1.0f, 0.5f, 0.0f, 1.0f }, "Over budget : requests dropped");
+		}
+	}
+	ImGui::End();
+}
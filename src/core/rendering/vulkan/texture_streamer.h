@@ -0,0 +1,109 @@
+#pragma once
+
+#include "core/engine/dds.h"
+#include "core/engine/job_system.h"
+#include "core/rendering/vulkan/VulkanTexture.h"
+
+#include <deque>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <vector>
+
+/*
+	Streams the mip chain of offline baked (.dds) textures.
+	A streamed texture is created from its mip tail only (mips up to tail_size texels). The geometry pass writes
+	for each texture the largest size it needs to the mip feedback buffer of the frame (see ObjectManager).
+	update() reads it back once the frame has completed, loads the missing mips on the job system and replaces
+	the image behind the texture id when they arrive. Over budget, textures that have not been requested for a
+	while fall back to their mip tail, kept in memory so that evictions do not need IO.
+*/
+class texture_streamer
+{
+public:
+	static texture_streamer& get_instance()
+	{
+		static texture_streamer instance;
+		return instance;
+	}
+
+	/* Creates the texture from the mips loaded in image (see dds::load max_size) and registers it. Returns the texture id, -1 on failure. */
+	int add_texture(std::string_view name, std::string_view baked_path, compressed_image&& image);
+
+	/* Call once the fence of the frame has been waited : reads its feedback, swaps in loaded mips, schedules loads and evictions */
+	void update(uint32_t frame_idx);
+
+	/* Waits for pending loads. Images are released with the other resources. */
+	void destroy();
+
+	void show_ui();
+
+	struct stats
+	{
+		size_t resident_bytes = 0;
+		size_t requested_bytes = 0;		/* Resident size if every request was satisfied */
+		uint32_t num_textures = 0;
+		uint32_t num_pending_loads = 0;
+		uint32_t num_loads = 0;
+		uint32_t num_evictions = 0;
+		bool is_over_budget = false;		/* Last update had to drop requests */
+	};
+	const stats& get_stats() const { return m_stats; }
+
+	bool enabled = true;							/* Textures loaded while disabled are fully resident, no new loads are scheduled */
+	uint32_t tail_size = 128;						/* Mips up to this size are always resident */
+	size_t budget_bytes = 512ull * 1024 * 1024;		/* Streamed textures, tails included */
+	uint32_t max_pending_loads = 8;
+	uint32_t eviction_delay_frames = 240;			/* Frames without any request before a texture can give its mips back */
+
+	texture_streamer(const texture_streamer&) = delete;
+	texture_streamer& operator=(const texture_streamer&) = delete;
+private:
+	texture_streamer() = default;
+
+	struct streamed_texture
+	{
+		int texture_id = -1;
+		std::string name;
+		std::string path;
+		VkFormat format = VK_FORMAT_UNDEFINED;
+		uint32_t w = 0;
+		uint32_t h = 0;
+		uint32_t mip_levels = 0;
+		uint32_t tail_mip = 0;			/* First mip of the tail, always resident */
+		uint32_t resident_mip = 0;		/* First resident mip */
+		uint32_t requested_mip = 0;		/* From the feedback, tail_mip when not requested */
+		uint64_t last_requested_frame = 0;
+		bool is_loading = false;
+		size_t pending_bytes = 0;		/* Added to m_pending_bytes when the load was scheduled, requested_mip may change since */
+		compressed_image tail;
+	};
+
+	struct completed_load
+	{
+		size_t index = 0;
+		bool success = false;
+		compressed_image image;
+	};
+
+	void read_feedback(uint32_t frame_idx);
+	void schedule_loads();
+	void load(size_t index);
+	void evict(streamed_texture& st);
+	bool evict_until(size_t target_resident_bytes);
+
+	/* Creates the image for the mips in image and swaps it in. The previous image is destroyed once no frame uses it. */
+	void create_texture(streamed_texture& st, const compressed_image& image);
+
+	static size_t get_size_bytes(const streamed_texture& st, uint32_t first_mip);
+
+	std::deque<streamed_texture> m_textures;		/* Stable addresses : Texture::info.debugName points to the name */
+	size_t m_resident_bytes = 0;
+	size_t m_pending_bytes = 0;						/* Extra size of the textures being loaded */
+
+	std::mutex m_completed_mutex;
+	std::vector<completed_load> m_completed;
+	job_counter m_pending_loads;
+
+	stats m_stats;
+};
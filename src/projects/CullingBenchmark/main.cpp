@@ -0,0 +1,111 @@
+#include "core/engine/logger.h"
+#include "core/engine/job_system.h"
+#include "core/rendering/frustum_culling.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <random>
+#include <vector>
+
+/*
+	Usage : CullingBenchmark [--count N] [--iterations N]
+	Measures CPU frustum culling of N random boxes (one per primitive instance) : scalar reference,
+	SIMD on one thread and SIMD across the job system.
+*/
+
+using steady_clock = std::chrono::steady_clock;
+
+static double to_ms(steady_clock::duration d)
+{
+	return std::chrono::duration<double, std::milli>(d).count();
+}
+
+/* Boxes scattered in a 1000 units cube around the camera, sized like scene primitives */
+static void make_boxes(aabb_soa& boxes, size_t count)
+{
+	std::mt19937 rng(1234);
+	std::uniform_real_distribution<float> position(-500.0f, 500.0f);
+	std::uniform_real_distribution<float> extent(0.25f, 5.0f);
+
+	boxes.resize(count);
+	for (size_t i = 0; i < count; i++)
+	{
+		glm::vec3 center = { position(rng), position(rng), position(rng) };
+		glm::vec3 extents = { extent(rng), extent(rng), extent(rng) };
+		boxes.set(i, center - extents, center + extents);
+	}
+}
+
+/* Best time of the iterations, in ms */
+template<typename Func>
+static double bench(int iterations, Func&& func)
+{
+	double best = 1e30;
+	for (int i = 0; i < iterations; i++)
+	{
+		auto start = steady_clock::now();
+		func();
+		best = std::min(best, to_ms(steady_clock::now() - start));
+	}
+	return best;
+}
+
+static size_t count_visible(const std::vector<uint8_t>& visible, size_t count)
+{
+	return std::count(visible.begin(), visible.begin() + count, uint8_t(1));
+}
+
+int main(int argc, char* argv[])
+{
+	logger::init("Culling Benchmark");
+
+	size_t count = 262144;
+	int iterations = 50;
+	for (int i = 1; i < argc; i++)
+	{
+		if (strcmp(argv[i], "--count") == 0 && i + 1 < argc)
+		{
+			count = std::max(1, atoi(argv[++i]));
+		}
+		else if (strcmp(argv[i], "--iterations") == 0 && i + 1 < argc)
+		{
+			iterations = std::max(1, atoi(argv[++i]));
+		}
+	}
+
+	aabb_soa boxes;
+	make_boxes(boxes, count);
+
+	glm::mat4 view = glm::lookAtRH(glm::vec3(0.0f), glm::vec3(0.0f, 0.0f, -1.0f), glm::vec3(0.0f, 1.0f, 0.0f));
+	glm::mat4 proj = glm::perspectiveRH_ZO(glm::radians(60.0f), 16.0f / 9.0f, 0.1f, 400.0f);
+	glm::vec4 planes[6];
+	extract_frustum_planes(proj * view, planes);
+
+	std::vector<uint8_t> visible_scalar(boxes.padded_size());
+	std::vector<uint8_t> visible_simd(boxes.padded_size());
+	std::vector<uint8_t> visible_parallel(boxes.padded_size());
+
+	job_system& js = job_system::get_instance();
+	js.init();
+
+	double scalar_ms = bench(iterations, [&]() { cull_aabbs_scalar(boxes, planes, 0, boxes.size(), visible_scalar.data()); });
+	double simd_ms = bench(iterations, [&]() { cull_aabbs(boxes, planes, 0, boxes.padded_size(), visible_simd.data()); });
+	double parallel_ms = bench(iterations, [&]() { cull_aabbs_parallel(boxes, planes, visible_parallel.data()); });
+
+	size_t num_visible = count_visible(visible_scalar, count);
+	bool match = std::equal(visible_scalar.begin(), visible_scalar.begin() + count, visible_simd.begin())
+		&& std::equal(visible_scalar.begin(), visible_scalar.begin() + count, visible_parallel.begin());
+
+	printf("%zu boxes, %zu visible, SIMD width %zu, %u workers%s\n", count, num_visible, k_simd_width, js.get_num_threads(), match ? "" : ", RESULTS DIFFER");
+	printf("%10s %10s %14s %10s\n", "path", "ms", "Mboxes/s", "speedup");
+	printf("%10s %10.3f %14.1f %10.2f\n", "scalar", scalar_ms, count / (scalar_ms * 1e3), 1.0);
+	printf("%10s %10.3f %14.1f %10.2f\n", "simd", simd_ms, count / (simd_ms * 1e3), scalar_ms / simd_ms);
+	printf("%10s %10.3f %14.1f %10.2f\n", "parallel", parallel_ms, count / (parallel_ms * 1e3), scalar_ms / parallel_ms);
+
+	js.terminate();
+
+	return match ? 0 : 1;
+}
@@ -0,0 +1,173 @@
+#include "core/engine/logger.h"
+#include "core/engine/job_system.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+
+/*
+	Usage : JobBenchmark [--max-threads N]
+	Measures job throughput and scheduling latency for an increasing number of worker threads.
+*/
+
+using steady_clock = std::chrono::steady_clock;
+
+static double to_us(steady_clock::duration d)
+{
+	return std::chrono::duration<double, std::micro>(d).count();
+}
+
+/* Small amount of work per job so that the figures are dominated by scheduling */
+static uint32_t spin_work(uint32_t seed, int iterations)
+{
+	for (int i = 0; i < iterations; i++)
+	{
+		seed = seed * 1664525u + 1013904223u;
+	}
+	return seed;
+}
+
+/* Independent jobs scheduled from the main thread */
+static double bench_throughput(size_t num_jobs)
+{
+	job_system& js = job_system::get_instance();
+	std::atomic<uint32_t> sink = 0;
+
+	auto start = steady_clock::now();
+	job_counter counter;
+	for (size_t i = 0; i < num_jobs; i++)
+	{
+		js.run([&sink, i]() { sink.fetch_add(spin_work((uint32_t)i, 64), std::memory_order_relaxed); }, &counter);
+	}
+	js.wait(counter);
+	auto end = steady_clock::now();
+
+	return num_jobs / (to_us(end - start) * 1e-6);
+}
+
+/* Jobs spawning and waiting on their own children : exercises stealing and wait-but-help */
+static double bench_nested(size_t num_parents, size_t num_children)
+{
+	job_system& js = job_system::get_instance();
+	std::atomic<uint32_t> sink = 0;
+
+	auto start = steady_clock::now();
+	job_counter counter;
+	for (size_t p = 0; p < num_parents; p++)
+	{
+		js.run([&js, &sink, p, num_children]()
+		{
+			job_counter children;
+			for (size_t c = 0; c < num_children; c++)
+			{
+				js.run([&sink, p, c]() { sink.fetch_add(spin_work(uint32_t(p ^ c), 64), std::memory_order_relaxed); }, &children);
+			}
+			js.wait(children);
+		}, &counter);
+	}
+	js.wait(counter);
+	auto end = steady_clock::now();
+
+	return (num_parents * (num_children + 1)) / (to_us(end - start) * 1e-6);
+}
+
+/* Batched loop, as used by asset import */
+static double bench_parallel_for(size_t count)
+{
+	job_system& js = job_system::get_instance();
+	std::vector<uint32_t> results(count);
+
+	auto start = steady_clock::now();
+	js.parallel_for(count, [&](size_t i) { results[i] = spin_work((uint32_t)i, 16); }, 256);
+	auto end = steady_clock::now();
+
+	return count / (to_us(end - start) * 1e-6);
+}
+
+struct latency_result
+{
+	double avg_us = 0.0;
+	double p50_us = 0.0;
+	double p99_us = 0.0;
+};
+
+/* Time from run() on the main thread to a worker starting the job. The main thread does not help, workers idle in between. */
+static latency_result bench_latency(size_t num_samples)
+{
+	job_system& js = job_system::get_instance();
+	std::vector<double> samples(num_samples);
+
+	for (size_t i = 0; i < num_samples; i++)
+	{
+		steady_clock::time_point job_start;
+		job_counter counter;
+
+		auto scheduled = steady_clock::now();
+		js.run([&job_start]() { job_start = steady_clock::now(); }, &counter);
+		while (!counter.is_done())
+		{
+			std::this_thread::yield();
+		}
+
+		samples[i] = to_us(job_start - scheduled);
+	}
+
+	std::sort(samples.begin(), samples.end());
+
+	latency_result result;
+	for (double s : samples)
+	{
+		result.avg_us += s;
+	}
+	result.avg_us /= num_samples;
+	result.p50_us = samples[num_samples / 2];
+	result.p99_us = samples[std::min(num_samples - 1, num_samples * 99 / 100)];
+	return result;
+}
+
+int main(int argc, char* argv[])
+{
+	logger::init("Job Benchmark");
+
+	unsigned int max_threads = std::max(2u, std::thread::hardware_concurrency()) - 1;
+	for (int i = 1; i < argc; i++)
+	{
+		if (strcmp(argv[i], "--max-threads") == 0 && i + 1 < argc)
+		{
+			max_threads = std::max(1, atoi(argv[++i]));
+		}
+	}
+
+	std::vector<unsigned int> thread_counts;
+	for (unsigned int n = 1; n < max_threads; n *= 2)
+	{
+		thread_counts.push_back(n);
+	}
+	thread_counts.push_back(max_threads);
+
+	printf("%8s %14s %14s %16s %12s %12s %12s\n", "workers", "jobs/s", "nested/s", "parallel_for/s", "lat avg us", "lat p50 us", "lat p99 us");
+
+	for (unsigned int num_threads : thread_counts)
+	{
+		job_system& js = job_system::get_instance();
+		js.init(num_threads);
+
+		/* Warm up : threads started, allocator pools populated */
+		bench_throughput(10000);
+
+		double throughput = bench_throughput(200000);
+		double nested = bench_nested(1000, 64);
+		double parallel_for = bench_parallel_for(4000000);
+		latency_result latency = bench_latency(2000);
+
+		printf("%8u %14.0f %14.0f %16.0f %12.2f %12.2f %12.2f\n", num_threads, throughput, nested, parallel_for, latency.avg_us, latency.p50_us, latency.p99_us);
+
+		js.terminate();
+	}
+
+	return 0;
+}
@@ -4,12 +4,17 @@
 #include "rendering/vulkan/VulkanDebugUtils.h"
 #include "rendering/vulkan/VulkanRenderInterface.h"
 #include "rendering/vulkan/RenderObjectManager.h"
+#include "rendering/vulkan/VkResourceManager.h"
+#include "rendering/vulkan/pipeline_cache.h"
+#include "rendering/vulkan/texture_streamer.h"
 
 #include "glm/gtx/quaternion.hpp"
 
 #include "rendering/vulkan/Renderers/DebugLineRenderer.hpp"
 #include "rendering/vulkan/Renderers/DeferredRenderer.hpp"
+#include "rendering/vulkan/Renderers/DrawCommandGenerator.hpp"
 #include "rendering/vulkan/Renderers/ForwardRenderer.hpp"
+#include "rendering/vulkan/Renderers/HiZRenderer.hpp"
 #include "rendering/vulkan/Renderers/SkyboxRenderer.hpp"
 #include "rendering/vulkan/Renderers/ShadowRenderer.hpp"
 #include "rendering/vulkan/Renderers/VolumetricLightRenderer.hpp"
@@ -24,10 +29,35 @@ static SkyboxRenderer skybox_renderer;
 static IBLRenderer ibl_renderer;
 static ShadowRenderer shadow_renderer;
 static VolumetricLightRenderer volumetric_light_renderer;
+static DrawCommandGenerator draw_command_generator;
+static HiZRenderer hiz_renderer;
 static std::vector<size_t> drawable_list;
 
-SampleProject::SampleProject(const char* title, uint32_t width, uint32_t height)
-	: Application(title, width, height)
+/* Passes without draw metrics of their own, for their CPU record time */
+static DrawMetricsEntry volumetric_light_metrics;
+static DrawMetricsEntry skybox_metrics;
+static DrawMetricsEntry gui_metrics;
+
+/* Scaled copy of src to dst, src is left readable by shaders and dst in TRANSFER_DST_OPTIMAL */
+static void blit_to_target(VkCommandBuffer cmd_buffer, Texture2D& src, Texture2D& dst)
+{
+	src.transition(cmd_buffer, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, VK_ACCESS_TRANSFER_READ_BIT);
+	dst.transition(cmd_buffer, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_ACCESS_TRANSFER_WRITE_BIT);
+
+	VkImageBlit blit =
+	{
+		.srcSubresource = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 0, 1 },
+		.srcOffsets = { { 0, 0, 0 }, { (int32_t)src.info.width, (int32_t)src.info.height, 1 } },
+		.dstSubresource = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 0, 1 },
+		.dstOffsets = { { 0, 0, 0 }, { (int32_t)dst.info.width, (int32_t)dst.info.height, 1 } },
+	};
+	vkCmdBlitImage(cmd_buffer, src.image, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, dst.image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &blit, VK_FILTER_LINEAR);
+
+	src.transition(cmd_buffer, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, VK_ACCESS_SHADER_READ_BIT);
+}
+
+SampleProject::SampleProject(const char* title, uint32_t width, uint32_t height, const launch_options& options)
+	: Application(title, width, height, options)
 {
 	
 }
@@ -36,6 +66,13 @@ void SampleProject::init()
 {
 	ObjectManager::get_instance().init();
 
+	/* Pipelines of the renderers below are compiled in parallel, see pipeline_cache */
+	pipeline_cache::get_instance().begin_batch();
+
+	draw_command_generator.init();
+	draw_command_generator.lod_bias = m_options.lod_bias;
+	draw_command_generator.lod_shadow_size = (float)ShadowRenderer::k_depth_size;
+
 	lights.init();
 	shadow_renderer.init();
 	debug_line_renderer.init();
@@ -57,12 +94,32 @@ void SampleProject::init()
 	deferred_renderer.init();
 	volumetric_light_renderer.create_pipeline();
 
+	/* Occlusion culling against the depth of the geometry pass */
+	hiz_renderer.init();
+	for (uint32_t i = 0; i < NUM_FRAMES; i++)
+	{
+		draw_command_generator.set_depth_pyramid(HiZRenderer::pyramid[i], i);
+	}
+
 
 	skybox_renderer.init();
+
+	volumetric_light_metrics = DrawMetricsManager::add_entry("Volumetric Light");
+	skybox_metrics = DrawMetricsManager::add_entry("Skybox");
+	gui_metrics = DrawMetricsManager::add_entry("GUI");
+
 	m_camera.update_aspect_ratio(1.0f);
+	if (!m_options.camera_path.empty())
+	{
+		m_camera_path.load(m_options.camera_path);
+	}
 	skybox_renderer.init(cubemap_renderer.cubemap_attachment);
+	pipeline_cache::get_instance().end_batch();
+
 	create_scene();
 	lights.write_ssbo();
+
+	VkResourceManager::get_instance(ctx.device)->get_allocator().log_stats();
 }
 
 void SampleProject::compose_gui()
@@ -71,15 +128,19 @@ void SampleProject::compose_gui()
 	m_gui.begin();
 	m_gui.show_toolbar();
 	m_gui.show_hierarchy(object_manager);
-	//m_gui.show_draw_metrics();
+	m_gui.show_draw_metrics();
 	m_gui.show_shader_library();
 	m_gui.show_viewport_window(deferred_renderer.ui_texture_ids.light_accumulation[ctx.curr_frame_idx], m_camera, object_manager);
 	m_camera.show_ui();
 	deferred_renderer.show_ui(m_camera);
 	ibl_renderer.show_ui();
 	shadow_renderer.show_ui();
+	draw_command_generator.show_ui();
+	hiz_renderer.show_ui();
 	lights.show_ui();
 	volumetric_light_renderer.show_ui();
+	texture_streamer::get_instance().show_ui();
+	ctx.profiler.show_ui();
 	m_gui.end();
 }
 
@@ -98,7 +159,11 @@ void SampleProject::update_frame_ubo()
 void SampleProject::update(float t, float dt)
 {
 	/* Update camera */
-	if (m_window->is_in_focus())
+	if (!m_camera_path.is_empty())
+	{
+		m_camera_path.evaluate(t, m_camera);
+	}
+	else if (m_window && m_window->is_in_focus())
 	{
 		if (m_event_manager->key_event.is_key_pressed_async(Key::Z))
 		{
@@ -133,7 +198,10 @@ void SampleProject::update(float t, float dt)
 		}
 	}
 
-	compose_gui();
+	if (!is_headless())
+	{
+		compose_gui();
+	}
 }
 
 void SampleProject::render()
@@ -146,16 +214,72 @@ void SampleProject::render()
 
 	ctx.swapchain->clear_color(cmd_buffer);
 
-	shadow_renderer.render(cmd_buffer, drawable_list, m_camera, VulkanRendererCommon::get_instance().m_framedata[ctx.curr_frame_idx], lights.dir_light.dir);
+	/* Indirect draw commands of the shadow and geometry passes, culled against the cascades and the camera */
+	shadow_renderer.update_cascades(m_camera, lights.dir_light.dir);
+	{
+		ScopedRecordTimer timer(draw_command_generator.culling_metrics[DrawCommandGenerator::view_camera]);
+		const VulkanRendererCommon::FrameData& frame_data = VulkanRendererCommon::get_instance().m_framedata[ctx.curr_frame_idx];
+		draw_command_generator.lod_camera_height = (float)DeferredRenderer::render_size;
+		draw_command_generator.generate(cmd_buffer, frame_data.view_proj, glm::vec3(frame_data.camera_pos_ws), shadow_renderer.cascades_data[ctx.curr_frame_idx].dir_light_view_proj);
+	}
 
-	deferred_renderer.geometry_pass.render(cmd_buffer, drawable_list);
+	/* Shadow and geometry passes record their draws in parallel, see vk::parallel_recorder */
+	{
+		ScopedRecordTimer timer(shadow_renderer.draw_metrics);
+		shadow_renderer.render(cmd_buffer, drawable_list);
+	}
 
-	volumetric_light_renderer.render(cmd_buffer);	// Volumetric renderer needs depth buffer written by geometry pass
+	{
+		ScopedRecordTimer timer(deferred_renderer.geometry_pass.draw_metrics);
+		deferred_renderer.geometry_pass.render(cmd_buffer, drawable_list, DrawCommandGenerator::view_camera);
+	}
 
-	deferred_renderer.lighting_pass.render(cmd_buffer);
+	/* Two-phase occlusion culling : the instances visible last frame were drawn above, test the others against their depth */
+	if (draw_command_generator.is_occlusion_culling_active())
+	{
+		{
+			ScopedRecordTimer timer(hiz_renderer.draw_metrics);
+			hiz_renderer.render(cmd_buffer);
+		}
+
+		{
+			ScopedRecordTimer timer(draw_command_generator.culling_metrics[DrawCommandGenerator::view_camera_late]);
+			draw_command_generator.generate_late(cmd_buffer);
+		}
+
+		{
+			ScopedRecordTimer timer(deferred_renderer.geometry_pass.draw_metrics);
+			deferred_renderer.geometry_pass.render(cmd_buffer, drawable_list, DrawCommandGenerator::view_camera_late);
+		}
+	}
+
+	{
+		ScopedRecordTimer timer(volumetric_light_metrics);
+		volumetric_light_renderer.render(cmd_buffer);	// Volumetric renderer needs depth buffer written by geometry pass
+	}
+
+	{
+		ScopedRecordTimer timer(deferred_renderer.lighting_pass.draw_metrics);
+		deferred_renderer.lighting_pass.render(cmd_buffer);
+	}
 
-	skybox_renderer.render(cmd_buffer);
-	m_gui.render(cmd_buffer);
+	{
+		ScopedRecordTimer timer(skybox_metrics);
+		skybox_renderer.render(cmd_buffer);
+	}
+
+	if (!is_headless())
+	{
+		ScopedRecordTimer timer(gui_metrics);
+		m_gui.render(cmd_buffer);
+	}
+	else
+	{
+		/* No scene viewport : the lit scene is copied to the offscreen target */
+		Texture2D& scene = deferred_renderer.gbuffer.light_accumulation_attachment[ctx.curr_frame_idx];
+		Texture2D& target = ctx.swapchain->color_attachments[ctx.swapchain->current_backbuffer_idx];
+		blit_to_target(cmd_buffer, scene, target);
+	}
 }
 
 void SampleProject::update_gpu_buffers()
@@ -166,7 +290,19 @@ void SampleProject::update_gpu_buffers()
 
 void SampleProject::create_scene()
 {
+	VertexFormat vertex_format = m_options.packed_vertices ? VertexFormat::PACKED : VertexFormat::FLOAT;
+
+	if (!m_options.scene.empty())
+	{
+		VulkanMesh scene;
+		scene.vertex_format = vertex_format;
+		scene.create_from_file(m_options.scene);
+		drawable_list.push_back(ObjectManager::get_instance().add_mesh(scene, m_options.scene, { .position = { 0,0,0 }, .rotation = {0,0,0}, .scale = {  1, 1, 1 } }, true));
+		return;
+	}
+
 	VulkanMesh plane;
+	plane.vertex_format = vertex_format;
 	plane.create_from_file("basic/unit_plane.glb");
 	drawable_list.push_back(ObjectManager::get_instance().add_mesh(plane, "Floor", { .position = { 0,0,0 }, .rotation = {0,0,0}, .scale = {  25, 25, 25 } }));
 
@@ -196,6 +332,14 @@ void SampleProject::update_instances_ssbo()
 
 void SampleProject::exit()
 {
+	/* Compared with the frame timings of runs at other LOD biases */
+	if (is_headless() && draw_command_generator.num_stats_frames > 0)
+	{
+		LOG_INFO("LOD bias {:.1f} : {} camera triangles, {} shadow triangles per frame", draw_command_generator.lod_bias,
+			draw_command_generator.total_camera_triangles / draw_command_generator.num_stats_frames,
+			draw_command_generator.total_shadow_triangles / draw_command_generator.num_stats_frames);
+	}
+
 	m_gui.exit();
 }
 
@@ -11,7 +11,7 @@
 class SampleProject : public Application
 {
 public:
-	SampleProject(const char* title, uint32_t width, uint32_t height);
+	SampleProject(const char* title, uint32_t width, uint32_t height, const launch_options& options = {});
 
 	virtual void init() override;
 	virtual void create_scene();
@@ -33,4 +33,5 @@ public:
 private:
 	VulkanGUI m_gui;
 	camera m_camera;
+	camera_path m_camera_path;
 };
\ No newline at end of file
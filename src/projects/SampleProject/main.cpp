@@ -4,7 +4,7 @@
 
 int main(int argc, char* argv[])
 {
-	SampleProject app("Sample Project", 1024u, 1024u);
+	SampleProject app("Sample Project", 1024u, 1024u, Application::parse_command_line(argc, argv));
 	app.run();
 	return 0;
 }
\ No newline at end of file
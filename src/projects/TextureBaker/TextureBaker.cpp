@@ -0,0 +1,603 @@
+#include "TextureBaker.h"
+
+#include "core/engine/Image.h"
+#include "core/engine/logger.h"
+#include "core/engine/job_system.h"
+
+#include "cgltf.h"
+
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cmath>
+#include <filesystem>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace texture_baker
+{
+	/* ---------------------------------------------------------------------------------------------------- */
+	/* Mip chain generation																					*/
+	/* ---------------------------------------------------------------------------------------------------- */
+
+	static float srgb_to_linear(float c)
+	{
+		return c <= 0.04045f ? c / 12.92f : std::pow((c + 0.055f) / 1.055f, 2.4f);
+	}
+
+	static float linear_to_srgb(float c)
+	{
+		return c <= 0.0031308f ? c * 12.92f : 1.055f * std::pow(c, 1.0f / 2.4f) - 0.055f;
+	}
+
+	/* Level in a filtering friendly space : linear color, or [-1, 1] vectors for normal maps */
+	struct float_image
+	{
+		uint32_t w = 0;
+		uint32_t h = 0;
+		std::vector<std::array<float, 4>> texels;
+	};
+
+	static float_image to_float(const uint8_t* rgba, uint32_t w, uint32_t h, usage tex_usage)
+	{
+		float_image result = { w, h, std::vector<std::array<float, 4>>(size_t(w) * h) };
+
+		for (size_t i = 0; i < result.texels.size(); i++)
+		{
+			std::array<float, 4>& t = result.texels[i];
+			for (int c = 0; c < 4; c++)
+			{
+				t[c] = rgba[i * 4 + c] / 255.0f;
+			}
+
+			if (tex_usage == usage::COLOR_SRGB)
+			{
+				for (int c = 0; c < 3; c++) t[c] = srgb_to_linear(t[c]);
+			}
+			else if (tex_usage == usage::NORMAL_MAP)
+			{
+				for (int c = 0; c < 3; c++) t[c] = t[c] * 2.0f - 1.0f;
+			}
+		}
+
+		return result;
+	}
+
+	static std::vector<uint8_t> to_rgba8(const float_image& image, usage tex_usage)
+	{
+		std::vector<uint8_t> result(image.texels.size() * 4);
+
+		for (size_t i = 0; i < image.texels.size(); i++)
+		{
+			std::array<float, 4> t = image.texels[i];
+
+			if (tex_usage == usage::COLOR_SRGB)
+			{
+				for (int c = 0; c < 3; c++) t[c] = linear_to_srgb(t[c]);
+			}
+			else if (tex_usage == usage::NORMAL_MAP)
+			{
+				float len = std::sqrt(t[0] * t[0] + t[1] * t[1] + t[2] * t[2]);
+				float inv_len = len > 0.0f ? 1.0f / len : 0.0f;
+				for (int c = 0; c < 3; c++) t[c] = t[c] * inv_len * 0.5f + 0.5f;
+			}
+
+			for (int c = 0; c < 4; c++)
+			{
+				result[i * 4 + c] = (uint8_t)std::lround(std::clamp(t[c], 0.0f, 1.0f) * 255.0f);
+			}
+		}
+
+		return result;
+	}
+
+	/* 2x2 box filter, edges are clamped for odd sizes */
+	static float_image downsample(const float_image& src)
+	{
+		float_image dst = { std::max(1u, src.w / 2), std::max(1u, src.h / 2) };
+		dst.texels.resize(size_t(dst.w) * dst.h);
+
+		for (uint32_t y = 0; y < dst.h; y++)
+		{
+			for (uint32_t x = 0; x < dst.w; x++)
+			{
+				uint32_t x0 = std::min(x * 2, src.w - 1), x1 = std::min(x * 2 + 1, src.w - 1);
+				uint32_t y0 = std::min(y * 2, src.h - 1), y1 = std::min(y * 2 + 1, src.h - 1);
+
+				const auto& a = src.texels[size_t(y0) * src.w + x0];
+				const auto& b = src.texels[size_t(y0) * src.w + x1];
+				const auto& c = src.texels[size_t(y1) * src.w + x0];
+				const auto& d = src.texels[size_t(y1) * src.w + x1];
+
+				auto& out = dst.texels[size_t(y) * dst.w + x];
+				for (int ch = 0; ch < 4; ch++)
+				{
+					out[ch] = 0.25f * (a[ch] + b[ch] + c[ch] + d[ch]);
+				}
+			}
+		}
+
+		return dst;
+	}
+
+	/* ---------------------------------------------------------------------------------------------------- */
+	/* Block encoders																						*/
+	/* ---------------------------------------------------------------------------------------------------- */
+
+	struct bit_writer
+	{
+		uint8_t* data;
+		uint32_t bit = 0;
+
+		void write(uint32_t value, uint32_t num_bits)
+		{
+			for (uint32_t i = 0; i < num_bits; i++, bit++)
+			{
+				if (value & (1u << i))
+				{
+					data[bit >> 3] |= uint8_t(1u << (bit & 7));
+				}
+			}
+		}
+	};
+
+	/* BC7 mode 6 : single subset, 7-bit RGBA endpoints + 1 unique p-bit per endpoint, 4-bit indices */
+	static constexpr int bc7_weights4[16] = { 0, 4, 9, 13, 17, 21, 26, 30, 34, 38, 43, 47, 51, 55, 60, 64 };
+
+	struct bc7_endpoint
+	{
+		int q[4];	/* 7-bit quantized */
+		int p;		/* p-bit */
+
+		int value(int c) const { return (q[c] << 1) | p; }
+	};
+
+	static bc7_endpoint quantize_bc7_endpoint(const float e[4])
+	{
+		bc7_endpoint best = {};
+		float best_err = 1e30f;
+
+		for (int p = 0; p < 2; p++)
+		{
+			bc7_endpoint candidate = {};
+			candidate.p = p;
+			float err = 0.0f;
+
+			for (int c = 0; c < 4; c++)
+			{
+				candidate.q[c] = std::clamp((int)std::lround((e[c] - p) * 0.5f), 0, 127);
+				float d = float(candidate.value(c)) - e[c];
+				err += d * d;
+			}
+
+			if (err < best_err)
+			{
+				best_err = err;
+				best = candidate;
+			}
+		}
+
+		return best;
+	}
+
+	/* Assigns each texel to its closest palette entry, returns the total squared error */
+	static uint32_t assign_bc7_indices(const uint8_t texels[16][4], const bc7_endpoint& e0, const bc7_endpoint& e1, int out_indices[16])
+	{
+		int palette[16][4];
+		for (int i = 0; i < 16; i++)
+		{
+			for (int c = 0; c < 4; c++)
+			{
+				palette[i][c] = ((64 - bc7_weights4[i]) * e0.value(c) + bc7_weights4[i] * e1.value(c) + 32) >> 6;
+			}
+		}
+
+		uint32_t total_err = 0;
+		for (int t = 0; t < 16; t++)
+		{
+			uint32_t best_err = UINT32_MAX;
+			for (int i = 0; i < 16; i++)
+			{
+				uint32_t err = 0;
+				for (int c = 0; c < 4; c++)
+				{
+					int d = palette[i][c] - texels[t][c];
+					err += uint32_t(d * d);
+				}
+
+				if (err < best_err)
+				{
+					best_err = err;
+					out_indices[t] = i;
+				}
+			}
+			total_err += best_err;
+		}
+
+		return total_err;
+	}
+
+	/* Least squares endpoints for fixed indices */
+	static bool refine_bc7_endpoints(const uint8_t texels[16][4], const int indices[16], float out_e0[4], float out_e1[4])
+	{
+		float a00 = 0, a01 = 0, a11 = 0;
+		float b0[4] = {}, b1[4] = {};
+
+		for (int t = 0; t < 16; t++)
+		{
+			float w = bc7_weights4[indices[t]] / 64.0f;
+			a00 += (1 - w) * (1 - w);
+			a01 += (1 - w) * w;
+			a11 += w * w;
+			for (int c = 0; c < 4; c++)
+			{
+				b0[c] += (1 - w) * texels[t][c];
+				b1[c] += w * texels[t][c];
+			}
+		}
+
+		float det = a00 * a11 - a01 * a01;
+		if (std::abs(det) < 1e-6f)
+		{
+			return false;
+		}
+
+		float inv_det = 1.0f / det;
+		for (int c = 0; c < 4; c++)
+		{
+			out_e0[c] = std::clamp((a11 * b0[c] - a01 * b1[c]) * inv_det, 0.0f, 255.0f);
+			out_e1[c] = std::clamp((a00 * b1[c] - a01 * b0[c]) * inv_det, 0.0f, 255.0f);
+		}
+
+		return true;
+	}
+
+	void encode_block_bc7(const uint8_t texels[16][4], uint8_t out_block[16])
+	{
+		/* Principal axis of the block colors */
+		float mean[4] = {};
+		for (int t = 0; t < 16; t++)
+		{
+			for (int c = 0; c < 4; c++) mean[c] += texels[t][c] / 16.0f;
+		}
+
+		float cov[4][4] = {};
+		for (int t = 0; t < 16; t++)
+		{
+			float d[4];
+			for (int c = 0; c < 4; c++) d[c] = texels[t][c] - mean[c];
+			for (int i = 0; i < 4; i++)
+			{
+				for (int j = 0; j < 4; j++) cov[i][j] += d[i] * d[j];
+			}
+		}
+
+		float axis[4] = { 1.0f, 1.0f, 1.0f, 1.0f };
+		for (int iter = 0; iter < 8; iter++)
+		{
+			float next[4] = {};
+			for (int i = 0; i < 4; i++)
+			{
+				for (int j = 0; j < 4; j++) next[i] += cov[i][j] * axis[j];
+			}
+
+			float len = std::sqrt(next[0] * next[0] + next[1] * next[1] + next[2] * next[2] + next[3] * next[3]);
+			if (len < 1e-6f)
+			{
+				break;
+			}
+			for (int i = 0; i < 4; i++) axis[i] = next[i] / len;
+		}
+
+		float t_min = 1e30f, t_max = -1e30f;
+		for (int t = 0; t < 16; t++)
+		{
+			float proj = 0.0f;
+			for (int c = 0; c < 4; c++) proj += (texels[t][c] - mean[c]) * axis[c];
+			t_min = std::min(t_min, proj);
+			t_max = std::max(t_max, proj);
+		}
+
+		float e0[4], e1[4];
+		for (int c = 0; c < 4; c++)
+		{
+			e0[c] = std::clamp(mean[c] + axis[c] * t_min, 0.0f, 255.0f);
+			e1[c] = std::clamp(mean[c] + axis[c] * t_max, 0.0f, 255.0f);
+		}
+
+		bc7_endpoint q0 = quantize_bc7_endpoint(e0);
+		bc7_endpoint q1 = quantize_bc7_endpoint(e1);
+		int indices[16];
+		uint32_t err = assign_bc7_indices(texels, q0, q1, indices);
+
+		for (int iter = 0; iter < 2 && err > 0; iter++)
+		{
+			if (!refine_bc7_endpoints(texels, indices, e0, e1))
+			{
+				break;
+			}
+
+			bc7_endpoint r0 = quantize_bc7_endpoint(e0);
+			bc7_endpoint r1 = quantize_bc7_endpoint(e1);
+			int refined_indices[16];
+			uint32_t refined_err = assign_bc7_indices(texels, r0, r1, refined_indices);
+
+			if (refined_err >= err)
+			{
+				break;
+			}
+
+			err = refined_err;
+			q0 = r0;
+			q1 = r1;
+			std::copy(refined_indices, refined_indices + 16, indices);
+		}
+
+		/* The anchor index (texel 0) is stored with an implicit 0 MSB */
+		if (indices[0] & 0x8)
+		{
+			std::swap(q0, q1);
+			for (int& i : indices) i = 15 - i;
+		}
+
+		std::fill(out_block, out_block + 16, uint8_t(0));
+		bit_writer bits = { out_block };
+		bits.write(1u << 6, 7);
+		for (int c = 0; c < 4; c++)
+		{
+			bits.write(q0.q[c], 7);
+			bits.write(q1.q[c], 7);
+		}
+		bits.write(q0.p, 1);
+		bits.write(q1.p, 1);
+		bits.write(indices[0], 3);
+		for (int t = 1; t < 16; t++)
+		{
+			bits.write(indices[t], 4);
+		}
+	}
+
+	/* BC4 : 2 8-bit endpoints, 8 interpolated values, 3-bit indices */
+	static void encode_block_bc4(const uint8_t values[16], uint8_t out_block[8])
+	{
+		uint8_t r0 = *std::max_element(values, values + 16);
+		uint8_t r1 = *std::min_element(values, values + 16);
+
+		int palette[8] = { r0, r1 };
+		for (int i = 2; i < 8; i++)
+		{
+			palette[i] = ((8 - i) * r0 + (i - 1) * r1 + 3) / 7;
+		}
+
+		std::fill(out_block, out_block + 8, uint8_t(0));
+		bit_writer bits = { out_block };
+		bits.write(r0, 8);
+		bits.write(r1, 8);
+
+		for (int t = 0; t < 16; t++)
+		{
+			int best = 0;
+			int best_err = INT32_MAX;
+			for (int i = 0; i < 8; i++)
+			{
+				int err = std::abs(palette[i] - values[t]);
+				if (err < best_err)
+				{
+					best_err = err;
+					best = i;
+				}
+			}
+			bits.write(best, 3);
+		}
+	}
+
+	/* BC5 : two BC4 blocks for the red and green channels */
+	void encode_block_bc5(const uint8_t texels[16][4], uint8_t out_block[16])
+	{
+		uint8_t r[16], g[16];
+		for (int t = 0; t < 16; t++)
+		{
+			r[t] = texels[t][0];
+			g[t] = texels[t][1];
+		}
+
+		encode_block_bc4(r, out_block);
+		encode_block_bc4(g, out_block + 8);
+	}
+
+	/* ---------------------------------------------------------------------------------------------------- */
+	/* Image baking																							*/
+	/* ---------------------------------------------------------------------------------------------------- */
+
+	static VkFormat get_bake_format(usage tex_usage)
+	{
+		switch (tex_usage)
+		{
+		case usage::COLOR_SRGB:		return VK_FORMAT_BC7_SRGB_BLOCK;
+		case usage::COLOR_LINEAR:	return VK_FORMAT_BC7_UNORM_BLOCK;
+		case usage::NORMAL_MAP:		return VK_FORMAT_BC5_UNORM_BLOCK;
+		}
+		return VK_FORMAT_UNDEFINED;
+	}
+
+	static void encode_level(const uint8_t* rgba, uint32_t w, uint32_t h, usage tex_usage, uint8_t* out)
+	{
+		uint32_t blocks_x = std::max(1u, (w + 3) / 4);
+		uint32_t blocks_y = std::max(1u, (h + 3) / 4);
+
+		job_system::get_instance().parallel_for(blocks_y, [&](size_t by)
+		{
+			for (uint32_t bx = 0; bx < blocks_x; bx++)
+			{
+				uint8_t texels[16][4];
+				for (uint32_t t = 0; t < 16; t++)
+				{
+					uint32_t x = std::min(bx * 4 + (t & 3), w - 1);
+					uint32_t y = std::min(uint32_t(by) * 4 + (t >> 2), h - 1);
+					std::copy_n(rgba + (size_t(y) * w + x) * 4, 4, texels[t]);
+				}
+
+				uint8_t* block = out + (size_t(by) * blocks_x + bx) * 16;
+				if (tex_usage == usage::NORMAL_MAP)
+				{
+					encode_block_bc5(texels, block);
+				}
+				else
+				{
+					encode_block_bc7(texels, block);
+				}
+			}
+		});
+	}
+
+	compressed_image bake(const uint8_t* rgba, uint32_t w, uint32_t h, usage tex_usage)
+	{
+		compressed_image result;
+		result.format = get_bake_format(tex_usage);
+		result.w = w;
+		result.h = h;
+		result.mip_levels = uint32_t(std::floor(std::log2(std::max(w, h)))) + 1;
+
+		size_t total_size_bytes = 0;
+		for (uint32_t mip = 0; mip < result.mip_levels; mip++)
+		{
+			result.mip_offsets.push_back(total_size_bytes);
+			result.mip_sizes.push_back(dds::get_mip_size_bytes(result.format, std::max(1u, w >> mip), std::max(1u, h >> mip)));
+			total_size_bytes += result.mip_sizes.back();
+		}
+		result.data.resize(total_size_bytes);
+
+		encode_level(rgba, w, h, tex_usage, result.data.data());
+
+		float_image level = to_float(rgba, w, h, tex_usage);
+		for (uint32_t mip = 1; mip < result.mip_levels; mip++)
+		{
+			level = downsample(level);
+			std::vector<uint8_t> level_rgba = to_rgba8(level, tex_usage);
+			encode_level(level_rgba.data(), level.w, level.h, tex_usage, result.data.data() + result.mip_offsets[mip]);
+		}
+
+		return result;
+	}
+
+	/* ---------------------------------------------------------------------------------------------------- */
+	/* Model baking																							*/
+	/* ---------------------------------------------------------------------------------------------------- */
+
+	struct texture_entry
+	{
+		cgltf_texture* tex;
+		usage tex_usage;
+	};
+
+	bool bake_model(std::string_view model_path, bool force)
+	{
+		std::string filename(model_path);
+
+		cgltf_options options = {};
+		cgltf_data* data = nullptr;
+		cgltf_result result = cgltf_parse_file(&options, filename.c_str(), &data);
+		if (result == cgltf_result_success)
+		{
+			result = cgltf_load_buffers(&options, data, filename.c_str());
+		}
+
+		if (result != cgltf_result_success)
+		{
+			LOG_ERROR("Could not read GLTF/GLB file {} [error code : {}]", filename, (int)result);
+			cgltf_free(data);
+			return false;
+		}
+
+		/* Same naming as the runtime loader (VulkanMesh.cpp) so that baked files are found next to the source */
+		std::string base_path = filename.substr(0, filename.find_last_of('/') + 1);
+		auto get_texture_name = [&](cgltf_texture* tex)
+		{
+			return tex->image->uri ? base_path + tex->image->uri : base_path + tex->image->name;
+		};
+
+		/* First usage wins, as in the runtime loader */
+		std::unordered_map<std::string, texture_entry> textures;
+		for (size_t i = 0; i < data->materials_count; i++)
+		{
+			cgltf_material* mat = &data->materials[i];
+			auto add = [&](cgltf_texture* tex, usage tex_usage)
+			{
+				if (tex && tex->image)
+				{
+					textures.insert({ get_texture_name(tex), { tex, tex_usage } });
+				}
+			};
+
+			add(mat->normal_texture.texture, usage::NORMAL_MAP);
+			add(mat->emissive_texture.texture, usage::COLOR_SRGB);
+			if (mat->has_pbr_metallic_roughness)
+			{
+				add(mat->pbr_metallic_roughness.base_color_texture.texture, usage::COLOR_SRGB);
+				add(mat->pbr_metallic_roughness.metallic_roughness_texture.texture, usage::COLOR_LINEAR);
+			}
+		}
+
+		size_t num_baked = 0;
+		size_t num_skipped = 0;
+		size_t source_size_bytes = 0;
+		size_t baked_size_bytes = 0;
+
+		for (const auto& [name, entry] : textures)
+		{
+			std::string baked_path = dds::get_baked_path(name);
+			const char* uri = entry.tex->image->uri;
+
+			std::error_code ec;
+			bool is_up_to_date = std::filesystem::exists(baked_path, ec) &&
+				(!uri || std::filesystem::last_write_time(baked_path, ec) > std::filesystem::last_write_time(name, ec));
+
+			if (is_up_to_date && !force)
+			{
+				num_skipped++;
+				continue;
+			}
+
+			auto start = std::chrono::steady_clock::now();
+
+			Image image;
+			if (uri)
+			{
+				image.load_from_file(name);
+			}
+			else
+			{
+				const uint8_t* buffer_view = cgltf_buffer_view_data(entry.tex->image->buffer_view);
+				image.load_from_buffer(buffer_view, entry.tex->image->buffer_view->size);
+			}
+
+			if (!image.get_data())
+			{
+				LOG_ERROR("Could not decode {}", name);
+				continue;
+			}
+
+			compressed_image baked = bake(static_cast<const uint8_t*>(image.get_data()), image.w, image.h, entry.tex_usage);
+			if (!dds::write(baked_path, baked))
+			{
+				continue;
+			}
+
+			/* Uncompressed size includes the mip chain the runtime would have generated */
+			size_t rgba_size_bytes = size_t(image.w) * image.h * 4 * 4 / 3;
+			source_size_bytes += rgba_size_bytes;
+			baked_size_bytes += baked.data.size();
+			num_baked++;
+
+			auto end = std::chrono::steady_clock::now();
+			LOG_INFO("{} -> {} ({}x{}, {} mips, {} KB -> {} KB, {:.1f} ms)", name, baked_path, image.w, image.h, baked.mip_levels,
+				rgba_size_bytes / 1024, baked.data.size() / 1024, std::chrono::duration<double, std::milli>(end - start).count());
+		}
+
+		LOG_INFO("Baked {} textures, {} up to date. Total size {} KB -> {} KB.", num_baked, num_skipped, source_size_bytes / 1024, baked_size_bytes / 1024);
+
+		cgltf_free(data);
+		return true;
+	}
+}
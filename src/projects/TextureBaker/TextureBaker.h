@@ -0,0 +1,30 @@
+#pragma once
+
+#include "core/engine/dds.h"
+
+#include <string_view>
+
+/*
+	Offline texture baker : encodes the textures referenced by a glTF model to block-compressed .dds files
+	with their full mip chain, next to the source images (see dds::get_baked_path).
+	Normal maps are encoded to BC5 (the shader reconstructs Z), everything else to BC7.
+*/
+namespace texture_baker
+{
+	enum class usage
+	{
+		COLOR_SRGB,		/* Base color, emissive */
+		COLOR_LINEAR,	/* Metallic-roughness */
+		NORMAL_MAP,
+	};
+
+	/* Builds the mip chain of an RGBA8 image and encodes every level */
+	compressed_image bake(const uint8_t* rgba, uint32_t w, uint32_t h, usage tex_usage);
+
+	/* Bakes every texture referenced by the materials of a model. Up to date textures are skipped unless force is set. */
+	bool bake_model(std::string_view model_path, bool force);
+
+	/* Single 4x4 block encoders. Input is 16 RGBA8 texels in row-major order. */
+	void encode_block_bc7(const uint8_t texels[16][4], uint8_t out_block[16]);
+	void encode_block_bc5(const uint8_t texels[16][4], uint8_t out_block[16]);
+}
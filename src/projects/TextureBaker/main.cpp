@@ -0,0 +1,45 @@
+#include "core/engine/logger.h"
+#include "core/engine/job_system.h"
+
+#include "TextureBaker.h"
+
+#include <cstdio>
+#include <cstring>
+
+/*
+	Usage : TextureBaker [--force] <model.gltf|model.glb> [...]
+	Model paths are relative to the working directory, e.g. ../../../data/models/sponza/Sponza.gltf
+*/
+int main(int argc, char* argv[])
+{
+	logger::init("Texture Baker");
+
+	bool force = false;
+	int num_models = 0;
+	int num_failed = 0;
+
+	for (int i = 1; i < argc; i++)
+	{
+		if (strcmp(argv[i], "--force") == 0)
+		{
+			force = true;
+			continue;
+		}
+
+		num_models++;
+		if (!texture_baker::bake_model(argv[i], force))
+		{
+			num_failed++;
+		}
+	}
+
+	if (num_models == 0)
+	{
+		printf("Usage : TextureBaker [--force] <model.gltf|model.glb> [...]\n");
+		return 1;
+	}
+
+	job_system::get_instance().terminate();
+
+	return num_failed ? 1 : 0;
+}